@@ -23,6 +23,7 @@ class Value;
 class Instruction;
 class CallInst;
 } // namespace llvm
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Attributes.h"
@@ -172,9 +173,13 @@ private:
 
   struct OpCodeCacheItem {
     llvm::SmallMapVector<llvm::Type *, llvm::Function *, 8> pOverloads;
+    // Overloads on the basic types (void, h, f, d, i1, i8, i16, i32, i64),
+    // indexed by type slot; mirrors those entries of pOverloads so the common
+    // GetOpFunc lookups don't have to search it.
+    llvm::Function *pBasicOverloads[kUserDefineTypeSlot];
   };
   OpCodeCacheItem m_OpCodeClassCache[(unsigned)OpCodeClass::NumOpClasses];
-  std::unordered_map<const llvm::Function *, OpCodeClass> m_FunctionToOpClass;
+  llvm::DenseMap<const llvm::Function *, OpCodeClass> m_FunctionToOpClass;
   void UpdateCache(OpCodeClass opClass, llvm::Type *Ty, llvm::Function *F);
 
 private:
@@ -37,7 +37,49 @@ ZlibResult ZlibDecompress(IMalloc *pMalloc, const void *pCompressedBuffer,
 //
 typedef void *ZlibCallbackFn(void *pUserData, size_t RequiredSize);
 
+// Compression levels, as in zlib: 0 stores the data uncompressed, 1 is the
+// fastest and 9 the smallest. The default trades the two off.
+const int ZlibDefaultCompression = -1;
+const int ZlibNoCompression = 0;
+const int ZlibBestSpeed = 1;
+const int ZlibBestCompression = 9;
+
 ZlibResult ZlibCompress(IMalloc *pMalloc, const void *pData, size_t pDataSize,
                         void *pUserData, ZlibCallbackFn *Callback,
-                        size_t *pOutCompressedSize);
+                        size_t *pOutCompressedSize,
+                        int Level = ZlibDefaultCompression);
+
+//
+// Compresses data that is handed over in pieces, so callers need not gather
+// it into one buffer first. The compressed output decompresses to all the
+// pieces concatenated, and is passed to Callback in segments as it is
+// produced.
+//
+class ZlibCompressStream {
+public:
+  ZlibCompressStream(IMalloc *pMalloc, void *pUserData,
+                     ZlibCallbackFn *Callback,
+                     int Level = ZlibDefaultCompression);
+  ~ZlibCompressStream();
+
+  ZlibResult Write(const void *pData, size_t DataSize);
+  // Writes out the rest of the compressed data; nothing may be written after.
+  ZlibResult Finish();
+  // Size of the compressed data passed to Callback so far.
+  size_t GetCompressedSize() const { return m_CompressedSize; }
+
+private:
+  ZlibCompressStream(const ZlibCompressStream &) = delete;
+  ZlibCompressStream &operator=(const ZlibCompressStream &) = delete;
+
+  struct Impl;
+  ZlibResult Deflate(int Flush);
+
+  Impl *m_pImpl = nullptr;
+  void *m_pUserData;
+  ZlibCallbackFn *m_Callback;
+  size_t m_CompressedSize = 0;
+  // First failure; once set, every call returns it.
+  ZlibResult m_Result = ZlibResult::Success;
+};
 } // namespace hlsl
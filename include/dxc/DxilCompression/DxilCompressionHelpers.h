@@ -21,9 +21,19 @@
 
 namespace hlsl {
 
+// ZlibCallbackFn that grows the Buffer passed as pUserData by RequiredSize.
+template <typename Buffer>
+void *ZlibAppendCallback(void *pUserData, size_t RequiredSize) {
+  Buffer *pBuffer = (Buffer *)pUserData;
+  const size_t lastSize = pBuffer->size();
+  pBuffer->resize(pBuffer->size() + RequiredSize);
+  return pBuffer->data() + lastSize;
+}
+
 template <typename Buffer>
 ZlibResult ZlibCompressAppend(IMalloc *pMalloc, const void *pData,
-                              size_t dataSize, Buffer &outBuffer) {
+                              size_t dataSize, Buffer &outBuffer,
+                              int level = ZlibDefaultCompression) {
   static_assert(sizeof(typename Buffer::value_type) == sizeof(uint8_t),
                 "Cannot append to a non-byte-sized buffer.");
 
@@ -49,16 +59,9 @@ ZlibResult ZlibCompressAppend(IMalloc *pMalloc, const void *pData,
   const size_t sizeBeforeCompress = outBuffer.size();
   size_t compressedDataSize = 0;
 
-  ZlibResult ret = ZlibCompress(
-      pMalloc, pData, dataSize, &outBuffer,
-      [](void *pUserData, size_t requiredSize) -> void * {
-        Buffer *pBuffer = (Buffer *)pUserData;
-        const size_t lastSize = pBuffer->size();
-        pBuffer->resize(pBuffer->size() + requiredSize);
-        void *ptr = pBuffer->data() + lastSize;
-        return ptr;
-      },
-      &compressedDataSize);
+  ZlibResult ret =
+      ZlibCompress(pMalloc, pData, dataSize, &outBuffer,
+                   ZlibAppendCallback<Buffer>, &compressedDataSize, level);
 
   if (ret == ZlibResult::Success) {
     // Resize the buffer to what was actually added to the end.
@@ -71,16 +74,17 @@ ZlibResult ZlibCompressAppend(IMalloc *pMalloc, const void *pData,
 
 template ZlibResult ZlibCompressAppend<llvm::SmallVectorImpl<char>>(
     IMalloc *pMalloc, const void *pData, size_t dataSize,
-    llvm::SmallVectorImpl<char> &outBuffer);
+    llvm::SmallVectorImpl<char> &outBuffer, int level);
 template ZlibResult ZlibCompressAppend<llvm::SmallVectorImpl<uint8_t>>(
     IMalloc *pMalloc, const void *pData, size_t dataSize,
-    llvm::SmallVectorImpl<uint8_t> &outBuffer);
+    llvm::SmallVectorImpl<uint8_t> &outBuffer, int level);
 template ZlibResult
 ZlibCompressAppend<std::vector<char>>(IMalloc *pMalloc, const void *pData,
                                       size_t dataSize,
-                                      std::vector<char> &outBuffer);
+                                      std::vector<char> &outBuffer, int level);
 template ZlibResult
 ZlibCompressAppend<std::vector<uint8_t>>(IMalloc *pMalloc, const void *pData,
                                          size_t dataSize,
-                                         std::vector<uint8_t> &outBuffer);
+                                         std::vector<uint8_t> &outBuffer,
+                                         int level);
 } // namespace hlsl
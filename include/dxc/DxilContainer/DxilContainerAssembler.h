@@ -12,6 +12,7 @@
 #pragma once
 
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 #include <functional>
 
@@ -82,6 +83,8 @@ void StripAndCreateReflectionStream(
 
 void WriteProgramPart(const hlsl::ShaderModel *pModel,
                       AbstractMemoryStream *pModuleBitcode, IStream *pStream);
+void WriteProgramPart(const hlsl::ShaderModel *pModel,
+                      llvm::ArrayRef<uint8_t> ModuleBitcode, IStream *pStream);
 
 void SerializeDxilContainerForModule(
     hlsl::DxilModule *pModule, AbstractMemoryStream *pModuleBitcode,
@@ -90,7 +93,8 @@ void SerializeDxilContainerForModule(
     DxilShaderHash *pShaderHashOut = nullptr,
     AbstractMemoryStream *pReflectionStreamOut = nullptr,
     AbstractMemoryStream *pRootSigStreamOut = nullptr,
-    void *pPrivateData = nullptr, size_t PrivateDataSize = 0);
+    void *pPrivateData = nullptr, size_t PrivateDataSize = 0,
+    AbstractMemoryStream *pProgramBitcodeOut = nullptr);
 void SerializeDxilContainerForRootSignature(
     hlsl::RootSignatureHandle *pRootSigHandle, AbstractMemoryStream *pStream);
 
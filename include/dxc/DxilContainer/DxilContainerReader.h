@@ -15,12 +15,23 @@
 #include "dxc/Support/Global.h"
 #include "dxc/Support/WinIncludes.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include <memory>
+
+namespace llvm {
+class MemoryBuffer;
+}
+
+class DxilPipelineStateValidation;
 
 namespace hlsl {
 
 const uint32_t DXIL_CONTAINER_BLOB_NOT_FOUND = UINT_MAX;
 
 struct DxilContainerHeader;
+namespace RDAT {
+class DxilRuntimeData;
+}
 
 //============================================================================
 // DxilContainerReader
@@ -39,9 +50,14 @@ struct DxilContainerHeader;
 // (3) You can parse a new container by calling Load() again, or just get rid
 //     of the class.
 //
+// The reader never copies the container: everything it returns, including
+// the RDAT and PSV readers, points into the buffer passed to Load(), or into
+// the file mapping owned by the reader after LoadFile().
+//
 class DxilContainerReader {
 public:
-  DxilContainerReader() {}
+  DxilContainerReader();
+  ~DxilContainerReader();
 
   // Sets the container to be parsed, and does some
   // basic integrity checking, making sure the blob FourCCs
@@ -49,9 +65,17 @@ public:
   //     Major = DXBC_MAJOR_VERSION
   //     Minor = DXBC_MAJOR_VERSION
   //
+  // The container must outlive the reader.
   // Returns S_OK or E_FAIL
   HRESULT Load(const void *pContainer, uint32_t containerSizeInBytes);
 
+  // Maps the file at fileName (small files are read instead) and loads the
+  // container in it. The file is accessed through the thread's
+  // MSFileSystem, and stays mapped until the reader is loaded again or
+  // destroyed.
+  // Returns S_OK or E_FAIL
+  HRESULT LoadFile(llvm::StringRef fileName);
+
   HRESULT GetVersion(DxilContainerVersion *pResult);
   HRESULT GetPartCount(uint32_t *pResult);
   HRESULT GetPartContent(uint32_t idx, const void **ppResult,
@@ -59,10 +83,22 @@ public:
   HRESULT GetPartFourCC(uint32_t idx, uint32_t *pResult);
   HRESULT FindFirstPartKind(uint32_t kind, uint32_t *pResult);
 
+  // Gets the content of the first part of the given kind.
+  // Returns DXC_E_MISSING_PART if there is none.
+  HRESULT FindFirstPartContent(uint32_t kind, const void **ppResult,
+                               uint32_t *pResultSize = nullptr);
+
+  // Initializes RDAT / PSV readers over the RDAT / PSV0 part in place.
+  // Returns DXC_E_MISSING_PART if the part isn't present, and
+  // DXC_E_CONTAINER_INVALID if it is malformed.
+  HRESULT GetRuntimeData(RDAT::DxilRuntimeData &RDAT);
+  HRESULT GetPipelineStateValidation(DxilPipelineStateValidation &PSV);
+
 private:
   const void *m_pContainer = nullptr;
   uint32_t m_uContainerSize = 0;
   const DxilContainerHeader *m_pHeader = nullptr;
+  std::unique_ptr<llvm::MemoryBuffer> m_pFileBuffer;
 
   bool IsLoaded() const { return m_pHeader != nullptr; }
 };
@@ -29,6 +29,16 @@ typedef void HASH_FUNCTION_PROTO(const BYTE *pData, UINT32 byteCount,
 // Computes a 128-bit hash of pData (size byteCount), returning 16 BYTE output
 void ComputeHashRetail(const BYTE *pData, UINT32 byteCount, BYTE *pOutHash);
 void ComputeHashDebug(const BYTE *pData, UINT32 byteCount, BYTE *pOutHash);
+// Computes the hashes of count buffers, writing DXIL_CONTAINER_HASH_SIZE bytes
+// per buffer to pOutHashes in order. The results are identical to hashing
+// each buffer on its own, but several buffers are hashed at once with SIMD
+// where the target supports it.
+void ComputeHashRetailMultiple(const BYTE *const *ppData,
+                               const UINT32 *pByteCounts, UINT32 count,
+                               BYTE *pOutHashes);
+void ComputeHashDebugMultiple(const BYTE *const *ppData,
+                              const UINT32 *pByteCounts, UINT32 count,
+                              BYTE *pOutHashes);
 // **************************************************************************************
 // **** DO NOT USE THESE ROUTINES TO PROVIDE FUNCTIONALITY THAT NEEDS TO BE
 // SECURE!!! ***
@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilInterpreter.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// A CPU reference interpreter for DXIL compute shaders.                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/DXIL/DxilConstants.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace hlsl {
+
+class DxilModule;
+
+struct DxilInterpStats {
+  uint64_t Groups;           // Thread groups dispatched.
+  uint64_t Waves;            // Waves launched.
+  uint64_t WaveInstructions; // Instructions executed, once per wave.
+  uint64_t LaneInstructions; // Instructions executed, once per active lane.
+};
+
+/// Runs the compute entry point of a DXIL module on the CPU.
+///
+/// Each wave executes in lockstep: every instruction runs over a loop of
+/// its active lanes, divergent lanes reconverge at the immediate
+/// post-dominator of the branch, and wave and quad operations see exactly
+/// the lanes a GPU would have active. The waves of a thread group run in
+/// turn, switching at group barriers.
+///
+/// Resources are CPU-side memory bound by register. Typed buffers hold their
+/// components at the width of their component type, without format
+/// conversion. Out-of-bounds loads return zero and out-of-bounds stores are
+/// dropped, as on D3D. Textures, samplers and operations outside compute
+/// shaders are not supported; executing one throws an hlsl::Exception with
+/// DXC_E_NOT_SUPPORTED.
+class DxilInterpreter {
+public:
+  /// The module must outlive the interpreter, and is not modified.
+  explicit DxilInterpreter(DxilModule &DM);
+  ~DxilInterpreter();
+
+  /// Sets the number of lanes in a wave, a power of two between 4 and 128.
+  /// Defaults to the wave size the entry point requires, or 32.
+  void SetWaveSize(unsigned WaveSize);
+  unsigned GetWaveSize() const;
+
+  /// Binds Size bytes at Data to register Register in space Space of the
+  /// given resource class. The memory is not copied; UAV writes land in it.
+  void BindResource(DXIL::ResourceClass Class, unsigned Space,
+                    unsigned Register, void *Data, size_t Size);
+  void SetUAVCounter(unsigned Space, unsigned Register, uint32_t Value);
+  uint32_t GetUAVCounter(unsigned Space, unsigned Register) const;
+
+  /// Runs X * Y * Z thread groups of the entry point.
+  void Dispatch(unsigned X, unsigned Y, unsigned Z);
+
+  const DxilInterpStats &GetStats() const;
+  void ResetStats();
+
+private:
+  class Impl;
+  std::unique_ptr<Impl> m_pImpl;
+};
+
+} // namespace hlsl
@@ -14,6 +14,7 @@
 #include "dxc/DXIL/DxilConstants.h"
 #include "dxc/Support/Global.h"
 #include "dxc/WinAdapter.h"
+#include "llvm/ADT/StringRef.h"
 #include <memory>
 
 namespace llvm {
@@ -68,6 +69,33 @@ HRESULT ValidateDxilContainer(const void *pContainer, uint32_t ContainerSize,
                               llvm::Module *pDebugModule,
                               llvm::raw_ostream &DiagStream);
 
+// Full container validation of a module that is already loaded, skipping the
+// bitcode load. ModuleBitcode is the bitcode the caller serialized pModule to;
+// the DXIL part of the container must hold exactly these bytes. pModule is
+// validated in place and not modified.
+HRESULT ValidateDxilContainerWithModule(const void *pContainer,
+                                        uint32_t ContainerSize,
+                                        llvm::Module *pModule,
+                                        llvm::StringRef ModuleBitcode,
+                                        llvm::Module *pDebugModule,
+                                        llvm::raw_ostream &DiagStream);
+
+// Limits the threads used to validate a module on the current thread,
+// including the calling thread, while in scope. Without a limit, large
+// libraries are validated on up to one thread per hardware thread; callers that
+// already validate on a pool of their own threads should use a limit of 1.
+class ScopedValidationThreadLimit {
+public:
+  explicit ScopedValidationThreadLimit(unsigned MaxThreads);
+  ~ScopedValidationThreadLimit();
+
+  // Returns the limit in effect on the current thread, or 0 if there is none.
+  static unsigned GetLimit();
+
+private:
+  unsigned m_PrevMaxThreads;
+};
+
 class PrintDiagnosticContext {
 private:
   llvm::DiagnosticPrinter &m_Printer;
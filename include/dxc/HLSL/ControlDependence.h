@@ -10,11 +10,16 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #pragma once
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/ADT/iterator_range.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Dominators.h"
 
-#include <unordered_map>
-#include <unordered_set>
+#include <cstddef>
+#include <iterator>
+#include <vector>
 
 namespace llvm {
 class Function;
@@ -23,32 +28,65 @@ class raw_ostream;
 
 namespace hlsl {
 
-using BasicBlockSet = std::unordered_set<llvm::BasicBlock *>;
 using PostDomRelationType = llvm::DominatorTreeBase<llvm::BasicBlock>;
 
+/// Blocks are numbered densely and the blocks each block is control dependent
+/// on are kept as a sparse bit vector row. Compute only records the post
+/// dominator tree; a row is computed, along with the rows it is derived from,
+/// the first time it is queried.
 class ControlDependence {
+  using BlockRow = llvm::SparseBitVector<>;
+
 public:
+  class BlockIterator {
+    BlockRow::iterator m_It;
+    const std::vector<llvm::BasicBlock *> *m_pBlocks;
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = llvm::BasicBlock *;
+    using difference_type = std::ptrdiff_t;
+    using pointer = llvm::BasicBlock **;
+    using reference = llvm::BasicBlock *;
+
+    BlockIterator(BlockRow::iterator It,
+                  const std::vector<llvm::BasicBlock *> *pBlocks)
+        : m_It(It), m_pBlocks(pBlocks) {}
+    llvm::BasicBlock *operator*() const { return (*m_pBlocks)[*m_It]; }
+    BlockIterator &operator++() {
+      ++m_It;
+      return *this;
+    }
+    bool operator==(const BlockIterator &RHS) const { return m_It == RHS.m_It; }
+    bool operator!=(const BlockIterator &RHS) const { return m_It != RHS.m_It; }
+  };
+  using BlockRange = llvm::iterator_range<BlockIterator>;
+
   void Compute(llvm::Function *F, PostDomRelationType &PostDomRel);
   void Clear();
-  const BasicBlockSet &GetCDBlocks(llvm::BasicBlock *pBB) const;
+  BlockRange GetCDBlocks(llvm::BasicBlock *pBB) const;
   void print(llvm::raw_ostream &OS);
   void dump();
 
 private:
-  using BasicBlockVector = std::vector<llvm::BasicBlock *>;
-  using ControlDependenceType =
-      std::unordered_map<llvm::BasicBlock *, BasicBlockSet>;
+  static const unsigned kNoBlock = ~0u;
 
   llvm::Function *m_pFunc;
-  ControlDependenceType m_ControlDependence;
-  BasicBlockSet m_EmptyBBSet;
-
-  llvm::BasicBlock *GetIPostDom(PostDomRelationType &PostDomRel,
-                                llvm::BasicBlock *pBB);
-  void ComputeRevTopOrderRec(PostDomRelationType &PostDomRel,
-                             llvm::BasicBlock *pBB,
-                             BasicBlockVector &RevTopOrder,
-                             BasicBlockSet &VisitedBBs);
+  std::vector<llvm::BasicBlock *> m_Blocks;
+  llvm::DenseMap<llvm::BasicBlock *, unsigned> m_BlockIndex;
+  // Immediate post dominator of each block, or kNoBlock.
+  std::vector<unsigned> m_IPostDom;
+  // Children of block i in the post dominator tree are
+  // m_PostDomChildren[m_PostDomChildBegin[i]..m_PostDomChildBegin[i + 1]).
+  std::vector<unsigned> m_PostDomChildBegin;
+  std::vector<unsigned> m_PostDomChildren;
+  // Rows, and which of them have been computed.
+  mutable std::vector<BlockRow> m_ControlDependence;
+  mutable llvm::BitVector m_Computed;
+  BlockRow m_EmptyRow;
+
+  const BlockRow &GetRow(unsigned BlockIdx) const;
+  void ComputeRow(unsigned BlockIdx) const;
 };
 
 } // namespace hlsl
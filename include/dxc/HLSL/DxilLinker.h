@@ -12,11 +12,13 @@
 #pragma once
 
 #include "dxc/HLSL/DxilExportMap.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/ErrorOr.h"
 
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -32,6 +34,20 @@ namespace hlsl {
 class DxilModule;
 class DxilResourceBase;
 
+// An entry point to link with DxilLinker::LinkEntries, and its result.
+struct DxilLinkEntry {
+  DxilLinkEntry(llvm::StringRef entry, llvm::StringRef profile)
+      : Entry(entry), Profile(profile) {}
+  std::string Entry;
+  std::string Profile;
+  // Context of pModule. Each entry is linked in a context of its own.
+  std::unique_ptr<llvm::LLVMContext> pContext;
+  // The linked module, or null if linking failed.
+  std::unique_ptr<llvm::Module> pModule;
+  // Diagnostics reported while linking the entry.
+  std::string Diagnostics;
+};
+
 // Linker for DxilModule.
 class DxilLinker {
 public:
@@ -43,9 +59,13 @@ public:
     m_valMajor = valMajor, m_valMinor = valMinor;
   }
   virtual bool HasLibNameRegistered(llvm::StringRef name) = 0;
+  // If set, bitcode is what the registered module (pDebugModule if present)
+  // is loaded from. It must stay alive while the lib is registered, and is
+  // required to link the lib with LinkEntries.
   virtual bool RegisterLib(llvm::StringRef name,
                            std::unique_ptr<llvm::Module> pModule,
-                           std::unique_ptr<llvm::Module> pDebugModule) = 0;
+                           std::unique_ptr<llvm::Module> pDebugModule,
+                           llvm::StringRef bitcode = llvm::StringRef()) = 0;
   virtual bool AttachLib(llvm::StringRef name) = 0;
   virtual bool DetachLib(llvm::StringRef name) = 0;
   virtual void DetachAll() = 0;
@@ -54,6 +74,16 @@ public:
   Link(llvm::StringRef entry, llvm::StringRef profile,
        dxilutil::ExportMap &exportMap) = 0;
 
+  // Links each of entries against the attached libs for a non-library
+  // profile, on up to maxThreads threads (0 for one per hardware thread).
+  // Each entry is linked in its own LLVMContext, against its own lazily
+  // loaded copy of the attached libs, which all read the bitcode the libs
+  // were registered with. The result for each entry is the module Link
+  // returns for it. Returns false, with an error reported on the linker's
+  // context, if an attached lib was registered without bitcode.
+  virtual bool LinkEntries(llvm::MutableArrayRef<DxilLinkEntry> entries,
+                           unsigned maxThreads) = 0;
+
 protected:
   DxilLinker(llvm::LLVMContext &Ctx, unsigned valMajor, unsigned valMinor)
       : m_ctx(Ctx), m_valMajor(valMajor), m_valMinor(valMinor) {}
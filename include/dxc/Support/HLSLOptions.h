@@ -235,6 +235,11 @@ public:
   bool TimeReport = false;              // OPT_ftime_report
   std::string TimeTrace = "";           // OPT_ftime_trace[EQ]
   unsigned TimeTraceGranularity = 500;  // OPT_ftime_trace_granularity_EQ
+  bool PassProfile = false;             // OPT_fpass_profile
+  bool ArenaAlloc = false;              // OPT_farena_alloc
+  bool ReuseLLVMContext = false;        // OPT_freuse_llvm_context
+  llvm::StringRef CompileCacheDir;      // OPT_fcompile_cache_EQ
+  bool IncrementalLib = false;          // OPT_fincremental_lib
   bool VerifyDiagnostics = false;       // OPT_verify
 
   // Optimization pass enables, disables and selects
@@ -16,6 +16,7 @@
 #include "dxc/dxcapi.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 
 // Simple adaptor for IStream. Can probably do better.
 class raw_stream_ostream : public llvm::raw_ostream {
@@ -33,6 +34,36 @@ public:
   ~raw_stream_ostream() override { flush(); }
 };
 
+// Adaptor for a stream that is only written to, such as one provided by an
+// API caller. Memory use is bounded by the buffer size, since each full buffer
+// is written out, and so is the size of each write to the stream.
+class raw_sequential_stream_ostream : public llvm::raw_ostream {
+private:
+  CComPtr<ISequentialStream> m_pStream;
+  uint64_t m_Position = 0;
+  size_t m_ChunkSize;
+  void write_impl(const char *Ptr, size_t Size) override {
+    while (Size > 0) {
+      ULONG cb = (ULONG)std::min(Size, m_ChunkSize);
+      ULONG cbWritten = 0;
+      IFT(m_pStream->Write(Ptr, cb, &cbWritten));
+      IFTBOOL(cbWritten == cb, E_FAIL);
+      Ptr += cb;
+      Size -= cb;
+      m_Position += cb;
+    }
+  }
+  uint64_t current_pos() const override { return m_Position; }
+
+public:
+  raw_sequential_stream_ostream(ISequentialStream *pStream,
+                                size_t BufferSize = 64 * 1024)
+      : m_pStream(pStream), m_ChunkSize(BufferSize) {
+    SetBufferSize(BufferSize);
+  }
+  ~raw_sequential_stream_ostream() override { flush(); }
+};
+
 namespace {
 HRESULT TranslateUtf8StringForOutput(LPCSTR pStr, SIZE_T size, UINT32 codePage,
                                      IDxcBlobEncoding **ppBlobEncoding) {
@@ -106,6 +137,9 @@ inline DxcOutputType DxcGetOutputType(DXC_OUT_KIND kind) {
   case DXC_OUT_REMARKS:
   case DXC_OUT_TIME_REPORT:
   case DXC_OUT_TIME_TRACE:
+  case DXC_OUT_COMPILE_CACHE_STATS:
+  case DXC_OUT_PASS_PROFILE:
+  case DXC_OUT_ALLOCATOR_STATS:
     return DxcOutputType_Text;
   default:
     return DxcOutputType_None;
@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcarena.h                                                                //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides an arena allocator for compile-lifetime allocations.             //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/Support/Global.h"
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/microcom.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace hlsl {
+
+struct DxcArenaStats {
+  uint64_t AllocCount;        // Allocations requested, including large ones.
+  uint64_t AllocatedBytes;    // Bytes requested, including large allocations.
+  uint64_t LiveBytes;         // Bytes in arena blocks not yet freed.
+  uint64_t PeakLiveBytes;     // High-water mark of LiveBytes.
+  uint64_t ReservedBytes;     // Bytes in chunks not yet released.
+  uint64_t PeakReservedBytes; // High-water mark of ReservedBytes.
+  uint64_t ChunkCount;        // Chunks reserved over the arena's lifetime.
+  uint64_t ParentAllocCount;  // Allocations passed through to the parent.
+};
+
+struct DxcArenaState;
+struct DxcArenaChunk;
+
+/// An IMalloc that carves allocations out of large chunks by bumping an atomic
+/// offset. Block sizes are rounded up to size classes, and a block freed while
+/// the arena is alive is kept for later allocations of its class; these free
+/// lists, and chunk replacement, are guarded by mutexes. The
+/// memory of a chunk is returned to the system at once when the arena is
+/// released and all its blocks are freed, so a block that outlives the arena
+/// keeps its whole chunk alive; results that outlive a compile should be
+/// copied to another allocator.
+///
+/// Large allocations, and pointers the arena did not allocate, are passed
+/// through to the parent allocator, so the arena can be installed as the
+/// thread allocator in the middle of a compile.
+class DxcArenaMalloc : public IMalloc {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  DxcArenaState *m_pState;
+  // The chunk allocations are carved out of. Replaced under m_mutex.
+  std::atomic<DxcArenaChunk *> m_pCurrent;
+  std::mutex m_mutex;
+  // Every chunk reserved by this arena, linked through their headers.
+  DxcArenaChunk *m_pChunks;
+
+  void *AllocSlow(SIZE_T cb);
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_ALLOC(DxcArenaMalloc)
+  DxcArenaMalloc(IMalloc *pParent);
+  ~DxcArenaMalloc();
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid,
+                                           void **ppvObject) override {
+    return DoBasicQueryInterface<IMalloc>(this, iid, ppvObject);
+  }
+
+  void *STDMETHODCALLTYPE Alloc(SIZE_T cb) override;
+  void *STDMETHODCALLTYPE Realloc(void *pv, SIZE_T cb) override;
+  void STDMETHODCALLTYPE Free(void *pv) override;
+  SIZE_T STDMETHODCALLTYPE GetSize(void *pv) override;
+  int STDMETHODCALLTYPE DidAlloc(void *pv) override;
+  void STDMETHODCALLTYPE HeapMinimize(void) override;
+
+  /// Returns true if pv points into a chunk of this arena.
+  bool Owns(const void *pv) const;
+
+  void GetStats(DxcArenaStats *pStats) const;
+};
+
+/// Chunks of all arenas that are not yet released. While it is zero, no
+/// pointer can be an arena block.
+extern std::atomic<uint64_t> g_DxcArenaLiveChunkCount;
+
+bool DxcArenaFreeSlow(void *pv) throw();
+
+/// Frees pv if it was allocated by any arena, whether or not that arena is
+/// still alive. Returns false, doing nothing, for other pointers. Inline so
+/// that, while no arena memory exists, deletes only pay a load and a branch.
+inline bool DxcArenaFree(void *pv) throw() {
+  // A pointer can only be an arena block while some chunk is registered. The
+  // thread freeing it has seen that chunk's registration, so a relaxed load
+  // cannot read zero.
+  if (g_DxcArenaLiveChunkCount.load(std::memory_order_relaxed) == 0)
+    return false;
+  return DxcArenaFreeSlow(pv);
+}
+
+} // namespace hlsl
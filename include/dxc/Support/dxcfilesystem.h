@@ -28,6 +28,16 @@ class MSFileSystem;
 } // namespace sys
 } // namespace llvm
 
+CROSS_PLATFORM_UUIDOF(IDxcCachingIncludeHandler,
+                      "9765ba8d-51e7-4fcd-9164-b6f802d6bce7")
+/// Implemented by the include handlers IDxcIncludeCache creates, so that
+/// DxcArgsFileSystem can get files already decoded with its code page.
+struct IDxcCachingIncludeHandler : public IDxcIncludeHandler {
+  virtual HRESULT STDMETHODCALLTYPE
+  LoadSourceUtf8(LPCWSTR pFilename, UINT32 defaultCodePage,
+                 IDxcBlobUtf8 **ppIncludeSource) = 0;
+};
+
 namespace dxcutil {
 
 class DxcArgsFileSystem : public ::llvm::sys::fs::MSFileSystem {
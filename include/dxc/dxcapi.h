@@ -742,8 +742,14 @@ typedef enum DXC_OUT_KIND {
       12, ///< IDxcBlobUtf8 or IDxcBlobWide - text directed at stdout.
   DXC_OUT_TIME_TRACE =
       13, ///< IDxcBlobUtf8 or IDxcBlobWide - text directed at stdout.
+  DXC_OUT_COMPILE_CACHE_STATS =
+      14, ///< IDxcBlobUtf8 or IDxcBlobWide - compile cache hit/miss report.
+  DXC_OUT_PASS_PROFILE =
+      15, ///< IDxcBlobUtf8 or IDxcBlobWide - per-pass statistics as JSON.
+  DXC_OUT_ALLOCATOR_STATS =
+      16, ///< IDxcBlobUtf8 or IDxcBlobWide - compile arena statistics.
 
-  DXC_OUT_LAST = DXC_OUT_TIME_TRACE, ///< Last value for a counter.
+  DXC_OUT_LAST = DXC_OUT_ALLOCATOR_STATS, ///< Last value for a counter.
 
   DXC_OUT_NUM_ENUMS,
   DXC_OUT_FORCE_DWORD = 0xFFFFFFFF
@@ -865,6 +871,126 @@ struct IDxcCompiler3 : public IUnknown {
       ) = 0;
 };
 
+CROSS_PLATFORM_UUIDOF(IDxcStreamPreprocessor,
+                      "5423923d-14bc-4450-a24a-90e2927fb46f")
+/// \brief Interface to preprocess HLSL source into a caller-provided stream.
+///
+/// Obtain it with QueryInterface on an instance created with
+/// CLSID_DxcCompiler.
+struct IDxcStreamPreprocessor : public IUnknown {
+  /// \brief Preprocess HLSL source, writing the text to pOutput as it is
+  /// produced.
+  ///
+  /// Behaves like IDxcCompiler3::Compile with -P, which pArguments must
+  /// include, except that the preprocessed text is written to pOutput in
+  /// chunks as UTF-8 rather than accumulated in memory. The result holds the
+  /// status and errors but no DXC_OUT_HLSL output. If preprocessing fails,
+  /// pOutput may have received part of the text.
+  virtual HRESULT STDMETHODCALLTYPE PreprocessToStream(
+      _In_ const DxcBuffer *pSource, ///< Source text to preprocess.
+      _In_opt_count_(argCount)
+          LPCWSTR *pArguments, ///< Array of pointers to arguments.
+      _In_ UINT32 argCount,    ///< Number of arguments.
+      _In_opt_ IDxcIncludeHandler
+          *pIncludeHandler, ///< user-provided interface to handle include
+                            ///< directives (optional).
+      _In_ IStream *pOutput, ///< Receives the preprocessed text.
+      _In_ REFIID riid,      ///< Interface ID for the result.
+      _Out_ LPVOID *ppResult ///< IDxcResult: status and errors.
+      ) = 0;
+};
+
+/// \brief A single compile in a batch passed to IDxcBatchCompiler.
+///
+/// The fields match the parameters of IDxcCompiler3::Compile. Everything the
+/// job points to must stay valid until IDxcBatchCompiler::CompileBatch
+/// returns.
+struct DxcBatchCompileJob {
+  const DxcBuffer *pSource; ///< Source text to compile.
+  LPCWSTR *pArguments;      ///< Array of pointers to arguments.
+  UINT32 argCount;          ///< Number of arguments.
+  IDxcIncludeHandler
+      *pIncludeHandler; ///< user-provided interface to handle include
+                        ///< directives (optional). Jobs may run on any
+                        ///< worker thread, so a handler shared between jobs
+                        ///< must be thread-safe.
+};
+
+CROSS_PLATFORM_UUIDOF(IDxcBatchCompileCallback,
+                      "31453b39-2102-4572-8970-bdac763eaddc")
+/// \brief Receives the results of IDxcBatchCompiler::CompileBatch.
+struct IDxcBatchCompileCallback : public IUnknown {
+  /// \brief Called once for each job as it completes.
+  ///
+  /// Calls are made from worker threads in completion order, but never
+  /// concurrently. Returning a failure stops jobs that have not started yet;
+  /// CompileBatch then returns that failure.
+  virtual HRESULT STDMETHODCALLTYPE OnJobComplete(
+      _In_ UINT32 jobIndex,   ///< Index of the job in the batch.
+      _In_ HRESULT hrCompile, ///< Result of IDxcCompiler3::Compile.
+      _In_opt_ IDxcResult
+          *pResult ///< Compile result, null if hrCompile failed. AddRef to
+                   ///< keep it.
+      ) = 0;
+};
+
+CROSS_PLATFORM_UUIDOF(IDxcBatchCompiler, "0e335b5a-f838-4069-992c-8c7e4b7ced83")
+/// \brief Interface to compile many shaders on a pool of worker threads.
+///
+/// Use DxcCreateInstance with CLSID_DxcBatchCompiler to obtain an instance of
+/// this interface. Worker threads and the compiler instance each of them uses
+/// are kept between batches until the object is released.
+struct IDxcBatchCompiler : public IUnknown {
+  /// \brief Compile a batch of shaders, blocking until all jobs complete.
+  ///
+  /// Results are passed to pCallback as soon as each job completes and are
+  /// not retained, so at most maxWorkers compiles are in flight at a time.
+  virtual HRESULT STDMETHODCALLTYPE CompileBatch(
+      _In_count_(jobCount) const DxcBatchCompileJob *pJobs, ///< Jobs to run.
+      _In_ UINT32 jobCount,                                 ///< Number of jobs.
+      _In_ UINT32 maxWorkers, ///< Maximum number of worker threads to use, or
+                              ///< 0 for the number of hardware threads.
+      _In_ IDxcBatchCompileCallback
+          *pCallback ///< Receives the result of each job.
+      ) = 0;
+};
+
+CROSS_PLATFORM_UUIDOF(IDxcIncludeCache, "f665eea8-5bd6-4bae-aafe-35da1515d66f")
+/// \brief Interface to a thread-safe cache of include files, decoded to UTF-8,
+/// that can be shared by any number of compiles and compiler instances.
+///
+/// Use DxcCreateInstance with CLSID_DxcIncludeCache to obtain an instance of
+/// this interface. Files are keyed by the name they are loaded with, so a
+/// cache should only be shared by include handlers that load the same
+/// contents for the same name.
+///
+/// Timestamps are in 100-nanosecond intervals since January 1, 1601 (UTC),
+/// the unit of FILETIME.
+struct IDxcIncludeCache : public IUnknown {
+  /// \brief Create an include handler that loads files through the cache.
+  ///
+  /// Pass the result to compiles in place of pIncludeHandler. Files missing
+  /// from the cache are loaded with pIncludeHandler, which must be
+  /// thread-safe if the result is used by concurrent compiles. Compiles get
+  /// the cached UTF-8 text itself as their source buffer, without copying it.
+  virtual HRESULT STDMETHODCALLTYPE CreateIncludeHandler(
+      _In_ IDxcIncludeHandler *pIncludeHandler, ///< Loads files on a miss.
+      _COM_Outptr_ IDxcIncludeHandler **ppResult ///< Handler using the cache.
+      ) = 0;
+
+  /// \brief Drop the cached contents of a file, or of all files.
+  virtual HRESULT STDMETHODCALLTYPE Invalidate(
+      _In_opt_ LPCWSTR pFilename ///< File to drop, or null for all files.
+      ) = 0;
+
+  /// \brief Drop the cached contents of a file if they were loaded before it
+  /// was last written.
+  virtual HRESULT STDMETHODCALLTYPE InvalidateIfModified(
+      _In_ LPCWSTR pFilename, ///< File to check.
+      _In_ UINT64 lastWriteTime ///< Time the file was last written.
+      ) = 0;
+};
+
 static const UINT32 DxcValidatorFlags_Default = 0;
 static const UINT32 DxcValidatorFlags_InPlaceEdit =
     1; // Validator is allowed to update shader blob in-place.
@@ -1306,4 +1432,18 @@ CLSID_SCOPE const GUID CLSID_DxcPdbUtils = {
     0x457e,
     {0xae, 0x8c, 0xec, 0x35, 0x5f, 0xae, 0xec, 0x7c}};
 
+// {d67f2b9c-9b99-4c53-a1f3-f77334c46f3a}
+CLSID_SCOPE const GUID CLSID_DxcBatchCompiler = {
+    0xd67f2b9c,
+    0x9b99,
+    0x4c53,
+    {0xa1, 0xf3, 0xf7, 0x73, 0x34, 0xc4, 0x6f, 0x3a}};
+
+// {059ccc6a-26fd-49e5-90cd-0bda96a416ab}
+CLSID_SCOPE const GUID CLSID_DxcIncludeCache = {
+    0x059ccc6a,
+    0x26fd,
+    0x49e5,
+    {0x90, 0xcd, 0x0b, 0xda, 0x96, 0xa4, 0x16, 0xab}};
+
 #endif
@@ -178,7 +178,12 @@ typedef enum DxcTranslationUnitFlags {
   DxcTranslationUnitFlags_IncludeBriefCommentsInCodeCompletion = 0x80,
 
   // Used to indicate that compilation should occur on the caller's thread.
-  DxcTranslationUnitFlags_UseCallerThread = 0x800
+  DxcTranslationUnitFlags_UseCallerThread = 0x800,
+
+  // Used to indicate that the bodies of functions outside the main file
+  // should be skipped while parsing. Declarations from included files remain
+  // available, and reparsing after an edit to the main file is cheaper.
+  DxcTranslationUnitFlags_SkipIncludedFunctionBodies = 0x1000
 } DxcTranslationUnitFlags;
 
 typedef enum DxcCursorFormatting {
@@ -892,6 +897,24 @@ struct IDxcTranslationUnit : public IUnknown {
       _Outptr_result_nullonfailure_ IDxcCodeCompleteResults **pResult) = 0;
 };
 
+CROSS_PLATFORM_UUIDOF(IDxcTranslationUnit2,
+                      "514f75b1-eb88-4a1e-ae63-931278aee688")
+struct IDxcTranslationUnit2 : public IDxcTranslationUnit {
+  // Copies the unsaved files and reparses the translation unit on a
+  // background thread. If a reparse is already running, the new request
+  // replaces any request still waiting behind it, so a burst of edits costs
+  // at most one extra reparse. Until WaitForReparse returns, only
+  // ReparseAsync, IsReparsePending and WaitForReparse may be called.
+  virtual HRESULT STDMETHODCALLTYPE
+  ReparseAsync(_In_count_(num_unsaved_files) IDxcUnsavedFile **unsaved_files,
+               unsigned num_unsaved_files) = 0;
+  virtual HRESULT STDMETHODCALLTYPE IsReparsePending(_Out_ BOOL *pValue) = 0;
+  // Blocks until no reparse is running or queued, and returns the result of
+  // the last one in pReparseStatus.
+  virtual HRESULT STDMETHODCALLTYPE
+  WaitForReparse(_Out_opt_ HRESULT *pReparseStatus) = 0;
+};
+
 CROSS_PLATFORM_UUIDOF(IDxcType, "2ec912fd-b144-4a15-ad0d-1c5439c81e46")
 struct IDxcType : public IUnknown {
   virtual HRESULT STDMETHODCALLTYPE
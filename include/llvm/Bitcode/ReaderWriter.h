@@ -28,6 +28,7 @@ namespace llvm {
   class Module;
   class ModulePass;
   class raw_ostream;
+  template <typename T> class SmallVectorImpl; // HLSL Change
 
   /// Read the header of the specified bitcode buffer and prepare for lazy
   /// deserialization of function bodies. If ShouldLazyLoadMetadata is true,
@@ -71,6 +72,16 @@ namespace llvm {
   void WriteBitcodeToFile(const Module *M, raw_ostream &Out,
                           bool ShouldPreserveUseListOrder = false);
 
+  // HLSL Change Begin
+  /// \brief Write the specified module to the end of \p Buffer.
+  ///
+  /// Unlike WriteBitcodeToFile, the bitcode is emitted straight into the
+  /// caller's buffer rather than copied out of an internal one, so callers
+  /// that know roughly how big the result will be can reserve it up front.
+  void WriteBitcodeToBuffer(const Module *M, SmallVectorImpl<char> &Buffer,
+                            bool ShouldPreserveUseListOrder = false);
+  // HLSL Change End
+
   /// isBitcodeWrapper - Return true if the given bytes are the magic bytes
   /// for an LLVM IR bitcode wrapper.
   ///
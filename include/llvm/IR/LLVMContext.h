@@ -175,6 +175,15 @@ public:
   void emitError(const Twine &ErrorStr);
   void emitWarning(const Twine &WarningStr); // HLSL Change
 
+  // HLSL Change - Begin
+  /// resetForReuse - Prepare the context to be used again once all of its
+  /// modules are destroyed. Restores the state that would make a module built
+  /// in it differ from one built in a new context, such as struct type names
+  /// and metadata kinds, while keeping uniqued types, constants, attributes
+  /// and metadata. Returns false if the context is still in use.
+  bool resetForReuse();
+  // HLSL Change - End
+
   /// \brief Query for a debug option's value.
   ///
   /// This function returns typed data populated from command line parsing.
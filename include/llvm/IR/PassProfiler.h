@@ -0,0 +1,110 @@
+//===- llvm/IR/PassProfiler.h - Per-pass statistics profiler ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// HLSL Change - new file.
+//
+// Records, for each pass run by the legacy pass managers, the wall time spent
+// in it, the instruction and basic block counts of the IR unit it ran on
+// before and after, and optionally the bytes it allocated. Unlike the time
+// trace profiler, the profiler is per thread, so concurrent compiles each get
+// their own report.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_IR_PASSPROFILER_H
+#define LLVM_IR_PASSPROFILER_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <functional>
+
+namespace llvm {
+
+class BasicBlock;
+class Function;
+class Module;
+class Pass;
+
+struct PassProfiler;
+extern LLVM_THREAD_LOCAL PassProfiler *PassProfilerInstance;
+
+/// Initialize the pass profiler for the current thread. If \p AllocatedBytes
+/// is given, it must return a running total of the bytes allocated on this
+/// thread; the difference across each pass is reported as its allocations.
+void passProfilerInitialize(std::function<uint64_t()> AllocatedBytes = nullptr);
+
+/// Cleanup the pass profiler of the current thread, if it was initialized.
+void passProfilerCleanup();
+
+/// Is the pass profiler enabled on the current thread?
+inline bool passProfilerEnabled() { return PassProfilerInstance != nullptr; }
+
+/// Write the collected statistics as JSON: one entry per pass instance, in
+/// the order the passes first ran. Time and allocations of a pass exclude
+/// those of passes it ran nested inside it, such as on-the-fly analyses.
+void passProfilerWrite(raw_ostream &OS);
+
+/// Drop the bookkeeping for \p P; called when a pass is destroyed so that a
+/// later pass allocated at the same address gets an entry of its own.
+void passProfilerForgetPass(const Pass *P);
+
+/// Instruction and basic block counts of the IR a pass ran on.
+struct PassProfileIRSize {
+  uint64_t Instructions = 0;
+  uint64_t Blocks = 0;
+
+  void add(const BasicBlock &BB);
+  void add(const Function &F);
+  void add(const Module &M);
+};
+
+/// The PassProfileScope records a run of a pass over the given IR unit from
+/// its construction to its destruction. If the profiler is not enabled on
+/// this thread, the overhead is a single branch.
+class PassProfileScope {
+public:
+  PassProfileScope(Pass *P, Module &M) {
+    if (PassProfilerInstance != nullptr)
+      begin(P, &M, nullptr);
+  }
+  PassProfileScope(Pass *P, Function &F) {
+    if (PassProfilerInstance != nullptr)
+      begin(P, nullptr, &F);
+  }
+  /// Record a run over a part of a module, such as a loop or a call graph
+  /// SCC. \p Measure adds up the size of that part; it is called before and
+  /// after the pass, so it must cope with the pass having deleted IR.
+  PassProfileScope(Pass *P,
+                   function_ref<void(PassProfileIRSize &)> Measure) {
+    if (PassProfilerInstance != nullptr)
+      begin(P, nullptr, nullptr, Measure);
+  }
+  ~PassProfileScope() {
+    if (Active)
+      end();
+  }
+
+private:
+  PassProfileScope(const PassProfileScope &) = delete;
+  PassProfileScope &operator=(const PassProfileScope &) = delete;
+
+  void
+  begin(Pass *P, Module *M, Function *F,
+        Optional<function_ref<void(PassProfileIRSize &)>> Measure = None);
+  void end();
+
+  bool Active = false;
+};
+
+} // end namespace llvm
+
+#endif
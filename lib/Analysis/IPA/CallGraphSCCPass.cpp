@@ -23,6 +23,7 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManagers.h"
+#include "llvm/IR/PassProfiler.h" // HLSL Change
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Timer.h"
@@ -134,6 +135,14 @@ bool CGPassManager::RunPassOnSCC(Pass *P, CallGraphSCC &CurSCC,
       TimeTraceScope FunctionScope("CGSCCPass-Function", FnName);
       // HLSL Change End - Support hierarchial time tracing.
       TimeRegion PassTimer(getPassTimer(CGSP));
+      // HLSL Change Begin - Measure the functions of the SCC. Passes keep
+      // CurSCC up to date when they replace or delete its functions.
+      PassProfileScope PassProfile(CGSP, [&](PassProfileIRSize &Size) {
+        for (CallGraphNode *CGN : CurSCC)
+          if (Function *F = CGN->getFunction())
+            Size.add(*F);
+      });
+      // HLSL Change End
       Changed = CGSP->runOnSCC(CurSCC);
     }
     
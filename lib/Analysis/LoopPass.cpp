@@ -16,6 +16,7 @@
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/PassProfiler.h" // HLSL Change
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/TimeProfiler.h" // HLSL Change
 #include "llvm/Support/Timer.h"
@@ -256,6 +257,15 @@ bool LPPassManager::runOnFunction(Function &F) {
         // HLSL Change Begin - Support hierarchial time tracing.
         llvm::TimeTraceScope PassScope("RunLoopPass", P->getPassName());
         // HLSL Change End - Support hierarchial time tracing.
+        // HLSL Change Begin - Measure the blocks of the loop, unless the
+        // pass deleted it.
+        PassProfileScope PassProfile(P, [&](PassProfileIRSize &Size) {
+          if (skipThisLoop)
+            return;
+          for (BasicBlock *BB : CurrentLoop->getBlocks())
+            Size.add(*BB);
+        });
+        // HLSL Change End
 
         Changed |= P->runOnLoop(CurrentLoop, *this);
       }
@@ -2505,20 +2505,7 @@ void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
     Buffer.insert(Buffer.begin(), DarwinBCHeaderSize, 0);
 
   // Emit the module into the buffer.
-  {
-    BitstreamWriter Stream(Buffer);
-
-    // Emit the file header.
-    Stream.Emit((unsigned)'B', 8);
-    Stream.Emit((unsigned)'C', 8);
-    Stream.Emit(0x0, 4);
-    Stream.Emit(0xC, 4);
-    Stream.Emit(0xE, 4);
-    Stream.Emit(0xD, 4);
-
-    // Emit the module.
-    WriteModule(M, Stream, ShouldPreserveUseListOrder);
-  }
+  WriteBitcodeToBuffer(M, Buffer, ShouldPreserveUseListOrder); // HLSL Change
 
   if (TT.isOSDarwin())
     EmitDarwinBCHeaderAndTrailer(Buffer, TT);
@@ -2526,3 +2513,21 @@ void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
   // Write the generated bitstream to "Out".
   Out.write((char*)&Buffer.front(), Buffer.size());
 }
+
+// HLSL Change Begin
+void llvm::WriteBitcodeToBuffer(const Module *M, SmallVectorImpl<char> &Buffer,
+                                bool ShouldPreserveUseListOrder) {
+  BitstreamWriter Stream(Buffer);
+
+  // Emit the file header.
+  Stream.Emit((unsigned)'B', 8);
+  Stream.Emit((unsigned)'C', 8);
+  Stream.Emit(0x0, 4);
+  Stream.Emit(0xC, 4);
+  Stream.Emit(0xE, 4);
+  Stream.Emit(0xD, 4);
+
+  // Emit the module.
+  WriteModule(M, Stream, ShouldPreserveUseListOrder);
+}
+// HLSL Change End
@@ -3945,7 +3945,12 @@ void OP::FixOverloadNames() {
 }
 
 void OP::UpdateCache(OpCodeClass opClass, Type *Ty, llvm::Function *F) {
-  m_OpCodeClassCache[(unsigned)opClass].pOverloads[Ty] = F;
+  OpCodeCacheItem &Cache = m_OpCodeClassCache[(unsigned)opClass];
+  Cache.pOverloads[Ty] = F;
+  // Pointer overloads map to their element's slot, so they stay in the map.
+  unsigned BasicSlot = Ty->isPointerTy() ? UINT_MAX : GetTypeSlot(Ty);
+  if (BasicSlot < kUserDefineTypeSlot)
+    Cache.pBasicOverloads[BasicSlot] = F;
   m_FunctionToOpClass[F] = opClass;
 }
 
@@ -3962,8 +3967,13 @@ Function *OP::GetOpFunc(OpCode opCode, Type *pOverloadType) {
   // but these will be caught by the validator, and this is not a regression.
 
   OpCodeClass opClass = m_OpCodeProps[(unsigned)opCode].opCodeClass;
-  Function *&F =
-      m_OpCodeClassCache[(unsigned)opClass].pOverloads[pOverloadType];
+  OpCodeCacheItem &Cache = m_OpCodeClassCache[(unsigned)opClass];
+  unsigned BasicSlot =
+      pOverloadType->isPointerTy() ? UINT_MAX : GetTypeSlot(pOverloadType);
+  if (BasicSlot < kUserDefineTypeSlot && Cache.pBasicOverloads[BasicSlot])
+    return Cache.pBasicOverloads[BasicSlot];
+
+  Function *&F = Cache.pOverloads[pOverloadType];
   if (F != nullptr) {
     UpdateCache(opClass, pOverloadType, F);
     return F;
@@ -6085,14 +6095,21 @@ bool OP::IsDxilOpUsed(OpCode opcode) const {
 
 void OP::RemoveFunction(Function *F) {
   if (OP::IsDxilOpFunc(F)) {
-    OpCodeClass opClass = m_FunctionToOpClass[F];
-    for (auto it : m_OpCodeClassCache[(unsigned)opClass].pOverloads) {
+    auto classIt = m_FunctionToOpClass.find(F);
+    if (classIt == m_FunctionToOpClass.end())
+      return;
+    OpCodeCacheItem &Cache = m_OpCodeClassCache[(unsigned)classIt->second];
+    for (auto it : Cache.pOverloads) {
       if (it.second == F) {
-        m_OpCodeClassCache[(unsigned)opClass].pOverloads.erase(it.first);
-        m_FunctionToOpClass.erase(F);
+        Cache.pOverloads.erase(it.first);
+        m_FunctionToOpClass.erase(classIt);
         break;
       }
     }
+    for (Function *&BasicF : Cache.pBasicOverloads) {
+      if (BasicF == F)
+        BasicF = nullptr;
+    }
   }
 }
 
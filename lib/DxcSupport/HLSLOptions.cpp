@@ -882,6 +882,12 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
              << opts.TimeTraceGranularity << " microseconds.";
     }
   }
+  opts.PassProfile = Args.hasFlag(OPT_fpass_profile, OPT_INVALID, false);
+  opts.ArenaAlloc = Args.hasFlag(OPT_farena_alloc, OPT_INVALID, false);
+  opts.ReuseLLVMContext =
+      Args.hasFlag(OPT_freuse_llvm_context, OPT_INVALID, false);
+  opts.CompileCacheDir = Args.getLastArgValue(OPT_fcompile_cache_EQ);
+  opts.IncrementalLib = Args.hasFlag(OPT_fincremental_lib, OPT_INVALID, false);
 
   opts.EnablePayloadQualifiers =
       Args.hasFlag(OPT_enable_payload_qualifiers, OPT_INVALID,
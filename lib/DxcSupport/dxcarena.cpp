@@ -0,0 +1,428 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcarena.cpp                                                              //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements an arena allocator for compile-lifetime allocations.           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/dxcarena.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+// Chunks are aligned to their size, so the chunk of a block is found by
+// masking its address.
+const unsigned kChunkShift = 20;
+const size_t kChunkSize = size_t(1) << kChunkShift;
+const size_t kChunkHeaderSize = 64;
+// Each block is preceded by a header holding its size.
+const size_t kBlockHeaderSize = 16;
+const size_t kBlockAlign = 16;
+// Larger allocations would waste too much of a chunk when they do not fit.
+const size_t kMaxBlockSize = kChunkSize / 4;
+
+// Blocks are rounded up to a size class, so that a freed block can serve any
+// later allocation of its class: multiples of 16 bytes up to 256 bytes, then
+// four classes per power of two up to kMaxBlockSize.
+const size_t kSmallClassLimit = 256;
+const unsigned kSmallClassCount = kSmallClassLimit / kBlockAlign;
+const unsigned kClassesPerDoubling = 4;
+const unsigned kSizeClassCount =
+    kSmallClassCount + 10 * kClassesPerDoubling; // 256 << 10 == kMaxBlockSize
+static_assert((kSmallClassLimit << 10) == kMaxBlockSize,
+              "else kSizeClassCount does not cover kMaxBlockSize");
+
+unsigned SizeClass(size_t cb) {
+  if (cb <= kSmallClassLimit)
+    return cb == 0 ? 0 : (unsigned)((cb - 1) / kBlockAlign);
+  size_t Last = cb - 1;
+  unsigned Log = llvm::Log2_64(Last);
+  unsigned Step = (unsigned)((Last - (size_t(1) << Log)) >> (Log - 2));
+  return kSmallClassCount + (Log - 8) * kClassesPerDoubling + Step;
+}
+
+size_t ClassSize(unsigned Class) {
+  if (Class < kSmallClassCount)
+    return (Class + 1) * kBlockAlign;
+  Class -= kSmallClassCount;
+  size_t Base = kSmallClassLimit << (Class / kClassesPerDoubling);
+  return Base + (Base / kClassesPerDoubling) * (Class % kClassesPerDoubling + 1);
+}
+
+// Chunks are registered in a two-level table indexed by address, so that
+// any pointer can be classified without reading the memory around it.
+// Covers 48-bit addresses; chunks above that are not used.
+const unsigned kRegistryBits = 48 - kChunkShift;
+const unsigned kLeafBits = kRegistryBits / 2;
+const size_t kLeafSize = size_t(1) << kLeafBits;
+const size_t kRootSize = size_t(1) << (kRegistryBits - kLeafBits);
+
+// Leaves are never freed, so lookups need no synchronization beyond the
+// atomics themselves.
+std::atomic<std::atomic<uint8_t> *> g_ChunkRegistry[kRootSize];
+
+std::atomic<uint8_t> *GetRegistryEntry(uintptr_t Key, bool Create) {
+  std::atomic<uint8_t> *Leaf =
+      g_ChunkRegistry[Key >> kLeafBits].load(std::memory_order_acquire);
+  if (Leaf == nullptr && Create) {
+    std::atomic<uint8_t> *NewLeaf =
+        (std::atomic<uint8_t> *)calloc(kLeafSize, sizeof(std::atomic<uint8_t>));
+    if (NewLeaf == nullptr)
+      return nullptr;
+    if (g_ChunkRegistry[Key >> kLeafBits].compare_exchange_strong(
+            Leaf, NewLeaf, std::memory_order_acq_rel)) {
+      Leaf = NewLeaf;
+    } else {
+      free(NewLeaf);
+    }
+  }
+  return Leaf ? &Leaf[Key & (kLeafSize - 1)] : nullptr;
+}
+
+void *AllocateChunkMemory() {
+#ifdef _WIN32
+  return _aligned_malloc(kChunkSize, kChunkSize);
+#else
+  void *P;
+  return posix_memalign(&P, kChunkSize, kChunkSize) == 0 ? P : nullptr;
+#endif
+}
+
+void FreeChunkMemory(void *P) {
+#ifdef _WIN32
+  _aligned_free(P);
+#else
+  free(P);
+#endif
+}
+
+void UpdatePeak(std::atomic<uint64_t> &Peak, uint64_t Value) {
+  uint64_t Prior = Peak.load(std::memory_order_relaxed);
+  while (Prior < Value &&
+         !Peak.compare_exchange_weak(Prior, Value, std::memory_order_relaxed))
+    ;
+}
+
+} // namespace
+
+namespace hlsl {
+
+// Shared by an arena and its chunks, so that blocks freed after the arena is
+// released still update its statistics.
+struct DxcArenaState {
+  // One for the arena, plus one per chunk not yet released.
+  std::atomic<uint64_t> Refs{1};
+  std::atomic<uint64_t> AllocCount{0};
+  std::atomic<uint64_t> AllocatedBytes{0};
+  std::atomic<uint64_t> LiveBytes{0};
+  std::atomic<uint64_t> PeakLiveBytes{0};
+  std::atomic<uint64_t> ReservedBytes{0};
+  std::atomic<uint64_t> PeakReservedBytes{0};
+  std::atomic<uint64_t> ChunkCount{0};
+  std::atomic<uint64_t> ParentAllocCount{0};
+
+  // Blocks freed while the arena is alive, by size class, linked through their
+  // first word. They keep their chunk alive until the arena is released.
+  // Heads are only changed under FreeListMutex, but may be read without it to
+  // skip empty lists.
+  std::mutex FreeListMutex;
+  bool ArenaAlive = true;
+  std::atomic<void *> FreeLists[kSizeClassCount] = {};
+
+  void Release() {
+    if (Refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      this->~DxcArenaState();
+      free(this);
+    }
+  }
+};
+
+struct DxcArenaChunk {
+  // Offset of the first free byte.
+  std::atomic<size_t> Next;
+  // Live blocks, plus one until the arena is released.
+  std::atomic<uint64_t> Refs;
+  DxcArenaState *pState;
+  // Next chunk reserved by the same arena; only used by the arena.
+  DxcArenaChunk *pNextChunk;
+};
+static_assert(sizeof(DxcArenaChunk) <= kChunkHeaderSize,
+              "else chunk header overlaps the first block");
+
+} // namespace hlsl
+
+using namespace hlsl;
+
+std::atomic<uint64_t> hlsl::g_DxcArenaLiveChunkCount{0};
+
+namespace {
+
+DxcArenaChunk *ChunkFromPointer(void *pv) {
+  uintptr_t Key = (uintptr_t)pv >> kChunkShift;
+  if (pv == nullptr || (Key >> kRegistryBits) != 0)
+    return nullptr;
+  std::atomic<uint8_t> *Entry = GetRegistryEntry(Key, /*Create*/ false);
+  if (Entry == nullptr || Entry->load(std::memory_order_acquire) == 0)
+    return nullptr;
+  return (DxcArenaChunk *)(Key << kChunkShift);
+}
+
+DxcArenaChunk *ChunkOfBlock(void *pv) {
+  return (DxcArenaChunk *)((uintptr_t)pv & ~(uintptr_t)(kChunkSize - 1));
+}
+
+size_t &BlockSize(void *pv) {
+  return *(size_t *)((char *)pv - kBlockHeaderSize);
+}
+
+void *&NextFreeBlock(void *pv) { return *(void **)pv; }
+
+void AddLiveBytes(DxcArenaState *pState, size_t cb) {
+  UpdatePeak(pState->PeakLiveBytes,
+             pState->LiveBytes.fetch_add(cb, std::memory_order_relaxed) + cb);
+}
+
+DxcArenaChunk *CreateChunk(DxcArenaState *pState) {
+  void *P = AllocateChunkMemory();
+  if (P == nullptr)
+    return nullptr;
+  uintptr_t Key = (uintptr_t)P >> kChunkShift;
+  std::atomic<uint8_t> *Entry =
+      (Key >> kRegistryBits) == 0 ? GetRegistryEntry(Key, /*Create*/ true)
+                                  : nullptr;
+  if (Entry == nullptr) {
+    FreeChunkMemory(P);
+    return nullptr;
+  }
+  DxcArenaChunk *C = new (P) DxcArenaChunk;
+  C->Next.store(kChunkHeaderSize, std::memory_order_relaxed);
+  C->Refs.store(1, std::memory_order_relaxed);
+  C->pState = pState;
+  C->pNextChunk = nullptr;
+  pState->Refs.fetch_add(1, std::memory_order_relaxed);
+  pState->ChunkCount.fetch_add(1, std::memory_order_relaxed);
+  g_DxcArenaLiveChunkCount.fetch_add(1, std::memory_order_relaxed);
+  UpdatePeak(pState->PeakReservedBytes,
+             pState->ReservedBytes.fetch_add(kChunkSize,
+                                             std::memory_order_relaxed) +
+                 kChunkSize);
+  Entry->store(1, std::memory_order_release);
+  return C;
+}
+
+void ReleaseChunk(DxcArenaChunk *C) {
+  if (C->Refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    return;
+  DxcArenaState *pState = C->pState;
+  GetRegistryEntry((uintptr_t)C >> kChunkShift, /*Create*/ false)
+      ->store(0, std::memory_order_release);
+  g_DxcArenaLiveChunkCount.fetch_sub(1, std::memory_order_relaxed);
+  pState->ReservedBytes.fetch_sub(kChunkSize, std::memory_order_relaxed);
+  C->~DxcArenaChunk();
+  FreeChunkMemory(C);
+  pState->Release();
+}
+
+// Returns a block of Total bytes, including its header, or null if C is full.
+void *TryBump(DxcArenaChunk *C, size_t Total) {
+  size_t Offset = C->Next.load(std::memory_order_relaxed);
+  do {
+    if (Total > kChunkSize - Offset)
+      return nullptr;
+  } while (!C->Next.compare_exchange_weak(Offset, Offset + Total,
+                                          std::memory_order_relaxed));
+  C->Refs.fetch_add(1, std::memory_order_relaxed);
+  void *pv = (char *)C + Offset + kBlockHeaderSize;
+  BlockSize(pv) = Total - kBlockHeaderSize;
+  AddLiveBytes(C->pState, Total - kBlockHeaderSize);
+  return pv;
+}
+
+// Returns a freed block of the size class, or null if there is none.
+void *TryReuse(DxcArenaState *pState, unsigned Class) {
+  std::atomic<void *> &Head = pState->FreeLists[Class];
+  if (Head.load(std::memory_order_relaxed) == nullptr)
+    return nullptr;
+  void *pv;
+  {
+    std::lock_guard<std::mutex> lock(pState->FreeListMutex);
+    pv = Head.load(std::memory_order_relaxed);
+    if (pv == nullptr)
+      return nullptr;
+    Head.store(NextFreeBlock(pv), std::memory_order_relaxed);
+  }
+  AddLiveBytes(pState, BlockSize(pv));
+  return pv;
+}
+
+// Keeps the block for reuse while its arena is alive. Otherwise only its
+// chunk's count of live blocks is updated.
+void FreeBlock(DxcArenaChunk *C, void *pv) {
+  DxcArenaState *pState = C->pState;
+  pState->LiveBytes.fetch_sub(BlockSize(pv), std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(pState->FreeListMutex);
+    if (pState->ArenaAlive) {
+      std::atomic<void *> &Head = pState->FreeLists[SizeClass(BlockSize(pv))];
+      NextFreeBlock(pv) = Head.load(std::memory_order_relaxed);
+      Head.store(pv, std::memory_order_relaxed);
+      return;
+    }
+  }
+  ReleaseChunk(C);
+}
+
+} // namespace
+
+DxcArenaMalloc::DxcArenaMalloc(IMalloc *pParent)
+    : m_pMalloc(pParent), m_pCurrent(nullptr), m_pChunks(nullptr) {
+  void *P = malloc(sizeof(DxcArenaState));
+  if (P == nullptr)
+    throw std::bad_alloc();
+  m_pState = new (P) DxcArenaState;
+}
+
+DxcArenaMalloc::~DxcArenaMalloc() {
+  m_pCurrent.store(nullptr, std::memory_order_relaxed);
+  // Blocks freed from now on go straight back to their chunks; those already
+  // freed are returned before the arena drops its own references.
+  {
+    std::lock_guard<std::mutex> lock(m_pState->FreeListMutex);
+    m_pState->ArenaAlive = false;
+  }
+  for (std::atomic<void *> &Head : m_pState->FreeLists) {
+    void *pv = Head.exchange(nullptr, std::memory_order_relaxed);
+    while (pv != nullptr) {
+      void *pNext = NextFreeBlock(pv);
+      ReleaseChunk(ChunkOfBlock(pv));
+      pv = pNext;
+    }
+  }
+  DxcArenaChunk *C = m_pChunks;
+  while (C != nullptr) {
+    DxcArenaChunk *pNext = C->pNextChunk;
+    ReleaseChunk(C);
+    C = pNext;
+  }
+  m_pState->Release();
+}
+
+void *DxcArenaMalloc::AllocSlow(SIZE_T cb) {
+  size_t Total = kBlockHeaderSize + ClassSize(SizeClass(cb));
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // Another thread may have replaced the chunk while this one waited.
+  DxcArenaChunk *C = m_pCurrent.load(std::memory_order_relaxed);
+  if (C != nullptr) {
+    if (void *pv = TryBump(C, Total))
+      return pv;
+  }
+  C = CreateChunk(m_pState);
+  if (C == nullptr) {
+    m_pState->ParentAllocCount.fetch_add(1, std::memory_order_relaxed);
+    return m_pMalloc->Alloc(cb);
+  }
+  C->pNextChunk = m_pChunks;
+  m_pChunks = C;
+  void *pv = TryBump(C, Total);
+  m_pCurrent.store(C, std::memory_order_release);
+  return pv;
+}
+
+void *STDMETHODCALLTYPE DxcArenaMalloc::Alloc(SIZE_T cb) {
+  m_pState->AllocCount.fetch_add(1, std::memory_order_relaxed);
+  m_pState->AllocatedBytes.fetch_add(cb, std::memory_order_relaxed);
+  if (cb > kMaxBlockSize) {
+    m_pState->ParentAllocCount.fetch_add(1, std::memory_order_relaxed);
+    return m_pMalloc->Alloc(cb);
+  }
+  unsigned Class = SizeClass(cb);
+  if (void *pv = TryReuse(m_pState, Class))
+    return pv;
+  DxcArenaChunk *C = m_pCurrent.load(std::memory_order_acquire);
+  if (C != nullptr) {
+    if (void *pv = TryBump(C, kBlockHeaderSize + ClassSize(Class)))
+      return pv;
+  }
+  return AllocSlow(cb);
+}
+
+void *STDMETHODCALLTYPE DxcArenaMalloc::Realloc(void *pv, SIZE_T cb) {
+  if (pv == nullptr)
+    return Alloc(cb);
+  if (cb == 0) {
+    Free(pv);
+    return nullptr;
+  }
+  DxcArenaChunk *C = ChunkFromPointer(pv);
+  if (C == nullptr)
+    return m_pMalloc->Realloc(pv, cb);
+  size_t OldSize = BlockSize(pv);
+  if (cb <= OldSize)
+    return pv;
+  void *pNew = Alloc(cb);
+  if (pNew == nullptr)
+    return nullptr;
+  memcpy(pNew, pv, OldSize);
+  FreeBlock(C, pv);
+  return pNew;
+}
+
+void STDMETHODCALLTYPE DxcArenaMalloc::Free(void *pv) {
+  if (DxcArenaChunk *C = ChunkFromPointer(pv))
+    FreeBlock(C, pv);
+  else
+    m_pMalloc->Free(pv);
+}
+
+SIZE_T STDMETHODCALLTYPE DxcArenaMalloc::GetSize(void *pv) {
+  if (ChunkFromPointer(pv) != nullptr)
+    return BlockSize(pv);
+  return m_pMalloc->GetSize(pv);
+}
+
+bool DxcArenaMalloc::Owns(const void *pv) const {
+  DxcArenaChunk *C = ChunkFromPointer(const_cast<void *>(pv));
+  return C != nullptr && C->pState == m_pState;
+}
+
+int STDMETHODCALLTYPE DxcArenaMalloc::DidAlloc(void *pv) {
+  if (DxcArenaChunk *C = ChunkFromPointer(pv))
+    return C->pState == m_pState ? 1 : 0;
+  return m_pMalloc->DidAlloc(pv);
+}
+
+void STDMETHODCALLTYPE DxcArenaMalloc::HeapMinimize(void) {
+  m_pMalloc->HeapMinimize();
+}
+
+void DxcArenaMalloc::GetStats(DxcArenaStats *pStats) const {
+  const DxcArenaState &S = *m_pState;
+  pStats->AllocCount = S.AllocCount.load(std::memory_order_relaxed);
+  pStats->AllocatedBytes = S.AllocatedBytes.load(std::memory_order_relaxed);
+  pStats->LiveBytes = S.LiveBytes.load(std::memory_order_relaxed);
+  pStats->PeakLiveBytes = S.PeakLiveBytes.load(std::memory_order_relaxed);
+  pStats->ReservedBytes = S.ReservedBytes.load(std::memory_order_relaxed);
+  pStats->PeakReservedBytes =
+      S.PeakReservedBytes.load(std::memory_order_relaxed);
+  pStats->ChunkCount = S.ChunkCount.load(std::memory_order_relaxed);
+  pStats->ParentAllocCount = S.ParentAllocCount.load(std::memory_order_relaxed);
+}
+
+bool hlsl::DxcArenaFreeSlow(void *pv) throw() {
+  DxcArenaChunk *C = ChunkFromPointer(pv);
+  if (C == nullptr)
+    return false;
+  FreeBlock(C, pv);
+  return true;
+}
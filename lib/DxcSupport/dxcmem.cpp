@@ -16,6 +16,7 @@
 
 #include "dxc/Support/WinFunctions.h"
 #include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/dxcarena.h"
 #include "llvm/Support/ThreadLocal.h"
 #include <memory>
 
@@ -123,6 +124,9 @@ void *DxcNew(std::size_t size) throw() {
 }
 
 void DxcDelete(void *ptr) throw() {
+  // Arena blocks may be deleted after their arena is no longer installed.
+  if (hlsl::DxcArenaFree(ptr))
+    return;
   IMalloc *iMalloc = DxcGetThreadMallocNoRef();
   if (iMalloc != nullptr) {
     iMalloc->Free(ptr);
@@ -15,9 +15,20 @@
 #include "dxc/Support/Global.h"
 #include "dxc/Support/WinIncludes.h"
 
+#include <new>
+#include <string.h>
+
+// The codec is chosen at build time; see CMakeLists.txt. Any library with
+// the zlib API can stand in for the bundled miniz.
+#ifdef DXIL_COMPRESSION_USE_ZLIB
+#include <zlib.h>
+typedef uInt ZlibSize_t;
+typedef Bytef ZlibInputBytesf;
+#else
 #include "miniz.h"
 typedef size_t ZlibSize_t;
 typedef const Bytef ZlibInputBytesf;
+#endif
 
 namespace {
 //
@@ -27,7 +38,8 @@ namespace {
 class Zlib {
 public:
   enum Operation { INFLATE, DEFLATE };
-  Zlib(Operation Op, IMalloc *pAllocator)
+  Zlib(Operation Op, IMalloc *pAllocator,
+       int Level = hlsl::ZlibDefaultCompression)
       : m_Stream{}, m_Op(Op), m_Initalized(false) {
     m_Stream = {};
 
@@ -41,7 +53,7 @@ public:
     if (Op == INFLATE) {
       ret = inflateInit(&m_Stream);
     } else {
-      ret = deflateInit(&m_Stream, Z_DEFAULT_COMPRESSION);
+      ret = deflateInit(&m_Stream, Level);
     }
 
     if (ret != Z_OK) {
@@ -128,8 +140,8 @@ hlsl::ZlibResult hlsl::ZlibDecompress(IMalloc *pMalloc,
 hlsl::ZlibResult hlsl::ZlibCompress(IMalloc *pMalloc, const void *pData,
                                     size_t pDataSize, void *pUserData,
                                     ZlibCallbackFn *Callback,
-                                    size_t *pOutCompressedSize) {
-  Zlib zlib(Zlib::DEFLATE, pMalloc);
+                                    size_t *pOutCompressedSize, int Level) {
+  Zlib zlib(Zlib::DEFLATE, pMalloc, Level);
   z_stream *pStream = zlib.GetStream();
   if (!pStream)
     return zlib.GetInitializationResult();
@@ -152,3 +164,101 @@ hlsl::ZlibResult hlsl::ZlibCompress(IMalloc *pMalloc, const void *pData,
   *pOutCompressedSize = pStream->total_out;
   return ZlibResult::Success;
 }
+
+struct hlsl::ZlibCompressStream::Impl {
+  Impl(IMalloc *pMalloc, int Level)
+      : pMalloc(pMalloc), zlib(Zlib::DEFLATE, pMalloc, Level) {}
+  IMalloc *pMalloc;
+  Zlib zlib;
+  // Compressed data is gathered here and passed on once a segment is full.
+  Byte Out[64 * 1024];
+};
+
+hlsl::ZlibCompressStream::ZlibCompressStream(IMalloc *pMalloc,
+                                             void *pUserData,
+                                             ZlibCallbackFn *Callback,
+                                             int Level)
+    : m_pUserData(pUserData), m_Callback(Callback) {
+  void *pImpl = pMalloc ? pMalloc->Alloc(sizeof(Impl))
+                        : ::operator new(sizeof(Impl), std::nothrow);
+  if (!pImpl) {
+    m_Result = ZlibResult::OutOfMemory;
+    return;
+  }
+  m_pImpl = new (pImpl) Impl(pMalloc, Level);
+  if (!m_pImpl->zlib.GetStream())
+    m_Result = m_pImpl->zlib.GetInitializationResult();
+}
+
+hlsl::ZlibCompressStream::~ZlibCompressStream() {
+  if (!m_pImpl)
+    return;
+  IMalloc *pMalloc = m_pImpl->pMalloc;
+  m_pImpl->~Impl();
+  if (pMalloc)
+    pMalloc->Free(m_pImpl);
+  else
+    ::operator delete(m_pImpl);
+}
+
+hlsl::ZlibResult hlsl::ZlibCompressStream::Deflate(int Flush) {
+  z_stream *pStream = m_pImpl->zlib.GetStream();
+  for (;;) {
+    pStream->next_out = m_pImpl->Out;
+    pStream->avail_out = sizeof(m_pImpl->Out);
+    int status = deflate(pStream, Flush);
+    if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR)
+      return m_Result = Zlib::TranslateZlibResult(status);
+
+    const size_t producedSize = sizeof(m_pImpl->Out) - pStream->avail_out;
+    if (producedSize) {
+      void *pDest = m_Callback(m_pUserData, producedSize);
+      if (!pDest)
+        return m_Result = ZlibResult::OutOfMemory;
+      memcpy(pDest, m_pImpl->Out, producedSize);
+      m_CompressedSize += producedSize;
+    }
+
+    if (status == Z_STREAM_END)
+      return ZlibResult::Success;
+    // Without Z_FINISH, deflate is done with the input once it no longer
+    // fills the output segment.
+    if (Flush != Z_FINISH && pStream->avail_in == 0 && pStream->avail_out)
+      return ZlibResult::Success;
+    // No progress is possible; only expected while waiting for more input.
+    if (status == Z_BUF_ERROR && !producedSize)
+      return m_Result = (Flush == Z_FINISH ? ZlibResult::InvalidData
+                                           : ZlibResult::Success);
+  }
+}
+
+hlsl::ZlibResult hlsl::ZlibCompressStream::Write(const void *pData,
+                                                 size_t DataSize) {
+  if (m_Result != ZlibResult::Success)
+    return m_Result;
+
+  // The stream counts available input in 32 bits.
+  const size_t kMaxPieceSize = 1u << 30;
+  z_stream *pStream = m_pImpl->zlib.GetStream();
+  const Byte *pCurr = (const Byte *)pData;
+  while (DataSize) {
+    const size_t pieceSize =
+        DataSize < kMaxPieceSize ? DataSize : kMaxPieceSize;
+    pStream->next_in = (ZlibInputBytesf *)pCurr;
+    pStream->avail_in = pieceSize;
+    if (Deflate(Z_NO_FLUSH) != ZlibResult::Success)
+      return m_Result;
+    pCurr += pieceSize;
+    DataSize -= pieceSize;
+  }
+  return ZlibResult::Success;
+}
+
+hlsl::ZlibResult hlsl::ZlibCompressStream::Finish() {
+  if (m_Result != ZlibResult::Success)
+    return m_Result;
+  z_stream *pStream = m_pImpl->zlib.GetStream();
+  pStream->next_in = nullptr;
+  pStream->avail_in = 0;
+  return Deflate(Z_FINISH);
+}
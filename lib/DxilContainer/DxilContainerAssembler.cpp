@@ -1780,10 +1780,10 @@ static bool HasDebugInfoOrLineNumbers(const Module &M) {
          llvm::hasDebugInfo(M);
 }
 
-static void GetPaddedProgramPartSize(AbstractMemoryStream *pStream,
+static void GetPaddedProgramPartSize(uint32_t bitcodeSize,
                                      uint32_t &bitcodeInUInt32,
                                      uint32_t &bitcodePaddingBytes) {
-  bitcodeInUInt32 = pStream->GetPtrSize();
+  bitcodeInUInt32 = bitcodeSize;
   bitcodePaddingBytes = (bitcodeInUInt32 % 4);
   bitcodeInUInt32 = (bitcodeInUInt32 / 4) + (bitcodePaddingBytes ? 1 : 0);
 }
@@ -1791,6 +1791,15 @@ static void GetPaddedProgramPartSize(AbstractMemoryStream *pStream,
 void hlsl::WriteProgramPart(const ShaderModel *pModel,
                             AbstractMemoryStream *pModuleBitcode,
                             IStream *pStream) {
+  WriteProgramPart(pModel,
+                   ArrayRef<uint8_t>(pModuleBitcode->GetPtr(),
+                                     pModuleBitcode->GetPtrSize()),
+                   pStream);
+}
+
+void hlsl::WriteProgramPart(const ShaderModel *pModel,
+                            ArrayRef<uint8_t> ModuleBitcode,
+                            IStream *pStream) {
   DXASSERT(pModel != nullptr, "else generation should have failed");
   DxilProgramHeader programHeader;
   uint32_t shaderVersion =
@@ -1799,16 +1808,15 @@ void hlsl::WriteProgramPart(const ShaderModel *pModel,
   pModel->GetDxilVersion(dxilMajor, dxilMinor);
   uint32_t dxilVersion = DXIL::MakeDxilVersion(dxilMajor, dxilMinor);
   InitProgramHeader(programHeader, shaderVersion, dxilVersion,
-                    pModuleBitcode->GetPtrSize());
+                    ModuleBitcode.size());
 
   uint32_t programInUInt32, programPaddingBytes;
-  GetPaddedProgramPartSize(pModuleBitcode, programInUInt32,
+  GetPaddedProgramPartSize(ModuleBitcode.size(), programInUInt32,
                            programPaddingBytes);
 
   ULONG cbWritten;
   IFT(WriteStreamValue(pStream, programHeader));
-  IFT(pStream->Write(pModuleBitcode->GetPtr(), pModuleBitcode->GetPtrSize(),
-                     &cbWritten));
+  IFT(pStream->Write(ModuleBitcode.data(), ModuleBitcode.size(), &cbWritten));
   if (programPaddingBytes) {
     uint32_t paddingValue = 0;
     IFT(pStream->Write(&paddingValue, programPaddingBytes, &cbWritten));
@@ -1880,8 +1888,8 @@ void hlsl::StripAndCreateReflectionStream(
   WriteBitcodeToFile(pReflectionM, outStream, false);
   outStream.flush();
   uint32_t reflectInUInt32 = 0, reflectPaddingBytes = 0;
-  GetPaddedProgramPartSize(pReflectionBitcodeStream, reflectInUInt32,
-                           reflectPaddingBytes);
+  GetPaddedProgramPartSize(pReflectionBitcodeStream->GetPtrSize(),
+                           reflectInUInt32, reflectPaddingBytes);
   reflectPartSizeInBytes =
       reflectInUInt32 * sizeof(uint32_t) + sizeof(DxilProgramHeader);
 
@@ -1895,7 +1903,7 @@ void hlsl::SerializeDxilContainerForModule(
     llvm::StringRef DebugName, SerializeDxilFlags Flags,
     DxilShaderHash *pShaderHashOut, AbstractMemoryStream *pReflectionStreamOut,
     AbstractMemoryStream *pRootSigStreamOut, void *pPrivateData,
-    size_t PrivateDataSize) {
+    size_t PrivateDataSize, AbstractMemoryStream *pProgramBitcodeOut) {
   llvm::TimeTraceScope TimeScope("SerializeDxilContainer", StringRef(""));
   // TODO: add a flag to update the module and remove information that is not
   // part of DXIL proper and is used only to assemble the container.
@@ -2043,11 +2051,10 @@ void hlsl::SerializeDxilContainerForModule(
 
   // If we have debug information present, serialize it to a debug part, then
   // use the stripped version as the canonical program version.
-  CComPtr<AbstractMemoryStream> pProgramStream = pInputProgramStream;
   bool bModuleStripped = false;
   if (HasDebugInfoOrLineNumbers(*pModule->GetModule())) {
     uint32_t debugInUInt32, debugPaddingBytes;
-    GetPaddedProgramPartSize(pInputProgramStream, debugInUInt32,
+    GetPaddedProgramPartSize(pInputProgramStream->GetPtrSize(), debugInUInt32,
                              debugPaddingBytes);
     if (Flags & SerializeDxilFlags::IncludeDebugInfoPart) {
       writer.AddPart(DFCC_ShaderDebugInfoDXIL,
@@ -2111,12 +2118,17 @@ void hlsl::SerializeDxilContainerForModule(
     bModuleStripped |= pModule->StripReflection();
   }
 
-  // If debug info or reflection was stripped, re-serialize the module.
+  // If debug info or reflection was stripped, re-serialize the module. The
+  // program part is written straight from this buffer; stripping only makes
+  // the module smaller, so reserving the input size keeps it from growing.
+  ArrayRef<uint8_t> ProgramBitcode(pInputProgramStream->GetPtr(),
+                                   pInputProgramStream->GetPtrSize());
+  SmallVector<char, 0> StrippedBitcode;
   if (bModuleStripped) {
-    pProgramStream.Release();
-    IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pProgramStream));
-    raw_stream_ostream outStream(pProgramStream.p);
-    WriteBitcodeToFile(pModule->GetModule(), outStream, false);
+    StrippedBitcode.reserve(pInputProgramStream->GetPtrSize());
+    WriteBitcodeToBuffer(pModule->GetModule(), StrippedBitcode, false);
+    ProgramBitcode = ArrayRef<uint8_t>((const uint8_t *)StrippedBitcode.data(),
+                                       StrippedBitcode.size());
   }
 
   // Compute hash if needed.
@@ -2133,8 +2145,7 @@ void hlsl::SerializeDxilContainerForModule(
                                    pModuleBitcode->GetPtrSize()));
       HashContent.Flags = (uint32_t)DxilShaderHashFlags::IncludesSource;
     } else {
-      md5.update(ArrayRef<uint8_t>(pProgramStream->GetPtr(),
-                                   pProgramStream->GetPtrSize()));
+      md5.update(ProgramBitcode);
       HashContent.Flags = (uint32_t)DxilShaderHashFlags::None;
     }
     md5.final(HashContent.Digest);
@@ -2187,15 +2198,20 @@ void hlsl::SerializeDxilContainerForModule(
 
   // Compute padded bitcode size.
   uint32_t programInUInt32, programPaddingBytes;
-  GetPaddedProgramPartSize(pProgramStream, programInUInt32,
+  GetPaddedProgramPartSize(ProgramBitcode.size(), programInUInt32,
                            programPaddingBytes);
 
   // Write the program part.
   writer.AddPart(
       DFCC_DXIL, programInUInt32 * sizeof(uint32_t) + sizeof(DxilProgramHeader),
       [&](AbstractMemoryStream *pStream) {
-        WriteProgramPart(pModule->GetShaderModel(), pProgramStream, pStream);
+        WriteProgramPart(pModule->GetShaderModel(), ProgramBitcode, pStream);
       });
+  if (pProgramBitcodeOut) {
+    ULONG cbWritten;
+    IFT(pProgramBitcodeOut->Write(ProgramBitcode.data(), ProgramBitcode.size(),
+                                  &cbWritten));
+  }
 
   // Private data part should be added last when assembling the container
   // becasue there is no garuntee of aligned size
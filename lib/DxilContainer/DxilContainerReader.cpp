@@ -11,13 +11,24 @@
 
 #include "dxc/DxilContainer/DxilContainerReader.h"
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilContainer/DxilPipelineStateValidation.h"
+#include "dxc/DxilContainer/DxilRuntimeReflection.h"
 #include "dxc/Support/Global.h"
 #include "dxc/WinAdapter.h"
+#include "llvm/Support/MemoryBuffer.h"
 
 namespace hlsl {
 
+DxilContainerReader::DxilContainerReader() {}
+DxilContainerReader::~DxilContainerReader() {}
+
 HRESULT DxilContainerReader::Load(const void *pContainer,
                                   uint32_t containerSizeInBytes) {
+  m_pFileBuffer.reset();
+  m_pContainer = nullptr;
+  m_uContainerSize = 0;
+  m_pHeader = nullptr;
+
   if (pContainer == nullptr) {
     return E_FAIL;
   }
@@ -38,6 +49,23 @@ HRESULT DxilContainerReader::Load(const void *pContainer,
   return S_OK;
 }
 
+HRESULT DxilContainerReader::LoadFile(llvm::StringRef fileName) {
+  // Without a null terminator, MemoryBuffer maps all but small files.
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> pBuffer =
+      llvm::MemoryBuffer::getFile(fileName, /*FileSize*/ -1,
+                                  /*RequiresNullTerminator*/ false);
+  if (!pBuffer)
+    return E_FAIL;
+  if ((*pBuffer)->getBufferSize() > UINT32_MAX)
+    return DXC_E_INPUT_FILE_TOO_LARGE;
+
+  std::unique_ptr<llvm::MemoryBuffer> pFileBuffer = std::move(pBuffer.get());
+  IFR(Load(pFileBuffer->getBufferStart(),
+           (uint32_t)pFileBuffer->getBufferSize()));
+  m_pFileBuffer = std::move(pFileBuffer);
+  return S_OK;
+}
+
 HRESULT DxilContainerReader::GetVersion(DxilContainerVersion *pResult) {
   if (pResult == nullptr)
     return E_POINTER;
@@ -98,4 +126,42 @@ HRESULT DxilContainerReader::FindFirstPartKind(uint32_t kind,
   return S_OK;
 }
 
+HRESULT DxilContainerReader::FindFirstPartContent(uint32_t kind,
+                                                  const void **ppResult,
+                                                  uint32_t *pResultSize) {
+  if (ppResult == nullptr)
+    return E_POINTER;
+  *ppResult = nullptr;
+  if (!IsLoaded())
+    return E_NOT_VALID_STATE;
+  const DxilPartHeader *pPart = GetDxilPartByType(m_pHeader, (DxilFourCC)kind);
+  if (pPart == nullptr)
+    return DXC_E_MISSING_PART;
+  *ppResult = GetDxilPartData(pPart);
+  if (pResultSize != nullptr) {
+    *pResultSize = pPart->PartSize;
+  }
+  return S_OK;
+}
+
+HRESULT DxilContainerReader::GetRuntimeData(RDAT::DxilRuntimeData &RDAT) {
+  const void *pData;
+  uint32_t size;
+  IFR(FindFirstPartContent(DFCC_RuntimeData, &pData, &size));
+  if (!RDAT.InitFromRDAT(pData, size))
+    return DXC_E_CONTAINER_INVALID;
+  return S_OK;
+}
+
+HRESULT
+DxilContainerReader::GetPipelineStateValidation(
+    DxilPipelineStateValidation &PSV) {
+  const void *pData;
+  uint32_t size;
+  IFR(FindFirstPartContent(DFCC_PipelineStateValidation, &pData, &size));
+  if (!PSV.InitFromPSV0(pData, size))
+    return DXC_E_CONTAINER_INVALID;
+  return S_OK;
+}
+
 } // namespace hlsl
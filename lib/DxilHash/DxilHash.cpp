@@ -10,6 +10,9 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "assert.h"
+#include <algorithm>
+#include <string.h>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -18,6 +21,16 @@
 typedef unsigned char UINT8;
 #endif
 
+#include "dxc/DxilHash/DxilHash.h"
+
+// SSE2 is part of every x64 target, so the multi-buffer path needs no
+// runtime check there; other targets use it only when built for SSE2.
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) ||            \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DXIL_HASH_SSE2 1
+#include <emmintrin.h>
+#endif
+
 // RSA Data Security, Inc. M
 //                         D
 //                         5 Message-Digest Algorithm
@@ -39,309 +52,348 @@ typedef unsigned char UINT8;
 #define S43 15
 #define S44 21
 
-const BYTE padding[64] = {0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-                          0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-                          0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-                          0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-
-void FF(UINT &a, UINT b, UINT c, UINT d, UINT x, UINT8 s, UINT ac) {
+static inline void FF(UINT &a, UINT b, UINT c, UINT d, UINT x, UINT8 s,
+                      UINT ac) {
   a += ((b & c) | (~b & d)) + x + ac;
   a = ((a << s) | (a >> (32 - s))) + b;
 }
 
-void GG(UINT &a, UINT b, UINT c, UINT d, UINT x, UINT8 s, UINT ac) {
+static inline void GG(UINT &a, UINT b, UINT c, UINT d, UINT x, UINT8 s,
+                      UINT ac) {
   a += ((b & d) | (c & ~d)) + x + ac;
   a = ((a << s) | (a >> (32 - s))) + b;
 }
 
-void HH(UINT &a, UINT b, UINT c, UINT d, UINT x, UINT8 s, UINT ac) {
+static inline void HH(UINT &a, UINT b, UINT c, UINT d, UINT x, UINT8 s,
+                      UINT ac) {
   a += (b ^ c ^ d) + x + ac;
   a = ((a << s) | (a >> (32 - s))) + b;
 }
 
-void II(UINT &a, UINT b, UINT c, UINT d, UINT x, UINT8 s, UINT ac) {
+static inline void II(UINT &a, UINT b, UINT c, UINT d, UINT x, UINT8 s,
+                      UINT ac) {
   a += (c ^ (b | ~d)) + x + ac;
   a = ((a << s) | (a >> (32 - s))) + b;
 }
 
-// **************************************************************************************
-// **** DO NOT USE THESE ROUTINES TO PROVIDE FUNCTIONALITY THAT NEEDS TO BE
-// SECURE!!! ***
-// **************************************************************************************
-void ComputeM_D_5Hash(const BYTE *pData, UINT byteCount, BYTE *pOutHash) {
-  UINT leftOver = byteCount & 0x3f;
-  UINT padAmount;
-  bool bTwoRowsPadding = false;
-  if (leftOver < 56) {
-    padAmount = 56 - leftOver;
-  } else {
-    padAmount = 120 - leftOver;
-    bTwoRowsPadding = true;
+namespace {
+
+// Step functions on one 32-bit word, hashing a single buffer.
+struct ScalarOps {
+  typedef UINT Word;
+  static Word Add(Word a, Word b) { return a + b; }
+  static void FF(Word &a, Word b, Word c, Word d, Word x, UINT8 s, UINT ac) {
+    ::FF(a, b, c, d, x, s, ac);
+  }
+  static void GG(Word &a, Word b, Word c, Word d, Word x, UINT8 s, UINT ac) {
+    ::GG(a, b, c, d, x, s, ac);
+  }
+  static void HH(Word &a, Word b, Word c, Word d, Word x, UINT8 s, UINT ac) {
+    ::HH(a, b, c, d, x, s, ac);
+  }
+  static void II(Word &a, Word b, Word c, Word d, Word x, UINT8 s, UINT ac) {
+    ::II(a, b, c, d, x, s, ac);
+  }
+};
+
+#ifdef DXIL_HASH_SSE2
+// Step functions on four 32-bit lanes, hashing four buffers in lockstep.
+struct SSE2Ops {
+  typedef __m128i Word;
+  static Word Add(Word a, Word b) { return _mm_add_epi32(a, b); }
+  static void Step(Word &a, Word b, Word f, Word x, UINT8 s, UINT ac) {
+    a = Add(a, Add(f, Add(x, _mm_set1_epi32((int)ac))));
+    a = Add(_mm_or_si128(_mm_sll_epi32(a, _mm_cvtsi32_si128(s)),
+                         _mm_srl_epi32(a, _mm_cvtsi32_si128(32 - s))),
+            b);
+  }
+  static void FF(Word &a, Word b, Word c, Word d, Word x, UINT8 s, UINT ac) {
+    Step(a, b, _mm_or_si128(_mm_and_si128(b, c), _mm_andnot_si128(b, d)), x, s,
+         ac);
+  }
+  static void GG(Word &a, Word b, Word c, Word d, Word x, UINT8 s, UINT ac) {
+    Step(a, b, _mm_or_si128(_mm_and_si128(b, d), _mm_andnot_si128(d, c)), x, s,
+         ac);
+  }
+  static void HH(Word &a, Word b, Word c, Word d, Word x, UINT8 s, UINT ac) {
+    Step(a, b, _mm_xor_si128(_mm_xor_si128(b, c), d), x, s, ac);
+  }
+  static void II(Word &a, Word b, Word c, Word d, Word x, UINT8 s, UINT ac) {
+    Word notD = _mm_xor_si128(d, _mm_set1_epi32(-1));
+    Step(a, b, _mm_xor_si128(c, _mm_or_si128(b, notD)), x, s, ac);
+  }
+};
+#endif
+
+// The retail and debug hashes differ from MD5 only in their final blocks,
+// which fold the byte count into the first and last words instead of
+// ending with a 64-bit bit count.
+enum class FinalBlockKind { MD5, Retail, Debug };
+
+} // namespace
+
+template <typename Ops>
+static void TransformBlock(typename Ops::Word (&state)[4],
+                           const typename Ops::Word *pX) {
+  typename Ops::Word a = state[0];
+  typename Ops::Word b = state[1];
+  typename Ops::Word c = state[2];
+  typename Ops::Word d = state[3];
+
+  /* Round 1 */
+  Ops::FF(a, b, c, d, pX[0], S11, 0xd76aa478);  /* 1 */
+  Ops::FF(d, a, b, c, pX[1], S12, 0xe8c7b756);  /* 2 */
+  Ops::FF(c, d, a, b, pX[2], S13, 0x242070db);  /* 3 */
+  Ops::FF(b, c, d, a, pX[3], S14, 0xc1bdceee);  /* 4 */
+  Ops::FF(a, b, c, d, pX[4], S11, 0xf57c0faf);  /* 5 */
+  Ops::FF(d, a, b, c, pX[5], S12, 0x4787c62a);  /* 6 */
+  Ops::FF(c, d, a, b, pX[6], S13, 0xa8304613);  /* 7 */
+  Ops::FF(b, c, d, a, pX[7], S14, 0xfd469501);  /* 8 */
+  Ops::FF(a, b, c, d, pX[8], S11, 0x698098d8);  /* 9 */
+  Ops::FF(d, a, b, c, pX[9], S12, 0x8b44f7af);  /* 10 */
+  Ops::FF(c, d, a, b, pX[10], S13, 0xffff5bb1); /* 11 */
+  Ops::FF(b, c, d, a, pX[11], S14, 0x895cd7be); /* 12 */
+  Ops::FF(a, b, c, d, pX[12], S11, 0x6b901122); /* 13 */
+  Ops::FF(d, a, b, c, pX[13], S12, 0xfd987193); /* 14 */
+  Ops::FF(c, d, a, b, pX[14], S13, 0xa679438e); /* 15 */
+  Ops::FF(b, c, d, a, pX[15], S14, 0x49b40821); /* 16 */
+
+  /* Round 2 */
+  Ops::GG(a, b, c, d, pX[1], S21, 0xf61e2562);  /* 17 */
+  Ops::GG(d, a, b, c, pX[6], S22, 0xc040b340);  /* 18 */
+  Ops::GG(c, d, a, b, pX[11], S23, 0x265e5a51); /* 19 */
+  Ops::GG(b, c, d, a, pX[0], S24, 0xe9b6c7aa);  /* 20 */
+  Ops::GG(a, b, c, d, pX[5], S21, 0xd62f105d);  /* 21 */
+  Ops::GG(d, a, b, c, pX[10], S22, 0x2441453);  /* 22 */
+  Ops::GG(c, d, a, b, pX[15], S23, 0xd8a1e681); /* 23 */
+  Ops::GG(b, c, d, a, pX[4], S24, 0xe7d3fbc8);  /* 24 */
+  Ops::GG(a, b, c, d, pX[9], S21, 0x21e1cde6);  /* 25 */
+  Ops::GG(d, a, b, c, pX[14], S22, 0xc33707d6); /* 26 */
+  Ops::GG(c, d, a, b, pX[3], S23, 0xf4d50d87);  /* 27 */
+  Ops::GG(b, c, d, a, pX[8], S24, 0x455a14ed);  /* 28 */
+  Ops::GG(a, b, c, d, pX[13], S21, 0xa9e3e905); /* 29 */
+  Ops::GG(d, a, b, c, pX[2], S22, 0xfcefa3f8);  /* 30 */
+  Ops::GG(c, d, a, b, pX[7], S23, 0x676f02d9);  /* 31 */
+  Ops::GG(b, c, d, a, pX[12], S24, 0x8d2a4c8a); /* 32 */
+
+  /* Round 3 */
+  Ops::HH(a, b, c, d, pX[5], S31, 0xfffa3942);  /* 33 */
+  Ops::HH(d, a, b, c, pX[8], S32, 0x8771f681);  /* 34 */
+  Ops::HH(c, d, a, b, pX[11], S33, 0x6d9d6122); /* 35 */
+  Ops::HH(b, c, d, a, pX[14], S34, 0xfde5380c); /* 36 */
+  Ops::HH(a, b, c, d, pX[1], S31, 0xa4beea44);  /* 37 */
+  Ops::HH(d, a, b, c, pX[4], S32, 0x4bdecfa9);  /* 38 */
+  Ops::HH(c, d, a, b, pX[7], S33, 0xf6bb4b60);  /* 39 */
+  Ops::HH(b, c, d, a, pX[10], S34, 0xbebfbc70); /* 40 */
+  Ops::HH(a, b, c, d, pX[13], S31, 0x289b7ec6); /* 41 */
+  Ops::HH(d, a, b, c, pX[0], S32, 0xeaa127fa);  /* 42 */
+  Ops::HH(c, d, a, b, pX[3], S33, 0xd4ef3085);  /* 43 */
+  Ops::HH(b, c, d, a, pX[6], S34, 0x4881d05);   /* 44 */
+  Ops::HH(a, b, c, d, pX[9], S31, 0xd9d4d039);  /* 45 */
+  Ops::HH(d, a, b, c, pX[12], S32, 0xe6db99e5); /* 46 */
+  Ops::HH(c, d, a, b, pX[15], S33, 0x1fa27cf8); /* 47 */
+  Ops::HH(b, c, d, a, pX[2], S34, 0xc4ac5665);  /* 48 */
+
+  /* Round 4 */
+  Ops::II(a, b, c, d, pX[0], S41, 0xf4292244);  /* 49 */
+  Ops::II(d, a, b, c, pX[7], S42, 0x432aff97);  /* 50 */
+  Ops::II(c, d, a, b, pX[14], S43, 0xab9423a7); /* 51 */
+  Ops::II(b, c, d, a, pX[5], S44, 0xfc93a039);  /* 52 */
+  Ops::II(a, b, c, d, pX[12], S41, 0x655b59c3); /* 53 */
+  Ops::II(d, a, b, c, pX[3], S42, 0x8f0ccc92);  /* 54 */
+  Ops::II(c, d, a, b, pX[10], S43, 0xffeff47d); /* 55 */
+  Ops::II(b, c, d, a, pX[1], S44, 0x85845dd1);  /* 56 */
+  Ops::II(a, b, c, d, pX[8], S41, 0x6fa87e4f);  /* 57 */
+  Ops::II(d, a, b, c, pX[15], S42, 0xfe2ce6e0); /* 58 */
+  Ops::II(c, d, a, b, pX[6], S43, 0xa3014314);  /* 59 */
+  Ops::II(b, c, d, a, pX[13], S44, 0x4e0811a1); /* 60 */
+  Ops::II(a, b, c, d, pX[4], S41, 0xf7537e82);  /* 61 */
+  Ops::II(d, a, b, c, pX[11], S42, 0xbd3af235); /* 62 */
+  Ops::II(c, d, a, b, pX[2], S43, 0x2ad7d2bb);  /* 63 */
+  Ops::II(b, c, d, a, pX[9], S44, 0xeb86d391);  /* 64 */
+
+  state[0] = Ops::Add(state[0], a);
+  state[1] = Ops::Add(state[1], b);
+  state[2] = Ops::Add(state[2], c);
+  state[3] = Ops::Add(state[3], d);
+}
+
+static void TransformBlocks(UINT (&state)[4], const BYTE *pBlocks,
+                            UINT blockCount) {
+  for (UINT i = 0; i < blockCount; i++, pBlocks += 64)
+    TransformBlock<ScalarOps>(state, (const UINT *)pBlocks);
+}
+
+// Builds the blocks that follow the byteCount / 64 full blocks of pData into
+// x, returning how many there are (one or two).
+static UINT BuildFinalBlocks(FinalBlockKind kind, const BYTE *pData,
+                             UINT byteCount, UINT (&x)[32]) {
+  UINT remainder = byteCount & 0x3f;
+  const BYTE *pRemainder = pData + (byteCount - remainder);
+  bool bTwoRowsPadding = remainder >= 56;
+  memset(x, 0, sizeof(x));
+
+  // Retail and debug hashes start a single final block with the size word,
+  // so the remaining data and the 0x80 pad byte follow it.
+  UINT dataOffset = (kind == FinalBlockKind::MD5 || bTwoRowsPadding) ? 0 : 4;
+  memcpy((BYTE *)x + dataOffset, pRemainder, remainder); // could copy nothing
+  ((BYTE *)x)[dataOffset + remainder] = 0x80;
+
+  UINT *pLast = bTwoRowsPadding ? x + 16 : x;
+  switch (kind) {
+  case FinalBlockKind::MD5:
+    pLast[14] = byteCount << 3; // sizepad lo
+    pLast[15] = 0;              // sizepad hi
+    break;
+  case FinalBlockKind::Retail:
+    pLast[0] = byteCount << 3;
+    pLast[15] = 1 | (byteCount << 1);
+    break;
+  case FinalBlockKind::Debug:
+    pLast[0] = byteCount << 4 | 0xf;
+    pLast[15] = (byteCount << 2) | 0x10000000;
+    break;
   }
-  UINT padAmountPlusSize = padAmount + 8;
+  return bTwoRowsPadding ? 2 : 1;
+}
+
+static void ComputeHash(FinalBlockKind kind, const BYTE *pData, UINT byteCount,
+                        BYTE *pOutHash) {
   UINT state[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
-  UINT N = (byteCount + padAmountPlusSize) >> 6;
-  UINT offset = 0;
-  UINT NextEndState = bTwoRowsPadding ? N - 2 : N - 1;
-  const BYTE *pCurrData = pData;
-  for (UINT i = 0; i < N; i++, offset += 64, pCurrData += 64) {
-    assert(byteCount - offset <= byteCount); // prefast doesn't understand this
-                                             // - no underflow will happen
-    assert(byteCount <
-           64 * i + 65); // prefast doesn't understand this - no overflows will
-                         // happen in any memcpy below
-    assert(byteCount < leftOver + 64 * i + 9);
-    assert(byteCount < leftOver + 64 * i + 1);
-    UINT x[16];
-    const UINT *pX;
-    if (i == NextEndState) {
-      if (!bTwoRowsPadding && i == N - 1) {
-        UINT remainder = byteCount - offset;
-        memcpy(x, pCurrData, remainder); // could copy nothing
-        memcpy((BYTE *)x + remainder, padding, padAmount);
-        x[14] = byteCount << 3; // sizepad lo
-        x[15] = 0;              // sizepad hi
-      } else if (bTwoRowsPadding) {
-        if (i == N - 2) {
-          UINT remainder = byteCount - offset;
-          memcpy(x, pCurrData, remainder);
-          memcpy((BYTE *)x + remainder, padding, padAmount - 56);
-          NextEndState = N - 1;
-        } else if (i == N - 1) {
-          memcpy(x, padding + padAmount - 56, 56);
-          x[14] = byteCount << 3; // sizepad lo
-          x[15] = 0;              // sizepad hi
-        }
-      }
-      pX = x;
-    } else {
-      pX = (const UINT *)pCurrData;
+  TransformBlocks(state, pData, byteCount >> 6);
+  UINT x[32];
+  UINT finalBlockCount = BuildFinalBlocks(kind, pData, byteCount, x);
+  TransformBlocks(state, (const BYTE *)x, finalBlockCount);
+  memcpy(pOutHash, state, 16);
+}
+
+namespace {
+
+// One buffer of a multi-buffer hash.
+struct HashLane {
+  const BYTE *pData;
+  UINT fullBlockCount;
+  UINT blockCount;
+  UINT finalBlocks[32];
+  UINT state[4];
+
+  const BYTE *GetBlock(UINT i) const {
+    return i < fullBlockCount ? pData + i * 64
+                              : (const BYTE *)finalBlocks +
+                                    (i - fullBlockCount) * 64;
+  }
+};
+
+} // namespace
+
+#ifdef DXIL_HASH_SSE2
+// Runs the first blockCount blocks of four lanes together.
+static void TransformLanesSSE2(HashLane *const (&lanes)[4], UINT blockCount) {
+  __m128i state[4];
+  for (unsigned j = 0; j < 4; j++)
+    state[j] = _mm_set_epi32((int)lanes[3]->state[j], (int)lanes[2]->state[j],
+                             (int)lanes[1]->state[j], (int)lanes[0]->state[j]);
+
+  for (UINT i = 0; i < blockCount; i++) {
+    const BYTE *pBlock[4];
+    for (unsigned l = 0; l < 4; l++)
+      pBlock[l] = lanes[l]->GetBlock(i);
+    // Transpose so that x[k] holds word k of each lane's block.
+    __m128i x[16];
+    for (unsigned k = 0; k < 16; k += 4) {
+      __m128i r0 = _mm_loadu_si128((const __m128i *)(pBlock[0] + k * 4));
+      __m128i r1 = _mm_loadu_si128((const __m128i *)(pBlock[1] + k * 4));
+      __m128i r2 = _mm_loadu_si128((const __m128i *)(pBlock[2] + k * 4));
+      __m128i r3 = _mm_loadu_si128((const __m128i *)(pBlock[3] + k * 4));
+      __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+      __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+      __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+      __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+      x[k + 0] = _mm_unpacklo_epi64(t0, t1);
+      x[k + 1] = _mm_unpackhi_epi64(t0, t1);
+      x[k + 2] = _mm_unpacklo_epi64(t2, t3);
+      x[k + 3] = _mm_unpackhi_epi64(t2, t3);
     }
+    TransformBlock<SSE2Ops>(state, x);
+  }
 
-    UINT a = state[0];
-    UINT b = state[1];
-    UINT c = state[2];
-    UINT d = state[3];
-
-    /* Round 1 */
-    FF(a, b, c, d, pX[0], S11, 0xd76aa478);  /* 1 */
-    FF(d, a, b, c, pX[1], S12, 0xe8c7b756);  /* 2 */
-    FF(c, d, a, b, pX[2], S13, 0x242070db);  /* 3 */
-    FF(b, c, d, a, pX[3], S14, 0xc1bdceee);  /* 4 */
-    FF(a, b, c, d, pX[4], S11, 0xf57c0faf);  /* 5 */
-    FF(d, a, b, c, pX[5], S12, 0x4787c62a);  /* 6 */
-    FF(c, d, a, b, pX[6], S13, 0xa8304613);  /* 7 */
-    FF(b, c, d, a, pX[7], S14, 0xfd469501);  /* 8 */
-    FF(a, b, c, d, pX[8], S11, 0x698098d8);  /* 9 */
-    FF(d, a, b, c, pX[9], S12, 0x8b44f7af);  /* 10 */
-    FF(c, d, a, b, pX[10], S13, 0xffff5bb1); /* 11 */
-    FF(b, c, d, a, pX[11], S14, 0x895cd7be); /* 12 */
-    FF(a, b, c, d, pX[12], S11, 0x6b901122); /* 13 */
-    FF(d, a, b, c, pX[13], S12, 0xfd987193); /* 14 */
-    FF(c, d, a, b, pX[14], S13, 0xa679438e); /* 15 */
-    FF(b, c, d, a, pX[15], S14, 0x49b40821); /* 16 */
-
-    /* Round 2 */
-    GG(a, b, c, d, pX[1], S21, 0xf61e2562);  /* 17 */
-    GG(d, a, b, c, pX[6], S22, 0xc040b340);  /* 18 */
-    GG(c, d, a, b, pX[11], S23, 0x265e5a51); /* 19 */
-    GG(b, c, d, a, pX[0], S24, 0xe9b6c7aa);  /* 20 */
-    GG(a, b, c, d, pX[5], S21, 0xd62f105d);  /* 21 */
-    GG(d, a, b, c, pX[10], S22, 0x2441453);  /* 22 */
-    GG(c, d, a, b, pX[15], S23, 0xd8a1e681); /* 23 */
-    GG(b, c, d, a, pX[4], S24, 0xe7d3fbc8);  /* 24 */
-    GG(a, b, c, d, pX[9], S21, 0x21e1cde6);  /* 25 */
-    GG(d, a, b, c, pX[14], S22, 0xc33707d6); /* 26 */
-    GG(c, d, a, b, pX[3], S23, 0xf4d50d87);  /* 27 */
-    GG(b, c, d, a, pX[8], S24, 0x455a14ed);  /* 28 */
-    GG(a, b, c, d, pX[13], S21, 0xa9e3e905); /* 29 */
-    GG(d, a, b, c, pX[2], S22, 0xfcefa3f8);  /* 30 */
-    GG(c, d, a, b, pX[7], S23, 0x676f02d9);  /* 31 */
-    GG(b, c, d, a, pX[12], S24, 0x8d2a4c8a); /* 32 */
-
-    /* Round 3 */
-    HH(a, b, c, d, pX[5], S31, 0xfffa3942);  /* 33 */
-    HH(d, a, b, c, pX[8], S32, 0x8771f681);  /* 34 */
-    HH(c, d, a, b, pX[11], S33, 0x6d9d6122); /* 35 */
-    HH(b, c, d, a, pX[14], S34, 0xfde5380c); /* 36 */
-    HH(a, b, c, d, pX[1], S31, 0xa4beea44);  /* 37 */
-    HH(d, a, b, c, pX[4], S32, 0x4bdecfa9);  /* 38 */
-    HH(c, d, a, b, pX[7], S33, 0xf6bb4b60);  /* 39 */
-    HH(b, c, d, a, pX[10], S34, 0xbebfbc70); /* 40 */
-    HH(a, b, c, d, pX[13], S31, 0x289b7ec6); /* 41 */
-    HH(d, a, b, c, pX[0], S32, 0xeaa127fa);  /* 42 */
-    HH(c, d, a, b, pX[3], S33, 0xd4ef3085);  /* 43 */
-    HH(b, c, d, a, pX[6], S34, 0x4881d05);   /* 44 */
-    HH(a, b, c, d, pX[9], S31, 0xd9d4d039);  /* 45 */
-    HH(d, a, b, c, pX[12], S32, 0xe6db99e5); /* 46 */
-    HH(c, d, a, b, pX[15], S33, 0x1fa27cf8); /* 47 */
-    HH(b, c, d, a, pX[2], S34, 0xc4ac5665);  /* 48 */
-
-    /* Round 4 */
-    II(a, b, c, d, pX[0], S41, 0xf4292244);  /* 49 */
-    II(d, a, b, c, pX[7], S42, 0x432aff97);  /* 50 */
-    II(c, d, a, b, pX[14], S43, 0xab9423a7); /* 51 */
-    II(b, c, d, a, pX[5], S44, 0xfc93a039);  /* 52 */
-    II(a, b, c, d, pX[12], S41, 0x655b59c3); /* 53 */
-    II(d, a, b, c, pX[3], S42, 0x8f0ccc92);  /* 54 */
-    II(c, d, a, b, pX[10], S43, 0xffeff47d); /* 55 */
-    II(b, c, d, a, pX[1], S44, 0x85845dd1);  /* 56 */
-    II(a, b, c, d, pX[8], S41, 0x6fa87e4f);  /* 57 */
-    II(d, a, b, c, pX[15], S42, 0xfe2ce6e0); /* 58 */
-    II(c, d, a, b, pX[6], S43, 0xa3014314);  /* 59 */
-    II(b, c, d, a, pX[13], S44, 0x4e0811a1); /* 60 */
-    II(a, b, c, d, pX[4], S41, 0xf7537e82);  /* 61 */
-    II(d, a, b, c, pX[11], S42, 0xbd3af235); /* 62 */
-    II(c, d, a, b, pX[2], S43, 0x2ad7d2bb);  /* 63 */
-    II(b, c, d, a, pX[9], S44, 0xeb86d391);  /* 64 */
-
-    state[0] += a;
-    state[1] += b;
-    state[2] += c;
-    state[3] += d;
+  for (unsigned j = 0; j < 4; j++) {
+    UINT words[4];
+    _mm_storeu_si128((__m128i *)words, state[j]);
+    for (unsigned l = 0; l < 4; l++)
+      lanes[l]->state[j] = words[l];
   }
+}
+#endif
 
-  memcpy(pOutHash, state, 16);
+static void ComputeHashMultiple(FinalBlockKind kind, const BYTE *const *ppData,
+                                const UINT *pByteCounts, UINT count,
+                                BYTE *pOutHashes) {
+  std::vector<HashLane> lanes(count);
+  for (UINT i = 0; i < count; i++) {
+    HashLane &lane = lanes[i];
+    lane.pData = ppData[i];
+    lane.fullBlockCount = pByteCounts[i] >> 6;
+    lane.blockCount =
+        lane.fullBlockCount +
+        BuildFinalBlocks(kind, ppData[i], pByteCounts[i], lane.finalBlocks);
+    lane.state[0] = 0x67452301;
+    lane.state[1] = 0xefcdab89;
+    lane.state[2] = 0x98badcfe;
+    lane.state[3] = 0x10325476;
+  }
+
+#ifdef DXIL_HASH_SSE2
+  // Group buffers of similar size, so lanes of a group run out of blocks at
+  // about the same time; whatever a lane has left runs on its own below.
+  std::vector<HashLane *> bySize(count);
+  for (UINT i = 0; i < count; i++)
+    bySize[i] = &lanes[i];
+  std::sort(bySize.begin(), bySize.end(), [](HashLane *A, HashLane *B) {
+    return A->blockCount > B->blockCount;
+  });
+  UINT lanesDone = 0;
+  for (; lanesDone + 4 <= count; lanesDone += 4) {
+    HashLane *const group[4] = {bySize[lanesDone], bySize[lanesDone + 1],
+                                bySize[lanesDone + 2], bySize[lanesDone + 3]};
+    UINT commonBlockCount = group[3]->blockCount;
+    TransformLanesSSE2(group, commonBlockCount);
+    for (HashLane *pLane : group) {
+      for (UINT b = commonBlockCount; b < pLane->blockCount; b++)
+        TransformBlock<ScalarOps>(pLane->state,
+                                  (const UINT *)pLane->GetBlock(b));
+    }
+  }
+  for (UINT i = lanesDone; i < count; i++) {
+    HashLane *pLane = bySize[i];
+    for (UINT b = 0; b < pLane->blockCount; b++)
+      TransformBlock<ScalarOps>(pLane->state, (const UINT *)pLane->GetBlock(b));
+  }
+#else
+  for (HashLane &lane : lanes) {
+    for (UINT b = 0; b < lane.blockCount; b++)
+      TransformBlock<ScalarOps>(lane.state, (const UINT *)lane.GetBlock(b));
+  }
+#endif
+
+  for (UINT i = 0; i < count; i++)
+    memcpy(pOutHashes + i * DXIL_CONTAINER_HASH_SIZE, lanes[i].state, 16);
 }
 
 // **************************************************************************************
 // **** DO NOT USE THESE ROUTINES TO PROVIDE FUNCTIONALITY THAT NEEDS TO BE
 // SECURE!!! ***
 // **************************************************************************************
-void ComputeHashRetail(const BYTE *pData, UINT byteCount, BYTE *pOutHash) {
-  UINT leftOver = byteCount & 0x3f;
-  UINT padAmount;
-  bool bTwoRowsPadding = false;
-  if (leftOver < 56) {
-    padAmount = 56 - leftOver;
-  } else {
-    padAmount = 120 - leftOver;
-    bTwoRowsPadding = true;
-  }
-  UINT padAmountPlusSize = padAmount + 8;
-  UINT state[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
-  UINT N = (byteCount + padAmountPlusSize) >> 6;
-  UINT offset = 0;
-  UINT NextEndState = bTwoRowsPadding ? N - 2 : N - 1;
-  const BYTE *pCurrData = pData;
-  for (UINT i = 0; i < N; i++, offset += 64, pCurrData += 64) {
-    UINT x[16];
-    const UINT *pX;
-    if (i == NextEndState) {
-      if (!bTwoRowsPadding && i == N - 1) {
-        UINT remainder = byteCount - offset;
-        x[0] = byteCount << 3;
-
-        assert(byteCount - offset <= byteCount); // check for underflow
-        assert(pCurrData + remainder == pData + byteCount);
-        memcpy((BYTE *)x + 4, pCurrData, remainder); // could copy nothing
-        memcpy((BYTE *)x + 4 + remainder, padding, padAmount);
-        x[15] = 1 | (byteCount << 1);
-      } else if (bTwoRowsPadding) {
-        if (i == N - 2) {
-          UINT remainder = byteCount - offset;
-
-          assert(byteCount - offset <= byteCount); // check for underflow
-          assert(pCurrData + remainder == pData + byteCount);
-          memcpy(x, pCurrData, remainder);
-          memcpy((BYTE *)x + remainder, padding, padAmount - 56);
-          NextEndState = N - 1;
-        } else if (i == N - 1) {
-          x[0] = byteCount << 3;
-          memcpy((BYTE *)x + 4, padding + padAmount - 56, 56);
-          x[15] = 1 | (byteCount << 1);
-        }
-      }
-      pX = x;
-    } else {
-      assert(pCurrData + 64 <= pData + byteCount);
-      pX = (const UINT *)pCurrData;
-    }
-
-    UINT a = state[0];
-    UINT b = state[1];
-    UINT c = state[2];
-    UINT d = state[3];
-
-    /* Round 1 */
-    FF(a, b, c, d, pX[0], S11, 0xd76aa478);  /* 1 */
-    FF(d, a, b, c, pX[1], S12, 0xe8c7b756);  /* 2 */
-    FF(c, d, a, b, pX[2], S13, 0x242070db);  /* 3 */
-    FF(b, c, d, a, pX[3], S14, 0xc1bdceee);  /* 4 */
-    FF(a, b, c, d, pX[4], S11, 0xf57c0faf);  /* 5 */
-    FF(d, a, b, c, pX[5], S12, 0x4787c62a);  /* 6 */
-    FF(c, d, a, b, pX[6], S13, 0xa8304613);  /* 7 */
-    FF(b, c, d, a, pX[7], S14, 0xfd469501);  /* 8 */
-    FF(a, b, c, d, pX[8], S11, 0x698098d8);  /* 9 */
-    FF(d, a, b, c, pX[9], S12, 0x8b44f7af);  /* 10 */
-    FF(c, d, a, b, pX[10], S13, 0xffff5bb1); /* 11 */
-    FF(b, c, d, a, pX[11], S14, 0x895cd7be); /* 12 */
-    FF(a, b, c, d, pX[12], S11, 0x6b901122); /* 13 */
-    FF(d, a, b, c, pX[13], S12, 0xfd987193); /* 14 */
-    FF(c, d, a, b, pX[14], S13, 0xa679438e); /* 15 */
-    FF(b, c, d, a, pX[15], S14, 0x49b40821); /* 16 */
-
-    /* Round 2 */
-    GG(a, b, c, d, pX[1], S21, 0xf61e2562);  /* 17 */
-    GG(d, a, b, c, pX[6], S22, 0xc040b340);  /* 18 */
-    GG(c, d, a, b, pX[11], S23, 0x265e5a51); /* 19 */
-    GG(b, c, d, a, pX[0], S24, 0xe9b6c7aa);  /* 20 */
-    GG(a, b, c, d, pX[5], S21, 0xd62f105d);  /* 21 */
-    GG(d, a, b, c, pX[10], S22, 0x2441453);  /* 22 */
-    GG(c, d, a, b, pX[15], S23, 0xd8a1e681); /* 23 */
-    GG(b, c, d, a, pX[4], S24, 0xe7d3fbc8);  /* 24 */
-    GG(a, b, c, d, pX[9], S21, 0x21e1cde6);  /* 25 */
-    GG(d, a, b, c, pX[14], S22, 0xc33707d6); /* 26 */
-    GG(c, d, a, b, pX[3], S23, 0xf4d50d87);  /* 27 */
-    GG(b, c, d, a, pX[8], S24, 0x455a14ed);  /* 28 */
-    GG(a, b, c, d, pX[13], S21, 0xa9e3e905); /* 29 */
-    GG(d, a, b, c, pX[2], S22, 0xfcefa3f8);  /* 30 */
-    GG(c, d, a, b, pX[7], S23, 0x676f02d9);  /* 31 */
-    GG(b, c, d, a, pX[12], S24, 0x8d2a4c8a); /* 32 */
-
-    /* Round 3 */
-    HH(a, b, c, d, pX[5], S31, 0xfffa3942);  /* 33 */
-    HH(d, a, b, c, pX[8], S32, 0x8771f681);  /* 34 */
-    HH(c, d, a, b, pX[11], S33, 0x6d9d6122); /* 35 */
-    HH(b, c, d, a, pX[14], S34, 0xfde5380c); /* 36 */
-    HH(a, b, c, d, pX[1], S31, 0xa4beea44);  /* 37 */
-    HH(d, a, b, c, pX[4], S32, 0x4bdecfa9);  /* 38 */
-    HH(c, d, a, b, pX[7], S33, 0xf6bb4b60);  /* 39 */
-    HH(b, c, d, a, pX[10], S34, 0xbebfbc70); /* 40 */
-    HH(a, b, c, d, pX[13], S31, 0x289b7ec6); /* 41 */
-    HH(d, a, b, c, pX[0], S32, 0xeaa127fa);  /* 42 */
-    HH(c, d, a, b, pX[3], S33, 0xd4ef3085);  /* 43 */
-    HH(b, c, d, a, pX[6], S34, 0x4881d05);   /* 44 */
-    HH(a, b, c, d, pX[9], S31, 0xd9d4d039);  /* 45 */
-    HH(d, a, b, c, pX[12], S32, 0xe6db99e5); /* 46 */
-    HH(c, d, a, b, pX[15], S33, 0x1fa27cf8); /* 47 */
-    HH(b, c, d, a, pX[2], S34, 0xc4ac5665);  /* 48 */
-
-    /* Round 4 */
-    II(a, b, c, d, pX[0], S41, 0xf4292244);  /* 49 */
-    II(d, a, b, c, pX[7], S42, 0x432aff97);  /* 50 */
-    II(c, d, a, b, pX[14], S43, 0xab9423a7); /* 51 */
-    II(b, c, d, a, pX[5], S44, 0xfc93a039);  /* 52 */
-    II(a, b, c, d, pX[12], S41, 0x655b59c3); /* 53 */
-    II(d, a, b, c, pX[3], S42, 0x8f0ccc92);  /* 54 */
-    II(c, d, a, b, pX[10], S43, 0xffeff47d); /* 55 */
-    II(b, c, d, a, pX[1], S44, 0x85845dd1);  /* 56 */
-    II(a, b, c, d, pX[8], S41, 0x6fa87e4f);  /* 57 */
-    II(d, a, b, c, pX[15], S42, 0xfe2ce6e0); /* 58 */
-    II(c, d, a, b, pX[6], S43, 0xa3014314);  /* 59 */
-    II(b, c, d, a, pX[13], S44, 0x4e0811a1); /* 60 */
-    II(a, b, c, d, pX[4], S41, 0xf7537e82);  /* 61 */
-    II(d, a, b, c, pX[11], S42, 0xbd3af235); /* 62 */
-    II(c, d, a, b, pX[2], S43, 0x2ad7d2bb);  /* 63 */
-    II(b, c, d, a, pX[9], S44, 0xeb86d391);  /* 64 */
-
-    state[0] += a;
-    state[1] += b;
-    state[2] += c;
-    state[3] += d;
-  }
+void ComputeM_D_5Hash(const BYTE *pData, UINT byteCount, BYTE *pOutHash) {
+  ComputeHash(FinalBlockKind::MD5, pData, byteCount, pOutHash);
+}
 
-  memcpy(pOutHash, state, 16);
+// **************************************************************************************
+// **** DO NOT USE THESE ROUTINES TO PROVIDE FUNCTIONALITY THAT NEEDS TO BE
+// SECURE!!! ***
+// **************************************************************************************
+void ComputeHashRetail(const BYTE *pData, UINT byteCount, BYTE *pOutHash) {
+  ComputeHash(FinalBlockKind::Retail, pData, byteCount, pOutHash);
 }
 
 // **************************************************************************************
@@ -349,138 +401,29 @@ void ComputeHashRetail(const BYTE *pData, UINT byteCount, BYTE *pOutHash) {
 // SECURE!!! ***
 // **************************************************************************************
 void ComputeHashDebug(const BYTE *pData, UINT byteCount, BYTE *pOutHash) {
-  UINT leftOver = byteCount & 0x3f;
-  UINT padAmount;
-  bool bTwoRowsPadding = false;
-  if (leftOver < 56) {
-    padAmount = 56 - leftOver;
-  } else {
-    padAmount = 120 - leftOver;
-    bTwoRowsPadding = true;
-  }
-  UINT padAmountPlusSize = padAmount + 8;
-  UINT state[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
-  UINT N = (byteCount + padAmountPlusSize) >> 6;
-  UINT offset = 0;
-  UINT NextEndState = bTwoRowsPadding ? N - 2 : N - 1;
-  const BYTE *pCurrData = pData;
-  for (UINT i = 0; i < N; i++, offset += 64, pCurrData += 64) {
-    UINT x[16];
-    const UINT *pX;
-    if (i == NextEndState) {
-      if (!bTwoRowsPadding && i == N - 1) {
-        UINT remainder = byteCount - offset;
-        x[0] = byteCount << 4 | 0xf;
-
-        assert(byteCount - offset <= byteCount); // check for underflow
-        assert(pCurrData + remainder == pData + byteCount);
-        memcpy((BYTE *)x + 4, pCurrData, remainder); // could copy nothing
-        memcpy((BYTE *)x + 4 + remainder, padding, padAmount);
-        x[15] = (byteCount << 2) | 0x10000000;
-      } else if (bTwoRowsPadding) {
-        if (i == N - 2) {
-          UINT remainder = byteCount - offset;
-          assert(byteCount - offset <= byteCount); // check for underflow
-          assert(pCurrData + remainder == pData + byteCount);
-          memcpy(x, pCurrData, remainder);
-          memcpy((BYTE *)x + remainder, padding, padAmount - 56);
-          NextEndState = N - 1;
-        } else if (i == N - 1) {
-          x[0] = byteCount << 4 | 0xf;
-          memcpy((BYTE *)x + 4, padding + padAmount - 56, 56);
-          x[15] = (byteCount << 2) | 0x10000000;
-        }
-      }
-      pX = x;
-    } else {
-      assert(pCurrData + 64 <= pData + byteCount);
-      pX = (const UINT *)pCurrData;
-    }
+  ComputeHash(FinalBlockKind::Debug, pData, byteCount, pOutHash);
+}
 
-    UINT a = state[0];
-    UINT b = state[1];
-    UINT c = state[2];
-    UINT d = state[3];
-
-    /* Round 1 */
-    FF(a, b, c, d, pX[0], S11, 0xd76aa478);  /* 1 */
-    FF(d, a, b, c, pX[1], S12, 0xe8c7b756);  /* 2 */
-    FF(c, d, a, b, pX[2], S13, 0x242070db);  /* 3 */
-    FF(b, c, d, a, pX[3], S14, 0xc1bdceee);  /* 4 */
-    FF(a, b, c, d, pX[4], S11, 0xf57c0faf);  /* 5 */
-    FF(d, a, b, c, pX[5], S12, 0x4787c62a);  /* 6 */
-    FF(c, d, a, b, pX[6], S13, 0xa8304613);  /* 7 */
-    FF(b, c, d, a, pX[7], S14, 0xfd469501);  /* 8 */
-    FF(a, b, c, d, pX[8], S11, 0x698098d8);  /* 9 */
-    FF(d, a, b, c, pX[9], S12, 0x8b44f7af);  /* 10 */
-    FF(c, d, a, b, pX[10], S13, 0xffff5bb1); /* 11 */
-    FF(b, c, d, a, pX[11], S14, 0x895cd7be); /* 12 */
-    FF(a, b, c, d, pX[12], S11, 0x6b901122); /* 13 */
-    FF(d, a, b, c, pX[13], S12, 0xfd987193); /* 14 */
-    FF(c, d, a, b, pX[14], S13, 0xa679438e); /* 15 */
-    FF(b, c, d, a, pX[15], S14, 0x49b40821); /* 16 */
-
-    /* Round 2 */
-    GG(a, b, c, d, pX[1], S21, 0xf61e2562);  /* 17 */
-    GG(d, a, b, c, pX[6], S22, 0xc040b340);  /* 18 */
-    GG(c, d, a, b, pX[11], S23, 0x265e5a51); /* 19 */
-    GG(b, c, d, a, pX[0], S24, 0xe9b6c7aa);  /* 20 */
-    GG(a, b, c, d, pX[5], S21, 0xd62f105d);  /* 21 */
-    GG(d, a, b, c, pX[10], S22, 0x2441453);  /* 22 */
-    GG(c, d, a, b, pX[15], S23, 0xd8a1e681); /* 23 */
-    GG(b, c, d, a, pX[4], S24, 0xe7d3fbc8);  /* 24 */
-    GG(a, b, c, d, pX[9], S21, 0x21e1cde6);  /* 25 */
-    GG(d, a, b, c, pX[14], S22, 0xc33707d6); /* 26 */
-    GG(c, d, a, b, pX[3], S23, 0xf4d50d87);  /* 27 */
-    GG(b, c, d, a, pX[8], S24, 0x455a14ed);  /* 28 */
-    GG(a, b, c, d, pX[13], S21, 0xa9e3e905); /* 29 */
-    GG(d, a, b, c, pX[2], S22, 0xfcefa3f8);  /* 30 */
-    GG(c, d, a, b, pX[7], S23, 0x676f02d9);  /* 31 */
-    GG(b, c, d, a, pX[12], S24, 0x8d2a4c8a); /* 32 */
-
-    /* Round 3 */
-    HH(a, b, c, d, pX[5], S31, 0xfffa3942);  /* 33 */
-    HH(d, a, b, c, pX[8], S32, 0x8771f681);  /* 34 */
-    HH(c, d, a, b, pX[11], S33, 0x6d9d6122); /* 35 */
-    HH(b, c, d, a, pX[14], S34, 0xfde5380c); /* 36 */
-    HH(a, b, c, d, pX[1], S31, 0xa4beea44);  /* 37 */
-    HH(d, a, b, c, pX[4], S32, 0x4bdecfa9);  /* 38 */
-    HH(c, d, a, b, pX[7], S33, 0xf6bb4b60);  /* 39 */
-    HH(b, c, d, a, pX[10], S34, 0xbebfbc70); /* 40 */
-    HH(a, b, c, d, pX[13], S31, 0x289b7ec6); /* 41 */
-    HH(d, a, b, c, pX[0], S32, 0xeaa127fa);  /* 42 */
-    HH(c, d, a, b, pX[3], S33, 0xd4ef3085);  /* 43 */
-    HH(b, c, d, a, pX[6], S34, 0x4881d05);   /* 44 */
-    HH(a, b, c, d, pX[9], S31, 0xd9d4d039);  /* 45 */
-    HH(d, a, b, c, pX[12], S32, 0xe6db99e5); /* 46 */
-    HH(c, d, a, b, pX[15], S33, 0x1fa27cf8); /* 47 */
-    HH(b, c, d, a, pX[2], S34, 0xc4ac5665);  /* 48 */
-
-    /* Round 4 */
-    II(a, b, c, d, pX[0], S41, 0xf4292244);  /* 49 */
-    II(d, a, b, c, pX[7], S42, 0x432aff97);  /* 50 */
-    II(c, d, a, b, pX[14], S43, 0xab9423a7); /* 51 */
-    II(b, c, d, a, pX[5], S44, 0xfc93a039);  /* 52 */
-    II(a, b, c, d, pX[12], S41, 0x655b59c3); /* 53 */
-    II(d, a, b, c, pX[3], S42, 0x8f0ccc92);  /* 54 */
-    II(c, d, a, b, pX[10], S43, 0xffeff47d); /* 55 */
-    II(b, c, d, a, pX[1], S44, 0x85845dd1);  /* 56 */
-    II(a, b, c, d, pX[8], S41, 0x6fa87e4f);  /* 57 */
-    II(d, a, b, c, pX[15], S42, 0xfe2ce6e0); /* 58 */
-    II(c, d, a, b, pX[6], S43, 0xa3014314);  /* 59 */
-    II(b, c, d, a, pX[13], S44, 0x4e0811a1); /* 60 */
-    II(a, b, c, d, pX[4], S41, 0xf7537e82);  /* 61 */
-    II(d, a, b, c, pX[11], S42, 0xbd3af235); /* 62 */
-    II(c, d, a, b, pX[2], S43, 0x2ad7d2bb);  /* 63 */
-    II(b, c, d, a, pX[9], S44, 0xeb86d391);  /* 64 */
-
-    state[0] += a;
-    state[1] += b;
-    state[2] += c;
-    state[3] += d;
-  }
+// **************************************************************************************
+// **** DO NOT USE THESE ROUTINES TO PROVIDE FUNCTIONALITY THAT NEEDS TO BE
+// SECURE!!! ***
+// **************************************************************************************
+void ComputeHashRetailMultiple(const BYTE *const *ppData,
+                               const UINT *pByteCounts, UINT count,
+                               BYTE *pOutHashes) {
+  ComputeHashMultiple(FinalBlockKind::Retail, ppData, pByteCounts, count,
+                      pOutHashes);
+}
 
-  memcpy(pOutHash, state, 16);
+// **************************************************************************************
+// **** DO NOT USE THESE ROUTINES TO PROVIDE FUNCTIONALITY THAT NEEDS TO BE
+// SECURE!!! ***
+// **************************************************************************************
+void ComputeHashDebugMultiple(const BYTE *const *ppData,
+                              const UINT *pByteCounts, UINT count,
+                              BYTE *pOutHashes) {
+  ComputeHashMultiple(FinalBlockKind::Debug, ppData, pByteCounts, count,
+                      pOutHashes);
 }
 // **************************************************************************************
 // **** DO NOT USE THESE ROUTINES TO PROVIDE FUNCTIONALITY THAT NEEDS TO BE
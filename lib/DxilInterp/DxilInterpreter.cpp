@@ -0,0 +1,2581 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilInterpreter.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// A CPU reference interpreter for DXIL compute shaders.                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/DxilInterp/DxilInterpreter.h"
+#include "dxc/DXIL/DxilCBuffer.h"
+#include "dxc/DXIL/DxilCompType.h"
+#include "dxc/DXIL/DxilFunctionProps.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilResource.h"
+#include "dxc/DXIL/DxilResourceProperties.h"
+#include "dxc/DXIL/DxilShaderModel.h"
+#include "dxc/Support/Global.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace {
+
+const unsigned kNoBlock = ~0u;
+const unsigned kBlockStart = ~0u;
+const unsigned kMaxWaveSize = 128;
+const unsigned kDefaultWaveSize = 32;
+
+// Pointers are a memory space in the top byte and a byte offset below it.
+// Private memory is per lane, group shared memory per thread group, and
+// constant memory holds the initializers of constant globals.
+enum : uint64_t {
+  kPrivateSpace = 0,
+  kGroupSharedSpace = 1,
+  kConstantSpace = 2,
+};
+const unsigned kSpaceShift = 56;
+const uint64_t kOffsetMask = (1ULL << kSpaceShift) - 1;
+
+uint64_t MakePointer(uint64_t Space, uint64_t Offset) {
+  return (Space << kSpaceShift) | Offset;
+}
+
+// Instruction kinds past the LLVM opcodes.
+enum : unsigned {
+  kOpDxil = 1000, // Aux holds the DXIL::OpCode.
+  kOpCall,        // Aux holds the index of the callee.
+};
+
+// The kind of a scalar held in a lane register. Integers are kept zero
+// extended from their width, floats as their bit pattern.
+enum class VK : uint8_t { None, I1, I8, I16, I32, I64, F16, F32, F64, Ptr };
+
+unsigned GetBits(VK K) {
+  switch (K) {
+  case VK::I1:
+    return 1;
+  case VK::I8:
+    return 8;
+  case VK::I16:
+  case VK::F16:
+    return 16;
+  case VK::I32:
+  case VK::F32:
+    return 32;
+  default:
+    return 64;
+  }
+}
+
+unsigned GetBytes(VK K) { return K == VK::I1 ? 1 : GetBits(K) / 8; }
+
+bool IsFloat(VK K) { return K == VK::F16 || K == VK::F32 || K == VK::F64; }
+
+uint64_t Trunc(uint64_t V, unsigned Bits) {
+  return Bits >= 64 ? V : V & ((1ULL << Bits) - 1);
+}
+
+int64_t SExt(uint64_t V, unsigned Bits) {
+  return Bits >= 64 ? (int64_t)V
+                    : (int64_t)(V << (64 - Bits)) >> (64 - Bits);
+}
+
+float HalfToFloat(uint16_t H) {
+  uint32_t Sign = (uint32_t)(H & 0x8000) << 16;
+  uint32_t Exp = (H >> 10) & 0x1f;
+  uint32_t Mant = H & 0x3ff;
+  if (Exp == 0x1f)
+    return BitsToFloat(Sign | 0x7f800000 | (Mant << 13));
+  if (Exp != 0)
+    return BitsToFloat(Sign | ((Exp + 112) << 23) | (Mant << 13));
+  if (Mant == 0)
+    return BitsToFloat(Sign);
+  // Normalize the denormal.
+  Exp = 113;
+  while (!(Mant & 0x400)) {
+    Mant <<= 1;
+    --Exp;
+  }
+  return BitsToFloat(Sign | (Exp << 23) | ((Mant & 0x3ff) << 13));
+}
+
+// Rounds to nearest even.
+uint16_t FloatToHalf(float F) {
+  uint32_t X = FloatToBits(F);
+  uint32_t Sign = (X >> 16) & 0x8000;
+  uint32_t Abs = X & 0x7fffffff;
+  if (Abs >= 0x7f800000)
+    return Sign | 0x7c00 | (Abs > 0x7f800000 ? 0x200 | (Abs >> 13) : 0);
+  if (Abs >= 0x477ff000) // 65520 and up round to infinity.
+    return Sign | 0x7c00;
+  if (Abs < 0x38800000) { // Below 2^-14, the smallest normal half.
+    if (Abs < 0x33000000) // Below 2^-25, which rounds to zero.
+      return Sign;
+    uint32_t Mant = (Abs & 0x7fffff) | 0x800000;
+    unsigned Shift = 126 - (Abs >> 23);
+    uint32_t H = Mant >> Shift;
+    uint32_t Rem = Mant & ((1u << Shift) - 1);
+    uint32_t Halfway = 1u << (Shift - 1);
+    if (Rem > Halfway || (Rem == Halfway && (H & 1)))
+      ++H;
+    return Sign | H;
+  }
+  uint32_t H = (Abs - 0x38000000) >> 13;
+  uint32_t Rem = Abs & 0x1fff;
+  if (Rem > 0x1000 || (Rem == 0x1000 && (H & 1)))
+    ++H;
+  return Sign | H;
+}
+
+double ReadFP(uint64_t V, VK K) {
+  switch (K) {
+  case VK::F16:
+    return HalfToFloat((uint16_t)V);
+  case VK::F32:
+    return BitsToFloat((uint32_t)V);
+  default: {
+    double D;
+    memcpy(&D, &V, sizeof(D));
+    return D;
+  }
+  }
+}
+
+uint64_t WriteFP(double D, VK K) {
+  switch (K) {
+  case VK::F16:
+    return FloatToHalf((float)D);
+  case VK::F32:
+    return FloatToBits((float)D);
+  default: {
+    uint64_t V;
+    memcpy(&V, &D, sizeof(V));
+    return V;
+  }
+  }
+}
+
+// Converts with saturation, and NaN to zero, as D3D does.
+uint64_t FPToInt(double D, unsigned Bits, bool Signed) {
+  if (std::isnan(D))
+    return 0;
+  if (Signed) {
+    double Limit = std::ldexp(1.0, Bits - 1);
+    if (D <= -Limit)
+      return Trunc(1ULL << (Bits - 1), Bits);
+    if (D >= Limit)
+      return Trunc((1ULL << (Bits - 1)) - 1, Bits);
+    return Trunc((uint64_t)(int64_t)D, Bits);
+  }
+  if (D <= 0)
+    return 0;
+  if (D >= std::ldexp(1.0, Bits))
+    return Trunc(~0ULL, Bits);
+  return (uint64_t)D;
+}
+
+bool IsNormalFP(uint64_t V, VK K) {
+  switch (K) {
+  case VK::F16: {
+    unsigned Exp = (V >> 10) & 0x1f;
+    return Exp != 0 && Exp != 0x1f;
+  }
+  case VK::F32:
+    return std::isnormal(BitsToFloat((uint32_t)V));
+  default:
+    return std::isnormal(ReadFP(V, K));
+  }
+}
+
+// D3D min and max return the other operand when one is NaN.
+double FMinD3D(double A, double B) {
+  if (std::isnan(A))
+    return B;
+  if (std::isnan(B))
+    return A;
+  return B < A ? B : A;
+}
+
+double FMaxD3D(double A, double B) {
+  if (std::isnan(A))
+    return B;
+  if (std::isnan(B))
+    return A;
+  return A < B ? B : A;
+}
+
+struct LaneMask {
+  uint64_t Words[2];
+
+  LaneMask() : Words{0, 0} {}
+  bool test(unsigned L) const { return (Words[L >> 6] >> (L & 63)) & 1; }
+  void set(unsigned L) { Words[L >> 6] |= 1ULL << (L & 63); }
+  bool none() const { return !(Words[0] | Words[1]); }
+  void reset(const LaneMask &Other) {
+    Words[0] &= ~Other.Words[0];
+    Words[1] &= ~Other.Words[1];
+  }
+};
+
+struct Inst {
+  unsigned Op;          // Instruction opcode, kOpDxil or kOpCall.
+  unsigned Aux;         // Predicate, DXIL opcode, callee, offset or index.
+  unsigned Dest;        // First result slot.
+  unsigned Operands;    // First operand code in CompiledFunction::Codes.
+  unsigned NumOperands; // Number of operand codes.
+  unsigned Extra;       // First side data in CompiledFunction::Extra.
+  unsigned NumSlots;    // Number of result slots.
+  VK Ty;                // Result kind; that of the first element of structs.
+  VK OpTy;              // Kind of the first operand, or the dx.op overload.
+  Instruction *I;       // For diagnostics.
+};
+
+struct Block {
+  unsigned Begin;  // First phi.
+  unsigned PhiEnd; // First instruction after the phis.
+};
+
+// A function flattened for execution. Operand codes index the frame's
+// registers when non-negative, and the constant pool when negative; both
+// hold a row of one value per lane.
+struct CompiledFunction {
+  Function *F;
+  std::vector<Inst> Insts;
+  std::vector<Block> Blocks;
+  std::vector<unsigned> IPostDom; // Immediate post-dominator, or kNoBlock.
+  std::vector<int> Codes;
+  std::vector<int64_t> Extra;
+  std::vector<uint64_t> Pool;
+  unsigned NumArgs = 0;
+  unsigned NumSlots = 0;
+  unsigned FrameSize = 0; // Private bytes for allocas.
+  unsigned StackSize = 0; // FrameSize plus the deepest callee's StackSize.
+  bool Compiling = true;
+};
+
+// An entry of the reconvergence stack: the lanes in Mask run PC until they
+// reach RPC, where the entry is popped and they rejoin the entry below.
+struct StackEntry {
+  unsigned PC;
+  unsigned RPC;
+  LaneMask Mask;
+};
+
+struct Frame {
+  CompiledFunction *CF;
+  std::vector<uint64_t> Regs;
+  std::vector<StackEntry> Stack;
+  std::vector<unsigned> Prev; // Block each lane came from, for phis.
+  unsigned Next;              // Next instruction, or kBlockStart.
+  unsigned PrivateBase;       // Private offset of this frame's allocas.
+  unsigned ReturnDest;        // Slot in the caller receiving the result.
+};
+
+struct Wave {
+  std::vector<Frame> Frames;
+  std::vector<uint8_t> Private;
+  unsigned FirstThread;
+  unsigned NumLanes;
+  unsigned Lanes[kMaxWaveSize]; // Active lanes of the block being run.
+  bool Done;
+};
+
+template <typename Fn> void ForLanes(const Wave &W, Fn F) {
+  for (unsigned i = 0, e = W.NumLanes; i != e; ++i)
+    F(W.Lanes[i]);
+}
+
+template <typename Fn>
+void Unary(const Wave &W, uint64_t *Dst, const uint64_t *A, Fn F) {
+  ForLanes(W, [&](unsigned L) { Dst[L] = F(A[L]); });
+}
+
+template <typename Fn>
+void Binary(const Wave &W, uint64_t *Dst, const uint64_t *A,
+            const uint64_t *B, Fn F) {
+  ForLanes(W, [&](unsigned L) { Dst[L] = F(A[L], B[L]); });
+}
+
+template <typename Fn>
+void Ternary(const Wave &W, uint64_t *Dst, const uint64_t *A,
+             const uint64_t *B, const uint64_t *C, Fn F) {
+  ForLanes(W, [&](unsigned L) { Dst[L] = F(A[L], B[L], C[L]); });
+}
+
+LLVM_ATTRIBUTE_NORETURN void Unsupported(const Twine &What) {
+  throw hlsl::Exception(DXC_E_NOT_SUPPORTED,
+                        ("DXIL interpreter: " + What + " is not supported")
+                            .str());
+}
+
+LLVM_ATTRIBUTE_NORETURN void Unsupported(const Instruction &I) {
+  std::string Str;
+  raw_string_ostream OS(Str);
+  I.print(OS);
+  Unsupported("instruction '" + Twine(StringRef(OS.str()).trim()) + "'");
+}
+
+VK GetKind(Type *Ty) {
+  switch (Ty->getTypeID()) {
+  case Type::VoidTyID:
+    return VK::None;
+  case Type::HalfTyID:
+    return VK::F16;
+  case Type::FloatTyID:
+    return VK::F32;
+  case Type::DoubleTyID:
+    return VK::F64;
+  case Type::PointerTyID:
+    return VK::Ptr;
+  case Type::IntegerTyID:
+    switch (Ty->getIntegerBitWidth()) {
+    case 1:
+      return VK::I1;
+    case 8:
+      return VK::I8;
+    case 16:
+      return VK::I16;
+    case 32:
+      return VK::I32;
+    case 64:
+      return VK::I64;
+    }
+    break;
+  case Type::StructTyID:
+    if (Ty->getStructNumElements() != 0)
+      return GetKind(Ty->getStructElementType(0));
+    break;
+  default:
+    break;
+  }
+  std::string Str;
+  raw_string_ostream OS(Str);
+  Ty->print(OS);
+  Unsupported("type '" + Twine(OS.str()) + "'");
+}
+
+// Structs occupy one slot per element, and may only hold scalars.
+unsigned GetSlotCount(Type *Ty) {
+  if (Ty->isVoidTy())
+    return 0;
+  StructType *ST = dyn_cast<StructType>(Ty);
+  if (!ST)
+    return 1;
+  for (Type *EltTy : ST->elements())
+    if (EltTy->isAggregateType() || EltTy->isVectorTy())
+      Unsupported("nested aggregate '" + ST->getName() + "'");
+  return ST->getNumElements();
+}
+
+const char *GetResourceClassPrefix(DXIL::ResourceClass Class) {
+  switch (Class) {
+  case DXIL::ResourceClass::SRV:
+    return "t";
+  case DXIL::ResourceClass::UAV:
+    return "u";
+  case DXIL::ResourceClass::CBuffer:
+    return "b";
+  default:
+    return "s";
+  }
+}
+
+} // namespace
+
+class DxilInterpreter::Impl {
+public:
+  Impl(DxilModule &DM);
+
+  void SetWaveSize(unsigned Size);
+  void Dispatch(unsigned X, unsigned Y, unsigned Z);
+
+  struct Binding {
+    uint8_t *Data;
+    size_t Size;
+    uint32_t Counter;
+  };
+  typedef std::tuple<unsigned, unsigned, unsigned> BindingKey;
+
+  DxilModule &m_DM;
+  Module &m_M;
+  const DataLayout &m_DL;
+  unsigned m_WaveSize;
+  unsigned m_NumThreads[3];
+  std::map<BindingKey, Binding> m_Bindings;
+  DxilInterpStats m_Stats;
+
+private:
+  struct ResourceHandle {
+    DXIL::ResourceClass Class;
+    unsigned Space;
+    unsigned Register;
+    DxilResourceProperties Props;
+    Binding *B;
+  };
+
+  // Compiled state, valid for m_WaveSize until m_Compiled is cleared.
+  bool m_Compiled = false;
+  std::vector<std::unique_ptr<CompiledFunction>> m_Functions;
+  DenseMap<Function *, unsigned> m_FunctionIndex;
+  DenseMap<GlobalVariable *, uint64_t> m_GlobalAddress;
+  std::vector<uint8_t> m_StaticImage; // Initial private memory of a lane.
+  std::vector<uint8_t> m_ConstantMemory;
+  unsigned m_GroupSharedSize = 0;
+  unsigned m_PrivateStride = 0;
+  unsigned m_Entry = 0;
+
+  // Dispatch state.
+  std::vector<ResourceHandle> m_Handles;
+  std::map<std::tuple<unsigned, unsigned, unsigned, uint32_t, uint32_t>,
+           unsigned>
+      m_HandleIndex;
+  std::vector<uint8_t> m_GroupShared;
+  std::vector<Wave> m_Waves;
+  std::vector<uint64_t> m_PhiValues;
+  unsigned m_GroupId[3];
+
+  // Compilation.
+  void Compile();
+  unsigned CompileFunction(Function *F);
+  void CompileInst(CompiledFunction &CF, Instruction &I,
+                   DenseMap<Value *, unsigned> &SlotOf,
+                   DenseMap<BasicBlock *, unsigned> &BlockIndex,
+                   DenseMap<Constant *, int> &PoolIndex,
+                   std::vector<uint64_t> &PoolValues);
+  int EncodeOperand(Value *V, DenseMap<Value *, unsigned> &SlotOf,
+                    DenseMap<Constant *, int> &PoolIndex,
+                    std::vector<uint64_t> &PoolValues);
+  uint64_t GetConstantValue(Constant *C);
+  uint64_t GetGlobalAddress(GlobalVariable *GV);
+  void WriteConstant(Constant *C, uint8_t *Dst);
+
+  // Execution.
+  void RunGroup();
+  bool RunWave(Wave &W);
+  void SetLanes(Wave &W, const LaneMask &Mask);
+  void ExecPhis(Wave &W, Frame &Fr, const Block &B);
+  void ExecInst(Wave &W, Frame &Fr, const Inst &In);
+  bool ExecDxilOp(Wave &W, Frame &Fr, const Inst &In);
+  void ExecWaveOp(Wave &W, Frame &Fr, const Inst &In);
+  void Branch(Wave &W, Frame &Fr, const Inst &In);
+  void Return(Wave &W, const Inst &In);
+  void Call(Wave &W, const Inst &In);
+
+  const uint64_t *Src(const Frame &Fr, int Code) const {
+    return Code >= 0 ? Fr.Regs.data() + (size_t)Code * m_WaveSize
+                     : Fr.CF->Pool.data() + (size_t)~Code * m_WaveSize;
+  }
+  uint8_t *Address(Wave &W, unsigned Lane, uint64_t Ptr, unsigned Size,
+                   bool Write);
+  uint64_t Load(Wave &W, unsigned Lane, uint64_t Ptr, VK K);
+  void Store(Wave &W, unsigned Lane, uint64_t Ptr, VK K, uint64_t V);
+
+  unsigned GetHandle(DXIL::ResourceClass Class, unsigned Space,
+                     unsigned Register, const DxilResourceProperties &Props);
+  ResourceHandle &LookupHandle(uint64_t V);
+  uint8_t *BufferAddress(ResourceHandle &H, uint64_t Offset, unsigned Size);
+  uint64_t BufferOffset(ResourceHandle &H, uint64_t C0, uint64_t C1,
+                        unsigned CompBytes, unsigned &NumComps);
+  unsigned GetThreadIdInGroup(unsigned FlatId, unsigned Comp) const;
+};
+
+DxilInterpreter::Impl::Impl(DxilModule &DM)
+    : m_DM(DM), m_M(*DM.GetModule()), m_DL(DM.GetModule()->getDataLayout()) {
+  IFTBOOLMSG(DM.GetShaderModel()->IsCS(), DXC_E_NOT_SUPPORTED,
+             "DXIL interpreter: only compute shaders are supported");
+  for (unsigned i = 0; i < 3; ++i)
+    m_NumThreads[i] = DM.GetNumThreads(i);
+  const DxilWaveSize &WS = DM.GetWaveSize();
+  if (WS.Preferred)
+    m_WaveSize = WS.Preferred;
+  else if (WS.Min && !WS.Max)
+    m_WaveSize = WS.Min;
+  else if (WS.Min)
+    m_WaveSize = std::min(std::max(kDefaultWaveSize, WS.Min), WS.Max);
+  else
+    m_WaveSize = kDefaultWaveSize;
+  memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+void DxilInterpreter::Impl::SetWaveSize(unsigned Size) {
+  IFTBOOLMSG(DxilWaveSize::IsValidValue(Size), E_INVALIDARG,
+             "wave size must be a power of two between 4 and 128");
+  if (Size != m_WaveSize)
+    m_Compiled = false;
+  m_WaveSize = Size;
+}
+
+//===----------------------------------------------------------------------===//
+// Compilation
+//===----------------------------------------------------------------------===//
+
+void DxilInterpreter::Impl::Compile() {
+  m_Functions.clear();
+  m_FunctionIndex.clear();
+  m_GlobalAddress.clear();
+  m_StaticImage.clear();
+  m_ConstantMemory.clear();
+  m_GroupSharedSize = 0;
+
+  Function *Entry = m_DM.GetEntryFunction();
+  IFTBOOLMSG(Entry && Entry->arg_empty(), DXC_E_NOT_SUPPORTED,
+             "DXIL interpreter: entry point must take no arguments");
+  m_Entry = CompileFunction(Entry);
+  m_PrivateStride = RoundUpToAlignment(m_StaticImage.size() +
+                                m_Functions[m_Entry]->StackSize,
+                            8);
+  m_Compiled = true;
+}
+
+unsigned DxilInterpreter::Impl::CompileFunction(Function *F) {
+  auto It = m_FunctionIndex.find(F);
+  if (It != m_FunctionIndex.end()) {
+    if (m_Functions[It->second]->Compiling)
+      Unsupported("recursive call to '" + F->getName() + "'");
+    return It->second;
+  }
+  unsigned Index = m_Functions.size();
+  m_Functions.emplace_back(new CompiledFunction());
+  m_FunctionIndex[F] = Index;
+  // Compiling callees adds to m_Functions, but does not move this one.
+  CompiledFunction &CF = *m_Functions.back();
+  CF.F = F;
+
+  DenseMap<BasicBlock *, unsigned> BlockIndex;
+  for (BasicBlock &BB : *F) {
+    unsigned Idx = BlockIndex.size();
+    BlockIndex[&BB] = Idx;
+  }
+
+  DominatorTreeBase<BasicBlock> PDT(true);
+  PDT.recalculate(*F);
+  CF.IPostDom.assign(BlockIndex.size(), kNoBlock);
+  for (BasicBlock &BB : *F) {
+    DomTreeNodeBase<BasicBlock> *Node = PDT.getNode(&BB);
+    if (Node && Node->getIDom() && Node->getIDom()->getBlock())
+      CF.IPostDom[BlockIndex[&BB]] = BlockIndex[Node->getIDom()->getBlock()];
+  }
+
+  DenseMap<Value *, unsigned> SlotOf;
+  unsigned NextSlot = 0;
+  for (Argument &A : F->args()) {
+    if (GetSlotCount(A.getType()) != 1)
+      Unsupported("aggregate argument of '" + F->getName() + "'");
+    GetKind(A.getType());
+    SlotOf[&A] = NextSlot++;
+  }
+  CF.NumArgs = NextSlot;
+  for (BasicBlock &BB : *F) {
+    for (Instruction &I : BB) {
+      unsigned Slots = GetSlotCount(I.getType());
+      if (Slots) {
+        SlotOf[&I] = NextSlot;
+        NextSlot += Slots;
+      }
+    }
+  }
+  CF.NumSlots = NextSlot;
+
+  DenseMap<Constant *, int> PoolIndex;
+  std::vector<uint64_t> PoolValues;
+  for (BasicBlock &BB : *F) {
+    Block B;
+    B.Begin = CF.Insts.size();
+    B.PhiEnd = B.Begin;
+    for (Instruction &I : BB) {
+      CompileInst(CF, I, SlotOf, BlockIndex, PoolIndex, PoolValues);
+      if (isa<PHINode>(I))
+        B.PhiEnd = CF.Insts.size();
+    }
+    CF.Blocks.push_back(B);
+  }
+
+  CF.Pool.resize(PoolValues.size() * m_WaveSize);
+  for (size_t i = 0; i < PoolValues.size(); ++i)
+    std::fill_n(CF.Pool.begin() + i * m_WaveSize, m_WaveSize, PoolValues[i]);
+
+  unsigned CalleeStack = 0;
+  for (const Inst &In : CF.Insts)
+    if (In.Op == kOpCall)
+      CalleeStack = std::max(CalleeStack, m_Functions[In.Aux]->StackSize);
+  CF.StackSize = CF.FrameSize + CalleeStack;
+  CF.Compiling = false;
+  return Index;
+}
+
+void DxilInterpreter::Impl::CompileInst(
+    CompiledFunction &CF, Instruction &I, DenseMap<Value *, unsigned> &SlotOf,
+    DenseMap<BasicBlock *, unsigned> &BlockIndex,
+    DenseMap<Constant *, int> &PoolIndex, std::vector<uint64_t> &PoolValues) {
+  Inst In;
+  In.I = &I;
+  In.Op = I.getOpcode();
+  In.Aux = 0;
+  In.Dest = 0;
+  In.NumSlots = GetSlotCount(I.getType());
+  if (In.NumSlots)
+    In.Dest = SlotOf[&I];
+  In.Ty = GetKind(I.getType());
+  In.OpTy = I.getNumOperands() && !isa<BasicBlock>(I.getOperand(0))
+                ? GetKind(I.getOperand(0)->getType())
+                : VK::None;
+  In.Operands = CF.Codes.size();
+  In.Extra = CF.Extra.size();
+
+  auto AddOperand = [&](Value *V) {
+    CF.Codes.push_back(EncodeOperand(V, SlotOf, PoolIndex, PoolValues));
+  };
+
+  switch (I.getOpcode()) {
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::FAdd:
+  case Instruction::FSub:
+  case Instruction::FMul:
+  case Instruction::FDiv:
+  case Instruction::FRem:
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+  case Instruction::FPTrunc:
+  case Instruction::FPExt:
+  case Instruction::FPToUI:
+  case Instruction::FPToSI:
+  case Instruction::UIToFP:
+  case Instruction::SIToFP:
+  case Instruction::BitCast:
+  case Instruction::AddrSpaceCast:
+  case Instruction::Select:
+  case Instruction::Load:
+  case Instruction::Store:
+    if (I.getType()->isVectorTy() ||
+        (I.getNumOperands() && I.getOperand(0)->getType()->isVectorTy()))
+      Unsupported(I);
+    for (Value *V : I.operands())
+      AddOperand(V);
+    if (I.getOpcode() == Instruction::Load ||
+        I.getOpcode() == Instruction::Store) {
+      Value *Ptr = isa<LoadInst>(I) ? cast<LoadInst>(I).getPointerOperand()
+                                  : cast<StoreInst>(I).getPointerOperand();
+      if (GetSlotCount(Ptr->getType()->getPointerElementType()) != 1 ||
+          GetKind(Ptr->getType()->getPointerElementType()) == VK::Ptr)
+        Unsupported(I);
+    }
+    break;
+  case Instruction::ICmp:
+  case Instruction::FCmp:
+    In.Aux = cast<CmpInst>(I).getPredicate();
+    for (Value *V : I.operands())
+      AddOperand(V);
+    break;
+  case Instruction::ExtractValue: {
+    ExtractValueInst &EVI = cast<ExtractValueInst>(I);
+    if (EVI.getNumIndices() != 1)
+      Unsupported(I);
+    In.Aux = EVI.getIndices()[0];
+    AddOperand(EVI.getAggregateOperand());
+    break;
+  }
+  case Instruction::InsertValue: {
+    InsertValueInst &IVI = cast<InsertValueInst>(I);
+    if (IVI.getNumIndices() != 1)
+      Unsupported(I);
+    In.Aux = IVI.getIndices()[0];
+    AddOperand(IVI.getAggregateOperand());
+    AddOperand(IVI.getInsertedValueOperand());
+    break;
+  }
+  case Instruction::GetElementPtr: {
+    GetElementPtrInst &GEP = cast<GetElementPtrInst>(I);
+    AddOperand(GEP.getPointerOperand());
+    // Side data: constant offset, number of variable terms, then the
+    // operand code, scale and index width of each term.
+    int64_t ConstOffset = 0;
+    SmallVector<int64_t, 6> Terms;
+    gep_type_iterator GTI = gep_type_begin(GEP);
+    for (auto Idx = GEP.idx_begin(), E = GEP.idx_end(); Idx != E;
+         ++Idx, ++GTI) {
+      if (StructType *ST = dyn_cast<StructType>(*GTI)) {
+        unsigned Field = cast<ConstantInt>(*Idx)->getZExtValue();
+        ConstOffset += m_DL.getStructLayout(ST)->getElementOffset(Field);
+        continue;
+      }
+      int64_t Scale = m_DL.getTypeAllocSize(GTI.getIndexedType());
+      if (ConstantInt *CI = dyn_cast<ConstantInt>(*Idx)) {
+        ConstOffset += CI->getSExtValue() * Scale;
+        continue;
+      }
+      Terms.push_back(EncodeOperand(*Idx, SlotOf, PoolIndex, PoolValues));
+      Terms.push_back(Scale);
+      Terms.push_back((*Idx)->getType()->getIntegerBitWidth());
+    }
+    CF.Extra.push_back(ConstOffset);
+    CF.Extra.push_back(Terms.size() / 3);
+    CF.Extra.insert(CF.Extra.end(), Terms.begin(), Terms.end());
+    break;
+  }
+  case Instruction::Alloca: {
+    AllocaInst &AI = cast<AllocaInst>(I);
+    ConstantInt *Count = dyn_cast<ConstantInt>(AI.getArraySize());
+    if (!Count)
+      Unsupported(I);
+    unsigned Align =
+        std::max(AI.getAlignment(),
+                 m_DL.getPrefTypeAlignment(AI.getAllocatedType()));
+    CF.FrameSize = RoundUpToAlignment(CF.FrameSize, Align);
+    In.Aux = CF.FrameSize;
+    CF.FrameSize +=
+        m_DL.getTypeAllocSize(AI.getAllocatedType()) * Count->getZExtValue();
+    break;
+  }
+  case Instruction::AtomicRMW: {
+    AtomicRMWInst &RMW = cast<AtomicRMWInst>(I);
+    In.Aux = RMW.getOperation();
+    AddOperand(RMW.getPointerOperand());
+    AddOperand(RMW.getValOperand());
+    break;
+  }
+  case Instruction::AtomicCmpXchg: {
+    AtomicCmpXchgInst &CX = cast<AtomicCmpXchgInst>(I);
+    AddOperand(CX.getPointerOperand());
+    AddOperand(CX.getCompareOperand());
+    AddOperand(CX.getNewValOperand());
+    break;
+  }
+  case Instruction::PHI: {
+    PHINode &Phi = cast<PHINode>(I);
+    CF.Extra.push_back(Phi.getNumIncomingValues());
+    for (unsigned i = 0, e = Phi.getNumIncomingValues(); i != e; ++i) {
+      CF.Extra.push_back(BlockIndex[Phi.getIncomingBlock(i)]);
+      CF.Extra.push_back(EncodeOperand(Phi.getIncomingValue(i), SlotOf,
+                                       PoolIndex, PoolValues));
+    }
+    break;
+  }
+  case Instruction::Br: {
+    BranchInst &Br = cast<BranchInst>(I);
+    if (Br.isConditional())
+      AddOperand(Br.getCondition());
+    for (unsigned i = 0, e = Br.getNumSuccessors(); i != e; ++i)
+      CF.Extra.push_back(BlockIndex[Br.getSuccessor(i)]);
+    In.OpTy = VK::I1;
+    break;
+  }
+  case Instruction::Switch: {
+    SwitchInst &SI = cast<SwitchInst>(I);
+    AddOperand(SI.getCondition());
+    CF.Extra.push_back(SI.getNumCases());
+    CF.Extra.push_back(BlockIndex[SI.getDefaultDest()]);
+    for (auto Case : SI.cases()) {
+      CF.Extra.push_back(GetConstantValue(Case.getCaseValue()));
+      CF.Extra.push_back(BlockIndex[Case.getCaseSuccessor()]);
+    }
+    break;
+  }
+  case Instruction::Ret:
+    if (Value *V = cast<ReturnInst>(I).getReturnValue()) {
+      unsigned Slots = GetSlotCount(V->getType());
+      int Code = EncodeOperand(V, SlotOf, PoolIndex, PoolValues);
+      // Aggregates are returned slot by slot.
+      for (unsigned i = 0; i < Slots; ++i)
+        CF.Codes.push_back(Code >= 0 ? Code + (int)i : Code - (int)i);
+    }
+    break;
+  case Instruction::Unreachable:
+    break;
+  case Instruction::Call: {
+    CallInst &CI = cast<CallInst>(I);
+    Function *Callee = CI.getCalledFunction();
+    if (!Callee)
+      Unsupported(I);
+    if (OP::IsDxilOpFunc(Callee)) {
+      In.Op = kOpDxil;
+      In.Aux = (unsigned)OP::getOpCode(&CI);
+      Type *OvlTy = OP::GetOverloadType((DXIL::OpCode)In.Aux, Callee);
+      In.OpTy = OvlTy ? GetKind(OvlTy) : VK::None;
+      for (unsigned i = 1, e = CI.getNumArgOperands(); i != e; ++i)
+        AddOperand(CI.getArgOperand(i));
+      break;
+    }
+    if (Callee->isDeclaration()) {
+      // Debug info and lifetime markers have no effect here.
+      StringRef Name = Callee->getName();
+      if (Name.startswith("llvm.dbg.") || Name.startswith("llvm.lifetime."))
+        return;
+      Unsupported("call to '" + Name + "'");
+    }
+    In.Op = kOpCall;
+    In.Aux = CompileFunction(Callee);
+    for (Value *V : CI.arg_operands())
+      AddOperand(V);
+    break;
+  }
+  default:
+    Unsupported(I);
+  }
+  In.NumOperands = CF.Codes.size() - In.Operands;
+  CF.Insts.push_back(In);
+}
+
+int DxilInterpreter::Impl::EncodeOperand(Value *V,
+                                         DenseMap<Value *, unsigned> &SlotOf,
+                                         DenseMap<Constant *, int> &PoolIndex,
+                                         std::vector<uint64_t> &PoolValues) {
+  auto Slot = SlotOf.find(V);
+  if (Slot != SlotOf.end())
+    return Slot->second;
+  Constant *C = dyn_cast<Constant>(V);
+  if (!C)
+    Unsupported("operand '" + V->getName() + "'");
+  auto It = PoolIndex.find(C);
+  if (It != PoolIndex.end())
+    return It->second;
+  // Aggregates take consecutive entries, so that element i of the one at
+  // code c is at code c - i.
+  int Code = ~(int)PoolValues.size();
+  if (StructType *ST = dyn_cast<StructType>(C->getType())) {
+    GetSlotCount(ST);
+    for (unsigned i = 0, e = ST->getNumElements(); i != e; ++i)
+      PoolValues.push_back(GetConstantValue(C->getAggregateElement(i)));
+  } else {
+    PoolValues.push_back(GetConstantValue(C));
+  }
+  PoolIndex[C] = Code;
+  return Code;
+}
+
+uint64_t DxilInterpreter::Impl::GetConstantValue(Constant *C) {
+  if (ConstantInt *CI = dyn_cast<ConstantInt>(C)) {
+    if (CI->getBitWidth() > 64)
+      Unsupported("wide integer constant");
+    return CI->getZExtValue();
+  }
+  if (ConstantFP *CFP = dyn_cast<ConstantFP>(C))
+    return CFP->getValueAPF().bitcastToAPInt().getZExtValue();
+  if (isa<UndefValue>(C) || isa<ConstantAggregateZero>(C) ||
+      isa<ConstantPointerNull>(C))
+    return 0;
+  if (GlobalVariable *GV = dyn_cast<GlobalVariable>(C))
+    return GetGlobalAddress(GV);
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(C)) {
+    switch (CE->getOpcode()) {
+    case Instruction::BitCast:
+    case Instruction::AddrSpaceCast:
+      return GetConstantValue(CE->getOperand(0));
+    case Instruction::GetElementPtr: {
+      GEPOperator *GEP = cast<GEPOperator>(CE);
+      APInt Offset(m_DL.getPointerSizeInBits(GEP->getPointerAddressSpace()),
+                   0);
+      if (!GEP->accumulateConstantOffset(m_DL, Offset))
+        break;
+      return GetConstantValue(cast<Constant>(GEP->getPointerOperand())) +
+             Offset.getSExtValue();
+    }
+    default:
+      break;
+    }
+  }
+  std::string Str;
+  raw_string_ostream OS(Str);
+  C->print(OS);
+  Unsupported("constant '" + Twine(OS.str()) + "'");
+}
+
+uint64_t DxilInterpreter::Impl::GetGlobalAddress(GlobalVariable *GV) {
+  auto It = m_GlobalAddress.find(GV);
+  if (It != m_GlobalAddress.end())
+    return It->second;
+  Type *Ty = GV->getType()->getPointerElementType();
+  uint64_t Size = m_DL.getTypeAllocSize(Ty);
+  unsigned Align = std::max(GV->getAlignment(), m_DL.getPrefTypeAlignment(Ty));
+  uint64_t Ptr;
+  switch (GV->getType()->getPointerAddressSpace()) {
+  case DXIL::kTGSMAddrSpace:
+    m_GroupSharedSize = RoundUpToAlignment(m_GroupSharedSize, Align);
+    Ptr = MakePointer(kGroupSharedSpace, m_GroupSharedSize);
+    m_GroupSharedSize += Size;
+    break;
+  case DXIL::kDefaultAddrSpace:
+  case DXIL::kImmediateCBufferAddrSpace: {
+    // Constants are shared by all lanes; other globals are static
+    // variables, private to each thread.
+    bool IsConstant = GV->isConstant() && GV->hasInitializer();
+    std::vector<uint8_t> &Memory =
+        IsConstant ? m_ConstantMemory : m_StaticImage;
+    size_t Offset = RoundUpToAlignment(Memory.size(), Align);
+    Memory.resize(Offset + Size);
+    if (GV->hasInitializer())
+      WriteConstant(GV->getInitializer(), Memory.data() + Offset);
+    Ptr = MakePointer(IsConstant ? kConstantSpace : kPrivateSpace, Offset);
+    break;
+  }
+  default:
+    Unsupported("global '" + GV->getName() + "' in address space " +
+                Twine(GV->getType()->getPointerAddressSpace()));
+  }
+  m_GlobalAddress[GV] = Ptr;
+  return Ptr;
+}
+
+void DxilInterpreter::Impl::WriteConstant(Constant *C, uint8_t *Dst) {
+  if (isa<UndefValue>(C) || isa<ConstantAggregateZero>(C))
+    return; // Memory starts zeroed.
+  Type *Ty = C->getType();
+  if (ArrayType *AT = dyn_cast<ArrayType>(Ty)) {
+    uint64_t EltSize = m_DL.getTypeAllocSize(AT->getElementType());
+    for (unsigned i = 0, e = AT->getNumElements(); i != e; ++i)
+      WriteConstant(C->getAggregateElement(i), Dst + i * EltSize);
+    return;
+  }
+  if (StructType *ST = dyn_cast<StructType>(Ty)) {
+    const StructLayout *SL = m_DL.getStructLayout(ST);
+    for (unsigned i = 0, e = ST->getNumElements(); i != e; ++i)
+      WriteConstant(C->getAggregateElement(i), Dst + SL->getElementOffset(i));
+    return;
+  }
+  VK K = GetKind(Ty);
+  if (K == VK::Ptr)
+    Unsupported("pointer in a global initializer");
+  uint64_t V = GetConstantValue(C);
+  memcpy(Dst, &V, GetBytes(K));
+}
+
+//===----------------------------------------------------------------------===//
+// Execution
+//===----------------------------------------------------------------------===//
+
+void DxilInterpreter::Impl::Dispatch(unsigned X, unsigned Y, unsigned Z) {
+  if (!m_Compiled)
+    Compile();
+  m_Handles.clear();
+  m_HandleIndex.clear();
+  for (m_GroupId[2] = 0; m_GroupId[2] < Z; ++m_GroupId[2])
+    for (m_GroupId[1] = 0; m_GroupId[1] < Y; ++m_GroupId[1])
+      for (m_GroupId[0] = 0; m_GroupId[0] < X; ++m_GroupId[0])
+        RunGroup();
+}
+
+void DxilInterpreter::Impl::RunGroup() {
+  unsigned GroupThreads = m_NumThreads[0] * m_NumThreads[1] * m_NumThreads[2];
+  unsigned NumWaves = (GroupThreads + m_WaveSize - 1) / m_WaveSize;
+  m_GroupShared.assign(m_GroupSharedSize, 0);
+  m_Waves.resize(NumWaves);
+  CompiledFunction &Entry = *m_Functions[m_Entry];
+  for (unsigned i = 0; i < NumWaves; ++i) {
+    Wave &W = m_Waves[i];
+    W.FirstThread = i * m_WaveSize;
+    W.Done = false;
+    W.NumLanes = 0;
+    W.Private.resize((size_t)m_PrivateStride * m_WaveSize);
+    for (unsigned L = 0; L < m_WaveSize; ++L)
+      std::copy(m_StaticImage.begin(), m_StaticImage.end(),
+                W.Private.begin() + (size_t)L * m_PrivateStride);
+
+    W.Frames.resize(1);
+    Frame &Fr = W.Frames[0];
+    Fr.CF = &Entry;
+    Fr.Regs.assign((size_t)Entry.NumSlots * m_WaveSize, 0);
+    Fr.Prev.assign(m_WaveSize, kNoBlock);
+    Fr.Next = kBlockStart;
+    Fr.PrivateBase = m_StaticImage.size();
+    Fr.ReturnDest = 0;
+    StackEntry Bottom;
+    Bottom.PC = 0;
+    Bottom.RPC = kNoBlock;
+    for (unsigned L = 0; L < m_WaveSize && W.FirstThread + L < GroupThreads;
+         ++L)
+      Bottom.Mask.set(L);
+    Fr.Stack.assign(1, Bottom);
+  }
+  ++m_Stats.Groups;
+  m_Stats.Waves += NumWaves;
+
+  // Each round runs every wave up to its next group barrier, so no wave
+  // passes a barrier before all have reached it.
+  for (bool AllDone = false; !AllDone;) {
+    AllDone = true;
+    for (Wave &W : m_Waves) {
+      if (!W.Done)
+        W.Done = RunWave(W);
+      AllDone &= W.Done;
+    }
+  }
+}
+
+void DxilInterpreter::Impl::SetLanes(Wave &W, const LaneMask &Mask) {
+  W.NumLanes = 0;
+  for (unsigned i = 0; i < 2; ++i)
+    for (uint64_t Bits = Mask.Words[i]; Bits; Bits &= Bits - 1)
+      W.Lanes[W.NumLanes++] = i * 64 + countTrailingZeros(Bits);
+}
+
+// Runs W until it returns from the entry point, or reaches a group barrier.
+// Returns true if it finished.
+bool DxilInterpreter::Impl::RunWave(Wave &W) {
+  for (;;) {
+    Frame &Fr = W.Frames.back();
+    CompiledFunction &CF = *Fr.CF;
+    if (Fr.Next == kBlockStart) {
+      const Block &B = CF.Blocks[Fr.Stack.back().PC];
+      SetLanes(W, Fr.Stack.back().Mask);
+      ExecPhis(W, Fr, B);
+      Fr.Next = B.PhiEnd;
+    }
+    for (unsigned i = Fr.Next;; ++i) {
+      const Inst &In = CF.Insts[i];
+      ++m_Stats.WaveInstructions;
+      m_Stats.LaneInstructions += W.NumLanes;
+      switch (In.Op) {
+      case Instruction::Br:
+      case Instruction::Switch:
+        Branch(W, Fr, In);
+        break;
+      case Instruction::Ret:
+        Return(W, In);
+        if (W.Frames.empty())
+          return true;
+        break;
+      case Instruction::Unreachable:
+        throw hlsl::Exception(DXC_E_GENERAL_INTERNAL_ERROR,
+                              "DXIL interpreter: reached unreachable in '" +
+                                  CF.F->getName().str() + "'");
+      case kOpCall:
+        Fr.Next = i + 1;
+        Call(W, In);
+        break;
+      case kOpDxil:
+        if (ExecDxilOp(W, Fr, In)) {
+          Fr.Next = i + 1;
+          return false;
+        }
+        continue;
+      default:
+        ExecInst(W, Fr, In);
+        continue;
+      }
+      break;
+    }
+  }
+}
+
+void DxilInterpreter::Impl::ExecPhis(Wave &W, Frame &Fr, const Block &B) {
+  const CompiledFunction &CF = *Fr.CF;
+  unsigned NumSlots = 0;
+  for (unsigned i = B.Begin; i < B.PhiEnd; ++i)
+    NumSlots += CF.Insts[i].NumSlots;
+  if (!NumSlots)
+    return;
+  // Read every incoming value before writing any phi, since phis of a
+  // block may use each other.
+  m_PhiValues.resize((size_t)NumSlots * m_WaveSize);
+  uint64_t *Out = m_PhiValues.data();
+  for (unsigned i = B.Begin; i < B.PhiEnd; ++i) {
+    const Inst &In = CF.Insts[i];
+    const int64_t *Incoming = CF.Extra.data() + In.Extra;
+    unsigned NumIncoming = Incoming[0];
+    ForLanes(W, [&](unsigned L) {
+      for (unsigned j = 0; j < NumIncoming; ++j) {
+        if (Incoming[1 + 2 * j] != Fr.Prev[L])
+          continue;
+        int Code = Incoming[2 + 2 * j];
+        for (unsigned s = 0; s < In.NumSlots; ++s)
+          Out[s * m_WaveSize + L] =
+              Src(Fr, Code >= 0 ? Code + (int)s : Code - (int)s)[L];
+        break;
+      }
+    });
+    Out += (size_t)In.NumSlots * m_WaveSize;
+  }
+  Out = m_PhiValues.data();
+  for (unsigned i = B.Begin; i < B.PhiEnd; ++i) {
+    const Inst &In = CF.Insts[i];
+    for (unsigned s = 0; s < In.NumSlots; ++s) {
+      uint64_t *Dst = Fr.Regs.data() + (size_t)(In.Dest + s) * m_WaveSize;
+      ForLanes(W, [&](unsigned L) { Dst[L] = Out[L]; });
+      Out += m_WaveSize;
+    }
+  }
+}
+
+void DxilInterpreter::Impl::Branch(Wave &W, Frame &Fr, const Inst &In) {
+  const CompiledFunction &CF = *Fr.CF;
+  const int64_t *Extra = CF.Extra.data() + In.Extra;
+  unsigned Cur = Fr.Stack.back().PC;
+  ForLanes(W, [&](unsigned L) { Fr.Prev[L] = Cur; });
+
+  SmallVector<std::pair<unsigned, LaneMask>, 4> Targets;
+  auto AddLane = [&](unsigned Target, unsigned L) {
+    for (auto &T : Targets) {
+      if (T.first == Target) {
+        T.second.set(L);
+        return;
+      }
+    }
+    Targets.push_back(std::make_pair(Target, LaneMask()));
+    Targets.back().second.set(L);
+  };
+  if (In.Op == Instruction::Br) {
+    if (In.NumOperands == 0) {
+      Targets.push_back(std::make_pair(Extra[0], Fr.Stack.back().Mask));
+    } else {
+      const uint64_t *Cond = Src(Fr, CF.Codes[In.Operands]);
+      ForLanes(W, [&](unsigned L) { AddLane(Extra[Cond[L] ? 0 : 1], L); });
+    }
+  } else {
+    const uint64_t *Cond = Src(Fr, CF.Codes[In.Operands]);
+    unsigned NumCases = Extra[0];
+    ForLanes(W, [&](unsigned L) {
+      unsigned Target = Extra[1];
+      for (unsigned j = 0; j < NumCases; ++j) {
+        if ((uint64_t)Extra[2 + 2 * j] == Cond[L]) {
+          Target = Extra[3 + 2 * j];
+          break;
+        }
+      }
+      AddLane(Target, L);
+    });
+  }
+
+  if (Targets.size() == 1) {
+    Fr.Stack.back().PC = Targets[0].first;
+  } else {
+    // Divergence: the lanes wait at the immediate post-dominator while each
+    // target runs. If they already wait there below, the entry is redundant.
+    unsigned R = CF.IPostDom[Cur];
+    if (R == Fr.Stack.back().RPC && Fr.Stack.size() > 1)
+      Fr.Stack.pop_back();
+    else
+      Fr.Stack.back().PC = R;
+    for (auto &T : Targets) {
+      if (T.first == R)
+        continue;
+      StackEntry E;
+      E.PC = T.first;
+      E.RPC = R;
+      E.Mask = T.second;
+      Fr.Stack.push_back(E);
+    }
+  }
+  while (Fr.Stack.back().PC == Fr.Stack.back().RPC)
+    Fr.Stack.pop_back();
+  Fr.Next = kBlockStart;
+}
+
+void DxilInterpreter::Impl::Return(Wave &W, const Inst &In) {
+  Frame &Fr = W.Frames.back();
+  if (In.NumOperands && W.Frames.size() > 1) {
+    Frame &Caller = W.Frames[W.Frames.size() - 2];
+    for (unsigned s = 0; s < In.NumOperands; ++s) {
+      const uint64_t *V = Src(Fr, Fr.CF->Codes[In.Operands + s]);
+      uint64_t *Dst =
+          Caller.Regs.data() + (size_t)(Fr.ReturnDest + s) * m_WaveSize;
+      ForLanes(W, [&](unsigned L) { Dst[L] = V[L]; });
+    }
+  }
+  // The returning lanes leave every entry; entries left empty are done.
+  LaneMask Returned = Fr.Stack.back().Mask;
+  for (StackEntry &E : Fr.Stack)
+    E.Mask.reset(Returned);
+  while (!Fr.Stack.empty() && Fr.Stack.back().Mask.none())
+    Fr.Stack.pop_back();
+  if (!Fr.Stack.empty()) {
+    assert(Fr.Stack.back().PC != kNoBlock && "lanes stranded at the exit");
+    Fr.Next = kBlockStart;
+    return;
+  }
+  W.Frames.pop_back();
+  if (!W.Frames.empty())
+    SetLanes(W, W.Frames.back().Stack.back().Mask);
+}
+
+void DxilInterpreter::Impl::Call(Wave &W, const Inst &In) {
+  CompiledFunction &Callee = *m_Functions[In.Aux];
+  W.Frames.emplace_back();
+  Frame &Caller = W.Frames[W.Frames.size() - 2];
+  Frame &Fr = W.Frames.back();
+  Fr.CF = &Callee;
+  Fr.Regs.assign((size_t)Callee.NumSlots * m_WaveSize, 0);
+  for (unsigned i = 0; i < Callee.NumArgs; ++i) {
+    const uint64_t *V = Src(Caller, Caller.CF->Codes[In.Operands + i]);
+    uint64_t *Dst = Fr.Regs.data() + (size_t)i * m_WaveSize;
+    ForLanes(W, [&](unsigned L) { Dst[L] = V[L]; });
+  }
+  StackEntry Bottom;
+  Bottom.PC = 0;
+  Bottom.RPC = kNoBlock;
+  Bottom.Mask = Caller.Stack.back().Mask;
+  Fr.Stack.assign(1, Bottom);
+  Fr.Prev.assign(m_WaveSize, kNoBlock);
+  Fr.Next = kBlockStart;
+  Fr.PrivateBase = Caller.PrivateBase + Caller.CF->FrameSize;
+  Fr.ReturnDest = In.Dest;
+}
+
+uint8_t *DxilInterpreter::Impl::Address(Wave &W, unsigned Lane, uint64_t Ptr,
+                                        unsigned Size, bool Write) {
+  uint64_t Offset = Ptr & kOffsetMask;
+  switch (Ptr >> kSpaceShift) {
+  case kPrivateSpace:
+    if (Offset + Size <= m_PrivateStride)
+      return &W.Private[(size_t)Lane * m_PrivateStride + Offset];
+    break;
+  case kGroupSharedSpace:
+    if (Offset + Size <= m_GroupShared.size())
+      return &m_GroupShared[Offset];
+    break;
+  case kConstantSpace:
+    if (!Write && Offset + Size <= m_ConstantMemory.size())
+      return &m_ConstantMemory[Offset];
+    break;
+  }
+  return nullptr;
+}
+
+uint64_t DxilInterpreter::Impl::Load(Wave &W, unsigned Lane, uint64_t Ptr,
+                                     VK K) {
+  uint64_t V = 0;
+  if (const uint8_t *P = Address(W, Lane, Ptr, GetBytes(K), false))
+    memcpy(&V, P, GetBytes(K));
+  return Trunc(V, GetBits(K));
+}
+
+void DxilInterpreter::Impl::Store(Wave &W, unsigned Lane, uint64_t Ptr, VK K,
+                                  uint64_t V) {
+  if (uint8_t *P = Address(W, Lane, Ptr, GetBytes(K), true))
+    memcpy(P, &V, GetBytes(K));
+}
+
+void DxilInterpreter::Impl::ExecInst(Wave &W, Frame &Fr, const Inst &In) {
+  const CompiledFunction &CF = *Fr.CF;
+  const int *Ops = CF.Codes.data() + In.Operands;
+  uint64_t *Dst = Fr.Regs.data() + (size_t)In.Dest * m_WaveSize;
+  const uint64_t *A = In.NumOperands > 0 ? Src(Fr, Ops[0]) : nullptr;
+  const uint64_t *B = In.NumOperands > 1 ? Src(Fr, Ops[1]) : nullptr;
+  VK K = In.Ty;
+  VK OpK = In.OpTy;
+  unsigned Bits = GetBits(K);
+  unsigned OpBits = GetBits(OpK);
+
+  switch (In.Op) {
+  case Instruction::Add:
+    return Binary(W, Dst, A, B,
+                  [=](uint64_t X, uint64_t Y) { return Trunc(X + Y, Bits); });
+  case Instruction::Sub:
+    return Binary(W, Dst, A, B,
+                  [=](uint64_t X, uint64_t Y) { return Trunc(X - Y, Bits); });
+  case Instruction::Mul:
+    return Binary(W, Dst, A, B,
+                  [=](uint64_t X, uint64_t Y) { return Trunc(X * Y, Bits); });
+  // Division by zero gives all ones, as D3D's udiv does.
+  case Instruction::UDiv:
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) {
+      return Y ? X / Y : Trunc(~0ULL, Bits);
+    });
+  case Instruction::URem:
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) {
+      return Y ? X % Y : Trunc(~0ULL, Bits);
+    });
+  case Instruction::SDiv:
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) {
+      int64_t SX = SExt(X, Bits), SY = SExt(Y, Bits);
+      if (!SY)
+        return Trunc(~0ULL, Bits);
+      if (SY == -1)
+        return Trunc(0 - X, Bits);
+      return Trunc(SX / SY, Bits);
+    });
+  case Instruction::SRem:
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) {
+      int64_t SX = SExt(X, Bits), SY = SExt(Y, Bits);
+      if (!SY)
+        return Trunc(~0ULL, Bits);
+      if (SY == -1)
+        return (uint64_t)0;
+      return Trunc(SX % SY, Bits);
+    });
+  // Shift amounts are taken modulo the width, as in DXIL.
+  case Instruction::Shl:
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) {
+      return Trunc(X << (Y & (Bits - 1)), Bits);
+    });
+  case Instruction::LShr:
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) {
+      return X >> (Y & (Bits - 1));
+    });
+  case Instruction::AShr:
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) {
+      return Trunc(SExt(X, Bits) >> (Y & (Bits - 1)), Bits);
+    });
+  case Instruction::And:
+    return Binary(W, Dst, A, B, [](uint64_t X, uint64_t Y) { return X & Y; });
+  case Instruction::Or:
+    return Binary(W, Dst, A, B, [](uint64_t X, uint64_t Y) { return X | Y; });
+  case Instruction::Xor:
+    return Binary(W, Dst, A, B, [](uint64_t X, uint64_t Y) { return X ^ Y; });
+  case Instruction::FAdd:
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) {
+      return WriteFP(ReadFP(X, K) + ReadFP(Y, K), K);
+    });
+  case Instruction::FSub:
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) {
+      return WriteFP(ReadFP(X, K) - ReadFP(Y, K), K);
+    });
+  case Instruction::FMul:
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) {
+      return WriteFP(ReadFP(X, K) * ReadFP(Y, K), K);
+    });
+  case Instruction::FDiv:
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) {
+      return WriteFP(ReadFP(X, K) / ReadFP(Y, K), K);
+    });
+  case Instruction::FRem:
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) {
+      return WriteFP(std::fmod(ReadFP(X, K), ReadFP(Y, K)), K);
+    });
+
+  case Instruction::ICmp: {
+    CmpInst::Predicate P = (CmpInst::Predicate)In.Aux;
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) -> uint64_t {
+      int64_t SX = SExt(X, OpBits), SY = SExt(Y, OpBits);
+      switch (P) {
+      case CmpInst::ICMP_EQ:
+        return X == Y;
+      case CmpInst::ICMP_NE:
+        return X != Y;
+      case CmpInst::ICMP_UGT:
+        return X > Y;
+      case CmpInst::ICMP_UGE:
+        return X >= Y;
+      case CmpInst::ICMP_ULT:
+        return X < Y;
+      case CmpInst::ICMP_ULE:
+        return X <= Y;
+      case CmpInst::ICMP_SGT:
+        return SX > SY;
+      case CmpInst::ICMP_SGE:
+        return SX >= SY;
+      case CmpInst::ICMP_SLT:
+        return SX < SY;
+      default:
+        return SX <= SY;
+      }
+    });
+  }
+  case Instruction::FCmp: {
+    CmpInst::Predicate P = (CmpInst::Predicate)In.Aux;
+    return Binary(W, Dst, A, B, [=](uint64_t X, uint64_t Y) -> uint64_t {
+      double FX = ReadFP(X, OpK), FY = ReadFP(Y, OpK);
+      bool Unordered = std::isnan(FX) || std::isnan(FY);
+      switch (P) {
+      case CmpInst::FCMP_FALSE:
+        return 0;
+      case CmpInst::FCMP_OEQ:
+        return !Unordered && FX == FY;
+      case CmpInst::FCMP_OGT:
+        return !Unordered && FX > FY;
+      case CmpInst::FCMP_OGE:
+        return !Unordered && FX >= FY;
+      case CmpInst::FCMP_OLT:
+        return !Unordered && FX < FY;
+      case CmpInst::FCMP_OLE:
+        return !Unordered && FX <= FY;
+      case CmpInst::FCMP_ONE:
+        return !Unordered && FX != FY;
+      case CmpInst::FCMP_ORD:
+        return !Unordered;
+      case CmpInst::FCMP_UNO:
+        return Unordered;
+      case CmpInst::FCMP_UEQ:
+        return Unordered || FX == FY;
+      case CmpInst::FCMP_UGT:
+        return Unordered || FX > FY;
+      case CmpInst::FCMP_UGE:
+        return Unordered || FX >= FY;
+      case CmpInst::FCMP_ULT:
+        return Unordered || FX < FY;
+      case CmpInst::FCMP_ULE:
+        return Unordered || FX <= FY;
+      case CmpInst::FCMP_UNE:
+        return Unordered || FX != FY;
+      default:
+        return 1;
+      }
+    });
+  }
+
+  case Instruction::Trunc:
+    return Unary(W, Dst, A, [=](uint64_t X) { return Trunc(X, Bits); });
+  case Instruction::ZExt:
+  case Instruction::BitCast:
+  case Instruction::AddrSpaceCast:
+    return Unary(W, Dst, A, [](uint64_t X) { return X; });
+  case Instruction::SExt:
+    return Unary(W, Dst, A,
+                 [=](uint64_t X) { return Trunc(SExt(X, OpBits), Bits); });
+  case Instruction::FPTrunc:
+  case Instruction::FPExt:
+    return Unary(W, Dst, A,
+                 [=](uint64_t X) { return WriteFP(ReadFP(X, OpK), K); });
+  case Instruction::FPToUI:
+    return Unary(W, Dst, A, [=](uint64_t X) {
+      return FPToInt(ReadFP(X, OpK), Bits, false);
+    });
+  case Instruction::FPToSI:
+    return Unary(W, Dst, A, [=](uint64_t X) {
+      return FPToInt(ReadFP(X, OpK), Bits, true);
+    });
+  case Instruction::UIToFP:
+    return Unary(W, Dst, A, [=](uint64_t X) { return WriteFP((double)X, K); });
+  case Instruction::SIToFP:
+    return Unary(W, Dst, A, [=](uint64_t X) {
+      return WriteFP((double)SExt(X, OpBits), K);
+    });
+
+  case Instruction::Select: {
+    for (unsigned s = 0; s < In.NumSlots; ++s) {
+      const uint64_t *T = Src(Fr, Ops[1] >= 0 ? Ops[1] + s : Ops[1] - s);
+      const uint64_t *F = Src(Fr, Ops[2] >= 0 ? Ops[2] + s : Ops[2] - s);
+      uint64_t *D = Dst + (size_t)s * m_WaveSize;
+      ForLanes(W, [&](unsigned L) { D[L] = A[L] ? T[L] : F[L]; });
+    }
+    return;
+  }
+  case Instruction::ExtractValue: {
+    int Code = Ops[0] >= 0 ? Ops[0] + (int)In.Aux : Ops[0] - (int)In.Aux;
+    return Unary(W, Dst, Src(Fr, Code), [](uint64_t X) { return X; });
+  }
+  case Instruction::InsertValue:
+    for (unsigned s = 0; s < In.NumSlots; ++s) {
+      const uint64_t *V =
+          s == In.Aux ? B : Src(Fr, Ops[0] >= 0 ? Ops[0] + s : Ops[0] - s);
+      uint64_t *D = Dst + (size_t)s * m_WaveSize;
+      ForLanes(W, [&](unsigned L) { D[L] = V[L]; });
+    }
+    return;
+
+  case Instruction::GetElementPtr: {
+    const int64_t *Extra = CF.Extra.data() + In.Extra;
+    int64_t ConstOffset = Extra[0];
+    unsigned NumTerms = Extra[1];
+    Unary(W, Dst, A, [=](uint64_t P) { return P + ConstOffset; });
+    for (unsigned t = 0; t < NumTerms; ++t) {
+      const uint64_t *Idx = Src(Fr, (int)Extra[2 + 3 * t]);
+      int64_t Scale = Extra[3 + 3 * t];
+      unsigned IdxBits = Extra[4 + 3 * t];
+      ForLanes(W,
+               [&](unsigned L) { Dst[L] += SExt(Idx[L], IdxBits) * Scale; });
+    }
+    return;
+  }
+  case Instruction::Alloca: {
+    uint64_t Ptr = MakePointer(kPrivateSpace, Fr.PrivateBase + In.Aux);
+    ForLanes(W, [&](unsigned L) { Dst[L] = Ptr; });
+    return;
+  }
+  case Instruction::Load:
+    ForLanes(W, [&](unsigned L) { Dst[L] = Load(W, L, A[L], K); });
+    return;
+  case Instruction::Store:
+    ForLanes(W, [&](unsigned L) { Store(W, L, B[L], OpK, A[L]); });
+    return;
+  case Instruction::AtomicRMW: {
+    AtomicRMWInst::BinOp RMWOp = (AtomicRMWInst::BinOp)In.Aux;
+    ForLanes(W, [&](unsigned L) {
+      uint64_t Old = Load(W, L, A[L], K), V = B[L], New;
+      int64_t SOld = SExt(Old, Bits), SV = SExt(V, Bits);
+      switch (RMWOp) {
+      case AtomicRMWInst::Xchg:
+        New = V;
+        break;
+      case AtomicRMWInst::Add:
+        New = Old + V;
+        break;
+      case AtomicRMWInst::Sub:
+        New = Old - V;
+        break;
+      case AtomicRMWInst::And:
+        New = Old & V;
+        break;
+      case AtomicRMWInst::Nand:
+        New = ~(Old & V);
+        break;
+      case AtomicRMWInst::Or:
+        New = Old | V;
+        break;
+      case AtomicRMWInst::Xor:
+        New = Old ^ V;
+        break;
+      case AtomicRMWInst::Max:
+        New = SOld > SV ? Old : V;
+        break;
+      case AtomicRMWInst::Min:
+        New = SOld < SV ? Old : V;
+        break;
+      case AtomicRMWInst::UMax:
+        New = std::max(Old, V);
+        break;
+      default:
+        New = std::min(Old, V);
+        break;
+      }
+      Store(W, L, A[L], K, Trunc(New, Bits));
+      Dst[L] = Old;
+    });
+    return;
+  }
+  case Instruction::AtomicCmpXchg: {
+    const uint64_t *New = Src(Fr, Ops[2]);
+    uint64_t *Success = Dst + m_WaveSize;
+    ForLanes(W, [&](unsigned L) {
+      uint64_t Old = Load(W, L, A[L], K);
+      Success[L] = Old == B[L];
+      if (Success[L])
+        Store(W, L, A[L], K, New[L]);
+      Dst[L] = Old;
+    });
+    return;
+  }
+  default:
+    Unsupported(*In.I);
+  }
+}
+
+namespace {
+
+template <typename Fn>
+void UnaryFP(const Wave &W, uint64_t *Dst, const uint64_t *A, VK K, Fn F) {
+  Unary(W, Dst, A, [&](uint64_t X) { return WriteFP(F(ReadFP(X, K)), K); });
+}
+
+template <typename Fn>
+void BinaryFP(const Wave &W, uint64_t *Dst, const uint64_t *A,
+              const uint64_t *B, VK K, Fn F) {
+  Binary(W, Dst, A, B, [&](uint64_t X, uint64_t Y) {
+    return WriteFP(F(ReadFP(X, K), ReadFP(Y, K)), K);
+  });
+}
+
+// Position of the highest set bit, counted from the most significant bit
+// of a Bits wide value, or all ones if no bit is set.
+uint64_t FirstBitHigh(uint64_t V, unsigned Bits) {
+  return V ? countLeadingZeros(V) - (64 - Bits) : 0xffffffff;
+}
+
+uint64_t ReverseBits(uint64_t V, unsigned Bits) {
+  uint64_t R = 0;
+  for (unsigned b = 0; b < Bits; ++b)
+    if ((V >> b) & 1)
+      R |= 1ULL << (Bits - 1 - b);
+  return R;
+}
+
+uint64_t Msad(uint32_t Ref, uint32_t Src, uint32_t Accum) {
+  for (unsigned i = 0; i < 4; ++i) {
+    uint8_t RefByte = Ref >> (i * 8), SrcByte = Src >> (i * 8);
+    if (RefByte)
+      Accum += RefByte > SrcByte ? RefByte - SrcByte : SrcByte - RefByte;
+  }
+  return Accum;
+}
+
+uint64_t WaveIdentity(DXIL::WaveOpKind Op, VK K) {
+  if (Op != DXIL::WaveOpKind::Product)
+    return 0;
+  return IsFloat(K) ? WriteFP(1.0, K) : 1;
+}
+
+uint64_t WaveCombine(DXIL::WaveOpKind Op, bool Signed, VK K, uint64_t A,
+                     uint64_t B) {
+  unsigned Bits = GetBits(K);
+  if (IsFloat(K)) {
+    double X = ReadFP(A, K), Y = ReadFP(B, K);
+    switch (Op) {
+    case DXIL::WaveOpKind::Sum:
+      return WriteFP(X + Y, K);
+    case DXIL::WaveOpKind::Product:
+      return WriteFP(X * Y, K);
+    case DXIL::WaveOpKind::Min:
+      return WriteFP(FMinD3D(X, Y), K);
+    default:
+      return WriteFP(FMaxD3D(X, Y), K);
+    }
+  }
+  bool Less = Signed ? SExt(A, Bits) < SExt(B, Bits) : A < B;
+  switch (Op) {
+  case DXIL::WaveOpKind::Sum:
+    return Trunc(A + B, Bits);
+  case DXIL::WaveOpKind::Product:
+    return Trunc(A * B, Bits);
+  case DXIL::WaveOpKind::Min:
+    return Less ? A : B;
+  default:
+    return Less ? B : A;
+  }
+}
+
+uint64_t WaveBitCombine(DXIL::WaveBitOpKind Op, uint64_t A, uint64_t B) {
+  switch (Op) {
+  case DXIL::WaveBitOpKind::And:
+    return A & B;
+  case DXIL::WaveBitOpKind::Or:
+    return A | B;
+  default:
+    return A ^ B;
+  }
+}
+
+uint64_t AtomicCombine(DXIL::AtomicBinOpCode Op, unsigned Bits, uint64_t Old,
+                       uint64_t V) {
+  bool Less = SExt(Old, Bits) < SExt(V, Bits);
+  switch (Op) {
+  case DXIL::AtomicBinOpCode::Add:
+    return Trunc(Old + V, Bits);
+  case DXIL::AtomicBinOpCode::And:
+    return Old & V;
+  case DXIL::AtomicBinOpCode::Or:
+    return Old | V;
+  case DXIL::AtomicBinOpCode::Xor:
+    return Old ^ V;
+  case DXIL::AtomicBinOpCode::IMin:
+    return Less ? Old : V;
+  case DXIL::AtomicBinOpCode::IMax:
+    return Less ? V : Old;
+  case DXIL::AtomicBinOpCode::UMin:
+    return std::min(Old, V);
+  case DXIL::AtomicBinOpCode::UMax:
+    return std::max(Old, V);
+  default:
+    return V;
+  }
+}
+
+// The code of element i of the aggregate at Code.
+int ElementCode(int Code, unsigned i) {
+  return Code >= 0 ? Code + (int)i : Code - (int)i;
+}
+
+} // namespace
+
+unsigned DxilInterpreter::Impl::GetThreadIdInGroup(unsigned FlatId,
+                                                   unsigned Comp) const {
+  switch (Comp) {
+  case 0:
+    return FlatId % m_NumThreads[0];
+  case 1:
+    return FlatId / m_NumThreads[0] % m_NumThreads[1];
+  default:
+    return FlatId / (m_NumThreads[0] * m_NumThreads[1]);
+  }
+}
+
+unsigned
+DxilInterpreter::Impl::GetHandle(DXIL::ResourceClass Class, unsigned Space,
+                                 unsigned Register,
+                                 const DxilResourceProperties &Props) {
+  auto Key = std::make_tuple((unsigned)Class, Space, Register,
+                             Props.RawDword0, Props.RawDword1);
+  auto It = m_HandleIndex.find(Key);
+  if (It != m_HandleIndex.end())
+    return It->second;
+  ResourceHandle H;
+  H.Class = Class;
+  H.Space = Space;
+  H.Register = Register;
+  H.Props = Props;
+  auto B = m_Bindings.find(BindingKey((unsigned)Class, Space, Register));
+  H.B = B != m_Bindings.end() ? &B->second : nullptr;
+  m_Handles.push_back(H);
+  // Zero is left for the null handle.
+  unsigned V = m_Handles.size();
+  m_HandleIndex[Key] = V;
+  return V;
+}
+
+DxilInterpreter::Impl::ResourceHandle &
+DxilInterpreter::Impl::LookupHandle(uint64_t V) {
+  IFTBOOLMSG(V != 0 && V <= m_Handles.size(), E_INVALIDARG,
+             "DXIL interpreter: invalid resource handle");
+  ResourceHandle &H = m_Handles[V - 1];
+  if (!H.B)
+    throw hlsl::Exception(E_INVALIDARG,
+                          "DXIL interpreter: no resource bound to " +
+                              std::string(GetResourceClassPrefix(H.Class)) +
+                              std::to_string(H.Register) + ", space" +
+                              std::to_string(H.Space));
+  return H;
+}
+
+uint8_t *DxilInterpreter::Impl::BufferAddress(ResourceHandle &H,
+                                              uint64_t Offset, unsigned Size) {
+  if (Offset > H.B->Size || Size > H.B->Size - Offset)
+    return nullptr;
+  return H.B->Data + Offset;
+}
+
+// Returns the offset of the element at C0, C1, and sets NumComps to how many
+// components of CompBytes bytes it holds.
+uint64_t DxilInterpreter::Impl::BufferOffset(ResourceHandle &H, uint64_t C0,
+                                             uint64_t C1, unsigned CompBytes,
+                                             unsigned &NumComps) {
+  DXIL::ResourceKind Kind = H.Props.getResourceKind();
+  switch (Kind) {
+  case DXIL::ResourceKind::RawBuffer:
+    NumComps = 4;
+    return C0;
+  case DXIL::ResourceKind::StructuredBuffer:
+    NumComps = 4;
+    return C0 * H.Props.StructStrideInBytes + C1;
+  case DXIL::ResourceKind::TypedBuffer: {
+    unsigned CompCount = std::max<unsigned>(H.Props.Typed.CompCount, 1);
+    unsigned CompSize = CompType(H.Props.getCompType()).GetSizeInBits() / 8;
+    unsigned ElementBytes = CompCount * (CompSize ? CompSize : 4);
+    NumComps = std::min(4u, ElementBytes / CompBytes);
+    return C0 * ElementBytes;
+  }
+  default:
+    Unsupported("access to " + Twine(GetResourceKindName(Kind)));
+  }
+}
+
+// Returns true if the wave must wait at a group barrier.
+bool DxilInterpreter::Impl::ExecDxilOp(Wave &W, Frame &Fr, const Inst &In) {
+  const int *Ops = Fr.CF->Codes.data() + In.Operands;
+  auto Arg = [&](unsigned i) { return Src(Fr, Ops[i]); };
+  // Immediate operands are the same in every lane.
+  auto Imm = [&](unsigned i) { return Arg(i)[W.Lanes[0]]; };
+  uint64_t *Dst = Fr.Regs.data() + (size_t)In.Dest * m_WaveSize;
+  auto Out = [&](unsigned s) { return Dst + (size_t)s * m_WaveSize; };
+  VK K = In.OpTy;
+  unsigned Bits = GetBits(K);
+
+  DXIL::OpCode Opc = (DXIL::OpCode)In.Aux;
+  switch (Opc) {
+  case DXIL::OpCode::ThreadId: {
+    unsigned Comp = std::min<unsigned>(Imm(0), 2);
+    ForLanes(W, [&](unsigned L) {
+      Dst[L] = m_GroupId[Comp] * m_NumThreads[Comp] +
+               GetThreadIdInGroup(W.FirstThread + L, Comp);
+    });
+    break;
+  }
+  case DXIL::OpCode::GroupId: {
+    unsigned Comp = std::min<unsigned>(Imm(0), 2);
+    ForLanes(W, [&](unsigned L) { Dst[L] = m_GroupId[Comp]; });
+    break;
+  }
+  case DXIL::OpCode::ThreadIdInGroup: {
+    unsigned Comp = std::min<unsigned>(Imm(0), 2);
+    ForLanes(W, [&](unsigned L) {
+      Dst[L] = GetThreadIdInGroup(W.FirstThread + L, Comp);
+    });
+    break;
+  }
+  case DXIL::OpCode::FlattenedThreadIdInGroup:
+    ForLanes(W, [&](unsigned L) { Dst[L] = W.FirstThread + L; });
+    break;
+
+  // Unary float operations.
+  case DXIL::OpCode::FAbs:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::fabs(X); });
+    break;
+  case DXIL::OpCode::Saturate:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) {
+      return std::isnan(X) ? 0.0 : std::min(std::max(X, 0.0), 1.0);
+    });
+    break;
+  case DXIL::OpCode::IsNaN:
+    Unary(W, Dst, Arg(0),
+          [=](uint64_t X) -> uint64_t { return std::isnan(ReadFP(X, K)); });
+    break;
+  case DXIL::OpCode::IsInf:
+    Unary(W, Dst, Arg(0),
+          [=](uint64_t X) -> uint64_t { return std::isinf(ReadFP(X, K)); });
+    break;
+  case DXIL::OpCode::IsFinite:
+    Unary(W, Dst, Arg(0),
+          [=](uint64_t X) -> uint64_t { return std::isfinite(ReadFP(X, K)); });
+    break;
+  case DXIL::OpCode::IsNormal:
+    Unary(W, Dst, Arg(0),
+          [=](uint64_t X) -> uint64_t { return IsNormalFP(X, K); });
+    break;
+  case DXIL::OpCode::Cos:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::cos(X); });
+    break;
+  case DXIL::OpCode::Sin:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::sin(X); });
+    break;
+  case DXIL::OpCode::Tan:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::tan(X); });
+    break;
+  case DXIL::OpCode::Acos:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::acos(X); });
+    break;
+  case DXIL::OpCode::Asin:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::asin(X); });
+    break;
+  case DXIL::OpCode::Atan:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::atan(X); });
+    break;
+  case DXIL::OpCode::Hcos:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::cosh(X); });
+    break;
+  case DXIL::OpCode::Hsin:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::sinh(X); });
+    break;
+  case DXIL::OpCode::Htan:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::tanh(X); });
+    break;
+  case DXIL::OpCode::Exp:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::exp2(X); });
+    break;
+  case DXIL::OpCode::Frc:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return X - std::floor(X); });
+    break;
+  case DXIL::OpCode::Log:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::log2(X); });
+    break;
+  case DXIL::OpCode::Sqrt:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::sqrt(X); });
+    break;
+  case DXIL::OpCode::Rsqrt:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return 1.0 / std::sqrt(X); });
+    break;
+  case DXIL::OpCode::Round_ne:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::nearbyint(X); });
+    break;
+  case DXIL::OpCode::Round_ni:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::floor(X); });
+    break;
+  case DXIL::OpCode::Round_pi:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::ceil(X); });
+    break;
+  case DXIL::OpCode::Round_z:
+    UnaryFP(W, Dst, Arg(0), K, [](double X) { return std::trunc(X); });
+    break;
+
+  // Unary bit operations.
+  case DXIL::OpCode::Bfrev:
+    Unary(W, Dst, Arg(0), [=](uint64_t X) { return ReverseBits(X, Bits); });
+    break;
+  case DXIL::OpCode::Countbits:
+    Unary(W, Dst, Arg(0),
+          [](uint64_t X) -> uint64_t { return countPopulation(X); });
+    break;
+  case DXIL::OpCode::FirstbitLo:
+    Unary(W, Dst, Arg(0), [](uint64_t X) -> uint64_t {
+      return X ? countTrailingZeros(X) : 0xffffffff;
+    });
+    break;
+  case DXIL::OpCode::FirstbitHi:
+    Unary(W, Dst, Arg(0), [=](uint64_t X) { return FirstBitHigh(X, Bits); });
+    break;
+  case DXIL::OpCode::FirstbitSHi:
+    Unary(W, Dst, Arg(0), [=](uint64_t X) {
+      return FirstBitHigh(SExt(X, Bits) < 0 ? Trunc(~X, Bits) : X, Bits);
+    });
+    break;
+
+  // Binary operations.
+  case DXIL::OpCode::FMax:
+    BinaryFP(W, Dst, Arg(0), Arg(1), K, FMaxD3D);
+    break;
+  case DXIL::OpCode::FMin:
+    BinaryFP(W, Dst, Arg(0), Arg(1), K, FMinD3D);
+    break;
+  case DXIL::OpCode::IMax:
+    Binary(W, Dst, Arg(0), Arg(1), [=](uint64_t X, uint64_t Y) {
+      return SExt(X, Bits) < SExt(Y, Bits) ? Y : X;
+    });
+    break;
+  case DXIL::OpCode::IMin:
+    Binary(W, Dst, Arg(0), Arg(1), [=](uint64_t X, uint64_t Y) {
+      return SExt(X, Bits) < SExt(Y, Bits) ? X : Y;
+    });
+    break;
+  case DXIL::OpCode::UMax:
+    Binary(W, Dst, Arg(0), Arg(1),
+           [](uint64_t X, uint64_t Y) { return std::max(X, Y); });
+    break;
+  case DXIL::OpCode::UMin:
+    Binary(W, Dst, Arg(0), Arg(1),
+           [](uint64_t X, uint64_t Y) { return std::min(X, Y); });
+    break;
+  case DXIL::OpCode::IMul:
+  case DXIL::OpCode::UMul: {
+    // Results are the high and low halves of the 64-bit product.
+    const uint64_t *A = Arg(0), *B = Arg(1);
+    bool Signed = Opc == DXIL::OpCode::IMul;
+    ForLanes(W, [&](unsigned L) {
+      uint64_t P = Signed ? (uint64_t)(SExt(A[L], 32) * SExt(B[L], 32))
+                          : A[L] * B[L];
+      Out(0)[L] = P >> 32;
+      Out(1)[L] = Trunc(P, 32);
+    });
+    break;
+  }
+  case DXIL::OpCode::UDiv: {
+    const uint64_t *A = Arg(0), *B = Arg(1);
+    ForLanes(W, [&](unsigned L) {
+      Out(0)[L] = B[L] ? A[L] / B[L] : 0xffffffff;
+      Out(1)[L] = B[L] ? A[L] % B[L] : 0xffffffff;
+    });
+    break;
+  }
+  case DXIL::OpCode::UAddc: {
+    const uint64_t *A = Arg(0), *B = Arg(1);
+    ForLanes(W, [&](unsigned L) {
+      Out(0)[L] = Trunc(A[L] + B[L], 32);
+      Out(1)[L] = (A[L] + B[L]) >> 32;
+    });
+    break;
+  }
+  case DXIL::OpCode::USubb: {
+    const uint64_t *A = Arg(0), *B = Arg(1);
+    ForLanes(W, [&](unsigned L) {
+      Out(0)[L] = Trunc(A[L] - B[L], 32);
+      Out(1)[L] = A[L] < B[L];
+    });
+    break;
+  }
+
+  // Tertiary and quaternary operations.
+  case DXIL::OpCode::FMad:
+    Ternary(W, Dst, Arg(0), Arg(1), Arg(2),
+            [=](uint64_t X, uint64_t Y, uint64_t Z) {
+              return WriteFP(ReadFP(X, K) * ReadFP(Y, K) + ReadFP(Z, K), K);
+            });
+    break;
+  case DXIL::OpCode::Fma:
+    Ternary(W, Dst, Arg(0), Arg(1), Arg(2),
+            [=](uint64_t X, uint64_t Y, uint64_t Z) {
+              return WriteFP(
+                  std::fma(ReadFP(X, K), ReadFP(Y, K), ReadFP(Z, K)), K);
+            });
+    break;
+  case DXIL::OpCode::IMad:
+  case DXIL::OpCode::UMad:
+    Ternary(W, Dst, Arg(0), Arg(1), Arg(2),
+            [=](uint64_t X, uint64_t Y, uint64_t Z) {
+              return Trunc(X * Y + Z, Bits);
+            });
+    break;
+  case DXIL::OpCode::Msad:
+    Ternary(W, Dst, Arg(0), Arg(1), Arg(2),
+            [](uint64_t X, uint64_t Y, uint64_t Z) { return Msad(X, Y, Z); });
+    break;
+  case DXIL::OpCode::Ibfe:
+  case DXIL::OpCode::Ubfe: {
+    bool Signed = Opc == DXIL::OpCode::Ibfe;
+    Ternary(W, Dst, Arg(0), Arg(1), Arg(2),
+            [=](uint64_t Width, uint64_t Offset, uint64_t V) -> uint64_t {
+              Width &= 31;
+              Offset &= 31;
+              if (!Width)
+                return 0;
+              if (Width + Offset < 32) {
+                uint32_t Shifted = (uint32_t)V << (32 - (Width + Offset));
+                return Signed ? Trunc((int32_t)Shifted >> (32 - Width), 32)
+                              : Shifted >> (32 - Width);
+              }
+              return Signed ? Trunc((int32_t)V >> Offset, 32)
+                            : (uint32_t)V >> Offset;
+            });
+    break;
+  }
+  case DXIL::OpCode::Bfi: {
+    const uint64_t *Width = Arg(0), *Offset = Arg(1), *V = Arg(2),
+                   *Replaced = Arg(3);
+    ForLanes(W, [&](unsigned L) {
+      unsigned Wd = Width[L] & 31, Off = Offset[L] & 31;
+      uint64_t Mask = Trunc(((1ULL << Wd) - 1) << Off, 32);
+      Dst[L] = ((V[L] << Off) & Mask) | (Replaced[L] & ~Mask);
+    });
+    break;
+  }
+
+  // Dot products.
+  case DXIL::OpCode::Dot2:
+  case DXIL::OpCode::Dot3:
+  case DXIL::OpCode::Dot4: {
+    unsigned N = (unsigned)Opc - (unsigned)DXIL::OpCode::Dot2 + 2;
+    ForLanes(W, [&](unsigned L) {
+      double Sum = 0;
+      for (unsigned i = 0; i < N; ++i)
+        Sum += ReadFP(Arg(i)[L], K) * ReadFP(Arg(N + i)[L], K);
+      Dst[L] = WriteFP(Sum, K);
+    });
+    break;
+  }
+  case DXIL::OpCode::Dot2AddHalf:
+    ForLanes(W, [&](unsigned L) {
+      double Sum = ReadFP(Arg(0)[L], VK::F32);
+      for (unsigned i = 0; i < 2; ++i)
+        Sum += ReadFP(Arg(1 + i)[L], VK::F16) * ReadFP(Arg(3 + i)[L], VK::F16);
+      Dst[L] = WriteFP(Sum, VK::F32);
+    });
+    break;
+  case DXIL::OpCode::Dot4AddI8Packed:
+  case DXIL::OpCode::Dot4AddU8Packed: {
+    bool Signed = Opc == DXIL::OpCode::Dot4AddI8Packed;
+    Ternary(W, Dst, Arg(0), Arg(1), Arg(2),
+            [=](uint64_t Acc, uint64_t X, uint64_t Y) {
+              for (unsigned i = 0; i < 4; ++i) {
+                uint64_t XB = (X >> (8 * i)) & 0xff, YB = (Y >> (8 * i)) & 0xff;
+                Acc += Signed ? (uint64_t)(SExt(XB, 8) * SExt(YB, 8)) : XB * YB;
+              }
+              return Trunc(Acc, 32);
+            });
+    break;
+  }
+
+  // Conversions.
+  case DXIL::OpCode::BitcastI16toF16:
+  case DXIL::OpCode::BitcastF16toI16:
+  case DXIL::OpCode::BitcastI32toF32:
+  case DXIL::OpCode::BitcastF32toI32:
+  case DXIL::OpCode::BitcastI64toF64:
+  case DXIL::OpCode::BitcastF64toI64:
+    Unary(W, Dst, Arg(0), [](uint64_t X) { return X; });
+    break;
+  case DXIL::OpCode::LegacyF32ToF16:
+    Unary(W, Dst, Arg(0), [](uint64_t X) -> uint64_t {
+      return FloatToHalf(BitsToFloat((uint32_t)X));
+    });
+    break;
+  case DXIL::OpCode::LegacyF16ToF32:
+    Unary(W, Dst, Arg(0), [](uint64_t X) -> uint64_t {
+      return FloatToBits(HalfToFloat((uint16_t)X));
+    });
+    break;
+  case DXIL::OpCode::LegacyDoubleToFloat:
+    Unary(W, Dst, Arg(0),
+          [](uint64_t X) { return WriteFP(ReadFP(X, VK::F64), VK::F32); });
+    break;
+  case DXIL::OpCode::LegacyDoubleToSInt32:
+  case DXIL::OpCode::LegacyDoubleToUInt32: {
+    bool Signed = Opc == DXIL::OpCode::LegacyDoubleToSInt32;
+    Unary(W, Dst, Arg(0), [=](uint64_t X) {
+      return FPToInt(ReadFP(X, VK::F64), 32, Signed);
+    });
+    break;
+  }
+  case DXIL::OpCode::MakeDouble:
+    Binary(W, Dst, Arg(0), Arg(1),
+           [](uint64_t Lo, uint64_t Hi) { return Lo | (Hi << 32); });
+    break;
+  case DXIL::OpCode::SplitDouble: {
+    const uint64_t *A = Arg(0);
+    ForLanes(W, [&](unsigned L) {
+      Out(0)[L] = Trunc(A[L], 32);
+      Out(1)[L] = A[L] >> 32;
+    });
+    break;
+  }
+
+  // Resources.
+  case DXIL::OpCode::CreateHandle: {
+    DXIL::ResourceClass Class = (DXIL::ResourceClass)Imm(0);
+    unsigned RangeId = Imm(1);
+    const DxilResourceBase *Res = nullptr;
+    switch (Class) {
+    case DXIL::ResourceClass::SRV:
+      if (RangeId < m_DM.GetSRVs().size())
+        Res = &m_DM.GetSRV(RangeId);
+      break;
+    case DXIL::ResourceClass::UAV:
+      if (RangeId < m_DM.GetUAVs().size())
+        Res = &m_DM.GetUAV(RangeId);
+      break;
+    case DXIL::ResourceClass::CBuffer:
+      if (RangeId < m_DM.GetCBuffers().size())
+        Res = &m_DM.GetCBuffer(RangeId);
+      break;
+    default:
+      Unsupported("samplers");
+    }
+    IFTBOOLMSG(Res, DXC_E_INCORRECT_DXIL_METADATA,
+               "DXIL interpreter: createHandle of an undeclared resource");
+    DxilResourceProperties Props =
+        resource_helper::loadPropsFromResourceBase(Res);
+    const uint64_t *Index = Arg(2);
+    ForLanes(W, [&](unsigned L) {
+      Dst[L] = GetHandle(Class, Res->GetSpaceID(), Index[L], Props);
+    });
+    break;
+  }
+  case DXIL::OpCode::CreateHandleFromBinding: {
+    // The binding is a %dx.types.ResBind {lower, upper, space, class}.
+    unsigned Space = Src(Fr, ElementCode(Ops[0], 2))[W.Lanes[0]];
+    DXIL::ResourceClass Class =
+        (DXIL::ResourceClass)Src(Fr, ElementCode(Ops[0], 3))[W.Lanes[0]];
+    if (Class == DXIL::ResourceClass::Sampler)
+      Unsupported("samplers");
+    const uint64_t *Index = Arg(1);
+    ForLanes(W, [&](unsigned L) {
+      Dst[L] = GetHandle(Class, Space, Index[L], DxilResourceProperties());
+    });
+    break;
+  }
+  case DXIL::OpCode::AnnotateHandle: {
+    DxilResourceProperties Props;
+    Props.RawDword0 = Src(Fr, ElementCode(Ops[1], 0))[W.Lanes[0]];
+    Props.RawDword1 = Src(Fr, ElementCode(Ops[1], 1))[W.Lanes[0]];
+    const uint64_t *Handle = Arg(0);
+    ForLanes(W, [&](unsigned L) {
+      IFTBOOLMSG(Handle[L] != 0 && Handle[L] <= m_Handles.size(),
+                 E_INVALIDARG, "DXIL interpreter: invalid resource handle");
+      ResourceHandle H = m_Handles[Handle[L] - 1];
+      Dst[L] = GetHandle(H.Class, H.Space, H.Register, Props);
+    });
+    break;
+  }
+  case DXIL::OpCode::BufferLoad:
+  case DXIL::OpCode::RawBufferLoad: {
+    const uint64_t *Handle = Arg(0), *C0 = Arg(1), *C1 = Arg(2);
+    unsigned Mask = Opc == DXIL::OpCode::RawBufferLoad ? Imm(3) : 0xf;
+    unsigned CompBytes = GetBytes(K);
+    ForLanes(W, [&](unsigned L) {
+      ResourceHandle &H = LookupHandle(Handle[L]);
+      unsigned NumComps;
+      uint64_t Offset =
+          BufferOffset(H, Trunc(C0[L], 32), Trunc(C1[L], 32), CompBytes,
+                       NumComps);
+      uint64_t Status = 1;
+      for (unsigned c = 0; c < 4; ++c) {
+        uint64_t V = 0;
+        if (c < NumComps && (Mask & (1 << c))) {
+          if (const uint8_t *P =
+                  BufferAddress(H, Offset + c * CompBytes, CompBytes))
+            memcpy(&V, P, CompBytes);
+          else
+            Status = 0;
+        }
+        Out(c)[L] = V;
+      }
+      Out(4)[L] = Status;
+    });
+    break;
+  }
+  case DXIL::OpCode::BufferStore:
+  case DXIL::OpCode::RawBufferStore: {
+    const uint64_t *Handle = Arg(0), *C0 = Arg(1), *C1 = Arg(2);
+    unsigned Mask = Imm(7);
+    unsigned CompBytes = GetBytes(K);
+    ForLanes(W, [&](unsigned L) {
+      ResourceHandle &H = LookupHandle(Handle[L]);
+      unsigned NumComps;
+      uint64_t Offset =
+          BufferOffset(H, Trunc(C0[L], 32), Trunc(C1[L], 32), CompBytes,
+                       NumComps);
+      for (unsigned c = 0; c < NumComps; ++c) {
+        if (!(Mask & (1 << c)))
+          continue;
+        if (uint8_t *P = BufferAddress(H, Offset + c * CompBytes, CompBytes))
+          memcpy(P, &Arg(3 + c)[L], CompBytes);
+      }
+    });
+    break;
+  }
+  case DXIL::OpCode::CBufferLoadLegacy: {
+    const uint64_t *Handle = Arg(0), *Row = Arg(1);
+    unsigned CompBytes = GetBytes(In.Ty);
+    ForLanes(W, [&](unsigned L) {
+      ResourceHandle &H = LookupHandle(Handle[L]);
+      for (unsigned c = 0; c < In.NumSlots; ++c) {
+        uint64_t V = 0;
+        if (const uint8_t *P =
+                BufferAddress(H, Row[L] * 16 + c * CompBytes, CompBytes))
+          memcpy(&V, P, CompBytes);
+        Out(c)[L] = V;
+      }
+    });
+    break;
+  }
+  case DXIL::OpCode::CBufferLoad: {
+    const uint64_t *Handle = Arg(0), *Offset = Arg(1);
+    unsigned CompBytes = GetBytes(In.Ty);
+    ForLanes(W, [&](unsigned L) {
+      ResourceHandle &H = LookupHandle(Handle[L]);
+      uint64_t V = 0;
+      if (const uint8_t *P = BufferAddress(H, Offset[L], CompBytes))
+        memcpy(&V, P, CompBytes);
+      Dst[L] = V;
+    });
+    break;
+  }
+  case DXIL::OpCode::BufferUpdateCounter: {
+    const uint64_t *Handle = Arg(0);
+    bool Increment = SExt(Imm(1), 8) > 0;
+    // Increments return the old count, decrements the new one.
+    ForLanes(W, [&](unsigned L) {
+      Binding &B = *LookupHandle(Handle[L]).B;
+      Dst[L] = Increment ? B.Counter++ : --B.Counter;
+    });
+    break;
+  }
+  case DXIL::OpCode::AtomicBinOp:
+  case DXIL::OpCode::AtomicCompareExchange: {
+    bool IsCmpXchg = Opc == DXIL::OpCode::AtomicCompareExchange;
+    unsigned First = IsCmpXchg ? 1 : 2;
+    const uint64_t *Handle = Arg(0), *C0 = Arg(First), *C1 = Arg(First + 1);
+    const uint64_t *Cmp = IsCmpXchg ? Arg(4) : nullptr;
+    const uint64_t *V = Arg(IsCmpXchg ? 5 : 5);
+    DXIL::AtomicBinOpCode AtomicOp =
+        IsCmpXchg ? DXIL::AtomicBinOpCode::Invalid
+                  : (DXIL::AtomicBinOpCode)Imm(1);
+    unsigned CompBytes = GetBytes(K);
+    ForLanes(W, [&](unsigned L) {
+      ResourceHandle &H = LookupHandle(Handle[L]);
+      unsigned NumComps;
+      uint64_t Offset =
+          BufferOffset(H, Trunc(C0[L], 32), Trunc(C1[L], 32), CompBytes,
+                       NumComps);
+      uint64_t Old = 0;
+      if (uint8_t *P = BufferAddress(H, Offset, CompBytes)) {
+        memcpy(&Old, P, CompBytes);
+        uint64_t New = IsCmpXchg ? (Old == Cmp[L] ? V[L] : Old)
+                                 : AtomicCombine(AtomicOp, Bits, Old, V[L]);
+        memcpy(P, &New, CompBytes);
+      }
+      Dst[L] = Old;
+    });
+    break;
+  }
+  case DXIL::OpCode::GetDimensions: {
+    const uint64_t *Handle = Arg(0);
+    ForLanes(W, [&](unsigned L) {
+      ResourceHandle &H = LookupHandle(Handle[L]);
+      unsigned NumComps;
+      uint64_t Stride = BufferOffset(H, 1, 0, 1, NumComps);
+      Out(0)[L] = Trunc(H.B->Size / std::max<uint64_t>(Stride, 1), 32);
+      for (unsigned s = 1; s < 4; ++s)
+        Out(s)[L] = 0;
+    });
+    break;
+  }
+
+  case DXIL::OpCode::Barrier:
+    return Imm(0) & (unsigned)DXIL::BarrierMode::SyncThreadGroup;
+  case DXIL::OpCode::BarrierByMemoryType:
+    return Imm(1) & (unsigned)DXIL::BarrierSemanticFlag::GroupSync;
+
+  case DXIL::OpCode::WaveIsFirstLane:
+  case DXIL::OpCode::WaveGetLaneIndex:
+  case DXIL::OpCode::WaveGetLaneCount:
+  case DXIL::OpCode::WaveAnyTrue:
+  case DXIL::OpCode::WaveAllTrue:
+  case DXIL::OpCode::WaveActiveAllEqual:
+  case DXIL::OpCode::WaveActiveBallot:
+  case DXIL::OpCode::WaveReadLaneAt:
+  case DXIL::OpCode::WaveReadLaneFirst:
+  case DXIL::OpCode::WaveActiveOp:
+  case DXIL::OpCode::WaveActiveBit:
+  case DXIL::OpCode::WavePrefixOp:
+  case DXIL::OpCode::WaveAllBitCount:
+  case DXIL::OpCode::WavePrefixBitCount:
+  case DXIL::OpCode::WaveMatch:
+  case DXIL::OpCode::WaveMultiPrefixOp:
+  case DXIL::OpCode::WaveMultiPrefixBitCount:
+  case DXIL::OpCode::QuadReadLaneAt:
+  case DXIL::OpCode::QuadOp:
+  case DXIL::OpCode::QuadVote:
+    ExecWaveOp(W, Fr, In);
+    break;
+
+  default:
+    Unsupported("DXIL operation '" + Twine(OP::GetOpCodeName(Opc)) + "'");
+  }
+  return false;
+}
+
+void DxilInterpreter::Impl::ExecWaveOp(Wave &W, Frame &Fr, const Inst &In) {
+  const int *Ops = Fr.CF->Codes.data() + In.Operands;
+  auto Arg = [&](unsigned i) { return Src(Fr, Ops[i]); };
+  auto Imm = [&](unsigned i) { return Arg(i)[W.Lanes[0]]; };
+  uint64_t *Dst = Fr.Regs.data() + (size_t)In.Dest * m_WaveSize;
+  auto Out = [&](unsigned s) { return Dst + (size_t)s * m_WaveSize; };
+  const uint64_t *V = In.NumOperands ? Arg(0) : nullptr;
+  VK K = In.OpTy;
+  unsigned Bits = GetBits(K);
+  unsigned First = W.Lanes[0];
+
+  // Writes the four 32-bit words of a lane mask to the result of lane L.
+  auto WriteMask = [&](unsigned L, const LaneMask &M) {
+    for (unsigned i = 0; i < 4; ++i)
+      Out(i)[L] = Trunc(M.Words[i / 2] >> (32 * (i % 2)), 32);
+  };
+  auto ReadMask = [&](unsigned L) {
+    LaneMask M;
+    for (unsigned i = 0; i < 4; ++i)
+      M.Words[i / 2] |= Arg(1 + i)[L] << (32 * (i % 2));
+    return M;
+  };
+
+  switch ((DXIL::OpCode)In.Aux) {
+  case DXIL::OpCode::WaveIsFirstLane:
+    ForLanes(W, [&](unsigned L) { Dst[L] = L == First; });
+    break;
+  case DXIL::OpCode::WaveGetLaneIndex:
+    ForLanes(W, [&](unsigned L) { Dst[L] = L; });
+    break;
+  case DXIL::OpCode::WaveGetLaneCount:
+    ForLanes(W, [&](unsigned L) { Dst[L] = m_WaveSize; });
+    break;
+  case DXIL::OpCode::WaveAnyTrue:
+  case DXIL::OpCode::WaveAllTrue: {
+    bool Any = false, All = true;
+    ForLanes(W, [&](unsigned L) {
+      Any |= V[L] != 0;
+      All &= V[L] != 0;
+    });
+    uint64_t R = (DXIL::OpCode)In.Aux == DXIL::OpCode::WaveAnyTrue ? Any : All;
+    ForLanes(W, [&](unsigned L) { Dst[L] = R; });
+    break;
+  }
+  case DXIL::OpCode::WaveActiveAllEqual: {
+    bool Equal = true;
+    ForLanes(W, [&](unsigned L) { Equal &= V[L] == V[First]; });
+    ForLanes(W, [&](unsigned L) { Dst[L] = Equal; });
+    break;
+  }
+  case DXIL::OpCode::WaveActiveBallot: {
+    LaneMask M;
+    ForLanes(W, [&](unsigned L) {
+      if (V[L])
+        M.set(L);
+    });
+    ForLanes(W, [&](unsigned L) { WriteMask(L, M); });
+    break;
+  }
+  case DXIL::OpCode::WaveReadLaneAt: {
+    const uint64_t *Lane = Arg(1);
+    // SetWaveSize only accepts powers of two, so the mask wraps the lane.
+    ForLanes(W, [&](unsigned L) { Dst[L] = V[Lane[L] & (m_WaveSize - 1)]; });
+    break;
+  }
+  case DXIL::OpCode::WaveReadLaneFirst:
+    ForLanes(W, [&](unsigned L) { Dst[L] = V[First]; });
+    break;
+  case DXIL::OpCode::WaveActiveOp: {
+    DXIL::WaveOpKind Op = (DXIL::WaveOpKind)Imm(1);
+    bool Signed = Imm(2) == (unsigned)DXIL::SignedOpKind::Signed;
+    uint64_t R = V[First];
+    for (unsigned i = 1; i < W.NumLanes; ++i)
+      R = WaveCombine(Op, Signed, K, R, V[W.Lanes[i]]);
+    ForLanes(W, [&](unsigned L) { Dst[L] = R; });
+    break;
+  }
+  case DXIL::OpCode::WaveActiveBit: {
+    DXIL::WaveBitOpKind Op = (DXIL::WaveBitOpKind)Imm(1);
+    uint64_t R = V[First];
+    for (unsigned i = 1; i < W.NumLanes; ++i)
+      R = WaveBitCombine(Op, R, V[W.Lanes[i]]);
+    ForLanes(W, [&](unsigned L) { Dst[L] = R; });
+    break;
+  }
+  case DXIL::OpCode::WavePrefixOp: {
+    DXIL::WaveOpKind Op = (DXIL::WaveOpKind)Imm(1);
+    bool Signed = Imm(2) == (unsigned)DXIL::SignedOpKind::Signed;
+    uint64_t R = WaveIdentity(Op, K);
+    ForLanes(W, [&](unsigned L) {
+      uint64_t Lane = V[L];
+      Dst[L] = R;
+      R = WaveCombine(Op, Signed, K, R, Lane);
+    });
+    break;
+  }
+  case DXIL::OpCode::WaveAllBitCount: {
+    uint64_t Count = 0;
+    ForLanes(W, [&](unsigned L) { Count += V[L] != 0; });
+    ForLanes(W, [&](unsigned L) { Dst[L] = Count; });
+    break;
+  }
+  case DXIL::OpCode::WavePrefixBitCount: {
+    uint64_t Count = 0;
+    ForLanes(W, [&](unsigned L) {
+      bool Set = V[L] != 0;
+      Dst[L] = Count;
+      Count += Set;
+    });
+    break;
+  }
+  case DXIL::OpCode::WaveMatch:
+    ForLanes(W, [&](unsigned L) {
+      LaneMask M;
+      ForLanes(W, [&](unsigned Other) {
+        if (V[Other] == V[L])
+          M.set(Other);
+      });
+      WriteMask(L, M);
+    });
+    break;
+  case DXIL::OpCode::WaveMultiPrefixOp:
+  case DXIL::OpCode::WaveMultiPrefixBitCount: {
+    bool IsBitCount =
+        (DXIL::OpCode)In.Aux == DXIL::OpCode::WaveMultiPrefixBitCount;
+    DXIL::WaveMultiPrefixOpKind Op =
+        IsBitCount ? DXIL::WaveMultiPrefixOpKind::Sum
+                   : (DXIL::WaveMultiPrefixOpKind)Imm(5);
+    bool Signed = !IsBitCount &&
+                  Imm(6) == (unsigned)DXIL::SignedOpKind::Signed;
+    // Every lane reads its inputs before any result is written.
+    SmallVector<uint64_t, kMaxWaveSize> Results(m_WaveSize);
+    ForLanes(W, [&](unsigned L) {
+      LaneMask M = ReadMask(L);
+      uint64_t R = Op == DXIL::WaveMultiPrefixOpKind::Product
+                       ? WaveIdentity(DXIL::WaveOpKind::Product, K)
+                   : Op == DXIL::WaveMultiPrefixOpKind::And ? Trunc(~0ULL, Bits)
+                                                            : 0;
+      for (unsigned i = 0; i < W.NumLanes && W.Lanes[i] < L; ++i) {
+        unsigned Other = W.Lanes[i];
+        if (!M.test(Other))
+          continue;
+        uint64_t X = V[Other];
+        switch (Op) {
+        case DXIL::WaveMultiPrefixOpKind::Sum:
+          R = IsBitCount ? R + (X != 0)
+                         : WaveCombine(DXIL::WaveOpKind::Sum, Signed, K, R, X);
+          break;
+        case DXIL::WaveMultiPrefixOpKind::Product:
+          R = WaveCombine(DXIL::WaveOpKind::Product, Signed, K, R, X);
+          break;
+        case DXIL::WaveMultiPrefixOpKind::And:
+          R &= X;
+          break;
+        case DXIL::WaveMultiPrefixOpKind::Or:
+          R |= X;
+          break;
+        case DXIL::WaveMultiPrefixOpKind::Xor:
+          R ^= X;
+          break;
+        }
+      }
+      Results[L] = R;
+    });
+    ForLanes(W, [&](unsigned L) { Dst[L] = Results[L]; });
+    break;
+  }
+  case DXIL::OpCode::QuadReadLaneAt: {
+    const uint64_t *QuadLane = Arg(1);
+    ForLanes(W, [&](unsigned L) { Dst[L] = V[(L & ~3u) | (QuadLane[L] & 3)]; });
+    break;
+  }
+  case DXIL::OpCode::QuadOp: {
+    // ReadAcrossX, ReadAcrossY and ReadAcrossDiagonal flip bit 0, bit 1 or
+    // both of the lane index.
+    unsigned Flip = (unsigned)Imm(1) + 1;
+    ForLanes(W, [&](unsigned L) { Dst[L] = V[L ^ Flip]; });
+    break;
+  }
+  case DXIL::OpCode::QuadVote: {
+    bool IsAll = Imm(1) == (unsigned)DXIL::QuadVoteOpKind::All;
+    const StackEntry &Top = Fr.Stack.back();
+    ForLanes(W, [&](unsigned L) {
+      bool Any = false, All = true;
+      for (unsigned Q = L & ~3u; Q < (L & ~3u) + 4; ++Q) {
+        if (!Top.Mask.test(Q))
+          continue;
+        Any |= V[Q] != 0;
+        All &= V[Q] != 0;
+      }
+      Dst[L] = IsAll ? All : Any;
+    });
+    break;
+  }
+  default:
+    llvm_unreachable("not a wave operation");
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// DxilInterpreter
+//===----------------------------------------------------------------------===//
+
+DxilInterpreter::DxilInterpreter(DxilModule &DM) : m_pImpl(new Impl(DM)) {}
+
+DxilInterpreter::~DxilInterpreter() {}
+
+void DxilInterpreter::SetWaveSize(unsigned WaveSize) {
+  m_pImpl->SetWaveSize(WaveSize);
+}
+
+unsigned DxilInterpreter::GetWaveSize() const { return m_pImpl->m_WaveSize; }
+
+void DxilInterpreter::BindResource(DXIL::ResourceClass Class, unsigned Space,
+                                   unsigned Register, void *Data,
+                                   size_t Size) {
+  IFTBOOL(Class == DXIL::ResourceClass::SRV ||
+              Class == DXIL::ResourceClass::UAV ||
+              Class == DXIL::ResourceClass::CBuffer,
+          E_INVALIDARG);
+  IFTBOOL(Data || !Size, E_INVALIDARG);
+  Impl::Binding &B = m_pImpl->m_Bindings[Impl::BindingKey(
+      (unsigned)Class, Space, Register)];
+  B.Data = (uint8_t *)Data;
+  B.Size = Size;
+}
+
+void DxilInterpreter::SetUAVCounter(unsigned Space, unsigned Register,
+                                    uint32_t Value) {
+  m_pImpl->m_Bindings[Impl::BindingKey((unsigned)DXIL::ResourceClass::UAV,
+                                       Space, Register)]
+      .Counter = Value;
+}
+
+uint32_t DxilInterpreter::GetUAVCounter(unsigned Space,
+                                        unsigned Register) const {
+  auto It = m_pImpl->m_Bindings.find(
+      Impl::BindingKey((unsigned)DXIL::ResourceClass::UAV, Space, Register));
+  return It != m_pImpl->m_Bindings.end() ? It->second.Counter : 0;
+}
+
+void DxilInterpreter::Dispatch(unsigned X, unsigned Y, unsigned Z) {
+  m_pImpl->Dispatch(X, Y, Z);
+}
+
+const DxilInterpStats &DxilInterpreter::GetStats() const {
+  return m_pImpl->m_Stats;
+}
+
+void DxilInterpreter::ResetStats() {
+  memset(&m_pImpl->m_Stats, 0, sizeof(m_pImpl->m_Stats));
+}
@@ -1358,4 +1358,59 @@ HRESULT ValidateDxilContainer(const void *pContainer, uint32_t ContainerSize,
                               llvm::raw_ostream &DiagStream) {
   return ValidateDxilContainer(pContainer, ContainerSize, nullptr, DiagStream);
 }
+
+// Validating a module in place only certifies the container if its DXIL part
+// holds that same module, that is, the bitcode the module was written to.
+static bool DxilPartMatchesModule(const DxilPartHeader *pPart,
+                                  StringRef ModuleBitcode) {
+  const DxilProgramHeader *pProgramHeader =
+      reinterpret_cast<const DxilProgramHeader *>(GetDxilPartData(pPart));
+  if (!IsValidDxilProgramHeader(pProgramHeader, pPart->PartSize))
+    return false;
+  const char *pIL = nullptr;
+  uint32_t ILLength = 0;
+  GetDxilProgramBitcode(pProgramHeader, &pIL, &ILLength);
+  return StringRef(pIL, ILLength) == ModuleBitcode;
+}
+
+HRESULT ValidateDxilContainerWithModule(const void *pContainer,
+                                        uint32_t ContainerSize,
+                                        llvm::Module *pModule,
+                                        StringRef ModuleBitcode,
+                                        llvm::Module *pDebugModule,
+                                        llvm::raw_ostream &DiagStream) {
+  DXASSERT_NOMSG(pModule != nullptr);
+
+  // The container must still hold a well formed DXIL part, even though the
+  // module it contains is not loaded from it.
+  const DxilPartHeader *pPart = nullptr;
+  IFR(FindDxilPart(pContainer, ContainerSize, DFCC_DXIL, &pPart));
+
+  llvm::DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+  PrintDiagnosticContext DiagContext(DiagPrinter);
+  DiagRestore DR(pModule, &DiagContext);
+  DiagRestore DR2(pDebugModule, &DiagContext);
+
+  DxilModule *pDxilModule = DxilModule::TryGetDxilModule(pModule);
+  if (!pDxilModule) {
+    return DXC_E_IR_VERIFICATION_FAILED;
+  }
+  if (!DxilPartMatchesModule(pPart, ModuleBitcode)) {
+    ValidationContext ValCtx(*pModule, pDebugModule, *pDxilModule);
+    ValCtx.EmitFormatError(ValidationRule::ContainerPartMatches,
+                           {"DXIL Program"});
+    return DXC_E_IR_VERIFICATION_FAILED;
+  }
+
+  // Validate DXIL Module
+  IFR(ValidateDxilModule(pModule, pDebugModule));
+
+  if (DiagContext.HasErrors() || DiagContext.HasWarnings()) {
+    return DXC_E_IR_VERIFICATION_FAILED;
+  }
+
+  return ValidateDxilContainerParts(
+      pModule, pDebugModule, IsDxilContainerLike(pContainer, ContainerSize),
+      ContainerSize);
+}
 } // namespace hlsl
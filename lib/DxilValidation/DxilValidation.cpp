@@ -43,13 +43,18 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/Type.h"
+#include "llvm/IR/TypeFinder.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "DxilValidationUtils.h"
 
 #include <algorithm>
+#include <atomic>
 #include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include <unordered_set>
 
 using namespace llvm;
@@ -2090,7 +2095,9 @@ static void ValidateExternalFunction(Function *F, ValidationContext &ValCtx) {
 ///////////////////////////////////////////////////////////////////////////////
 // Instruction validation functions.                                         //
 
-static bool IsDxilBuiltinStructType(StructType *ST, hlsl::OP *hlslOP) {
+static bool IsDxilBuiltinStructType(StructType *ST,
+                                    ValidationContext &ValCtx) {
+  hlsl::OP *hlslOP = ValCtx.DxilMod.GetOP();
   if (ST == hlslOP->GetBinaryWithCarryType())
     return true;
   if (ST == hlslOP->GetBinaryWithTwoOutputsType())
@@ -2108,6 +2115,8 @@ static bool IsDxilBuiltinStructType(StructType *ST, hlsl::OP *hlslOP) {
   if (ST == hlslOP->GetSplitDoubleType())
     return true;
 
+  // The return types below are created on first use.
+  std::lock_guard<std::mutex> lock(ValCtx.OPTypeMutex);
   unsigned EltNum = ST->getNumElements();
   switch (EltNum) {
   case 2:
@@ -2160,8 +2169,7 @@ static bool ValidateType(Type *Ty, ValidationContext &ValCtx,
       // Allow handle type.
       if (ValCtx.HandleTy == Ty)
         return true;
-      hlsl::OP *hlslOP = ValCtx.DxilMod.GetOP();
-      if (IsDxilBuiltinStructType(ST, hlslOP)) {
+      if (IsDxilBuiltinStructType(ST, ValCtx)) {
         ValCtx.EmitTypeError(Ty, ValidationRule::InstrDxilStructUser);
         result = false;
       }
@@ -2222,7 +2230,7 @@ static bool GetNodeOperandAsInt(ValidationContext &ValCtx, MDNode *pMD,
 }
 
 static bool IsPrecise(Instruction &I, ValidationContext &ValCtx) {
-  MDNode *pMD = I.getMetadata(DxilMDHelper::kDxilPreciseAttributeMDName);
+  MDNode *pMD = I.getMetadata(ValCtx.kDxilPreciseMDKind);
   if (pMD == nullptr) {
     return false;
   }
@@ -2414,7 +2422,7 @@ static void ValidateControlFlowHint(BasicBlock &bb, ValidationContext &ValCtx) {
   if (!TI)
     return;
 
-  MDNode *pNode = TI->getMetadata(DxilMDHelper::kDxilControlFlowHintMDName);
+  MDNode *pNode = TI->getMetadata(ValCtx.kDxilControlFlowHintMDKind);
   if (!pNode)
     return;
 
@@ -2859,7 +2867,7 @@ static void ValidateFunctionBody(Function *F, ValidationContext &ValCtx) {
         if (StructType *ST = dyn_cast<StructType>(Ty)) {
           Value *Agg = EV->getAggregateOperand();
           if (!isa<AtomicCmpXchgInst>(Agg) &&
-              !IsDxilBuiltinStructType(ST, ValCtx.DxilMod.GetOP())) {
+              !IsDxilBuiltinStructType(ST, ValCtx)) {
             ValCtx.EmitInstrError(EV, ValidationRule::InstrExtractValue);
           }
         } else {
@@ -2942,9 +2950,11 @@ static void ValidateFunctionBody(Function *F, ValidationContext &ValCtx) {
         BitCastInst *Cast = cast<BitCastInst>(&I);
         Type *FromTy = Cast->getOperand(0)->getType();
         Type *ToTy = Cast->getType();
-        // Allow i8* cast for llvm.lifetime.* intrinsics.
-        if (SupportsLifetimeIntrinsics &&
-            ToTy == Type::getInt8PtrTy(ToTy->getContext()))
+        // Allow i8* cast for llvm.lifetime.* intrinsics. Match the type by
+        // shape rather than Type::getInt8PtrTy, which may create it.
+        if (SupportsLifetimeIntrinsics && ToTy->isPointerTy() &&
+            ToTy->getPointerAddressSpace() == 0 &&
+            ToTy->getPointerElementType()->isIntegerTy(8))
           continue;
         if (isa<PointerType>(FromTy)) {
           FromTy = FromTy->getPointerElementType();
@@ -5816,6 +5826,117 @@ static void ValidateUninitializedOutput(ValidationContext &ValCtx) {
   }
 }
 
+// Libraries with fewer function definitions than this per worker thread are
+// validated on the calling thread only.
+static const unsigned kMinFunctionsPerValidationWorker = 8;
+
+static thread_local unsigned ValidationThreadLimit = 0;
+
+ScopedValidationThreadLimit::ScopedValidationThreadLimit(unsigned MaxThreads)
+    : m_PrevMaxThreads(ValidationThreadLimit) {
+  ValidationThreadLimit = std::max(MaxThreads, 1u);
+}
+
+ScopedValidationThreadLimit::~ScopedValidationThreadLimit() {
+  ValidationThreadLimit = m_PrevMaxThreads;
+}
+
+unsigned ScopedValidationThreadLimit::GetLimit() {
+  return ValidationThreadLimit;
+}
+
+static void ValidateFunctions(ValidationContext &ValCtx) {
+  Module &M = ValCtx.M;
+  std::vector<Function *> Functions;
+  std::vector<unsigned> Definitions;
+  for (Function &F : M.functions()) {
+    if (!F.isDeclaration())
+      Definitions.push_back(Functions.size());
+    Functions.push_back(&F);
+  }
+
+  // Only libraries have enough functions to benefit, and non-library function
+  // attribute validation is not safe to run concurrently.
+  unsigned NumWorkers = 1;
+  if (ValCtx.isLibProfile) {
+    unsigned MaxWorkers = ValidationThreadLimit;
+    if (MaxWorkers == 0)
+      MaxWorkers = std::thread::hardware_concurrency();
+    NumWorkers = std::min<unsigned>(
+        MaxWorkers, Definitions.size() / kMinFunctionsPerValidationWorker);
+  }
+  if (NumWorkers < 2) {
+    for (Function *F : Functions)
+      ValidateFunction(*F, ValCtx);
+    return;
+  }
+
+  // Diagnostics are recorded per function and replayed in module order once
+  // all functions are validated.
+  std::vector<ValidationDiagBuffer> Diags(Functions.size());
+
+  // Declarations are validated on this thread; validating DXIL operation
+  // calls updates the per-entry state shared by all functions.
+  for (unsigned i = 0, e = Functions.size(); i != e; ++i) {
+    if (!Functions[i]->isDeclaration())
+      continue;
+    ValidationContext::DeferDiagsScope Scope(Diags[i]);
+    ValidateFunction(*Functions[i], ValCtx);
+  }
+
+  // The DataLayout computes struct layouts on first use; compute them up
+  // front so the workers only read them.
+  TypeFinder StructTypes;
+  StructTypes.run(M, /*onlyNamed*/ false);
+  for (StructType *ST : StructTypes)
+    if (ST->isSized())
+      ValCtx.DL.getStructLayout(ST);
+
+  IMalloc *pMalloc = DxcGetThreadMallocNoRef();
+  std::atomic<unsigned> NextDefinition(0);
+  std::mutex ExceptionMutex;
+  std::exception_ptr WorkerException;
+  auto ValidateDefinitions = [&]() {
+    DxcThreadMalloc TM(pMalloc);
+    try {
+      for (;;) {
+        unsigned Idx = NextDefinition++;
+        if (Idx >= Definitions.size())
+          break;
+        unsigned i = Definitions[Idx];
+        ValidationContext::DeferDiagsScope Scope(Diags[i]);
+        ValidateFunction(*Functions[i], ValCtx);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(ExceptionMutex);
+      if (!WorkerException)
+        WorkerException = std::current_exception();
+      NextDefinition = Definitions.size();
+    }
+  };
+
+  // This thread is one of the workers.
+  std::vector<std::thread> Workers;
+  Workers.reserve(NumWorkers - 1);
+  try {
+    // The thread start state is freed on the worker after its allocator is
+    // uninstalled, so it must come from the default allocator.
+    DxcThreadMalloc TMDefault(nullptr);
+    while (Workers.size() < NumWorkers - 1)
+      Workers.emplace_back(ValidateDefinitions);
+  } catch (...) {
+    // Validate with the workers that did start.
+  }
+  ValidateDefinitions();
+  for (std::thread &Worker : Workers)
+    Worker.join();
+  if (WorkerException)
+    std::rethrow_exception(WorkerException);
+
+  for (ValidationDiagBuffer &FunctionDiags : Diags)
+    FunctionDiags.Replay();
+}
+
 uint32_t ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule) {
   DxilModule *pDxilModule = DxilModule::TryGetDxilModule(pModule);
   if (!pDxilModule) {
@@ -5845,9 +5966,7 @@ uint32_t ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule) {
   ValidateFlowControl(ValCtx);
 
   // Validate functions.
-  for (Function &F : pModule->functions()) {
-    ValidateFunction(F, ValCtx);
-  }
+  ValidateFunctions(ValCtx);
 
   ValidateShaderFlags(ValCtx);
 
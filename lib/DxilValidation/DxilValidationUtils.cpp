@@ -26,6 +26,32 @@
 #include "llvm/Support/raw_ostream.h"
 
 namespace hlsl {
+// Buffer that diagnostics emitted on this thread are deferred to, if any.
+static thread_local ValidationDiagBuffer *CurrentDiagBuffer = nullptr;
+
+void ValidationDiagBuffer::Replay() {
+  for (std::function<void()> &Emit : Diags)
+    Emit();
+  Diags.clear();
+}
+
+ValidationContext::DeferDiagsScope::DeferDiagsScope(
+    ValidationDiagBuffer &Buffer)
+    : pPrevBuffer(CurrentDiagBuffer) {
+  CurrentDiagBuffer = &Buffer;
+}
+
+ValidationContext::DeferDiagsScope::~DeferDiagsScope() {
+  CurrentDiagBuffer = pPrevBuffer;
+}
+
+void ValidationContext::EmitOrDefer(std::function<void()> Emit) {
+  if (CurrentDiagBuffer)
+    CurrentDiagBuffer->Diags.emplace_back(std::move(Emit));
+  else
+    Emit();
+}
+
 EntryStatus::EntryStatus(DxilEntryProps &entryProps)
     : m_bCoverageIn(false), m_bInnerCoverageIn(false), hasViewID(false) {
   for (unsigned i = 0; i < DXIL::kNumOutputStreams; i++) {
@@ -267,16 +293,21 @@ void ValidationContext::EmitGlobalVariableFormatError(
     GlobalVariable *GV, ValidationRule rule, ArrayRef<StringRef> args) {
   std::string ruleText = GetValidationRuleText(rule);
   FormatRuleText(ruleText, args);
-  if (pDebugModule)
-    GV = pDebugModule->getGlobalVariable(GV->getName());
-  dxilutil::EmitErrorOnGlobalVariable(M.getContext(), GV, ruleText);
-  Failed = true;
+  EmitOrDefer([this, GV, ruleText]() {
+    GlobalVariable *DiagGV = GV;
+    if (pDebugModule)
+      DiagGV = pDebugModule->getGlobalVariable(GV->getName());
+    dxilutil::EmitErrorOnGlobalVariable(M.getContext(), DiagGV, ruleText);
+    Failed = true;
+  });
 }
 
 // This is the least desirable mechanism, as it has no context.
 void ValidationContext::EmitError(ValidationRule rule) {
-  dxilutil::EmitErrorOnContext(M.getContext(), GetValidationRuleText(rule));
-  Failed = true;
+  EmitOrDefer([this, rule]() {
+    dxilutil::EmitErrorOnContext(M.getContext(), GetValidationRuleText(rule));
+    Failed = true;
+  });
 }
 
 void ValidationContext::FormatRuleText(std::string &ruleText,
@@ -309,16 +340,21 @@ void ValidationContext::EmitFormatError(ValidationRule rule,
                                         ArrayRef<StringRef> args) {
   std::string ruleText = GetValidationRuleText(rule);
   FormatRuleText(ruleText, args);
-  dxilutil::EmitErrorOnContext(M.getContext(), ruleText);
-  Failed = true;
+  EmitOrDefer([this, ruleText]() {
+    dxilutil::EmitErrorOnContext(M.getContext(), ruleText);
+    Failed = true;
+  });
 }
 
 void ValidationContext::EmitMetaError(Metadata *Meta, ValidationRule rule) {
-  std::string O;
-  raw_string_ostream OSS(O);
-  Meta->print(OSS, &M);
-  dxilutil::EmitErrorOnContext(M.getContext(), GetValidationRuleText(rule) + O);
-  Failed = true;
+  EmitOrDefer([this, Meta, rule]() {
+    std::string O;
+    raw_string_ostream OSS(O);
+    Meta->print(OSS, &M);
+    dxilutil::EmitErrorOnContext(M.getContext(),
+                                 GetValidationRuleText(rule) + O);
+    Failed = true;
+  });
 }
 
 // Use this instead of DxilResourceBase::GetGlobalName
@@ -368,20 +404,24 @@ ValidationContext::GetResourceName(const hlsl::DxilResourceBase *Res) {
 
 void ValidationContext::EmitResourceError(const hlsl::DxilResourceBase *Res,
                                           ValidationRule rule) {
-  std::string QuotedRes = " '" + GetResourceName(Res) + "'";
-  dxilutil::EmitErrorOnContext(M.getContext(),
-                               GetValidationRuleText(rule) + QuotedRes);
-  Failed = true;
+  EmitOrDefer([this, Res, rule]() {
+    std::string QuotedRes = " '" + GetResourceName(Res) + "'";
+    dxilutil::EmitErrorOnContext(M.getContext(),
+                                 GetValidationRuleText(rule) + QuotedRes);
+    Failed = true;
+  });
 }
 
 void ValidationContext::EmitResourceFormatError(
     const hlsl::DxilResourceBase *Res, ValidationRule rule,
     ArrayRef<StringRef> args) {
-  std::string QuotedRes = " '" + GetResourceName(Res) + "'";
   std::string ruleText = GetValidationRuleText(rule);
   FormatRuleText(ruleText, args);
-  dxilutil::EmitErrorOnContext(M.getContext(), ruleText + QuotedRes);
-  Failed = true;
+  EmitOrDefer([this, Res, ruleText]() {
+    std::string QuotedRes = " '" + GetResourceName(Res) + "'";
+    dxilutil::EmitErrorOnContext(M.getContext(), ruleText + QuotedRes);
+    Failed = true;
+  });
 }
 
 bool ValidationContext::IsDebugFunctionCall(Instruction *I) {
@@ -416,6 +456,15 @@ Instruction *ValidationContext::GetDebugInstr(Instruction *I) {
 // If `isError` is true, `Rule` may omit repeated errors
 void ValidationContext::EmitInstrDiagMsg(Instruction *I, ValidationRule Rule,
                                          std::string Msg, bool isError) {
+  // The repeated error check, the debug instruction lookup and the slot
+  // tracker all depend on diagnostics being emitted in order on one thread.
+  if (CurrentDiagBuffer) {
+    EmitOrDefer([this, I, Rule, Msg, isError]() {
+      EmitInstrDiagMsg(I, Rule, Msg, isError);
+    });
+    return;
+  }
+
   BasicBlock *BB = I->getParent();
   Function *F = BB->getParent();
 
@@ -499,22 +548,29 @@ void ValidationContext::EmitTypeError(Type *Ty, ValidationRule rule) {
 }
 
 void ValidationContext::EmitFnError(Function *F, ValidationRule rule) {
-  if (pDebugModule)
-    if (Function *dbgF = pDebugModule->getFunction(F->getName()))
-      F = dbgF;
-  dxilutil::EmitErrorOnFunction(M.getContext(), F, GetValidationRuleText(rule));
-  Failed = true;
+  EmitOrDefer([this, F, rule]() {
+    Function *DiagF = F;
+    if (pDebugModule)
+      if (Function *dbgF = pDebugModule->getFunction(F->getName()))
+        DiagF = dbgF;
+    dxilutil::EmitErrorOnFunction(M.getContext(), DiagF,
+                                  GetValidationRuleText(rule));
+    Failed = true;
+  });
 }
 
 void ValidationContext::EmitFnFormatError(Function *F, ValidationRule rule,
                                           ArrayRef<StringRef> args) {
   std::string ruleText = GetValidationRuleText(rule);
   FormatRuleText(ruleText, args);
-  if (pDebugModule)
-    if (Function *dbgF = pDebugModule->getFunction(F->getName()))
-      F = dbgF;
-  dxilutil::EmitErrorOnFunction(M.getContext(), F, ruleText);
-  Failed = true;
+  EmitOrDefer([this, F, ruleText]() {
+    Function *DiagF = F;
+    if (pDebugModule)
+      if (Function *dbgF = pDebugModule->getFunction(F->getName()))
+        DiagF = dbgF;
+    dxilutil::EmitErrorOnFunction(M.getContext(), DiagF, ruleText);
+    Failed = true;
+  });
 }
 
 void ValidationContext::EmitFnAttributeError(Function *F, StringRef Kind,
@@ -20,7 +20,9 @@
 #include "llvm/IR/DebugLoc.h"
 #include "llvm/IR/ModuleSlotTracker.h"
 
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -63,6 +65,18 @@ struct EntryStatus {
   EntryStatus(DxilEntryProps &entryProps);
 };
 
+// Diagnostics emitted while validating one function on a worker thread. They
+// are replayed on the validating thread in module order, so the output is the
+// same as when functions are validated one after another.
+class ValidationDiagBuffer {
+public:
+  void Replay();
+
+private:
+  friend struct ValidationContext;
+  std::vector<std::function<void()>> Diags;
+};
+
 struct ValidationContext {
   bool Failed = false;
   Module &M;
@@ -88,6 +102,9 @@ struct ValidationContext {
   unsigned m_DxilMajor, m_DxilMinor;
   ModuleSlotTracker slotTracker;
   std::unique_ptr<CallGraph> pCallGraph;
+  // Guards the types hlsl::OP creates on first use while functions are
+  // validated concurrently.
+  std::mutex OPTypeMutex;
 
   ValidationContext(Module &llvmModule, Module *DebugModule,
                     DxilModule &dxilModule);
@@ -99,6 +116,19 @@ struct ValidationContext {
   CallGraph &GetCallGraph();
   DxilResourceProperties GetResourceFromVal(Value *resVal);
 
+  // Records the diagnostics emitted on this thread into Buffer for as long as
+  // it is alive, instead of reporting them to the LLVMContext.
+  class DeferDiagsScope {
+  public:
+    explicit DeferDiagsScope(ValidationDiagBuffer &Buffer);
+    ~DeferDiagsScope();
+
+  private:
+    ValidationDiagBuffer *pPrevBuffer;
+  };
+  // Runs Emit, or records it if diagnostics are deferred on this thread.
+  void EmitOrDefer(std::function<void()> Emit);
+
   void EmitGlobalVariableFormatError(GlobalVariable *GV, ValidationRule rule,
                                      ArrayRef<StringRef> args);
   // This is the least desirable mechanism, as it has no context.
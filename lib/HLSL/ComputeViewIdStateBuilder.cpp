@@ -24,6 +24,7 @@
 #include "llvm/IR/Operator.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/MathExtras.h"
 
 #include <algorithm>
 
@@ -99,6 +100,28 @@ private:
   DynamicallyIndexedElemsType m_OutSigDynIdxElems;
   DynamicallyIndexedElemsType m_PCSigDynIdxElems;
 
+  // Contributions are rows of a dense bit matrix. A row holds the input
+  // scalars, the DS patch constant scalars, and the HS control point outputs
+  // loaded by the patch constant function that contribute to a value, followed
+  // by a bit for ViewID.
+  static const unsigned kInputBit = 0;
+  static const unsigned kPCInputBit = kMaxSigScalars;
+  static const unsigned kOutputCPBit = 2 * kMaxSigScalars;
+  static const unsigned kViewIdBit = 3 * kMaxSigScalars;
+  static const unsigned kSigWords = kMaxSigScalars / 64;
+  static const unsigned kRowWords = kViewIdBit / 64 + 1;
+
+  // Node of the graph of contributing instructions, numbered in visit order.
+  struct ContributionNode {
+    unsigned Index;
+    // Smallest index reachable from this node, for finding cycles.
+    unsigned LowLink;
+    // Index of the node whose row holds the contributions of this node, once
+    // the cycle it belongs to is complete.
+    unsigned Row;
+    bool OnStack;
+  };
+
   // Information per entry point.
   using FunctionSetType = std::unordered_set<llvm::Function *>;
   using InstructionSetType = std::unordered_set<llvm::Instruction *>;
@@ -108,9 +131,12 @@ private:
     FunctionSetType Functions;
     // Outputs to analyze.
     InstructionSetType Outputs;
-    // Contributing instructions per output.
-    std::unordered_map<unsigned, InstructionSetType>
-        ContributingInstructions[kNumStreams];
+    // Contributions per scalar output, kRowWords words per output.
+    std::vector<uint64_t> OutputContributions[kNumStreams];
+    // Contributing instructions visited so far and their rows, shared by all
+    // outputs of the entry.
+    std::unordered_map<llvm::Instruction *, ContributionNode> Nodes;
+    std::vector<uint64_t> NodeContributions;
     void Clear();
   };
 
@@ -143,12 +169,16 @@ private:
   void AnalyzeFunctions(EntryInfo &Entry);
   void CollectValuesContributingToOutputs(EntryInfo &Entry,
                                           bool IsForPatchConstant);
-  void CollectValuesContributingToOutputRec(
-      EntryInfo &Entry, llvm::Value *pContributingValue,
-      InstructionSetType &ContributingInstructions);
-  void CollectPhiCFValuesContributingToOutputRec(
+  unsigned ComputeContributions(EntryInfo &Entry, llvm::Instruction *pRoot);
+  llvm::Instruction *GetContributingInstruction(EntryInfo &Entry,
+                                                llvm::Value *pValue);
+  void CollectContributingInstructions(
+      EntryInfo &Entry, llvm::Instruction *pInst,
+      llvm::SmallVectorImpl<llvm::Instruction *> &ContributingInstructions);
+  void CollectPhiCFValuesContributingToOutput(
       llvm::PHINode *pPhi, EntryInfo &Entry,
-      InstructionSetType &ContributingInstructions);
+      llvm::SmallVectorImpl<llvm::Instruction *> &ContributingInstructions);
+  void AddLeafContribution(llvm::Instruction *pInst, uint64_t *pRow);
   const ValueSetType &CollectReachingDecls(llvm::Value *pValue);
   void CollectReachingDeclsRec(llvm::Value *pValue, ValueSetType &ReachingDecls,
                                ValueSetType &Visited);
@@ -157,8 +187,7 @@ private:
                         ValueSetType &Visited);
   void UpdateDynamicIndexUsageState() const;
   void
-  CreateViewIdSets(const std::unordered_map<unsigned, InstructionSetType>
-                       &ContributingInstructions,
+  CreateViewIdSets(const std::vector<uint64_t> &OutputContributions,
                    OutputsDependentOnViewIdType &OutputsDependentOnViewId,
                    InputsContributingToOutputType &InputsContributingToOutputs,
                    bool bPC);
@@ -217,19 +246,18 @@ void DxilViewIdStateBuilder::Compute() {
   // 5. Construct dependency sets.
   for (unsigned StreamId = 0; StreamId < (pSM->IsGS() ? kNumStreams : 1u);
        StreamId++) {
-    CreateViewIdSets(m_Entry.ContributingInstructions[StreamId],
+    CreateViewIdSets(m_Entry.OutputContributions[StreamId],
                      m_OutputsDependentOnViewId[StreamId],
                      m_InputsContributingToOutputs[StreamId], false);
   }
   if (pSM->IsHS() || pSM->IsMS()) {
-    CreateViewIdSets(m_PCEntry.ContributingInstructions[0],
+    CreateViewIdSets(m_PCEntry.OutputContributions[0],
                      m_PCOrPrimOutputsDependentOnViewId,
                      m_InputsContributingToPCOrPrimOutputs, true);
   } else if (pSM->IsDS()) {
     OutputsDependentOnViewIdType OutputsDependentOnViewId;
-    CreateViewIdSets(m_Entry.ContributingInstructions[0],
-                     OutputsDependentOnViewId, m_PCInputsContributingToOutputs,
-                     true);
+    CreateViewIdSets(m_Entry.OutputContributions[0], OutputsDependentOnViewId,
+                     m_PCInputsContributingToOutputs, true);
     DXASSERT_NOMSG(OutputsDependentOnViewId == m_OutputsDependentOnViewId[0]);
   }
 
@@ -267,7 +295,9 @@ void DxilViewIdStateBuilder::EntryInfo::Clear() {
   Functions.clear();
   Outputs.clear();
   for (unsigned i = 0; i < kNumStreams; i++)
-    ContributingInstructions[i].clear();
+    OutputContributions[i].clear();
+  Nodes.clear();
+  NodeContributions.clear();
 }
 
 void DxilViewIdStateBuilder::FuncInfo::Clear() {
@@ -457,8 +487,20 @@ void DxilViewIdStateBuilder::AnalyzeFunctions(EntryInfo &Entry) {
   }
 }
 
+static void OrWords(uint64_t *pDst, const uint64_t *pSrc, unsigned NumWords) {
+  for (unsigned i = 0; i < NumWords; i++)
+    pDst[i] |= pSrc[i];
+}
+
+static bool TestBit(const uint64_t *pWords, unsigned Bit) {
+  return (pWords[Bit / 64] >> (Bit % 64)) & 1;
+}
+
 void DxilViewIdStateBuilder::CollectValuesContributingToOutputs(
     EntryInfo &Entry, bool IsForPatchConstantOrPrimitive) {
+  for (unsigned i = 0; i < kNumStreams; i++)
+    Entry.OutputContributions[i].assign(kMaxSigScalars * kRowWords, 0);
+
   for (auto *CI : Entry.Outputs) { // CI = call instruction
     DxilSignature *pDxilSig = nullptr;
     Value *pContributingValue = nullptr;
@@ -520,120 +562,192 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputs(
       endRow = SigElem.GetRows() - 1;
     }
 
-    InstructionSetType ContributingInstructionsAllRows;
-    InstructionSetType *pContributingInstructions =
-        &ContributingInstructionsAllRows;
-    if (startRow == endRow) {
-      // Scalar or indexable with known index.
-      unsigned index = GetLinearIndex(SigElem, startRow, col);
-      pContributingInstructions =
-          &Entry.ContributingInstructions[StreamId][index];
-    }
-
-    CollectValuesContributingToOutputRec(Entry, pContributingValue,
-                                         *pContributingInstructions);
-
-    // Handle control dependence of this instruction BB.
+    // The stored value and the control dependence of this instruction BB.
+    SmallVector<Instruction *, 8> Roots;
+    if (Instruction *I = GetContributingInstruction(Entry, pContributingValue))
+      Roots.push_back(I);
     BasicBlock *pBB = CI->getParent();
     Function *F = pBB->getParent();
     FuncInfo *pFuncInfo = m_FuncInfo[F].get();
-    const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
-    for (BasicBlock *B : CtrlDepSet) {
-      CollectValuesContributingToOutputRec(Entry, B->getTerminator(),
-                                           *pContributingInstructions);
+    for (BasicBlock *B : pFuncInfo->CtrlDep.GetCDBlocks(pBB)) {
+      if (Instruction *I =
+              GetContributingInstruction(Entry, B->getTerminator()))
+        Roots.push_back(I);
     }
 
-    if (pContributingInstructions == &ContributingInstructionsAllRows) {
-      // Write dynamically indexed output contributions to all rows.
-      for (int row = startRow; row <= endRow; row++) {
-        unsigned index = GetLinearIndex(SigElem, row, col);
-        Entry.ContributingInstructions[StreamId][index].insert(
-            ContributingInstructionsAllRows.begin(),
-            ContributingInstructionsAllRows.end());
-      }
+    uint64_t Contributions[kRowWords] = {};
+    for (Instruction *I : Roots) {
+      unsigned Row = ComputeContributions(Entry, I);
+      OrWords(Contributions, &Entry.NodeContributions[Row * kRowWords],
+              kRowWords);
+    }
+
+    // Dynamically indexed outputs get the contributions in all rows.
+    for (int row = startRow; row <= endRow; row++) {
+      unsigned index = GetLinearIndex(SigElem, row, col);
+      OrWords(&Entry.OutputContributions[StreamId][index * kRowWords],
+              Contributions, kRowWords);
+    }
+  }
+}
+
+// Returns the row of NodeContributions holding everything that contributes to
+// pRoot. Contributions are memoized per entry, so that each instruction is
+// visited once no matter how many outputs it contributes to. Instructions are
+// walked with an explicit worklist in depth-first order, and the instructions
+// of a cycle (through phis, memory or control dependence) share the row of
+// the first one visited, since they all contribute to each other.
+unsigned DxilViewIdStateBuilder::ComputeContributions(EntryInfo &Entry,
+                                                      Instruction *pRoot) {
+  auto itRoot = Entry.Nodes.find(pRoot);
+  if (itRoot != Entry.Nodes.end()) {
+    DXASSERT_NOMSG(!itRoot->second.OnStack);
+    return itRoot->second.Row;
+  }
+
+  struct Frame {
+    ContributionNode *pNode;
+    SmallVector<Instruction *, 8> Successors;
+    unsigned NextSuccessor;
+  };
+  vector<Frame> Worklist;
+  // Nodes whose cycle is not complete yet.
+  vector<ContributionNode *> Stack;
+
+  auto Visit = [&](Instruction *pInst) {
+    unsigned Index = Entry.Nodes.size();
+    // References to elements of an unordered_map survive rehashing.
+    ContributionNode &Node = Entry.Nodes[pInst];
+    Node.Index = Index;
+    Node.LowLink = Index;
+    Node.Row = Index;
+    Node.OnStack = true;
+    Stack.push_back(&Node);
+    Entry.NodeContributions.resize((Index + 1) * kRowWords, 0);
+    AddLeafContribution(pInst, &Entry.NodeContributions[Index * kRowWords]);
+    Worklist.emplace_back();
+    Worklist.back().pNode = &Node;
+    Worklist.back().NextSuccessor = 0;
+    CollectContributingInstructions(Entry, pInst, Worklist.back().Successors);
+  };
+  auto Merge = [&](ContributionNode &Node, const ContributionNode &Succ) {
+    if (Succ.OnStack) {
+      Node.LowLink = std::min(Node.LowLink, Succ.LowLink);
+    } else {
+      OrWords(&Entry.NodeContributions[Node.Index * kRowWords],
+              &Entry.NodeContributions[Succ.Row * kRowWords], kRowWords);
+    }
+  };
+
+  Visit(pRoot);
+  while (!Worklist.empty()) {
+    Frame &F = Worklist.back();
+    if (F.NextSuccessor < F.Successors.size()) {
+      Instruction *pSucc = F.Successors[F.NextSuccessor++];
+      auto it = Entry.Nodes.find(pSucc);
+      if (it == Entry.Nodes.end())
+        Visit(pSucc);
+      else
+        Merge(*F.pNode, it->second);
+      continue;
     }
+
+    ContributionNode &Node = *F.pNode;
+    Worklist.pop_back();
+    if (Node.LowLink == Node.Index) {
+      // Node is the first visited of a complete cycle; gather the
+      // contributions of the cycle into its row.
+      ContributionNode *pMember;
+      do {
+        pMember = Stack.back();
+        Stack.pop_back();
+        pMember->OnStack = false;
+        pMember->Row = Node.Index;
+        if (pMember != &Node)
+          OrWords(&Entry.NodeContributions[Node.Index * kRowWords],
+                  &Entry.NodeContributions[pMember->Index * kRowWords],
+                  kRowWords);
+      } while (pMember != &Node);
+    }
+    if (!Worklist.empty())
+      Merge(*Worklist.back().pNode, Node);
   }
+  DXASSERT_NOMSG(Stack.empty());
+  return Entry.Nodes[pRoot].Row;
 }
 
-void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(
-    EntryInfo &Entry, Value *pContributingValue,
-    InstructionSetType &ContributingInstructions) {
-  if (dyn_cast<Argument>(pContributingValue)) {
+// Returns pValue if it is an instruction whose contributions are tracked.
+Instruction *
+DxilViewIdStateBuilder::GetContributingInstruction(EntryInfo &Entry,
+                                                   Value *pValue) {
+  if (dyn_cast<Argument>(pValue)) {
     // This must be a leftover signature argument of an entry function.
     DXASSERT_NOMSG(Entry.pEntryFunc == m_pModule->GetEntryFunction() ||
                    Entry.pEntryFunc == m_pModule->GetPatchConstantFunction());
-    return;
+    return nullptr;
   }
 
-  Instruction *pContributingInst = dyn_cast<Instruction>(pContributingValue);
-  if (pContributingInst == nullptr) {
+  Instruction *pInst = dyn_cast<Instruction>(pValue);
+  if (pInst == nullptr) {
     // Can be literal constant, global decl, branch target.
-    DXASSERT_NOMSG(isa<Constant>(pContributingValue) ||
-                   isa<BasicBlock>(pContributingValue));
-    return;
+    DXASSERT_NOMSG(isa<Constant>(pValue) || isa<BasicBlock>(pValue));
+    return nullptr;
   }
 
-  BasicBlock *pBB = pContributingInst->getParent();
-  Function *F = pBB->getParent();
-  auto FuncInfoIt = m_FuncInfo.find(F);
-  DXASSERT_NOMSG(FuncInfoIt != m_FuncInfo.end());
-  if (FuncInfoIt == m_FuncInfo.end()) {
-    return;
-  }
+  Function *F = pInst->getParent()->getParent();
+  DXASSERT_NOMSG(m_FuncInfo.count(F));
+  if (!m_FuncInfo.count(F))
+    return nullptr;
+  return pInst;
+}
 
-  auto itInst = ContributingInstructions.emplace(pContributingInst);
-  // Already visited instruction.
-  if (!itInst.second)
-    return;
+// Collects the instructions that directly contribute to pInst.
+void DxilViewIdStateBuilder::CollectContributingInstructions(
+    EntryInfo &Entry, Instruction *pInst,
+    SmallVectorImpl<Instruction *> &ContributingInstructions) {
+  auto Add = [&](Value *V) {
+    if (Instruction *I = GetContributingInstruction(Entry, V))
+      ContributingInstructions.push_back(I);
+  };
 
   // Handle special cases.
-  if (PHINode *phi = dyn_cast<PHINode>(pContributingInst)) {
-    CollectPhiCFValuesContributingToOutputRec(phi, Entry,
-                                              ContributingInstructions);
-  } else if (isa<LoadInst>(pContributingInst) ||
-             isa<AtomicCmpXchgInst>(pContributingInst) ||
-             isa<AtomicRMWInst>(pContributingInst)) {
-    Value *pPtrValue = pContributingInst->getOperand(0);
+  if (PHINode *phi = dyn_cast<PHINode>(pInst)) {
+    CollectPhiCFValuesContributingToOutput(phi, Entry,
+                                           ContributingInstructions);
+  } else if (isa<LoadInst>(pInst) || isa<AtomicCmpXchgInst>(pInst) ||
+             isa<AtomicRMWInst>(pInst)) {
+    Value *pPtrValue = pInst->getOperand(0);
     DXASSERT_NOMSG(pPtrValue->getType()->isPointerTy());
     const ValueSetType &ReachingDecls = CollectReachingDecls(pPtrValue);
     DXASSERT_NOMSG(ReachingDecls.size() > 0);
     for (Value *pDeclValue : ReachingDecls) {
       const ValueSetType &Stores = CollectStores(pDeclValue);
-      for (Value *V : Stores) {
-        CollectValuesContributingToOutputRec(Entry, V,
-                                             ContributingInstructions);
-      }
+      for (Value *V : Stores)
+        Add(V);
     }
-  } else if (CallInst *CI = dyn_cast<CallInst>(pContributingInst)) {
+  } else if (CallInst *CI = dyn_cast<CallInst>(pInst)) {
     if (!hlsl::OP::IsDxilOpFuncCallInst(CI)) {
       Function *F = CI->getCalledFunction();
       if (!F->empty()) {
         // Return value of a user function.
         if (Entry.Functions.find(F) != Entry.Functions.end()) {
           const FuncInfo &FI = *m_FuncInfo[F];
-          for (ReturnInst *pRetInst : FI.Returns) {
-            CollectValuesContributingToOutputRec(Entry, pRetInst,
-                                                 ContributingInstructions);
-          }
+          for (ReturnInst *pRetInst : FI.Returns)
+            Add(pRetInst);
         }
       }
     }
   }
 
   // Handle instruction inputs.
-  unsigned NumOps = pContributingInst->getNumOperands();
-  for (unsigned i = 0; i < NumOps; i++) {
-    Value *O = pContributingInst->getOperand(i);
-    CollectValuesContributingToOutputRec(Entry, O, ContributingInstructions);
-  }
+  for (Value *O : pInst->operands())
+    Add(O);
 
   // Handle control dependence of this instruction BB.
-  FuncInfo *pFuncInfo = FuncInfoIt->second.get();
-  const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
-  for (BasicBlock *B : CtrlDepSet) {
-    CollectValuesContributingToOutputRec(Entry, B->getTerminator(),
-                                         ContributingInstructions);
-  }
+  BasicBlock *pBB = pInst->getParent();
+  FuncInfo *pFuncInfo = m_FuncInfo[pBB->getParent()].get();
+  for (BasicBlock *B : pFuncInfo->CtrlDep.GetCDBlocks(pBB))
+    Add(B->getTerminator());
 }
 
 // Only process control-dependent basic blocks for constant operands of the
@@ -643,9 +757,9 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(
 // point is the highest dominator where it is still legal to "insert" constant
 // assignment. In this context, "legal" means that only one value "leaves" the
 // dominator and reaches Phi.
-void DxilViewIdStateBuilder::CollectPhiCFValuesContributingToOutputRec(
+void DxilViewIdStateBuilder::CollectPhiCFValuesContributingToOutput(
     PHINode *pPhi, EntryInfo &Entry,
-    InstructionSetType &ContributingInstructions) {
+    SmallVectorImpl<Instruction *> &ContributingInstructions) {
   Function *F = pPhi->getParent()->getParent();
   FuncInfo *pFuncInfo = m_FuncInfo[F].get();
   unordered_map<DomTreeNodeBase<BasicBlock> *, Value *> DomTreeMarkers;
@@ -722,10 +836,10 @@ void DxilViewIdStateBuilder::CollectPhiCFValuesContributingToOutputRec(
     // Handle control dependence of this constant argument highest legal
     // "definition" point.
     pBB = pDefDomNode->getBlock();
-    const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
-    for (BasicBlock *B : CtrlDepSet) {
-      CollectValuesContributingToOutputRec(Entry, B->getTerminator(),
-                                           ContributingInstructions);
+    for (BasicBlock *B : pFuncInfo->CtrlDep.GetCDBlocks(pBB)) {
+      if (Instruction *I =
+              GetContributingInstruction(Entry, B->getTerminator()))
+        ContributingInstructions.push_back(I);
     }
   }
 }
@@ -838,102 +952,114 @@ void DxilViewIdStateBuilder::CollectStoresRec(llvm::Value *pValue,
   }
 }
 
+// Sets the bits of pRow for what pInst reads from the signatures or ViewID.
+void DxilViewIdStateBuilder::AddLeafContribution(Instruction *pInst,
+                                                 uint64_t *pRow) {
+  const ShaderModel *pSM = m_pModule->GetShaderModel();
+
+  // Set output dependence on ViewId.
+  if (DxilInst_ViewID VID = DxilInst_ViewID(pInst)) {
+    DXASSERT(m_bUsesViewId, "otherwise, DxilModule flag not set properly");
+    pRow[kViewIdBit / 64] |= 1ULL << (kViewIdBit % 64);
+    return;
+  }
+
+  // Start setting output dependence on inputs.
+  DxilSignatureElement *pSigElem = nullptr;
+  unsigned BaseBit = kInputBit;
+  unsigned inpId = (unsigned)-1;
+  int startRow = Semantic::kUndefinedRow, endRow = Semantic::kUndefinedRow;
+  unsigned col = (unsigned)-1;
+  if (DxilInst_LoadInput LI = DxilInst_LoadInput(pInst)) {
+    GetUnsignedVal(LI.get_inputSigId(), &inpId);
+    GetUnsignedVal(LI.get_colIndex(), &col);
+    GetUnsignedVal(LI.get_rowIndex(), (uint32_t *)&startRow);
+    pSigElem = &m_pModule->GetInputSignature().GetElement(inpId);
+  } else if (DxilInst_LoadOutputControlPoint LOCP =
+                 DxilInst_LoadOutputControlPoint(pInst)) {
+    GetUnsignedVal(LOCP.get_inputSigId(), &inpId);
+    GetUnsignedVal(LOCP.get_col(), &col);
+    GetUnsignedVal(LOCP.get_row(), (uint32_t *)&startRow);
+    if (pSM->IsHS()) {
+      pSigElem = &m_pModule->GetOutputSignature().GetElement(inpId);
+      BaseBit = kOutputCPBit;
+    } else if (pSM->IsDS()) {
+      pSigElem = &m_pModule->GetInputSignature().GetElement(inpId);
+    } else {
+      DXASSERT_NOMSG(false);
+    }
+  } else if (DxilInst_LoadPatchConstant LPC =
+                 DxilInst_LoadPatchConstant(pInst)) {
+    if (pSM->IsDS()) {
+      GetUnsignedVal(LPC.get_inputSigId(), &inpId);
+      GetUnsignedVal(LPC.get_col(), &col);
+      GetUnsignedVal(LPC.get_row(), (uint32_t *)&startRow);
+      pSigElem = &m_pModule->GetPatchConstOrPrimSignature().GetElement(inpId);
+      BaseBit = kPCInputBit;
+    }
+  }
+
+  // Finalize setting output dependence on inputs.
+  if (pSigElem && pSigElem->IsAllocated()) {
+    if (startRow != Semantic::kUndefinedRow) {
+      endRow = startRow;
+    } else {
+      // The entire column contributes to output.
+      startRow = 0;
+      endRow = pSigElem->GetRows() - 1;
+    }
+
+    for (int row = startRow; row <= endRow; row++) {
+      unsigned Bit = BaseBit + GetLinearIndex(*pSigElem, row, col);
+      pRow[Bit / 64] |= 1ULL << (Bit % 64);
+    }
+  }
+}
+
 void DxilViewIdStateBuilder::CreateViewIdSets(
-    const std::unordered_map<unsigned, InstructionSetType>
-        &ContributingInstructions,
+    const std::vector<uint64_t> &OutputContributions,
     OutputsDependentOnViewIdType &OutputsDependentOnViewId,
     InputsContributingToOutputType &InputsContributingToOutputs, bool bPC) {
   const ShaderModel *pSM = m_pModule->GetShaderModel();
-
-  for (auto &itOut : ContributingInstructions) {
-    unsigned outIdx = itOut.first;
-    for (Instruction *pInst : itOut.second) {
-      // Set output dependence on ViewId.
-      if (DxilInst_ViewID VID = DxilInst_ViewID(pInst)) {
-        DXASSERT(m_bUsesViewId, "otherwise, DxilModule flag not set properly");
-        OutputsDependentOnViewId[outIdx] = true;
-        continue;
+  // Outputs of the DS depend on patch constants through LoadPatchConstant;
+  // the other inputs are only counted towards the other outputs.
+  unsigned InputBit = (pSM->IsDS() && bPC) ? kPCInputBit : kInputBit;
+
+  for (unsigned outIdx = 0; outIdx < kMaxSigScalars; outIdx++) {
+    const uint64_t *pRow = &OutputContributions[outIdx * kRowWords];
+    if (TestBit(pRow, kViewIdBit))
+      OutputsDependentOnViewId[outIdx] = true;
+
+    uint64_t Inputs[kSigWords];
+    for (unsigned i = 0; i < kSigWords; i++)
+      Inputs[i] = pRow[InputBit / 64 + i];
+
+    for (unsigned i = 0; i < kSigWords; i++) {
+      for (uint64_t Word = pRow[kOutputCPBit / 64 + i]; Word != 0;
+           Word &= Word - 1) {
+        unsigned index = i * 64 + countTrailingZeros(Word);
+        // This HS patch-constant output depends on an input value of
+        // LoadOutputControlPoint that is the output value of the HS main
+        // (control-point) function. Transitively update this
+        // (patch-constant) output dependence on main (control-point) output.
+        DXASSERT_NOMSG(&OutputsDependentOnViewId ==
+                       &m_PCOrPrimOutputsDependentOnViewId);
+        OutputsDependentOnViewId[outIdx] =
+            OutputsDependentOnViewId[outIdx] ||
+            m_OutputsDependentOnViewId[0][index];
+        const uint64_t *pCPRow =
+            &m_Entry.OutputContributions[0][index * kRowWords];
+        OrWords(Inputs, &pCPRow[kInputBit / 64], kSigWords);
       }
+    }
 
-      // Start setting output dependence on inputs.
-      DxilSignatureElement *pSigElem = nullptr;
-      bool bLoadOutputCPInHS = false;
-      unsigned inpId = (unsigned)-1;
-      int startRow = Semantic::kUndefinedRow, endRow = Semantic::kUndefinedRow;
-      unsigned col = (unsigned)-1;
-      if (DxilInst_LoadInput LI = DxilInst_LoadInput(pInst)) {
-        GetUnsignedVal(LI.get_inputSigId(), &inpId);
-        GetUnsignedVal(LI.get_colIndex(), &col);
-        GetUnsignedVal(LI.get_rowIndex(), (uint32_t *)&startRow);
-        pSigElem = &m_pModule->GetInputSignature().GetElement(inpId);
-        if (pSM->IsDS() && bPC) {
-          pSigElem = nullptr;
-        }
-      } else if (DxilInst_LoadOutputControlPoint LOCP =
-                     DxilInst_LoadOutputControlPoint(pInst)) {
-        GetUnsignedVal(LOCP.get_inputSigId(), &inpId);
-        GetUnsignedVal(LOCP.get_col(), &col);
-        GetUnsignedVal(LOCP.get_row(), (uint32_t *)&startRow);
-        if (pSM->IsHS()) {
-          pSigElem = &m_pModule->GetOutputSignature().GetElement(inpId);
-          bLoadOutputCPInHS = true;
-        } else if (pSM->IsDS()) {
-          if (!bPC) {
-            pSigElem = &m_pModule->GetInputSignature().GetElement(inpId);
-          }
-        } else {
-          DXASSERT_NOMSG(false);
-        }
-      } else if (DxilInst_LoadPatchConstant LPC =
-                     DxilInst_LoadPatchConstant(pInst)) {
-        if (pSM->IsDS() && bPC) {
-          GetUnsignedVal(LPC.get_inputSigId(), &inpId);
-          GetUnsignedVal(LPC.get_col(), &col);
-          GetUnsignedVal(LPC.get_row(), (uint32_t *)&startRow);
-          pSigElem =
-              &m_pModule->GetPatchConstOrPrimSignature().GetElement(inpId);
-        }
-      } else {
-        continue;
-      }
-
-      // Finalize setting output dependence on inputs.
-      if (pSigElem && pSigElem->IsAllocated()) {
-        if (startRow != Semantic::kUndefinedRow) {
-          endRow = startRow;
-        } else {
-          // The entire column contributes to output.
-          startRow = 0;
-          endRow = pSigElem->GetRows() - 1;
-        }
-
-        auto &ContributingInputs = InputsContributingToOutputs[outIdx];
-        for (int row = startRow; row <= endRow; row++) {
-          unsigned index = GetLinearIndex(*pSigElem, row, col);
-          if (!bLoadOutputCPInHS) {
-            ContributingInputs.emplace(index);
-          } else {
-            // This HS patch-constant output depends on an input value of
-            // LoadOutputControlPoint that is the output value of the HS main
-            // (control-point) function. Transitively update this
-            // (patch-constant) output dependence on main (control-point)
-            // output.
-            DXASSERT_NOMSG(&OutputsDependentOnViewId ==
-                           &m_PCOrPrimOutputsDependentOnViewId);
-            OutputsDependentOnViewId[outIdx] =
-                OutputsDependentOnViewId[outIdx] ||
-                m_OutputsDependentOnViewId[0][index];
-
-            const auto it = m_InputsContributingToOutputs[0].find(index);
-            if (it != m_InputsContributingToOutputs[0].end()) {
-              const std::set<unsigned>
-                  &LoadOutputCPInputsContributingToOutputs = it->second;
-              ContributingInputs.insert(
-                  LoadOutputCPInputsContributingToOutputs.begin(),
-                  LoadOutputCPInputsContributingToOutputs.end());
-            }
-          }
-        }
+    std::set<unsigned> *pContributingInputs = nullptr;
+    for (unsigned i = 0; i < kSigWords; i++) {
+      for (uint64_t Word = Inputs[i]; Word != 0; Word &= Word - 1) {
+        if (!pContributingInputs)
+          pContributingInputs = &InputsContributingToOutputs[outIdx];
+        unsigned index = i * 64 + countTrailingZeros(Word);
+        pContributingInputs->emplace_hint(pContributingInputs->end(), index);
       }
     }
   }
@@ -13,26 +13,34 @@
 
 #include "dxc/HLSL/ControlDependence.h"
 #include "dxc/Support/Global.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Function.h"
 #include "llvm/Support/Debug.h"
 
 using namespace llvm;
 using namespace hlsl;
 
-const BasicBlockSet &ControlDependence::GetCDBlocks(BasicBlock *pBB) const {
-  auto it = m_ControlDependence.find(pBB);
-  if (it != m_ControlDependence.end())
-    return it->second;
-  else
-    return m_EmptyBBSet;
+const unsigned ControlDependence::kNoBlock;
+
+ControlDependence::BlockRange
+ControlDependence::GetCDBlocks(BasicBlock *pBB) const {
+  const BlockRow *pRow = &m_EmptyRow;
+  auto it = m_BlockIndex.find(pBB);
+  if (it != m_BlockIndex.end())
+    pRow = &GetRow(it->second);
+  return BlockRange(BlockIterator(pRow->begin(), &m_Blocks),
+                    BlockIterator(pRow->end(), &m_Blocks));
 }
 
 void ControlDependence::print(raw_ostream &OS) {
   OS << "Control dependence for function '" << m_pFunc->getName() << "'\n";
-  for (auto &it : m_ControlDependence) {
-    BasicBlock *pBB = it.first;
+  for (BasicBlock *pBB : m_Blocks) {
+    BlockRange CDBlocks = GetCDBlocks(pBB);
+    if (CDBlocks.begin() == CDBlocks.end())
+      continue;
     OS << "Block " << pBB->getName() << ": { ";
     bool bFirst = true;
-    for (BasicBlock *pBB2 : it.second) {
+    for (BasicBlock *pBB2 : CDBlocks) {
       if (!bFirst)
         OS << ", ";
       OS << pBB2->getName();
@@ -46,80 +54,105 @@ void ControlDependence::print(raw_ostream &OS) {
 void ControlDependence::dump() { print(dbgs()); }
 
 void ControlDependence::Compute(Function *F, PostDomRelationType &PostDomRel) {
+  Clear();
   m_pFunc = F;
 
-  // Compute reverse topological order of PDT.
-  BasicBlockVector RevTopOrder;
-  BasicBlockSet VisitedBBs;
-  for (BasicBlock *pBB : PostDomRel.getRoots()) {
-    ComputeRevTopOrderRec(PostDomRel, pBB, RevTopOrder, VisitedBBs);
+  unsigned NumBlocks = 0;
+  for (BasicBlock &BB : *F) {
+    m_Blocks.push_back(&BB);
+    m_BlockIndex[&BB] = NumBlocks++;
   }
-  DXASSERT_NOMSG(RevTopOrder.size() == VisitedBBs.size());
-
-  // Compute control dependence relation.
-  for (size_t iBB = 0; iBB < RevTopOrder.size(); iBB++) {
-    BasicBlock *x = RevTopOrder[iBB];
-
-    // For each y = pred(x): if ipostdom(y) != x then add "x is control
-    // dependent on y"
-    for (auto itPred = pred_begin(x), endPred = pred_end(x); itPred != endPred;
-         ++itPred) {
-      BasicBlock *y = *itPred; // predecessor of x
-      BasicBlock *pPredIDomBB = GetIPostDom(PostDomRel, y);
-      if (pPredIDomBB != x) {
-        m_ControlDependence[x].insert(y);
-      }
-    }
 
-    // For all z such that ipostdom(z) = x
-    for (DomTreeNode *child : PostDomRel.getNode(x)->getChildren()) {
-      BasicBlock *z = child->getBlock();
-
-      auto it = m_ControlDependence.find(z);
-      if (it == m_ControlDependence.end())
-        continue;
+  // Only blocks in the subtrees of the roots have control dependences. Blocks
+  // that cannot reach an exit are not in the tree, and blocks that are only
+  // post dominated by the virtual root of a function with several exits are
+  // not below any root.
+  BitVector InRootSubtree(NumBlocks);
+  for (BasicBlock *pRootBB : PostDomRel.getRoots()) {
+    SmallVector<BasicBlock *, 8> Descendants;
+    PostDomRel.getDescendants(pRootBB, Descendants);
+    for (BasicBlock *pDescBB : Descendants)
+      InRootSubtree.set(m_BlockIndex[pDescBB]);
+  }
 
-      // For all y in CDG(z)
-      for (BasicBlock *y : it->second) {
-        // if ipostdom(y) != x then add "x is control dependent on y"
-        BasicBlock *pPredIDomBB = GetIPostDom(PostDomRel, y);
-        if (pPredIDomBB != x) {
-          m_ControlDependence[x].insert(y);
-        }
-      }
-    }
+  // Record the post dominator tree by block number.
+  m_IPostDom.assign(NumBlocks, kNoBlock);
+  m_PostDomChildBegin.assign(NumBlocks + 1, 0);
+  m_ControlDependence.assign(NumBlocks, BlockRow());
+  m_Computed.resize(NumBlocks);
+  for (unsigned i = 0; i < NumBlocks; i++) {
+    m_PostDomChildBegin[i] = m_PostDomChildren.size();
+    if (!InRootSubtree.test(i))
+      m_Computed.set(i);
+    DomTreeNode *pNode = PostDomRel.getNode(m_Blocks[i]);
+    if (pNode == nullptr)
+      continue;
+    DomTreeNode *pIDomNode = pNode->getIDom();
+    if (pIDomNode != nullptr && pIDomNode->getBlock() != nullptr)
+      m_IPostDom[i] = m_BlockIndex[pIDomNode->getBlock()];
+    for (DomTreeNode *pChild : pNode->getChildren())
+      m_PostDomChildren.push_back(m_BlockIndex[pChild->getBlock()]);
   }
+  m_PostDomChildBegin[NumBlocks] = m_PostDomChildren.size();
 }
 
 void ControlDependence::Clear() {
   m_pFunc = nullptr;
+  m_Blocks.clear();
+  m_BlockIndex.clear();
+  m_IPostDom.clear();
+  m_PostDomChildBegin.clear();
+  m_PostDomChildren.clear();
   m_ControlDependence.clear();
-  m_EmptyBBSet.clear();
+  m_Computed.clear();
 }
 
-BasicBlock *ControlDependence::GetIPostDom(PostDomRelationType &PostDomRel,
-                                           BasicBlock *pBB) {
-  auto *pPDTNode = PostDomRel.getNode(pBB);
-  auto *pIDomNode = pPDTNode->getIDom();
-  BasicBlock *pIDomBB = pIDomNode != nullptr ? pIDomNode->getBlock() : nullptr;
-  return pIDomBB;
+// The row of a block is derived from the rows of its children in the post
+// dominator tree, so compute the missing rows of the subtree bottom up.
+const ControlDependence::BlockRow &
+ControlDependence::GetRow(unsigned BlockIdx) const {
+  if (!m_Computed.test(BlockIdx)) {
+    // Pairs of a block and the next of its children to visit.
+    SmallVector<std::pair<unsigned, unsigned>, 16> Stack;
+    Stack.emplace_back(BlockIdx, m_PostDomChildBegin[BlockIdx]);
+    while (!Stack.empty()) {
+      unsigned x = Stack.back().first;
+      unsigned &NextChild = Stack.back().second;
+      if (NextChild < m_PostDomChildBegin[x + 1]) {
+        unsigned z = m_PostDomChildren[NextChild++];
+        if (!m_Computed.test(z))
+          Stack.emplace_back(z, m_PostDomChildBegin[z]);
+        continue;
+      }
+      ComputeRow(x);
+      m_Computed.set(x);
+      Stack.pop_back();
+    }
+  }
+  return m_ControlDependence[BlockIdx];
 }
 
-void ControlDependence::ComputeRevTopOrderRec(PostDomRelationType &PostDomRel,
-                                              BasicBlock *pBB,
-                                              BasicBlockVector &RevTopOrder,
-                                              BasicBlockSet &VisitedBBs) {
-  if (VisitedBBs.find(pBB) != VisitedBBs.end()) {
-    return;
-  }
-  VisitedBBs.insert(pBB);
+void ControlDependence::ComputeRow(unsigned x) const {
+  BlockRow &Row = m_ControlDependence[x];
 
-  SmallVector<BasicBlock *, 8> Descendants;
-  PostDomRel.getDescendants(pBB, Descendants);
-  for (BasicBlock *pDescBB : Descendants) {
-    if (pDescBB != pBB)
-      ComputeRevTopOrderRec(PostDomRel, pDescBB, RevTopOrder, VisitedBBs);
+  // For each y = pred(x): if ipostdom(y) != x then add "x is control
+  // dependent on y"
+  for (BasicBlock *pPredBB : predecessors(m_Blocks[x])) {
+    unsigned y = m_BlockIndex.lookup(pPredBB);
+    if (m_IPostDom[y] != x)
+      Row.set(y);
   }
 
-  RevTopOrder.emplace_back(pBB);
+  // For all z such that ipostdom(z) = x
+  for (unsigned i = m_PostDomChildBegin[x]; i < m_PostDomChildBegin[x + 1];
+       i++) {
+    unsigned z = m_PostDomChildren[i];
+    DXASSERT_NOMSG(m_Computed.test(z));
+    // For all y in CDG(z)
+    for (unsigned y : m_ControlDependence[z]) {
+      // if ipostdom(y) != x then add "x is control dependent on y"
+      if (m_IPostDom[y] != x)
+        Row.set(y);
+    }
+  }
 }
@@ -2294,14 +2294,9 @@ HRESULT DxilModuleReflection::LoadProgramHeader(
     auto errorHandler = [&bBitcodeLoadError](const DiagnosticInfo &diagInfo) {
       bBitcodeLoadError |= diagInfo.getSeverity() == DS_Error;
     };
-#if 0 // We materialize eagerly, because we'll need to walk instructions to look
-      // for usage information.
+    // Reflection is built from metadata, so load function bodies lazily.
     ErrorOr<std::unique_ptr<Module>> mod =
         getLazyBitcodeModule(std::move(pMemBuffer), Context, errorHandler);
-#else
-    ErrorOr<std::unique_ptr<Module>> mod =
-        parseBitcodeFile(pMemBuffer->getMemBufferRef(), Context, errorHandler);
-#endif
     if (!mod || bBitcodeLoadError) {
       return E_INVALIDARG;
     }
@@ -2313,6 +2308,13 @@ HRESULT DxilModuleReflection::LoadProgramHeader(
     m_bUsageInMetadata =
         hlsl::DXIL::CompareVersions(ValMajor, ValMinor, 1, 5) >= 0;
 
+    // Before validator 1.5, usage information isn't in metadata and we need
+    // to walk instructions to look for it.
+    if (!m_bUsageInMetadata) {
+      if (m_pModule->materializeAllPermanently() || bBitcodeLoadError)
+        return E_INVALIDARG;
+    }
+
     CreateReflectionObjects();
     return S_OK;
   }
@@ -27,12 +27,19 @@
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/LLVMContext.h"
@@ -110,7 +117,7 @@ struct DxilFunctionLinkInfo {
 class DxilLib {
 
 public:
-  DxilLib(std::unique_ptr<llvm::Module> pModule);
+  DxilLib(std::unique_ptr<llvm::Module> pModule, StringRef bitcode);
   virtual ~DxilLib() {}
   bool HasFunction(std::string &name);
   llvm::StringMap<std::unique_ptr<DxilFunctionLinkInfo>> &GetFunctionTable() {
@@ -122,6 +129,8 @@ public:
   DxilResourceBase *GetResource(const llvm::Constant *GV);
 
   DxilModule &GetDxilModule() { return m_DM; }
+  // Bitcode the module was loaded from, if known.
+  StringRef GetBitcode() { return m_bitcode; }
   void LazyLoadFunction(Function *F);
   void BuildGlobalUsage();
   void CollectUsedInitFunctions(SetVector<StringRef> &addedFunctionSet,
@@ -132,6 +141,7 @@ public:
 private:
   std::unique_ptr<llvm::Module> m_pModule;
   DxilModule &m_DM;
+  StringRef m_bitcode;
   // Map from name to Link info for extern functions.
   llvm::StringMap<std::unique_ptr<DxilFunctionLinkInfo>> m_functionNameMap;
   llvm::SmallPtrSet<llvm::Function *, 4> m_entrySet;
@@ -152,15 +162,21 @@ public:
   virtual ~DxilLinkerImpl() {}
   bool HasLibNameRegistered(StringRef name) override;
   bool RegisterLib(StringRef name, std::unique_ptr<llvm::Module> pModule,
-                   std::unique_ptr<llvm::Module> pDebugModule) override;
+                   std::unique_ptr<llvm::Module> pDebugModule,
+                   StringRef bitcode) override;
   bool AttachLib(StringRef name) override;
   bool DetachLib(StringRef name) override;
   void DetachAll() override;
 
   std::unique_ptr<llvm::Module> Link(StringRef entry, StringRef profile,
                                      dxilutil::ExportMap &exportMap) override;
+  bool LinkEntries(MutableArrayRef<DxilLinkEntry> entries,
+                   unsigned maxThreads) override;
 
 private:
+  void LinkEntryInOwnContext(
+      DxilLinkEntry &entry,
+      ArrayRef<std::pair<StringRef, StringRef>> libBitcode);
   bool AttachLib(DxilLib *lib);
   bool DetachLib(DxilLib *lib);
   bool AddFunctions(SmallVector<StringRef, 4> &workList,
@@ -172,6 +188,8 @@ private:
   std::unordered_set<DxilLib *> m_attachedLibs;
   // Owner of all DxilLib.
   StringMap<std::unique_ptr<DxilLib>> m_LibMap;
+  // Names of registered libs, in registration order.
+  std::vector<std::string> m_LibNames;
   llvm::StringMap<std::pair<DxilFunctionLinkInfo *, DxilLib *>>
       m_functionNameMap;
 };
@@ -191,8 +209,9 @@ DxilFunctionLinkInfo::DxilFunctionLinkInfo(Function *F) : func(F) {
 // DxilLib methods.
 //
 
-DxilLib::DxilLib(std::unique_ptr<llvm::Module> pModule)
-    : m_pModule(std::move(pModule)), m_DM(m_pModule->GetOrCreateDxilModule()) {
+DxilLib::DxilLib(std::unique_ptr<llvm::Module> pModule, StringRef bitcode)
+    : m_pModule(std::move(pModule)), m_DM(m_pModule->GetOrCreateDxilModule()),
+      m_bitcode(bitcode) {
   Module &M = *m_pModule;
   const std::string MID = (Twine(M.getModuleIdentifier()) + ".").str();
 
@@ -412,6 +431,11 @@ const char kExportNameCollision[] =
     "Export name collides with another export: ";
 const char kExportFunctionMissing[] = "Could not find target for export: ";
 const char kNoFunctionsToExport[] = "Library has no functions to export";
+const char kInvalidProfileToLinkEntries[] =
+    "Cannot link entries separately for profile ";
+const char kNoLibBitcode[] =
+    "Library was registered without bitcode to link entries from: ";
+const char kLoadLibFailed[] = "Failed to load library ";
 } // namespace
 //------------------------------------------------------------------------------
 //
@@ -1300,7 +1324,8 @@ bool DxilLinkerImpl::HasLibNameRegistered(StringRef name) {
 
 bool DxilLinkerImpl::RegisterLib(StringRef name,
                                  std::unique_ptr<llvm::Module> pModule,
-                                 std::unique_ptr<llvm::Module> pDebugModule) {
+                                 std::unique_ptr<llvm::Module> pDebugModule,
+                                 StringRef bitcode) {
   if (m_LibMap.count(name))
     return false;
 
@@ -1311,8 +1336,10 @@ bool DxilLinkerImpl::RegisterLib(StringRef name,
     return false;
 
   pM->setModuleIdentifier(name);
-  std::unique_ptr<DxilLib> pLib = llvm::make_unique<DxilLib>(std::move(pM));
+  std::unique_ptr<DxilLib> pLib =
+      llvm::make_unique<DxilLib>(std::move(pM), bitcode);
   m_LibMap[name] = std::move(pLib);
+  m_LibNames.emplace_back(name);
   return true;
 }
 
@@ -1600,6 +1627,122 @@ DxilLinkerImpl::Link(StringRef entry, StringRef profile,
   }
 }
 
+void DxilLinkerImpl::LinkEntryInOwnContext(
+    DxilLinkEntry &entry,
+    ArrayRef<std::pair<StringRef, StringRef>> libBitcode) {
+  entry.pContext = llvm::make_unique<LLVMContext>();
+  LLVMContext &Ctx = *entry.pContext;
+  raw_string_ostream DiagStream(entry.Diagnostics);
+  DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+  Ctx.setDiagnosticHandler(dxilutil::PrintDiagnosticHandler, &DiagPrinter,
+                           true);
+
+  {
+    // Register the libs in the same order as this linker did, so that types
+    // loaded under the same name are renamed the same way.
+    DxilLinkerImpl linker(Ctx, m_valMajor, m_valMinor);
+    bool bSuccess = true;
+    for (auto &it : libBitcode) {
+      ErrorOr<std::unique_ptr<Module>> pM = getLazyBitcodeModule(
+          MemoryBuffer::getMemBuffer(it.second, it.first,
+                                     /*RequiresNullTerminator*/ false),
+          Ctx, nullptr, /*ShouldLazyLoadMetadata*/ false,
+          /*ShouldTrackBitstreamUsage*/ true);
+      if (std::error_code EC = pM.getError()) {
+        dxilutil::EmitErrorOnContext(
+            Ctx, Twine(kLoadLibFailed) + it.first + ": " + EC.message());
+        bSuccess = false;
+        break;
+      }
+      linker.RegisterLib(it.first, std::move(pM.get()), nullptr, it.second);
+      bSuccess &= linker.AttachLib(it.first);
+    }
+    if (bSuccess) {
+      dxilutil::ExportMap exportMap;
+      entry.pModule = linker.Link(entry.Entry, entry.Profile, exportMap);
+    }
+  }
+
+  DiagStream.flush();
+  Ctx.setDiagnosticHandler(nullptr, nullptr);
+}
+
+bool DxilLinkerImpl::LinkEntries(MutableArrayRef<DxilLinkEntry> entries,
+                                 unsigned maxThreads) {
+  for (DxilLinkEntry &entry : entries) {
+    const ShaderModel *pSM = ShaderModel::GetByName(entry.Profile.c_str());
+    DXIL::ShaderKind kind = pSM->GetKind();
+    if (kind == DXIL::ShaderKind::Invalid ||
+        kind == DXIL::ShaderKind::Library ||
+        (kind >= DXIL::ShaderKind::RayGeneration &&
+         kind <= DXIL::ShaderKind::Callable)) {
+      dxilutil::EmitErrorOnContext(
+          m_ctx, Twine(kInvalidProfileToLinkEntries) + entry.Profile);
+      return false;
+    }
+  }
+
+  // Modules cannot be shared across contexts. Every entry loads the attached
+  // libs again from the bitcode they were registered with; lazy loading only
+  // reads the functions that entry uses.
+  std::vector<std::pair<StringRef, StringRef>> libBitcode;
+  for (const std::string &name : m_LibNames) {
+    DxilLib *pLib = m_LibMap[name].get();
+    if (!m_attachedLibs.count(pLib))
+      continue;
+    if (pLib->GetBitcode().empty()) {
+      dxilutil::EmitErrorOnContext(m_ctx, Twine(kNoLibBitcode) + name);
+      return false;
+    }
+    libBitcode.emplace_back(name, pLib->GetBitcode());
+  }
+
+  unsigned NumWorkers = maxThreads;
+  if (NumWorkers == 0)
+    NumWorkers = std::thread::hardware_concurrency();
+  NumWorkers = std::max(1u, std::min<unsigned>(NumWorkers, entries.size()));
+
+  IMalloc *pMalloc = DxcGetThreadMallocNoRef();
+  std::atomic<unsigned> NextEntry(0);
+  std::mutex ExceptionMutex;
+  std::exception_ptr WorkerException;
+  auto LinkNextEntries = [&]() {
+    DxcThreadMalloc TM(pMalloc);
+    try {
+      for (;;) {
+        unsigned Idx = NextEntry++;
+        if (Idx >= entries.size())
+          break;
+        LinkEntryInOwnContext(entries[Idx], libBitcode);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(ExceptionMutex);
+      if (!WorkerException)
+        WorkerException = std::current_exception();
+      NextEntry = entries.size();
+    }
+  };
+
+  // This thread is one of the workers.
+  std::vector<std::thread> Workers;
+  Workers.reserve(NumWorkers - 1);
+  try {
+    // The thread start state is freed on the worker after its allocator is
+    // uninstalled, so it must come from the default allocator.
+    DxcThreadMalloc TMDefault(nullptr);
+    while (Workers.size() < NumWorkers - 1)
+      Workers.emplace_back(LinkNextEntries);
+  } catch (...) {
+    // Link with the workers that did start.
+  }
+  LinkNextEntries();
+  for (std::thread &Worker : Workers)
+    Worker.join();
+  if (WorkerException)
+    std::rethrow_exception(WorkerException);
+  return true;
+}
+
 namespace hlsl {
 
 DxilLinker *DxilLinker::CreateLinker(LLVMContext &Ctx, unsigned valMajor,
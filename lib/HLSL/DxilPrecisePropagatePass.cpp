@@ -351,8 +351,7 @@ FuncInfo &DxilPrecisePropagatePass::GetFuncInfo(Function *F) {
 void DxilPrecisePropagatePass::PropagateCtrlDep(FuncInfo &FI, BasicBlock *BB) {
   if (Processed(BB))
     return;
-  const BasicBlockSet &CtrlDepSet = FI.CtrlDep.GetCDBlocks(BB);
-  for (BasicBlock *B : CtrlDepSet) {
+  for (BasicBlock *B : FI.CtrlDep.GetCDBlocks(BB)) {
     AddToWorkList(B->getTerminator());
   }
 }
@@ -82,7 +82,9 @@ private:
     DXIL::ResourceKind RK;
     Type *ResourceType;
   };
-  std::unordered_map<Value *, ResAttribute> HandleMetaMap;
+  // Attributes of each handle, decoded from its annotation on first use.
+  // Lowering a texture or buffer access asks for them several times.
+  DenseMap<Value *, ResAttribute> HandleMetaMap;
   std::unordered_set<Instruction *> &UpdateCounterSet;
   // Map from pointer of cbuffer to pointer of resource.
   // For cbuffer like this:
@@ -213,36 +215,31 @@ public:
 
 private:
   ResAttribute &FindCreateHandleResourceBase(Value *Handle) {
-    if (HandleMetaMap.count(Handle))
-      return HandleMetaMap[Handle];
+    auto It = HandleMetaMap.find(Handle);
+    if (It != HandleMetaMap.end())
+      return It->second;
 
-    // Add invalid first to avoid dead loop.
-    HandleMetaMap[Handle] = {
-        DXIL::ResourceClass::Invalid, DXIL::ResourceKind::Invalid,
-        StructType::get(Type::getVoidTy(HLM.GetCtx()), nullptr)};
     if (CallInst *CI = dyn_cast<CallInst>(Handle)) {
       hlsl::HLOpcodeGroup group =
           hlsl::GetHLOpcodeGroupByName(CI->getCalledFunction());
       if (group == HLOpcodeGroup::HLAnnotateHandle) {
-        Constant *Props = cast<Constant>(CI->getArgOperand(
-            HLOperandIndex::kAnnotateHandleResourcePropertiesOpIdx));
-        DxilResourceProperties RP =
-            resource_helper::loadPropsFromConstant(*Props);
+        DxilResourceProperties RP = GetResPropsFromAnnotateHandle(CI);
         Type *ResTy =
             CI->getArgOperand(HLOperandIndex::kAnnotateHandleResourceTypeOpIdx)
                 ->getType();
 
         ResAttribute Attrib = {RP.getResourceClass(), RP.getResourceKind(),
                                ResTy};
-
-        HandleMetaMap[Handle] = Attrib;
-        return HandleMetaMap[Handle];
+        return HandleMetaMap[Handle] = Attrib;
       }
     }
     dxilutil::EmitErrorOnContext(Handle->getContext(),
                                  "cannot map resource to handle.");
 
-    return HandleMetaMap[Handle];
+    ResAttribute Invalid = {
+        DXIL::ResourceClass::Invalid, DXIL::ResourceKind::Invalid,
+        StructType::get(Type::getVoidTy(HLM.GetCtx()), nullptr)};
+    return HandleMetaMap[Handle] = Invalid;
   }
   CallInst *FindCreateHandle(Value *handle,
                              std::unordered_set<Value *> &resSet) {
@@ -4077,10 +4074,10 @@ Value *GenerateRawBufLd(Value *handle, Value *bufIdx, Value *offset,
                         Constant *alignment);
 
 // Sets up arguments for buffer load call.
-static SmallVector<Value *, 10> GetBufLoadArgs(ResLoadHelper helper,
+static SmallVector<Value *, 10> GetBufLoadArgs(const ResLoadHelper &helper,
                                                HLResource::Kind RK,
-                                               IRBuilder<> Builder, Type *EltTy,
-                                               unsigned LdSize) {
+                                               IRBuilder<> &Builder,
+                                               Type *EltTy, unsigned LdSize) {
   OP::OpCode opcode = helper.opcode;
   llvm::Constant *opArg = Builder.getInt32((uint32_t)opcode);
 
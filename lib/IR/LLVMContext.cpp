@@ -177,6 +177,41 @@ void LLVMContext::emitError(const Twine &ErrorStr) {
 void LLVMContext::emitWarning(const Twine &WarningStr) {
   diagnose(DiagnosticInfoInlineAsm(WarningStr, DiagnosticSeverity::DS_Warning));
 }
+
+bool LLVMContext::resetForReuse() {
+  if (!pImpl->OwnedModules.empty() || !pImpl->ValueHandles.empty() ||
+      !pImpl->ValueNames.empty() || !pImpl->InstructionMetadata.empty() ||
+      !pImpl->FunctionMetadata.empty())
+    return false;
+
+  pImpl->InlineAsmDiagHandler = nullptr;
+  pImpl->InlineAsmDiagContext = nullptr;
+  pImpl->DiagnosticHandler = nullptr;
+  pImpl->DiagnosticContext = nullptr;
+  pImpl->RespectDiagnosticFilters = false;
+  pImpl->YieldCallback = nullptr;
+  pImpl->YieldOpaqueHandle = nullptr;
+
+  // Struct names are written to bitcode, and a name still taken would give
+  // the next module's type a numbered suffix instead.
+  SmallVector<StructType *, 64> NamedTypes;
+  for (auto &Entry : pImpl->NamedStructTypes)
+    NamedTypes.push_back(Entry.getValue());
+  for (StructType *ST : NamedTypes)
+    ST->setName("");
+  pImpl->NamedStructTypesUniqueID = 0;
+
+  // Every metadata kind is written to bitcode, in the order of registration.
+  SmallVector<StringRef, 32> KindNames;
+  getMDKindNames(KindNames);
+  for (unsigned ID = MD_dereferenceable_or_null + 1; ID < KindNames.size();
+       ++ID)
+    pImpl->CustomMDKindNames.erase(KindNames[ID]);
+
+  pImpl->DiscriminatorTable.clear();
+  pImpl->dropTriviallyDeadConstantArrays();
+  return true;
+}
 // HLSL Change End
 
 
@@ -17,6 +17,7 @@
 #include "llvm/IR/LegacyPassManagers.h"
 #include "llvm/IR/LegacyPassNameParser.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/PassProfiler.h" // HLSL Change
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
@@ -1583,6 +1584,7 @@ bool FPPassManager::runOnFunction(Function &F) {
     {
       PassManagerPrettyStackEntry X(FP, F);
       TimeRegion PassTimer(getPassTimer(FP));
+      PassProfileScope PassProfile(FP, F); // HLSL Change
 
       LocalChanged |= FP->runOnFunction(F);
     }
@@ -1665,6 +1667,7 @@ MPPassManager::runOnModule(Module &M) {
     {
       PassManagerPrettyStackEntry X(MP, M);
       TimeRegion PassTimer(getPassTimer(MP));
+      PassProfileScope PassProfile(MP, M); // HLSL Change
 
       LocalChanged |= MP->runOnModule(M);
     }
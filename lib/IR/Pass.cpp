@@ -17,6 +17,7 @@
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/LegacyPassNameParser.h"
+#include "llvm/IR/PassProfiler.h" // HLSL Change
 #include "llvm/PassRegistry.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
@@ -32,6 +33,7 @@ using namespace llvm;
 // Force out-of-line virtual method.
 Pass::~Pass() {
   delete Resolver;
+  passProfilerForgetPass(this); // HLSL Change
 }
 
 // HLSL Change Starts
@@ -0,0 +1,242 @@
+//===-- PassProfiler.cpp - Per-pass statistics profiler -------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// HLSL Change - new file.
+//
+/// \file Per-pass statistics profiler implementation.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/PassProfiler.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include <cassert>
+#include <cctype>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace llvm {
+
+LLVM_THREAD_LOCAL PassProfiler *PassProfilerInstance = nullptr;
+
+static std::string escapeString(StringRef Src) {
+  std::string OS;
+  for (const char &C : Src) {
+    switch (C) {
+    case '"':
+    case '\\':
+      OS += '\\';
+      OS += C;
+      break;
+    default:
+      if (std::isprint(C) != 0)
+        OS += C;
+    }
+  }
+  return OS;
+}
+
+static const char *getPassKindName(PassKind Kind) {
+  switch (Kind) {
+  case PT_BasicBlock:
+    return "basicblock";
+  case PT_Region:
+    return "region";
+  case PT_Loop:
+    return "loop";
+  case PT_Function:
+    return "function";
+  case PT_CallGraphSCC:
+    return "cgscc";
+  case PT_Module:
+    return "module";
+  case PT_PassManager:
+    return "passmanager";
+  }
+  return "unknown";
+}
+
+void PassProfileIRSize::add(const BasicBlock &BB) {
+  ++Blocks;
+  Instructions += BB.size();
+}
+
+void PassProfileIRSize::add(const Function &F) {
+  for (const BasicBlock &BB : F)
+    add(BB);
+}
+
+void PassProfileIRSize::add(const Module &M) {
+  for (const Function &F : M)
+    add(F);
+}
+
+namespace {
+
+typedef steady_clock::duration DurationType;
+
+} // namespace
+
+struct PassProfiler {
+  struct Entry {
+    std::string Name;
+    const char *Kind;
+    uint64_t Runs = 0;
+    DurationType Duration = DurationType::zero();
+    uint64_t AllocatedBytes = 0;
+    PassProfileIRSize Before;
+    PassProfileIRSize After;
+  };
+
+  // A pass run in progress. Nested runs charge their time and allocations to
+  // the enclosing frame so that they can be excluded from it.
+  struct Frame {
+    unsigned EntryIndex;
+    Module *M;
+    Function *F;
+    Optional<function_ref<void(PassProfileIRSize &)>> Measure;
+    time_point<steady_clock> Start;
+    uint64_t StartBytes;
+    DurationType ChildDuration;
+    uint64_t ChildBytes;
+  };
+
+  uint64_t allocatedBytes() const {
+    return AllocatedBytes ? AllocatedBytes() : 0;
+  }
+
+  static PassProfileIRSize measure(const Frame &Fr) {
+    PassProfileIRSize Size;
+    if (Fr.Measure)
+      (*Fr.Measure)(Size);
+    else if (Fr.F)
+      Size.add(*Fr.F);
+    else
+      Size.add(*Fr.M);
+    return Size;
+  }
+
+  void begin(Pass *P, Module *M, Function *F,
+             Optional<function_ref<void(PassProfileIRSize &)>> Measure) {
+    auto Inserted = EntryForPass.insert(
+        std::make_pair(P, static_cast<unsigned>(Entries.size())));
+    if (Inserted.second) {
+      Entries.emplace_back();
+      Entries.back().Name = P->getPassName();
+      Entries.back().Kind = getPassKindName(P->getPassKind());
+    }
+    Entry &E = Entries[Inserted.first->second];
+    ++E.Runs;
+
+    Frame Fr;
+    Fr.EntryIndex = Inserted.first->second;
+    Fr.M = M;
+    Fr.F = F;
+    Fr.Measure = Measure;
+    PassProfileIRSize Size = measure(Fr);
+    E.Before.Instructions += Size.Instructions;
+    E.Before.Blocks += Size.Blocks;
+    Fr.StartBytes = allocatedBytes();
+    Fr.ChildDuration = DurationType::zero();
+    Fr.ChildBytes = 0;
+    Fr.Start = steady_clock::now();
+    Stack.push_back(Fr);
+  }
+
+  void end() {
+    assert(!Stack.empty() && "Must call begin first");
+    Frame Fr = Stack.back();
+    Stack.pop_back();
+
+    DurationType Duration = steady_clock::now() - Fr.Start;
+    uint64_t Bytes = allocatedBytes() - Fr.StartBytes;
+    Entry &E = Entries[Fr.EntryIndex];
+    E.Duration += Duration - Fr.ChildDuration;
+    E.AllocatedBytes += Bytes - Fr.ChildBytes;
+    PassProfileIRSize Size = measure(Fr);
+    E.After.Instructions += Size.Instructions;
+    E.After.Blocks += Size.Blocks;
+
+    if (!Stack.empty()) {
+      Stack.back().ChildDuration += Duration;
+      Stack.back().ChildBytes += Bytes;
+    }
+  }
+
+  void Write(raw_ostream &OS) {
+    assert(Stack.empty() && "All passes should be done when calling Write");
+
+    OS << "{ \"passes\": [";
+    const char *Sep = "\n";
+    for (const Entry &E : Entries) {
+      OS << Sep << "{ \"name\":\"" << escapeString(E.Name)
+         << "\", \"kind\":\"" << E.Kind << "\", \"runs\":" << E.Runs
+         << ", \"wallTimeUs\":"
+         << duration_cast<microseconds>(E.Duration).count()
+         << ", \"instructionsBefore\":" << E.Before.Instructions
+         << ", \"instructionsAfter\":" << E.After.Instructions
+         << ", \"blocksBefore\":" << E.Before.Blocks
+         << ", \"blocksAfter\":" << E.After.Blocks;
+      if (AllocatedBytes)
+        OS << ", \"allocatedBytes\":" << E.AllocatedBytes;
+      OS << " }";
+      Sep = ",\n";
+    }
+    OS << "\n] }\n";
+  }
+
+  std::vector<Entry> Entries;
+  DenseMap<const Pass *, unsigned> EntryForPass;
+  std::vector<Frame> Stack;
+  std::function<uint64_t()> AllocatedBytes;
+};
+
+void passProfilerInitialize(std::function<uint64_t()> AllocatedBytes) {
+  assert(PassProfilerInstance == nullptr &&
+         "Profiler should not be initialized");
+  PassProfilerInstance = new PassProfiler();
+  PassProfilerInstance->AllocatedBytes = std::move(AllocatedBytes);
+}
+
+void passProfilerCleanup() {
+  delete PassProfilerInstance;
+  PassProfilerInstance = nullptr;
+}
+
+void passProfilerWrite(raw_ostream &OS) {
+  assert(PassProfilerInstance != nullptr && "Profiler object can't be null");
+  PassProfilerInstance->Write(OS);
+}
+
+void passProfilerForgetPass(const Pass *P) {
+  if (PassProfilerInstance != nullptr)
+    PassProfilerInstance->EntryForPass.erase(P);
+}
+
+void PassProfileScope::begin(
+    Pass *P, Module *M, Function *F,
+    Optional<function_ref<void(PassProfileIRSize &)>> Measure) {
+  // Pass managers only run other passes, which are profiled themselves.
+  if (P->getAsPMDataManager() != nullptr)
+    return;
+  PassProfilerInstance->begin(P, M, F, Measure);
+  Active = true;
+}
+
+void PassProfileScope::end() {
+  if (PassProfilerInstance != nullptr)
+    PassProfilerInstance->end();
+}
+
+} // namespace llvm
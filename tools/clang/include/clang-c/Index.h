@@ -1209,6 +1209,13 @@ enum CXTranslationUnit_Flags {
    */
   CXTranslationUnit_IncludeBriefCommentsInCodeCompletion = 0x80,
   CXTranslationUnit_UseCallerThread = 0x800, // HLSL Change - add a flag
+  // HLSL Change Starts - no support for PCH
+  /**
+   * \brief Used to indicate that the bodies of functions outside the main
+   * file should be skipped while parsing.
+   */
+  CXTranslationUnit_SkipIncludedFunctionBodies = 0x1000,
+  // HLSL Change Ends
 };
 
 /**
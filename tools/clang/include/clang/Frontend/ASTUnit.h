@@ -313,6 +313,13 @@ private:
   /// \brief True if non-system source files should be treated as volatile
   /// (likely to change while trying to use them).
   bool UserFilesAreVolatile : 1;
+
+  // HLSL Change Starts - no support for PCH
+  /// \brief True if only the bodies of functions in the main file are parsed.
+  /// This takes the place of a precompiled preamble: the declarations of the
+  /// included files are still available, but reparsing them is much cheaper.
+  bool SkipIncludedFunctionBodies : 1;
+  // HLSL Change Ends
  
   /// \brief The language options used when we load an AST file.
   LangOptions ASTFileLangOpts;
@@ -553,6 +560,11 @@ public:
   bool getOnlyLocalDecls() const { return OnlyLocalDecls; }
 
   bool getOwnsRemappedFileBuffers() const { return OwnsRemappedFileBuffers; }
+  // HLSL Change Starts - no support for PCH
+  bool getSkipIncludedFunctionBodies() const {
+    return SkipIncludedFunctionBodies;
+  }
+  // HLSL Change Ends
   void setOwnsRemappedFileBuffers(bool val) { OwnsRemappedFileBuffers = val; }
 
   StringRef getMainFileName() const;
@@ -863,7 +875,8 @@ public:
       bool AllowPCHWithCompilerErrors = false, bool SkipFunctionBodies = false,
       bool UserFilesAreVolatile = false, bool ForSerialization = false,
       std::unique_ptr<ASTUnit> *ErrAST = nullptr,
-      hlsl::DxcLangExtensionsHelperApply *HlslLangExtensions = nullptr); // HLSL Change
+      hlsl::DxcLangExtensionsHelperApply *HlslLangExtensions = nullptr, // HLSL Change
+      bool SkipIncludedFunctionBodies = false); // HLSL Change
 
   /// \brief Reparse the source files using the same command-line options that
   /// were originally used to produce this translation unit.
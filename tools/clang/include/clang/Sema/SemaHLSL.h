@@ -71,6 +71,14 @@ void DiagnoseRegisterType(clang::Sema *self, clang::SourceLocation loc,
 
 void DiagnoseTranslationUnit(clang::Sema *self);
 
+// Collects the functions exported by a library translation unit, each paired
+// with the function definitions reachable from it (itself included) through
+// calls in its body or in global initializers.
+void GetExportedFunctionCallees(
+    clang::Sema *self,
+    std::vector<std::pair<clang::FunctionDecl *,
+                          std::vector<clang::FunctionDecl *>>> &Exports);
+
 void DiagnoseUnusualAnnotationsForHLSL(
     clang::Sema &S, std::vector<hlsl::UnusualAnnotation *> &annotations);
 
@@ -215,6 +215,7 @@ ASTUnit::ASTUnit(bool _MainFileIsAST)
     NumWarningsInPreamble(0),
     ShouldCacheCodeCompletionResults(false),
     IncludeBriefCommentsInCodeCompletion(false), UserFilesAreVolatile(false),
+    SkipIncludedFunctionBodies(false), // HLSL Change
     CompletionCacheTopLevelHashValue(0),
     PreambleTopLevelHashValue(0),
     CurrentTopLevelHashValue(0),
@@ -876,6 +877,14 @@ public:
   // We're not interested in "interesting" decls.
   void HandleInterestingDecl(DeclGroupRef) override {}
 
+  // HLSL Change Starts - no support for PCH
+  bool shouldSkipFunctionBody(Decl *D) override {
+    if (!Unit.getSkipIncludedFunctionBodies())
+      return true;
+    return !Unit.getSourceManager().isInMainFile(D->getLocation());
+  }
+  // HLSL Change Ends
+
   void HandleTopLevelDeclInObjCContainer(DeclGroupRef D) override {
     for (Decl *TopLevelDecl : D)
       handleTopLevelDecl(TopLevelDecl);
@@ -1975,7 +1984,8 @@ ASTUnit *ASTUnit::LoadFromCommandLine(
     bool AllowPCHWithCompilerErrors, bool SkipFunctionBodies,
     bool UserFilesAreVolatile, bool ForSerialization,
     std::unique_ptr<ASTUnit> *ErrAST,
-    hlsl::DxcLangExtensionsHelperApply *HlslLangExtensions) { // HLSL Change
+    hlsl::DxcLangExtensionsHelperApply *HlslLangExtensions, // HLSL Change
+    bool SkipIncludedFunctionBodies) { // HLSL Change
   assert(Diags.get() && "no DiagnosticsEngine was provided");
 
   SmallVector<StoredDiagnostic, 4> StoredDiagnostics;
@@ -2042,6 +2052,15 @@ ASTUnit *ASTUnit::LoadFromCommandLine(
   // Create the AST unit.
   std::unique_ptr<ASTUnit> AST;
   AST.reset(new ASTUnit(false));
+  // HLSL Change Starts - no support for PCH
+  // Without a precompiled preamble, every reparse parses the included files
+  // again. When requested, parse only the declarations of the included files
+  // and keep function bodies for the main file.
+  if (SkipIncludedFunctionBodies && !SkipFunctionBodies) {
+    CI->getFrontendOpts().SkipFunctionBodies = true;
+    AST->SkipIncludedFunctionBodies = true;
+  }
+  // HLSL Change Ends
   // HLSL Change Starts
   AST->HlslLangExtensions = HlslLangExtensions;
   // Enable -verify and -verify-ignore-unexpected on the libclang initialization path.
@@ -886,10 +886,6 @@ void SpirvEmitter::HandleTranslationUnit(ASTContext &context) {
   if (context.getDiagnostics().hasErrorOccurred())
     return;
 
-  if (!UpgradeToVulkanMemoryModelIfNeeded(&m)) {
-    return;
-  }
-
   // Check the existance of Texture and Sampler with
   // [[vk::combinedImageSampler]] for the same descriptor set and binding.
   auto resourceInfoForSampledImages =
@@ -918,74 +914,12 @@ void SpirvEmitter::HandleTranslationUnit(ASTContext &context) {
       !dsetbindingsToCombineImageSampler.empty() ||
       spirvOptions.signaturePacking;
 
-  // Run legalization passes
-  if (spirvOptions.codeGenHighLevel) {
+  if (spirvOptions.codeGenHighLevel)
     beforeHlslLegalization = needsLegalization;
-  } else {
-    if (needsLegalization) {
-      std::string messages;
-      if (!spirvToolsLegalize(&m, &messages,
-                              &dsetbindingsToCombineImageSampler)) {
-        emitFatalError("failed to legalize SPIR-V: %0", {}) << messages;
-        emitNote("please file a bug report on "
-                 "https://github.com/Microsoft/DirectXShaderCompiler/issues "
-                 "with source code if possible",
-                 {});
-        return;
-      } else if (!messages.empty()) {
-        emitWarning("SPIR-V legalization: %0", {}) << messages;
-      }
-    }
 
-    if (theCompilerInstance.getCodeGenOpts().OptimizationLevel > 0) {
-      // Run optimization passes
-      std::string messages;
-      if (!spirvToolsOptimize(&m, &messages)) {
-        emitFatalError("failed to optimize SPIR-V: %0", {}) << messages;
-        emitNote("please file a bug report on "
-                 "https://github.com/Microsoft/DirectXShaderCompiler/issues "
-                 "with source code if possible",
-                 {});
-        return;
-      }
-    }
-
-    // Fixup debug instruction opcodes: change the opcode to
-    // OpExtInstWithForwardRefsKHR is the instruction at least one forward
-    // reference.
-    if (spirvOptions.debugInfoRich) {
-      std::string messages;
-      if (!spirvToolsFixupOpExtInst(&m, &messages)) {
-        emitFatalError("failed to fix OpExtInst opcodes: %0", {}) << messages;
-        emitNote("please file a bug report on "
-                 "https://github.com/Microsoft/DirectXShaderCompiler/issues "
-                 "with source code if possible",
-                 {});
-        return;
-      } else if (!messages.empty()) {
-        emitWarning("SPIR-V fix-opextinst-opcodes: %0", {}) << messages;
-      }
-    }
-
-    // Trim unused capabilities.
-    // When optimizations are enabled, some optimization passes like DCE could
-    // make some capabilities useless. To avoid logic duplication between this
-    // pass, and DXC, DXC generates some capabilities unconditionally. This
-    // means we should run this pass, even when optimizations are disabled.
-    {
-      std::string messages;
-      if (!spirvToolsTrimCapabilities(&m, &messages)) {
-        emitFatalError("failed to trim capabilities: %0", {}) << messages;
-        emitNote("please file a bug report on "
-                 "https://github.com/Microsoft/DirectXShaderCompiler/issues "
-                 "with source code if possible",
-                 {});
-        return;
-      } else if (!messages.empty()) {
-        emitWarning("SPIR-V capability trimming: %0", {}) << messages;
-      }
-    }
-  }
+  // Run memory model upgrade, legalization, optimization and the fixup passes.
+  if (!spirvToolsPostProcess(&m, &dsetbindingsToCombineImageSampler))
+    return;
 
   // Validate the generated SPIR-V code
   if (!spirvOptions.disableValidation) {
@@ -15079,159 +15013,234 @@ SpirvEmitter::createFunctionScopeTempFromParameter(const ParmVarDecl *param) {
   return tempVar;
 }
 
-bool SpirvEmitter::spirvToolsRunPass(std::vector<uint32_t> *mod,
-                                     spvtools::Optimizer::PassToken token,
-                                     std::string *messages) {
-  spvtools::Optimizer optimizer(featureManager.getTargetEnv());
-  optimizer.SetMessageConsumer(
-      [messages](spv_message_level_t /*level*/, const char * /*source*/,
-                 const spv_position_t & /*position*/,
-                 const char *message) { *messages += message; });
+bool SpirvEmitter::spirvToolsPostProcess(
+    std::vector<uint32_t> *mod,
+    const std::vector<DescriptorSetAndBinding>
+        *dsetbindingsToCombineImageSampler) {
+  std::vector<PostProcessStage> stages;
 
-  string::RawOstreamBuf printAllBuf(llvm::errs());
-  std::ostream printAllOS(&printAllBuf);
-  if (spirvOptions.printAll)
-    optimizer.SetPrintAll(&printAllOS);
-
-  spvtools::OptimizerOptions options;
-  options.set_run_validator(false);
-  options.set_preserve_bindings(spirvOptions.preserveBindings);
-  options.set_max_id_bound(spirvOptions.maxId);
+  // DXC generates code assuming the vulkan memory model is not used. However,
+  // if a feature is used that requires the Vulkan memory model, then some code
+  // may need to be rewritten.
+  if (spirvOptions.useVulkanMemoryModel ||
+      spvBuilder.hasCapability(spv::Capability::VulkanMemoryModel))
+    stages.push_back(PostProcessStage::UpgradeMemoryModel);
 
-  optimizer.RegisterPass(std::move(token));
-  return optimizer.Run(mod->data(), mod->size(), mod, options);
-}
+  if (!spirvOptions.codeGenHighLevel) {
+    if (needsLegalization)
+      stages.push_back(PostProcessStage::Legalize);
 
-bool SpirvEmitter::spirvToolsFixupOpExtInst(std::vector<uint32_t> *mod,
-                                            std::string *messages) {
-  spvtools::Optimizer::PassToken token =
-      spvtools::CreateOpExtInstWithForwardReferenceFixupPass();
-  return spirvToolsRunPass(mod, std::move(token), messages);
-}
+    if (theCompilerInstance.getCodeGenOpts().OptimizationLevel > 0)
+      stages.push_back(PostProcessStage::Optimize);
 
-bool SpirvEmitter::spirvToolsTrimCapabilities(std::vector<uint32_t> *mod,
-                                              std::string *messages) {
-  spvtools::Optimizer::PassToken token = spvtools::CreateTrimCapabilitiesPass();
-  return spirvToolsRunPass(mod, std::move(token), messages);
-}
+    // Fixup debug instruction opcodes: change the opcode to
+    // OpExtInstWithForwardRefsKHR is the instruction at least one forward
+    // reference.
+    if (spirvOptions.debugInfoRich)
+      stages.push_back(PostProcessStage::FixupOpExtInst);
 
-bool SpirvEmitter::spirvToolsUpgradeToVulkanMemoryModel(
-    std::vector<uint32_t> *mod, std::string *messages) {
-  spvtools::Optimizer::PassToken token =
-      spvtools::CreateUpgradeMemoryModelPass();
-  return spirvToolsRunPass(mod, std::move(token), messages);
-}
+    // Trim unused capabilities.
+    // When optimizations are enabled, some optimization passes like DCE could
+    // make some capabilities useless. To avoid logic duplication between this
+    // pass, and DXC, DXC generates some capabilities unconditionally. This
+    // means we should run this pass, even when optimizations are disabled.
+    stages.push_back(PostProcessStage::TrimCapabilities);
+  }
 
-bool SpirvEmitter::spirvToolsOptimize(std::vector<uint32_t> *mod,
-                                      std::string *messages) {
-  spvtools::Optimizer optimizer(featureManager.getTargetEnv());
-  optimizer.SetMessageConsumer(
-      [messages](spv_message_level_t /*level*/, const char * /*source*/,
-                 const spv_position_t & /*position*/,
-                 const char *message) { *messages += message; });
+  if (stages.empty())
+    return true;
 
   string::RawOstreamBuf printAllBuf(llvm::errs());
   std::ostream printAllOS(&printAllBuf);
-  if (spirvOptions.printAll)
-    optimizer.SetPrintAll(&printAllOS);
+  auto setUpOptimizer = [this, &printAllOS](spvtools::Optimizer &optimizer,
+                                            std::string &messages) {
+    optimizer.SetMessageConsumer(
+        [&messages](spv_message_level_t /*level*/, const char * /*source*/,
+                    const spv_position_t & /*position*/,
+                    const char *message) { messages += message; });
+    if (spirvOptions.printAll)
+      optimizer.SetPrintAll(&printAllOS);
+  };
 
   spvtools::OptimizerOptions options;
   options.set_run_validator(false);
   options.set_preserve_bindings(spirvOptions.preserveBindings);
   options.set_max_id_bound(spirvOptions.maxId);
 
+  // Usually all stages run in a single optimizer, so the module is parsed into
+  // IR and serialized back only once.
+  {
+    std::string messages;
+    spvtools::Optimizer optimizer(featureManager.getTargetEnv());
+    setUpOptimizer(optimizer, messages);
+    bool registered = true;
+    for (PostProcessStage stage : stages)
+      registered = registered &&
+                   spirvToolsRegisterStagePasses(
+                       stage, &optimizer, dsetbindingsToCombineImageSampler);
+    std::vector<uint32_t> result;
+    if (registered &&
+        optimizer.Run(mod->data(), mod->size(), &result, options) &&
+        messages.empty()) {
+      *mod = std::move(result);
+      return true;
+    }
+  }
+
+  // The optimizer doesn't tell which pass failed or sent a message, so run the
+  // stages again one at a time to report them against the right stage.
+  for (PostProcessStage stage : stages) {
+    std::string messages;
+    spvtools::Optimizer optimizer(featureManager.getTargetEnv());
+    setUpOptimizer(optimizer, messages);
+    if (!spirvToolsRegisterStagePasses(stage, &optimizer,
+                                       dsetbindingsToCombineImageSampler) ||
+        !optimizer.Run(mod->data(), mod->size(), mod, options)) {
+      switch (stage) {
+      case PostProcessStage::UpgradeMemoryModel:
+        emitFatalError("failed to use the vulkan memory model: %0", {})
+            << messages;
+        break;
+      case PostProcessStage::Legalize:
+        emitFatalError("failed to legalize SPIR-V: %0", {}) << messages;
+        break;
+      case PostProcessStage::Optimize:
+        emitFatalError("failed to optimize SPIR-V: %0", {}) << messages;
+        break;
+      case PostProcessStage::FixupOpExtInst:
+        emitFatalError("failed to fix OpExtInst opcodes: %0", {}) << messages;
+        break;
+      case PostProcessStage::TrimCapabilities:
+        emitFatalError("failed to trim capabilities: %0", {}) << messages;
+        break;
+      }
+      emitNote("please file a bug report on "
+               "https://github.com/Microsoft/DirectXShaderCompiler/issues "
+               "with source code if possible",
+               {});
+      return false;
+    }
+
+    if (messages.empty())
+      continue;
+    switch (stage) {
+    case PostProcessStage::Legalize:
+      emitWarning("SPIR-V legalization: %0", {}) << messages;
+      break;
+    case PostProcessStage::FixupOpExtInst:
+      emitWarning("SPIR-V fix-opextinst-opcodes: %0", {}) << messages;
+      break;
+    case PostProcessStage::TrimCapabilities:
+      emitWarning("SPIR-V capability trimming: %0", {}) << messages;
+      break;
+    case PostProcessStage::UpgradeMemoryModel:
+    case PostProcessStage::Optimize:
+      // Messages from these stages are only reported on failure.
+      break;
+    }
+  }
+  return true;
+}
+
+bool SpirvEmitter::spirvToolsRegisterStagePasses(
+    PostProcessStage stage, spvtools::Optimizer *optimizer,
+    const std::vector<DescriptorSetAndBinding>
+        *dsetbindingsToCombineImageSampler) {
+  switch (stage) {
+  case PostProcessStage::UpgradeMemoryModel:
+    optimizer->RegisterPass(spvtools::CreateUpgradeMemoryModelPass());
+    return true;
+  case PostProcessStage::Legalize:
+    spirvToolsRegisterLegalizationPasses(optimizer,
+                                         dsetbindingsToCombineImageSampler);
+    return true;
+  case PostProcessStage::Optimize:
+    return spirvToolsRegisterOptimizationPasses(optimizer);
+  case PostProcessStage::FixupOpExtInst:
+    optimizer->RegisterPass(
+        spvtools::CreateOpExtInstWithForwardReferenceFixupPass());
+    return true;
+  case PostProcessStage::TrimCapabilities:
+    optimizer->RegisterPass(spvtools::CreateTrimCapabilitiesPass());
+    return true;
+  }
+  llvm_unreachable("unknown post-processing stage");
+}
+
+bool SpirvEmitter::spirvToolsRegisterOptimizationPasses(
+    spvtools::Optimizer *optimizer) {
   if (spirvOptions.optConfig.empty()) {
     // Add performance passes.
-    optimizer.RegisterPerformancePasses(spirvOptions.preserveInterface);
+    optimizer->RegisterPerformancePasses(spirvOptions.preserveInterface);
 
     // Add propagation of volatile semantics passes.
-    optimizer.RegisterPass(spvtools::CreateSpreadVolatileSemanticsPass());
+    optimizer->RegisterPass(spvtools::CreateSpreadVolatileSemanticsPass());
 
     // Add compact ID pass.
-    optimizer.RegisterPass(spvtools::CreateCompactIdsPass());
-  } else {
-    // Command line options use llvm::SmallVector and llvm::StringRef, whereas
-    // SPIR-V optimizer uses std::vector and std::string.
-    std::vector<std::string> stdFlags;
-    for (const auto &f : spirvOptions.optConfig)
-      stdFlags.push_back(f.str());
-    if (!optimizer.RegisterPassesFromFlags(stdFlags))
-      return false;
+    optimizer->RegisterPass(spvtools::CreateCompactIdsPass());
+    return true;
   }
 
-  return optimizer.Run(mod->data(), mod->size(), mod, options);
+  // Command line options use llvm::SmallVector and llvm::StringRef, whereas
+  // SPIR-V optimizer uses std::vector and std::string.
+  std::vector<std::string> stdFlags;
+  for (const auto &f : spirvOptions.optConfig)
+    stdFlags.push_back(f.str());
+  return optimizer->RegisterPassesFromFlags(stdFlags);
 }
 
-bool SpirvEmitter::spirvToolsLegalize(std::vector<uint32_t> *mod,
-                                      std::string *messages,
-                                      const std::vector<DescriptorSetAndBinding>
-                                          *dsetbindingsToCombineImageSampler) {
-  spvtools::Optimizer optimizer(featureManager.getTargetEnv());
-  optimizer.SetMessageConsumer(
-      [messages](spv_message_level_t /*level*/, const char * /*source*/,
-                 const spv_position_t & /*position*/,
-                 const char *message) { *messages += message; });
-
-  string::RawOstreamBuf printAllBuf(llvm::errs());
-  std::ostream printAllOS(&printAllBuf);
-  if (spirvOptions.printAll)
-    optimizer.SetPrintAll(&printAllOS);
-
-  spvtools::OptimizerOptions options;
-  options.set_run_validator(false);
-  options.set_preserve_bindings(spirvOptions.preserveBindings);
-  options.set_max_id_bound(spirvOptions.maxId);
-
+void SpirvEmitter::spirvToolsRegisterLegalizationPasses(
+    spvtools::Optimizer *optimizer,
+    const std::vector<DescriptorSetAndBinding>
+        *dsetbindingsToCombineImageSampler) {
   // Add interface variable SROA if the signature packing is enabled.
   if (spirvOptions.signaturePacking) {
-    optimizer.RegisterPass(
+    optimizer->RegisterPass(
         spvtools::CreateInterfaceVariableScalarReplacementPass());
   }
-  optimizer.RegisterLegalizationPasses(spirvOptions.preserveInterface);
+  optimizer->RegisterLegalizationPasses(spirvOptions.preserveInterface);
   // Add flattening of resources if needed.
   if (spirvOptions.flattenResourceArrays) {
-    optimizer.RegisterPass(
+    optimizer->RegisterPass(
         spvtools::CreateReplaceDescArrayAccessUsingVarIndexPass());
-    optimizer.RegisterPass(
+    optimizer->RegisterPass(
         spvtools::CreateAggressiveDCEPass(spirvOptions.preserveInterface));
-    optimizer.RegisterPass(
+    optimizer->RegisterPass(
         spvtools::CreateDescriptorArrayScalarReplacementPass());
-    optimizer.RegisterPass(
+    optimizer->RegisterPass(
         spvtools::CreateAggressiveDCEPass(spirvOptions.preserveInterface));
   }
   if (declIdMapper.requiresFlatteningCompositeResources()) {
-    optimizer.RegisterPass(
+    optimizer->RegisterPass(
         spvtools::CreateDescriptorCompositeScalarReplacementPass());
     // ADCE should be run after desc_sroa in order to remove potentially
     // illegal types such as structures containing opaque types.
-    optimizer.RegisterPass(
+    optimizer->RegisterPass(
         spvtools::CreateAggressiveDCEPass(spirvOptions.preserveInterface));
   }
   if (dsetbindingsToCombineImageSampler &&
       !dsetbindingsToCombineImageSampler->empty()) {
-    optimizer.RegisterPass(spvtools::CreateConvertToSampledImagePass(
+    optimizer->RegisterPass(spvtools::CreateConvertToSampledImagePass(
         *dsetbindingsToCombineImageSampler));
     // ADCE should be run after combining images and samplers in order to
     // remove potentially illegal types such as structures containing opaque
     // types.
-    optimizer.RegisterPass(
+    optimizer->RegisterPass(
         spvtools::CreateAggressiveDCEPass(spirvOptions.preserveInterface));
   }
   if (spirvOptions.reduceLoadSize) {
     // The threshold must be bigger than 1.0 to reduce all possible loads.
-    optimizer.RegisterPass(spvtools::CreateReduceLoadSizePass(1.1));
+    optimizer->RegisterPass(spvtools::CreateReduceLoadSizePass(1.1));
     // ADCE should be run after reduce-load-size pass in order to remove
     // dead instructions.
-    optimizer.RegisterPass(
+    optimizer->RegisterPass(
         spvtools::CreateAggressiveDCEPass(spirvOptions.preserveInterface));
   }
-  optimizer.RegisterPass(spvtools::CreateCompactIdsPass());
-  optimizer.RegisterPass(spvtools::CreateSpreadVolatileSemanticsPass());
+  optimizer->RegisterPass(spvtools::CreateCompactIdsPass());
+  optimizer->RegisterPass(spvtools::CreateSpreadVolatileSemanticsPass());
   if (spirvOptions.fixFuncCallArguments) {
-    optimizer.RegisterPass(spvtools::CreateFixFuncCallArgumentsPass());
+    optimizer->RegisterPass(spvtools::CreateFixFuncCallArgumentsPass());
   }
-
-  return optimizer.Run(mod->data(), mod->size(), mod, options);
 }
 
 SpirvInstruction *
@@ -15524,26 +15533,5 @@ SpirvEmitter::splatScalarToGenerate(QualType type, SpirvInstruction *scalar,
   return {};
 }
 
-bool SpirvEmitter::UpgradeToVulkanMemoryModelIfNeeded(
-    std::vector<uint32_t> *module) {
-  // DXC generates code assuming the vulkan memory model is not used. However,
-  // if a feature is used that requires the Vulkan memory model, then some code
-  // may need to be rewritten.
-  if (!spirvOptions.useVulkanMemoryModel &&
-      !spvBuilder.hasCapability(spv::Capability::VulkanMemoryModel))
-    return true;
-
-  std::string messages;
-  if (!spirvToolsUpgradeToVulkanMemoryModel(module, &messages)) {
-    emitFatalError("failed to use the vulkan memory model: %0", {}) << messages;
-    emitNote("please file a bug report on "
-             "https://github.com/Microsoft/DirectXShaderCompiler/issues "
-             "with source code if possible",
-             {});
-    return false;
-  }
-  return true;
-}
-
 } // end namespace spirv
 } // end namespace clang
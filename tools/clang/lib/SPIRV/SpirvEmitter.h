@@ -1228,50 +1228,48 @@ private:
                               const clang::FunctionDecl *,
                               bool isEntryFunction);
 
-  /// \brief Helper function to run SPIRV-Tools optimizer's performance passes.
-  /// Runs the SPIRV-Tools optimizer on the given SPIR-V module |mod|, and
-  /// gets the info/warning/error messages via |messages|.
-  /// Returns true on success and false otherwise.
-  bool spirvToolsOptimize(std::vector<uint32_t> *mod, std::string *messages);
-
-  // \brief Runs the pass represented by the given pass token on the module.
-  // Returns true if the pass was successfully run. Any messages from the
-  // optimizer are returned in `messages`.
-  bool spirvToolsRunPass(std::vector<uint32_t> *mod,
-                         spvtools::Optimizer::PassToken token,
-                         std::string *messages);
-
-  // \brief Calls SPIRV-Tools optimizer fix-opextinst-opcodes pass. This pass
-  // fixes OpExtInst/OpExtInstWithForwardRefsKHR opcodes to use the correct one
-  // depending of the presence of forward references.
-  bool spirvToolsFixupOpExtInst(std::vector<uint32_t> *mod,
-                                std::string *messages);
-
-  // \brief Calls SPIRV-Tools optimizer's, but only with the capability trimming
-  // pass. Removes unused capabilities from the given SPIR-V module |mod|, and
-  // returns info/warning/error messages via |messages|. This pass doesn't trim
-  // all capabilities. To see the list of supported capabilities, check the pass
-  // headers.
-  bool spirvToolsTrimCapabilities(std::vector<uint32_t> *mod,
-                                  std::string *messages);
-
-  // \brief Runs the upgrade memory model pass using SPIRV-Tools's optimizer.
-  // This pass will modify the module, |mod|, so that it conforms to the Vulkan
-  // memory model instead of the GLSL450 memory model. Returns
-  // info/warning/error messages via |messages|.
-  bool spirvToolsUpgradeToVulkanMemoryModel(std::vector<uint32_t> *mod,
-                                            std::string *messages);
-
-  /// \brief Helper function to run SPIRV-Tools optimizer's legalization passes.
-  /// Runs the SPIRV-Tools legalization on the given SPIR-V module |mod|, and
-  /// gets the info/warning/error messages via |messages|. If
+  /// \brief The SPIRV-Tools post-processing stages, in the order they run.
+  enum class PostProcessStage {
+    UpgradeMemoryModel,
+    Legalize,
+    Optimize,
+    FixupOpExtInst,
+    TrimCapabilities,
+  };
+
+  /// \brief Runs the SPIRV-Tools passes of every post-processing stage that
+  /// applies to the SPIR-V module |mod|: upgrading to the Vulkan memory model,
+  /// legalization, optimization, OpExtInst opcode fixup and capability
+  /// trimming. The stages normally share one optimizer, so |mod| is parsed into
+  /// IR and serialized back only once; if that fails or sends any message, the
+  /// stages run again one at a time so that diagnostics name their stage. If
   /// |dsetbindingsToCombineImageSampler| is not empty, runs
-  /// --convert-to-sampled-image pass.
+  /// --convert-to-sampled-image pass as part of legalization.
   /// Returns true on success and false otherwise.
-  bool
-  spirvToolsLegalize(std::vector<uint32_t> *mod, std::string *messages,
-                     const std::vector<spvtools::opt::DescriptorSetAndBinding>
-                         *dsetbindingsToCombineImageSampler);
+  bool spirvToolsPostProcess(
+      std::vector<uint32_t> *mod,
+      const std::vector<spvtools::opt::DescriptorSetAndBinding>
+          *dsetbindingsToCombineImageSampler);
+
+  /// \brief Registers the passes of the post-processing |stage| with
+  /// |optimizer|. Returns false if they could not be registered.
+  bool spirvToolsRegisterStagePasses(
+      PostProcessStage stage, spvtools::Optimizer *optimizer,
+      const std::vector<spvtools::opt::DescriptorSetAndBinding>
+          *dsetbindingsToCombineImageSampler);
+
+  /// \brief Registers SPIRV-Tools optimizer's legalization passes with
+  /// |optimizer|. If |dsetbindingsToCombineImageSampler| is not empty, also
+  /// registers --convert-to-sampled-image pass.
+  void spirvToolsRegisterLegalizationPasses(
+      spvtools::Optimizer *optimizer,
+      const std::vector<spvtools::opt::DescriptorSetAndBinding>
+          *dsetbindingsToCombineImageSampler);
+
+  /// \brief Registers SPIRV-Tools optimizer's performance passes, or the
+  /// passes given with -Oconfig, with |optimizer|.
+  /// Returns false if -Oconfig has an invalid flag and true otherwise.
+  bool spirvToolsRegisterOptimizationPasses(spvtools::Optimizer *optimizer);
 
   /// \brief Helper function to run the SPIRV-Tools validator.
   /// Runs the SPIRV-Tools validator on the given SPIR-V module |mod|, and
@@ -1316,11 +1314,6 @@ private:
                                           SpirvInstruction *scalar,
                                           SpirvLayoutRule rule);
 
-  /// Modifies the instruction in the code that use the GLSL450 memory module to
-  /// use the Vulkan memory model. This is done only if it has been requested or
-  /// the Vulkan memory model capability has been added to the module.
-  bool UpgradeToVulkanMemoryModelIfNeeded(std::vector<uint32_t> *module);
-
   // Splits the `value`, which must be a 64-bit scalar, into two 32-bit wide
   // uints, stored in `lowbits` and `highbits`.
   void splitDouble(SpirvInstruction *value, SourceLocation loc,
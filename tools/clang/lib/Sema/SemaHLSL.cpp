@@ -40,6 +40,7 @@
 #include "clang/Sema/TemplateDeduction.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
@@ -2398,74 +2399,119 @@ static bool TemplateHasDefaultType(ArBasicKind kind) {
   }
 }
 
+/// <summary>
+/// Use this class to look up intrinsic definitions that come from an external
+/// source. The definitions found for a type and function name are kept, so
+/// each name is only looked up once in the external tables.
+/// </summary>
+class IntrinsicTableLookupCache {
+public:
+  struct Match {
+    unsigned TableIndex;
+    const HLSL_INTRINSIC *Intrinsic;
+  };
+
+private:
+  llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2> &_tables;
+  llvm::StringMap<llvm::SmallVector<Match, 4>> _lookups;
+
+public:
+  IntrinsicTableLookupCache(
+      llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2> &tables)
+      : _tables(tables) {}
+
+  IDxcIntrinsicTable *GetTable(unsigned tableIndex) const {
+    return _tables[tableIndex];
+  }
+
+  /// <summary>Forgets all lookups; call when the tables change.</summary>
+  void Clear() { _lookups.clear(); }
+
+  /// <summary>Returns all definitions of functionName on typeName, in table
+  /// order.</summary>
+  ArrayRef<Match> Lookup(StringRef typeName, StringRef functionName) {
+    if (_tables.empty())
+      return ArrayRef<Match>();
+
+    std::string key = (typeName + "::" + functionName).str();
+    auto insertResult = _lookups.insert(
+        std::make_pair(StringRef(key), llvm::SmallVector<Match, 4>()));
+    llvm::SmallVector<Match, 4> &matches = insertResult.first->second;
+    if (!insertResult.second)
+      return matches;
+
+    CA2WEX<> typeNameW(typeName.str().c_str());
+    CA2WEX<> functionNameW(functionName.str().c_str());
+
+    // The lookup cookie is only reset when a table fails the lookup, as it
+    // was when tables were queried while iterating.
+    UINT64 lookupCookie = 0;
+    for (unsigned i = 0; i < _tables.size(); ++i) {
+      for (;;) {
+        const HLSL_INTRINSIC *pIntrinsic = nullptr;
+        if (FAILED(_tables[i]->LookupIntrinsic(typeNameW, functionNameW,
+                                               &pIntrinsic, &lookupCookie))) {
+          lookupCookie = 0;
+          pIntrinsic = nullptr;
+        }
+        if (pIntrinsic == nullptr)
+          break;
+        matches.push_back(Match{i, pIntrinsic});
+      }
+    }
+    return matches;
+  }
+};
+
 /// <summary>
 /// Use this class to iterate over intrinsic definitions that come from an
 /// external source.
 /// </summary>
 class IntrinsicTableDefIter {
 private:
+  IntrinsicTableLookupCache *_cache;
   StringRef _typeName;
   StringRef _functionName;
-  llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2> &_tables;
-  const HLSL_INTRINSIC *_tableIntrinsic;
-  UINT64 _tableLookupCookie;
-  unsigned _tableIndex;
+  ArrayRef<IntrinsicTableLookupCache::Match> _matches;
+  size_t _matchIndex;
   unsigned _argCount;
   bool _firstChecked;
 
-  IntrinsicTableDefIter(
-      llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2> &tables,
-      StringRef typeName, StringRef functionName, unsigned argCount)
-      : _typeName(typeName), _functionName(functionName), _tables(tables),
-        _tableIntrinsic(nullptr), _tableLookupCookie(0), _tableIndex(0),
-        _argCount(argCount), _firstChecked(false) {}
-
-  void CheckForIntrinsic() {
-    if (_tableIndex >= _tables.size()) {
-      return;
-    }
-
-    _firstChecked = true;
-
-    // TODO: review this - this will allocate at least once per string
-    CA2WEX<> typeName(_typeName.str().c_str());
-    CA2WEX<> functionName(_functionName.str().c_str());
+  IntrinsicTableDefIter(IntrinsicTableLookupCache *cache, StringRef typeName,
+                        StringRef functionName, unsigned argCount)
+      : _cache(cache), _typeName(typeName), _functionName(functionName),
+        _matchIndex(0), _argCount(argCount), _firstChecked(false) {}
 
-    if (FAILED(_tables[_tableIndex]->LookupIntrinsic(
-            typeName, functionName, &_tableIntrinsic, &_tableLookupCookie))) {
-      _tableLookupCookie = 0;
-      _tableIntrinsic = nullptr;
-    }
-  }
+  bool AtEnd() const { return _matchIndex >= _matches.size(); }
 
   void MoveToNext() {
-    for (;;) {
-      // If we don't have an intrinsic, try the following table.
-      if (_firstChecked && _tableIntrinsic == nullptr) {
-        _tableIndex++;
-      }
-
-      CheckForIntrinsic();
-      if (_tableIndex == _tables.size() ||
-          (_tableIntrinsic != nullptr &&
-           _tableIntrinsic->uNumArgs ==
-               (_argCount + 1))) // uNumArgs includes return
-        break;
+    if (!_firstChecked) {
+      // Look up on first use, so the external tables are left alone when a
+      // built-in intrinsic matches.
+      _firstChecked = true;
+      _matches = _cache->Lookup(_typeName, _functionName);
+      _matchIndex = 0;
+    } else if (!AtEnd()) {
+      _matchIndex++;
     }
+
+    while (!AtEnd() && _matches[_matchIndex].Intrinsic->uNumArgs !=
+                           (_argCount + 1)) // uNumArgs includes return
+      _matchIndex++;
   }
 
 public:
-  static IntrinsicTableDefIter
-  CreateStart(llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2> &tables,
-              StringRef typeName, StringRef functionName, unsigned argCount) {
-    IntrinsicTableDefIter result(tables, typeName, functionName, argCount);
+  static IntrinsicTableDefIter CreateStart(IntrinsicTableLookupCache *cache,
+                                           StringRef typeName,
+                                           StringRef functionName,
+                                           unsigned argCount) {
+    IntrinsicTableDefIter result(cache, typeName, functionName, argCount);
     return result;
   }
 
-  static IntrinsicTableDefIter
-  CreateEnd(llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2> &tables) {
-    IntrinsicTableDefIter result(tables, StringRef(), StringRef(), 0);
-    result._tableIndex = tables.size();
+  static IntrinsicTableDefIter CreateEnd(IntrinsicTableLookupCache *cache) {
+    IntrinsicTableDefIter result(cache, StringRef(), StringRef(), 0);
+    result._firstChecked = true;
     return result;
   }
 
@@ -2473,18 +2519,19 @@ public:
     if (!_firstChecked) {
       MoveToNext();
     }
-    return _tableIndex != other._tableIndex; // More things could be compared
-                                             // but we only match end.
+    return AtEnd() != other.AtEnd(); // More things could be compared
+                                     // but we only match end.
   }
 
   const HLSL_INTRINSIC *operator*() const {
     DXASSERT(_firstChecked, "otherwise deref without comparing to end");
-    return _tableIntrinsic;
+    return AtEnd() ? nullptr : _matches[_matchIndex].Intrinsic;
   }
 
   LPCSTR GetTableName() const {
     LPCSTR tableName = nullptr;
-    if (FAILED(_tables[_tableIndex]->GetTableName(&tableName))) {
+    if (FAILED(_cache->GetTable(_matches[_matchIndex].TableIndex)
+                   ->GetTableName(&tableName))) {
       return nullptr;
     }
     return tableName;
@@ -2492,8 +2539,9 @@ public:
 
   LPCSTR GetLoweringStrategy() const {
     LPCSTR lowering = nullptr;
-    if (FAILED(_tables[_tableIndex]->GetLoweringStrategy(_tableIntrinsic->Op,
-                                                         &lowering))) {
+    const IntrinsicTableLookupCache::Match &match = _matches[_matchIndex];
+    if (FAILED(_cache->GetTable(match.TableIndex)
+                   ->GetLoweringStrategy(match.Intrinsic->Op, &lowering))) {
       return nullptr;
     }
     return lowering;
@@ -2855,6 +2903,9 @@ private:
   // Intrinsic tables available externally.
   llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2> m_intrinsicTables;
 
+  // Lookups already done in m_intrinsicTables.
+  IntrinsicTableLookupCache m_intrinsicTableLookups;
+
   // Scalar types indexed by HLSLScalarType.
   QualType m_scalarTypes[HLSLScalarTypeCount];
 
@@ -3867,6 +3918,7 @@ public:
         m_vkIntegralConstantTemplateDecl(nullptr),
         m_vkLiteralTemplateDecl(nullptr), m_hlslNSDecl(nullptr),
         m_vkNSDecl(nullptr), m_context(nullptr), m_sema(nullptr),
+        m_intrinsicTableLookups(m_intrinsicTables),
         m_hlslStringTypedef(nullptr) {
     memset(m_matrixTypes, 0, sizeof(m_matrixTypes));
     memset(m_matrixShorthandTypes, 0, sizeof(m_matrixShorthandTypes));
@@ -4429,6 +4481,7 @@ public:
   void RegisterIntrinsicTable(IDxcIntrinsicTable *table) {
     DXASSERT_NOMSG(table != nullptr);
     m_intrinsicTables.push_back(table);
+    m_intrinsicTableLookups.Clear();
     // If already initialized, add methods immediately.
     if (m_sema != nullptr) {
       AddIntrinsicTableMethods(table);
@@ -4869,36 +4922,50 @@ public:
                                                   StringRef typeName,
                                                   StringRef nameIdentifier,
                                                   size_t argumentCount) {
-    // This is implemented by a linear scan for now.
-    // We tested binary search on tables, and there was no performance gain on
-    // samples probably for the following reasons.
-    // 1. The tables are not big enough to make noticable difference
-    // 2. The user of this function assumes that it returns the first entry in
-    // the table that matches name and argument count. So even in the binary
-    // search, we have to scan backwards until the entry does not match the name
-    // or arg count. For linear search this is not a problem
-    for (unsigned int i = 0; i < tableSize; i++) {
-      const HLSL_INTRINSIC *pIntrinsic = &table[i];
-
-      const bool isVariadicFn = IsVariadicIntrinsicFunction(pIntrinsic);
-
-      // Do some quick checks to verify size and name.
-      if (!isVariadicFn && pIntrinsic->uNumArgs != 1 + argumentCount) {
-        continue;
-      }
-      if (!nameIdentifier.equals(StringRef(pIntrinsic->pArgs[0].pName))) {
-        continue;
+    // The user of this function assumes that it returns the first entry in
+    // the table that matches name and argument count. The generated name
+    // index orders entries by name and then by position, so a binary search
+    // finds the entries for the name in table order.
+    const HLSL_INTRINSIC *pFound = table + tableSize;
+    if (const UINT *nameIndex = GetIntrinsicNameIndex(table)) {
+      const UINT *nameIndexEnd = nameIndex + tableSize;
+      const UINT *it = std::lower_bound(
+          nameIndex, nameIndexEnd, nameIdentifier,
+          [table](UINT idx, StringRef name) {
+            return StringRef(table[idx].pArgs[0].pName) < name;
+          });
+      for (; it != nameIndexEnd &&
+             nameIdentifier.equals(StringRef(table[*it].pArgs[0].pName));
+           ++it) {
+        const HLSL_INTRINSIC *pIntrinsic = &table[*it];
+        if (IsVariadicIntrinsicFunction(pIntrinsic) ||
+            pIntrinsic->uNumArgs == 1 + argumentCount) {
+          pFound = pIntrinsic;
+          break;
+        }
       }
+    } else {
+      for (unsigned int i = 0; i < tableSize; i++) {
+        const HLSL_INTRINSIC *pIntrinsic = &table[i];
 
-      return IntrinsicDefIter::CreateStart(
-          table, tableSize, pIntrinsic,
-          IntrinsicTableDefIter::CreateStart(m_intrinsicTables, typeName,
-                                             nameIdentifier, argumentCount));
+        const bool isVariadicFn = IsVariadicIntrinsicFunction(pIntrinsic);
+
+        // Do some quick checks to verify size and name.
+        if (!isVariadicFn && pIntrinsic->uNumArgs != 1 + argumentCount) {
+          continue;
+        }
+        if (!nameIdentifier.equals(StringRef(pIntrinsic->pArgs[0].pName))) {
+          continue;
+        }
+
+        pFound = pIntrinsic;
+        break;
+      }
     }
 
     return IntrinsicDefIter::CreateStart(
-        table, tableSize, table + tableSize,
-        IntrinsicTableDefIter::CreateStart(m_intrinsicTables, typeName,
+        table, tableSize, pFound,
+        IntrinsicTableDefIter::CreateStart(&m_intrinsicTableLookups, typeName,
                                            nameIdentifier, argumentCount));
   }
 
@@ -4945,7 +5012,8 @@ public:
     IntrinsicDefIter cursor = FindIntrinsicByNameAndArgCount(
         table, tableCount, StringRef(), nameIdentifier, Args.size());
     IntrinsicDefIter end = IntrinsicDefIter::CreateEnd(
-        table, tableCount, IntrinsicTableDefIter::CreateEnd(m_intrinsicTables));
+        table, tableCount,
+        IntrinsicTableDefIter::CreateEnd(&m_intrinsicTableLookups));
 
     for (; cursor != end; ++cursor) {
       // If this is the intrinsic we're interested in, build up a representation
@@ -10559,7 +10627,7 @@ HLSLExternalSource::DeduceTemplateArgumentsForHLSL(
       intrinsics, intrinsicCount, objectName, nameIdentifier, Args.size());
   IntrinsicDefIter end = IntrinsicDefIter::CreateEnd(
       intrinsics, intrinsicCount,
-      IntrinsicTableDefIter::CreateEnd(m_intrinsicTables));
+      IntrinsicTableDefIter::CreateEnd(&m_intrinsicTableLookups));
 
   while (cursor != end) {
     size_t badArgIdx;
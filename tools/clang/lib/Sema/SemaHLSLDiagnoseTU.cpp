@@ -189,6 +189,21 @@ public:
     return CheckRecursion(CallStack, EntryFnDecl);
   }
 
+  // Adds FD and every function reachable from it to Reachable.
+  void GetReachableFunctions(FunctionDecl *FD, FunctionSet &Reachable) {
+    PendingFunctions pending;
+    pending.push_back(getFunctionWithBody(FD));
+    while (!pending.empty()) {
+      FunctionDecl *D = pending.pop_back_val();
+      if (!Reachable.insert(D).second)
+        continue;
+      auto node = m_callNodes.find(D);
+      if (node != m_callNodes.end())
+        pending.append(node->second.CalleeFns.begin(),
+                       node->second.CalleeFns.end());
+    }
+  }
+
   const CallNodes &GetCallGraph() { return m_callNodes; }
 
   const FunctionSet GetVisitedFunctions() { return m_visitedFunctions; }
@@ -683,3 +698,26 @@ void hlsl::DiagnoseTranslationUnit(clang::Sema *self) {
       Visitor.TraverseDecl(FD);
   }
 }
+
+void hlsl::GetExportedFunctionCallees(
+    clang::Sema *self,
+    std::vector<std::pair<clang::FunctionDecl *,
+                          std::vector<clang::FunctionDecl *>>> &Exports) {
+  DXASSERT_NOMSG(self != nullptr);
+  Exports.clear();
+  if (!self->getLangOpts().IsHLSLLibrary)
+    return;
+
+  llvm::SmallVector<VarDecl *, 16> GlobalsWithInit;
+  GatherGlobalsWithInitializers(
+      self->getASTContext().getTranslationUnitDecl(), GlobalsWithInit);
+
+  CallGraphWithRecurseGuard callGraph;
+  for (FunctionDecl *FD : GetAllExportedFDecls(self)) {
+    callGraph.BuildForEntry(FD, GlobalsWithInit);
+    FunctionSet Reachable;
+    callGraph.GetReachableFunctions(FD, Reachable);
+    Exports.emplace_back(FD, std::vector<FunctionDecl *>(Reachable.begin(),
+                                                         Reachable.end()));
+  }
+}
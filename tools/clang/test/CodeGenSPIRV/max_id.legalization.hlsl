@@ -0,0 +1,18 @@
+// RUN: not %dxc -T cs_6_0 -E main %s -spirv -fspv-max-id 10 2>&1 | FileCheck %s
+// RUN: not %dxc -T cs_6_0 -E main %s -spirv -O0 -fspv-max-id 10 2>&1 | FileCheck %s
+
+// The local resource requires legalization, which runs before optimization.
+// An ID overflow while legalizing must be reported against legalization,
+// whether or not optimization runs afterwards.
+// CHECK: fatal error: failed to legalize SPIR-V: ID overflow. Try running compact-ids.
+// CHECK-NOT: failed to optimize SPIR-V
+
+
+RWStructuredBuffer<int> data;
+
+[numthreads(1,1,1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+  RWStructuredBuffer<int> local = data;
+  local[id.x] = 1;
+}
@@ -0,0 +1,19 @@
+// A preprocess that fails writes no -Fi file, and keeps one written before.
+// RUN: rm -f %t.pp %t.pp.tmp
+// RUN: %dxc -T ps_6_0 -P -Fi %t.pp -DFAIL %s 2>&1 | FileCheck %s --check-prefix=ERR
+// RUN: not ls %t.pp
+// RUN: not ls %t.pp.tmp
+
+// RUN: %dxc -T ps_6_0 -P -Fi %t.pp %s
+// RUN: %dxc -T ps_6_0 -P -Fi %t.pp -DFAIL %s 2>&1 | FileCheck %s --check-prefix=ERR
+// RUN: FileCheck --input-file=%t.pp %s --check-prefix=PREV
+// RUN: not ls %t.pp.tmp
+
+// ERR: error: preprocessing failed
+// PREV: float4 main()
+
+#ifdef FAIL
+#error preprocessing failed
+#endif
+
+float4 main() : SV_Target { return 1; }
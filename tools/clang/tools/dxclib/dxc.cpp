@@ -910,6 +910,8 @@ int DxcContext::Compile() {
       if (SUCCEEDED(pCompileResult->QueryInterface(&pResult))) {
         WriteDxcOutputToConsole(pResult, DXC_OUT_REMARKS);
         WriteDxcOutputToConsole(pResult, DXC_OUT_TIME_REPORT);
+        WriteDxcOutputToConsole(pResult, DXC_OUT_PASS_PROFILE);
+        WriteDxcOutputToConsole(pResult, DXC_OUT_ALLOCATOR_STATS);
 
         if (m_Opts.TimeTrace == "-")
           WriteDxcOutputToConsole(pResult, DXC_OUT_TIME_TRACE);
@@ -995,6 +997,86 @@ int DxcContext::DumpBinary() {
   return ActOnBlob(pSource.p);
 }
 
+// Write-only stream over a file, which preprocessed text is streamed into.
+class DxcFileOutputStream : public IStream {
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  CHandle m_file;
+
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  DxcFileOutputStream(HANDLE file) : m_dwRef(0), m_file(file) {}
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid,
+                                           void **ppvObject) override {
+    return DoBasicQueryInterface<IStream, ISequentialStream>(this, iid,
+                                                             ppvObject);
+  }
+
+  // ISequentialStream
+  HRESULT STDMETHODCALLTYPE Read(void *, ULONG, ULONG *) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE Write(const void *pv, ULONG cb,
+                                  ULONG *pcbWritten) override {
+    DWORD written = 0;
+    if (FALSE == WriteFile(m_file, pv, cb, &written, nullptr))
+      return HRESULT_FROM_WIN32(GetLastError());
+    if (pcbWritten != nullptr)
+      *pcbWritten = written;
+    return S_OK;
+  }
+
+  // IStream
+  HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER, DWORD,
+                                 ULARGE_INTEGER *) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetSize(ULARGE_INTEGER) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE CopyTo(IStream *, ULARGE_INTEGER, ULARGE_INTEGER *,
+                                   ULARGE_INTEGER *) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE Commit(DWORD) override { return S_OK; }
+  HRESULT STDMETHODCALLTYPE Revert(void) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE LockRegion(ULARGE_INTEGER, ULARGE_INTEGER,
+                                       DWORD) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE UnlockRegion(ULARGE_INTEGER, ULARGE_INTEGER,
+                                         DWORD) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE Stat(STATSTG *, DWORD) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE Clone(IStream **) override { return E_NOTIMPL; }
+};
+
+// Renames pTempName over pFileName, replacing any existing file.
+static HRESULT ReplaceFileWith(LPCWSTR pFileName, LPCWSTR pTempName) {
+#ifdef _WIN32
+  bool renamed =
+      ::MoveFileExW(pTempName, pFileName, MOVEFILE_REPLACE_EXISTING) != FALSE;
+#else
+  bool renamed =
+      ::rename(Unicode::WideToUTF8StringOrThrow(pTempName).c_str(),
+               Unicode::WideToUTF8StringOrThrow(pFileName).c_str()) == 0;
+#endif
+  return renamed ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+}
+
+// Removes a temporary file that is not renamed into place.
+static void DeleteTempFile(LPCWSTR pTempName) {
+#ifdef _WIN32
+  ::DeleteFileW(pTempName);
+#else
+  ::remove(Unicode::WideToUTF8StringOrThrow(pTempName).c_str());
+#endif
+}
+
 void DxcContext::Preprocess() {
   DXASSERT(!m_Opts.Preprocess.empty(),
            "else option reading should have failed");
@@ -1017,6 +1099,63 @@ void DxcContext::Preprocess() {
 
   ReadFileIntoBlob(m_dxcSupport, StringRefWide(m_Opts.InputFile), &pSource);
   IFT(CreateInstance(CLSID_DxcCompiler, &pCompiler));
+
+  // Stream UTF-8 output straight to the file, so that large preprocessed
+  // sources need not be held in memory. Older compilers lack the interface.
+  CComPtr<IDxcStreamPreprocessor> pStreamPreprocessor;
+  if (m_Opts.DefaultTextCodePage == DXC_CP_UTF8 &&
+      SUCCEEDED(pCompiler.QueryInterface(&pStreamPreprocessor))) {
+    CComPtr<IDxcUtils> pUtils;
+    CComPtr<IDxcCompilerArgs> pArgs;
+    IFT(CreateInstance(CLSID_DxcUtils, &pUtils));
+    IFT(pUtils->BuildArguments(StringRefWide(m_Opts.InputFile), nullptr,
+                               nullptr, args.data(), args.size(),
+                               m_Opts.Defines.data(), m_Opts.Defines.size(),
+                               &pArgs));
+    StringRefWide outputName(m_Opts.Preprocess);
+    LPCWSTR preprocessArgs[] = {L"-P", L"-Fi", outputName};
+    IFT(pArgs->AddArguments(preprocessArgs, _countof(preprocessArgs)));
+
+    // Write next to the -Fi file and rename over it only once preprocessing
+    // succeeds, so that, as with the fallback path, a failure neither leaves
+    // partial output nor truncates a file written by an earlier run.
+    std::wstring tempName = std::wstring(outputName) + L".tmp";
+    HANDLE file = CreateFileW(tempName.c_str(), GENERIC_WRITE, FILE_SHARE_READ,
+                              nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      IFT_Data(HRESULT_FROM_WIN32(GetLastError()), tempName.c_str());
+    }
+
+    BOOL sourceEncodingKnown = false;
+    DxcBuffer buffer = {pSource->GetBufferPointer(), pSource->GetBufferSize(),
+                        CP_ACP};
+    CComPtr<IDxcResult> pResult;
+    HRESULT hr;
+    {
+      // Releasing the stream closes the file.
+      CComPtr<DxcFileOutputStream> pOutput = new DxcFileOutputStream(file);
+      hr = pSource->GetEncoding(&sourceEncodingKnown, &buffer.Encoding);
+      if (SUCCEEDED(hr))
+        hr = pStreamPreprocessor->PreprocessToStream(
+            &buffer, pArgs->GetArguments(), pArgs->GetCount(),
+            pIncludeHandler, pOutput, IID_PPV_ARGS(&pResult));
+    }
+    HRESULT status = E_FAIL;
+    if (SUCCEEDED(hr))
+      hr = pResult->GetStatus(&status);
+    HRESULT renameHr = E_FAIL;
+    if (SUCCEEDED(hr) && SUCCEEDED(status))
+      renameHr = ReplaceFileWith(outputName, tempName.c_str());
+    if (FAILED(renameHr))
+      DeleteTempFile(tempName.c_str());
+    IFT(hr);
+    WriteOperationErrorsToConsole(pResult, m_Opts.OutputWarnings);
+    if (SUCCEEDED(status))
+      IFT_Data(renameHr, outputName);
+    return;
+  }
+
   IFT(pCompiler->Preprocess(pSource, StringRefWide(m_Opts.InputFile),
                             args.data(), args.size(), m_Opts.Defines.data(),
                             m_Opts.Defines.size(), pIncludeHandler,
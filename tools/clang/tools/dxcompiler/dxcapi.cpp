@@ -40,6 +40,8 @@ HRESULT CreateDxcOptimizer(REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcContainerBuilder(REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcLinker(REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcPdbUtils(REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcBatchCompiler(REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcIncludeCache(REFIID riid, _Out_ LPVOID *ppv);
 
 namespace hlsl {
 void CreateDxcContainerReflection(IDxcContainerReflection **ppResult);
@@ -108,6 +110,10 @@ static HRESULT ThreadMallocDxcCreateInstance(REFCLSID rclsid, REFIID riid,
     hr = CreateDxcRewriter(riid, ppv);
   } else if (IsEqualCLSID(rclsid, CLSID_DxcLinker)) {
     hr = CreateDxcLinker(riid, ppv);
+  } else if (IsEqualCLSID(rclsid, CLSID_DxcBatchCompiler)) {
+    hr = CreateDxcBatchCompiler(riid, ppv);
+  } else if (IsEqualCLSID(rclsid, CLSID_DxcIncludeCache)) {
+    hr = CreateDxcIncludeCache(riid, ppv);
   }
 // Note: The following targets are not yet enabled for non-Windows platforms.
 #ifdef _WIN32
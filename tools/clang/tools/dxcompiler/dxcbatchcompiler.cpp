@@ -0,0 +1,218 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcbatchcompiler.cpp                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the DirectX Compiler batch compiler.                           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+
+#include "dxc/DxilValidation/DxilValidation.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/microcom.h"
+#include "dxc/dxcapi.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// This declaration is used to create the compiler each worker reuses.
+HRESULT CreateDxcCompiler(REFIID riid, LPVOID *ppv);
+
+namespace {
+
+// State of the batch being run by the workers.
+struct DxcBatch {
+  const DxcBatchCompileJob *pJobs;
+  UINT32 JobCount;
+  UINT32 MaxWorkers;
+  IDxcBatchCompileCallback *pCallback;
+
+  // Next job to claim; workers take jobs in order as they become free, so
+  // long compiles don't hold up jobs queued behind them on another worker.
+  std::atomic<UINT32> NextJob;
+  std::atomic<bool> Cancelled;
+  // Serializes calls to pCallback; also guards CallbackHR.
+  std::mutex CallbackMutex;
+  HRESULT CallbackHR;
+  // Workers running jobs from this batch; guarded by the pool mutex.
+  UINT32 ActiveWorkers;
+
+  DxcBatch(const DxcBatchCompileJob *pJobs, UINT32 JobCount, UINT32 MaxWorkers,
+           IDxcBatchCompileCallback *pCallback)
+      : pJobs(pJobs), JobCount(JobCount), MaxWorkers(MaxWorkers),
+        pCallback(pCallback), NextJob(0), Cancelled(false), CallbackHR(S_OK),
+        ActiveWorkers(0) {}
+
+  bool HasWork() const { return !Cancelled && NextJob < JobCount; }
+};
+
+} // namespace
+
+class DxcBatchCompiler : public IDxcBatchCompiler {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+
+  // Serializes CompileBatch calls.
+  std::mutex m_batchMutex;
+  // Guards the fields below.
+  std::mutex m_poolMutex;
+  std::condition_variable m_workAvailable;
+  std::condition_variable m_batchDone;
+  std::vector<std::thread> m_workers;
+  DxcBatch *m_pBatch = nullptr;
+  bool m_stopping = false;
+
+  void WorkerMain();
+  void RunJobs(DxcBatch &batch, CComPtr<IDxcCompiler3> &pCompiler);
+  void EnsureWorkers(UINT32 count);
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcBatchCompiler)
+
+  ~DxcBatchCompiler() {
+    {
+      std::lock_guard<std::mutex> lock(m_poolMutex);
+      m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+    for (std::thread &worker : m_workers)
+      worker.join();
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid,
+                                           void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcBatchCompiler>(this, iid, ppvObject);
+  }
+
+  // IDxcBatchCompiler
+  HRESULT STDMETHODCALLTYPE CompileBatch(
+      const DxcBatchCompileJob *pJobs, UINT32 jobCount, UINT32 maxWorkers,
+      IDxcBatchCompileCallback *pCallback) override;
+};
+
+void DxcBatchCompiler::WorkerMain() {
+  // Each worker keeps its allocator and compiler for its whole lifetime,
+  // rather than setting them up again for every job.
+  DxcThreadMalloc TM(m_pMalloc);
+  CComPtr<IDxcCompiler3> pCompiler;
+
+  std::unique_lock<std::mutex> lock(m_poolMutex);
+  for (;;) {
+    m_workAvailable.wait(lock, [this]() {
+      return m_stopping ||
+             (m_pBatch && m_pBatch->HasWork() &&
+              m_pBatch->ActiveWorkers < m_pBatch->MaxWorkers);
+    });
+    if (m_stopping)
+      break;
+
+    DxcBatch *pBatch = m_pBatch;
+    ++pBatch->ActiveWorkers;
+    lock.unlock();
+    RunJobs(*pBatch, pCompiler);
+    lock.lock();
+    if (--pBatch->ActiveWorkers == 0)
+      m_batchDone.notify_all();
+  }
+}
+
+void DxcBatchCompiler::RunJobs(DxcBatch &batch,
+                               CComPtr<IDxcCompiler3> &pCompiler) {
+  // The batch workers already keep the hardware threads busy; share them out
+  // rather than letting every validation start one thread per hardware thread.
+  hlsl::ScopedValidationThreadLimit ValidationLimit(
+      std::thread::hardware_concurrency() / batch.MaxWorkers);
+  for (;;) {
+    if (batch.Cancelled)
+      return;
+    UINT32 jobIndex = batch.NextJob++;
+    if (jobIndex >= batch.JobCount)
+      return;
+
+    const DxcBatchCompileJob &job = batch.pJobs[jobIndex];
+    CComPtr<IDxcResult> pResult;
+    HRESULT hr = S_OK;
+    try {
+      if (!pCompiler)
+        IFT(CreateDxcCompiler(__uuidof(IDxcCompiler3), (void **)&pCompiler));
+      hr = pCompiler->Compile(job.pSource, job.pArguments, job.argCount,
+                              job.pIncludeHandler, IID_PPV_ARGS(&pResult));
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+    if (FAILED(hr))
+      pResult.Release();
+
+    std::lock_guard<std::mutex> lock(batch.CallbackMutex);
+    if (batch.Cancelled)
+      return;
+    HRESULT hrCallback = batch.pCallback->OnJobComplete(jobIndex, hr, pResult);
+    if (FAILED(hrCallback)) {
+      batch.CallbackHR = hrCallback;
+      batch.Cancelled = true;
+    }
+  }
+}
+
+void DxcBatchCompiler::EnsureWorkers(UINT32 count) {
+  // Workers are only ever added; idle ones wait for the next batch.
+  if (m_workers.size() >= count)
+    return;
+  m_workers.reserve(count);
+  // The thread start state is freed on the new thread after WorkerMain
+  // returns and no allocator is installed there anymore, so it must come
+  // from the default allocator.
+  DxcThreadMalloc TMDefault(nullptr);
+  while (m_workers.size() < count)
+    m_workers.emplace_back(&DxcBatchCompiler::WorkerMain, this);
+}
+
+HRESULT STDMETHODCALLTYPE DxcBatchCompiler::CompileBatch(
+    const DxcBatchCompileJob *pJobs, UINT32 jobCount, UINT32 maxWorkers,
+    IDxcBatchCompileCallback *pCallback) {
+  if ((pJobs == nullptr && jobCount != 0) || pCallback == nullptr)
+    return E_INVALIDARG;
+  if (jobCount == 0)
+    return S_OK;
+
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    std::lock_guard<std::mutex> batchLock(m_batchMutex);
+
+    if (maxWorkers == 0)
+      maxWorkers = std::max(1u, std::thread::hardware_concurrency());
+    maxWorkers = std::min(maxWorkers, jobCount);
+
+    DxcBatch batch(pJobs, jobCount, maxWorkers, pCallback);
+    std::unique_lock<std::mutex> lock(m_poolMutex);
+    EnsureWorkers(maxWorkers);
+    m_pBatch = &batch;
+    m_workAvailable.notify_all();
+    // Once no jobs are left to claim, no worker can join the batch, so it is
+    // done when the last active worker finishes.
+    m_batchDone.wait(lock, [&batch]() {
+      return !batch.HasWork() && batch.ActiveWorkers == 0;
+    });
+    m_pBatch = nullptr;
+    return batch.CallbackHR;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT CreateDxcBatchCompiler(REFIID riid, LPVOID *ppv) {
+  try {
+    CComPtr<DxcBatchCompiler> result(
+        DxcBatchCompiler::Alloc(DxcGetThreadMallocNoRef()));
+    IFROOM(result.p);
+    return result.p->QueryInterface(riid, ppv);
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
@@ -0,0 +1,390 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccompilecache.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Content-addressed on-disk cache of compile results.                       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxccompilecache.h"
+#include "dxc/DxilContainer/DxilContainer.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Option/ArgList.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/HLSLOptions.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/dxcapi.impl.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace {
+
+// On-disk layout of a cache entry: header, then OutputCount records of
+// CompileCacheOutputHeader followed by the UTF-8 output name and the output
+// data. Entries are written to a temporary file and renamed into place; the
+// payload digest still turns anything unexpected on disk into a miss.
+static const uint32_t CompileCacheMagic = DXC_FOURCC('D', 'X', 'C', 'C');
+static const uint32_t CompileCacheFormatVersion = 1;
+
+struct CompileCacheHeader {
+  uint32_t Magic;
+  uint32_t FormatVersion;
+  uint8_t Key[16];
+  uint8_t PayloadDigest[16];
+  uint32_t PayloadSize;
+  uint32_t OutputCount;
+};
+
+struct CompileCacheOutputHeader {
+  uint32_t Kind;     // DXC_OUT_KIND
+  uint32_t CodePage; // Zero for binary outputs.
+  uint32_t NameSize;
+  uint32_t DataSize;
+};
+
+struct CompileCacheCounters {
+  std::atomic<uint64_t> Hits;
+  std::atomic<uint64_t> Misses;
+  std::atomic<uint64_t> Stores;
+};
+
+CompileCacheCounters &GetCompileCacheCounters() {
+  static CompileCacheCounters Counters = {{0}, {0}, {0}};
+  return Counters;
+}
+
+// Outputs that are reproduced from the cache. Timing reports describe the
+// compile that produced them and the stats output describes the lookup.
+bool IsCachedOutputKind(DXC_OUT_KIND Kind) {
+  switch (Kind) {
+  case DXC_OUT_OBJECT:
+  case DXC_OUT_ERRORS:
+  case DXC_OUT_PDB:
+  case DXC_OUT_SHADER_HASH:
+  case DXC_OUT_REFLECTION:
+  case DXC_OUT_ROOT_SIGNATURE:
+  case DXC_OUT_REMARKS:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Options that only name output files or affect reporting; they do not change
+// the compiled outputs, so they are left out of the cache key.
+bool IsOutputOnlyOption(unsigned ID) {
+  switch (ID) {
+  case options::OPT_Fo:
+  case options::OPT_Fc:
+  case options::OPT_Fh:
+  case options::OPT_Fe:
+  case options::OPT_Fre:
+  case options::OPT_Frs:
+  case options::OPT_Fsh:
+  case options::OPT_Vn:
+  case options::OPT_Cc:
+  case options::OPT_Ni:
+  case options::OPT_No:
+  case options::OPT_Lx:
+  case options::OPT_ftime_report:
+  case options::OPT_ftime_trace:
+  case options::OPT_ftime_trace_EQ:
+  case options::OPT_ftime_trace_granularity_EQ:
+  case options::OPT_fcompile_cache_EQ:
+    return true;
+  default:
+    return false;
+  }
+}
+
+std::string GetCompileCacheEntryPath(StringRef CacheDir,
+                                     const dxcutil::CompileCacheKey &Key) {
+  std::string Path = CacheDir.str();
+  if (!Path.empty() && Path.back() != '/' && Path.back() != '\\')
+    Path += '/';
+  Path += Key.ToString();
+  Path += ".dxcc";
+  return Path;
+}
+
+// Writes an entry to a temporary file next to Path and renames it over Path,
+// so that a crash or a concurrent compile never leaves a partial entry under
+// its final name. Concurrent writers of one key write equal entries, so it
+// does not matter which rename wins.
+bool WriteCompileCacheFile(const std::string &Path,
+                           const std::vector<uint8_t> &Data) {
+  static std::atomic<uint32_t> TempCounter(0);
+  std::string TempPath;
+  raw_string_ostream OS(TempPath);
+  OS << Path << '.'
+     << (uint64_t)std::hash<std::thread::id>()(std::this_thread::get_id())
+     << '.'
+     << (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count()
+     << '.' << TempCounter++ << ".tmp";
+  OS.flush();
+  std::wstring WideTempPath =
+      Unicode::UTF8ToWideStringOrThrow(TempPath.c_str());
+  bool Written = SUCCEEDED(
+      WriteBinaryFile(WideTempPath.c_str(), Data.data(), (DWORD)Data.size()));
+#ifdef _WIN32
+  std::wstring WidePath = Unicode::UTF8ToWideStringOrThrow(Path.c_str());
+  if (Written && ::MoveFileExW(WideTempPath.c_str(), WidePath.c_str(),
+                               MOVEFILE_REPLACE_EXISTING))
+    return true;
+  ::DeleteFileW(WideTempPath.c_str());
+#else
+  if (Written && ::rename(TempPath.c_str(), Path.c_str()) == 0)
+    return true;
+  ::unlink(TempPath.c_str());
+#endif
+  return false;
+}
+
+template <typename T> void AppendValue(std::vector<uint8_t> &Buf, const T &V) {
+  const uint8_t *pBytes = reinterpret_cast<const uint8_t *>(&V);
+  Buf.insert(Buf.end(), pBytes, pBytes + sizeof(T));
+}
+
+} // namespace
+
+namespace dxcutil {
+
+std::string CompileCacheKey::ToString() const {
+  SmallString<32> Str;
+  MD5::MD5Result Copy;
+  memcpy(Copy, Digest, sizeof(Copy));
+  MD5::stringifyResult(Copy, Str);
+  return Str.str().str();
+}
+
+void CompileCacheKeyBuilder::AddBytes(const void *pData, size_t size) {
+  m_Hash.update(
+      ArrayRef<uint8_t>(reinterpret_cast<const uint8_t *>(pData), size));
+}
+
+void CompileCacheKeyBuilder::AddString(StringRef Str) {
+  AddUInt32((uint32_t)Str.size());
+  m_Hash.update(Str);
+}
+
+void CompileCacheKeyBuilder::AddUInt32(uint32_t Value) {
+  AddBytes(&Value, sizeof(Value));
+}
+
+void CompileCacheKeyBuilder::AddNormalizedArguments(
+    const llvm::opt::InputArgList &Args) {
+  // Hash option IDs rather than spellings so that '-' and '/' prefixes and
+  // joined/separate forms of the same option produce the same key. Order is
+  // kept since later options may override earlier ones.
+  for (const llvm::opt::Arg *A : Args) {
+    unsigned ID = A->getOption().getID();
+    if (IsOutputOnlyOption(ID))
+      continue;
+    AddUInt32(ID);
+    AddUInt32(A->getNumValues());
+    for (const char *Value : A->getValues())
+      AddString(Value);
+  }
+}
+
+void CompileCacheKeyBuilder::AddVersionInfo(IDxcVersionInfo *pVersionInfo) {
+  UINT32 Major = 0, Minor = 0, Flags = 0;
+  IFT(pVersionInfo->GetVersion(&Major, &Minor));
+  IFT(pVersionInfo->GetFlags(&Flags));
+  AddUInt32(Major);
+  AddUInt32(Minor);
+  AddUInt32(Flags);
+
+  CComPtr<IDxcVersionInfo2> pVersionInfo2;
+  if (SUCCEEDED(pVersionInfo->QueryInterface(&pVersionInfo2))) {
+    UINT32 CommitCount = 0;
+    CComHeapPtr<char> CommitHash;
+    IFT(pVersionInfo2->GetCommitInfo(&CommitCount, &CommitHash));
+    AddUInt32(CommitCount);
+    AddString(CommitHash.m_pData ? CommitHash.m_pData : "");
+  }
+
+  CComPtr<IDxcVersionInfo3> pVersionInfo3;
+  if (SUCCEEDED(pVersionInfo->QueryInterface(&pVersionInfo3))) {
+    CComHeapPtr<char> VersionString;
+    IFT(pVersionInfo3->GetCustomVersionString(&VersionString));
+    AddString(VersionString.m_pData ? VersionString.m_pData : "");
+  }
+}
+
+void CompileCacheKeyBuilder::Finish(CompileCacheKey &Key) {
+  m_Hash.final(Key.Digest);
+}
+
+bool LoadCompileCacheEntry(StringRef CacheDir, const CompileCacheKey &Key,
+                           DxcResult *pResult) {
+  std::wstring Path = Unicode::UTF8ToWideStringOrThrow(
+      GetCompileCacheEntryPath(CacheDir, Key).c_str());
+  CDxcMallocHeapPtr<uint8_t> pData(DxcGetThreadMallocNoRef());
+  DWORD DataSize = 0;
+  if (FAILED(ReadBinaryFile(pData.GetMallocNoRef(), Path.c_str(),
+                            (void **)&pData.m_pData, &DataSize)))
+    return false;
+
+  CompileCacheHeader Header;
+  if (DataSize < sizeof(Header))
+    return false;
+  memcpy(&Header, pData.m_pData, sizeof(Header));
+  if (Header.Magic != CompileCacheMagic ||
+      Header.FormatVersion != CompileCacheFormatVersion ||
+      memcmp(Header.Key, Key.Digest, sizeof(Header.Key)) != 0 ||
+      Header.PayloadSize != DataSize - sizeof(Header))
+    return false;
+
+  const uint8_t *pPayload = pData.m_pData + sizeof(Header);
+  MD5 PayloadHash;
+  MD5::MD5Result PayloadDigest;
+  PayloadHash.update(ArrayRef<uint8_t>(pPayload, Header.PayloadSize));
+  PayloadHash.final(PayloadDigest);
+  if (memcmp(Header.PayloadDigest, PayloadDigest, sizeof(PayloadDigest)) != 0)
+    return false;
+
+  // Validate every record before touching pResult so that a bad entry never
+  // leaves a partially populated result.
+  const uint8_t *pCur = pPayload;
+  const uint8_t *pEnd = pPayload + Header.PayloadSize;
+  std::vector<std::pair<CompileCacheOutputHeader, const uint8_t *>> Records;
+  for (uint32_t i = 0; i < Header.OutputCount; ++i) {
+    CompileCacheOutputHeader Output;
+    if ((size_t)(pEnd - pCur) < sizeof(Output))
+      return false;
+    memcpy(&Output, pCur, sizeof(Output));
+    pCur += sizeof(Output);
+    if (!IsCachedOutputKind((DXC_OUT_KIND)Output.Kind) ||
+        (uint64_t)Output.NameSize + Output.DataSize > (uint64_t)(pEnd - pCur))
+      return false;
+    Records.emplace_back(Output, pCur);
+    pCur += Output.NameSize + Output.DataSize;
+  }
+  if (pCur != pEnd)
+    return false;
+
+  for (auto &Record : Records) {
+    const CompileCacheOutputHeader &Output = Record.first;
+    DXC_OUT_KIND Kind = (DXC_OUT_KIND)Output.Kind;
+    const uint8_t *pName = Record.second;
+    const uint8_t *pOutputData = pName + Output.NameSize;
+    CComPtr<IDxcBlob> pBlob;
+    if (Output.CodePage) {
+      CComPtr<IDxcBlobEncoding> pText;
+      IFT(DxcCreateBlobWithEncodingOnHeapCopy(pOutputData, Output.DataSize,
+                                              Output.CodePage, &pText));
+      pBlob = pText;
+    } else {
+      IFT(DxcCreateBlobOnHeapCopy(pOutputData, Output.DataSize, &pBlob));
+    }
+    IFT(pResult->SetOutputObject(Kind, pBlob));
+    if (Output.NameSize) {
+      IFT(pResult->SetOutputName(
+          Kind, StringRef((const char *)pName, Output.NameSize)));
+    }
+  }
+  IFT(pResult->SetStatusAndPrimaryResult(S_OK, DXC_OUT_OBJECT));
+  return true;
+}
+
+bool StoreCompileCacheEntry(StringRef CacheDir, const CompileCacheKey &Key,
+                            IDxcResult *pResult) {
+  std::vector<uint8_t> Payload;
+  uint32_t OutputCount = 0;
+  for (unsigned i = DXC_OUT_NONE + 1; i <= DXC_OUT_LAST; ++i) {
+    DXC_OUT_KIND Kind = (DXC_OUT_KIND)i;
+    if (!IsCachedOutputKind(Kind) || !pResult->HasOutput(Kind))
+      continue;
+    CComPtr<IDxcBlob> pBlob;
+    CComPtr<IDxcBlobWide> pName;
+    if (FAILED(pResult->GetOutput(Kind, IID_PPV_ARGS(&pBlob), &pName)) ||
+        !pBlob)
+      continue;
+
+    CompileCacheOutputHeader Output = {};
+    Output.Kind = Kind;
+    if (DxcGetOutputType(Kind) == DxcOutputType_Text) {
+      CComPtr<IDxcBlobEncoding> pEncoding;
+      BOOL Known = FALSE;
+      if (SUCCEEDED(pBlob.QueryInterface(&pEncoding)))
+        IFT(pEncoding->GetEncoding(&Known, &Output.CodePage));
+      if (!Known)
+        Output.CodePage = DXC_CP_UTF8;
+    }
+    std::string Name;
+    if (pName)
+      Name = Unicode::WideToUTF8StringOrThrow(pName->GetStringPointer());
+    Output.NameSize = (uint32_t)Name.size();
+    Output.DataSize = (uint32_t)pBlob->GetBufferSize();
+
+    AppendValue(Payload, Output);
+    Payload.insert(Payload.end(), Name.begin(), Name.end());
+    const uint8_t *pBytes = (const uint8_t *)pBlob->GetBufferPointer();
+    Payload.insert(Payload.end(), pBytes, pBytes + Output.DataSize);
+    ++OutputCount;
+  }
+
+  CompileCacheHeader Header = {};
+  Header.Magic = CompileCacheMagic;
+  Header.FormatVersion = CompileCacheFormatVersion;
+  memcpy(Header.Key, Key.Digest, sizeof(Header.Key));
+  Header.PayloadSize = (uint32_t)Payload.size();
+  Header.OutputCount = OutputCount;
+  MD5 PayloadHash;
+  PayloadHash.update(Payload);
+  PayloadHash.final(Header.PayloadDigest);
+
+  std::vector<uint8_t> Entry;
+  Entry.reserve(sizeof(Header) + Payload.size());
+  AppendValue(Entry, Header);
+  Entry.insert(Entry.end(), Payload.begin(), Payload.end());
+
+  return WriteCompileCacheFile(GetCompileCacheEntryPath(CacheDir, Key), Entry);
+}
+
+HRESULT SetCompileCacheStatsOutput(DxcResult *pResult,
+                                   const CompileCacheKey &Key, bool Hit,
+                                   bool Stored,
+                                   const LibraryExportStats *pExports) {
+  CompileCacheCounters &Counters = GetCompileCacheCounters();
+  if (Hit)
+    ++Counters.Hits;
+  else
+    ++Counters.Misses;
+  if (Stored)
+    ++Counters.Stores;
+
+  std::string Stats;
+  raw_string_ostream OS(Stats);
+  OS << "result: " << (Hit ? "hit" : "miss") << "\n"
+     << "key: " << Key.ToString() << "\n"
+     << "hits: " << Counters.Hits.load() << "\n"
+     << "misses: " << Counters.Misses.load() << "\n"
+     << "stores: " << Counters.Stores.load() << "\n";
+  if (pExports)
+    OS << "exports reused: " << pExports->Reused << "\n"
+       << "exports compiled: " << pExports->Compiled << "\n";
+  OS.flush();
+  return pResult->SetOutputString(DXC_OUT_COMPILE_CACHE_STATS, Stats.c_str(),
+                                  Stats.size());
+}
+
+} // namespace dxcutil
@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccompilecache.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Content-addressed on-disk cache of compile results.                       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/dxcapi.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MD5.h"
+
+#include <string>
+
+class DxcResult;
+
+namespace llvm {
+namespace opt {
+class InputArgList;
+}
+} // namespace llvm
+
+namespace dxcutil {
+
+// Digest identifying a compile: everything that can change its outputs is
+// folded in, so two compiles with equal keys produce identical results.
+struct CompileCacheKey {
+  llvm::MD5::MD5Result Digest;
+  std::string ToString() const;
+};
+
+class CompileCacheKeyBuilder {
+public:
+  void AddBytes(const void *pData, size_t size);
+  // Strings are length-prefixed so adjacent values cannot alias.
+  void AddString(llvm::StringRef Str);
+  void AddUInt32(uint32_t Value);
+  // Adds the arguments that affect compile outputs, skipping those that only
+  // name output files or control reporting.
+  void AddNormalizedArguments(const llvm::opt::InputArgList &Args);
+  // Adds compiler version, commit and custom version string when available.
+  void AddVersionInfo(IDxcVersionInfo *pVersionInfo);
+  void Finish(CompileCacheKey &Key);
+
+private:
+  llvm::MD5 m_Hash;
+};
+
+// Fills pResult with the outputs stored for Key in CacheDir. Returns false
+// if there is no entry, or it is unreadable or corrupt.
+bool LoadCompileCacheEntry(llvm::StringRef CacheDir, const CompileCacheKey &Key,
+                           DxcResult *pResult);
+
+// Stores the outputs of a successful compile for Key in CacheDir. Failure to
+// write the entry is not an error; the next compile simply misses again.
+bool StoreCompileCacheEntry(llvm::StringRef CacheDir,
+                            const CompileCacheKey &Key, IDxcResult *pResult);
+
+// How the exports of a library compiled with -fincremental-lib were obtained.
+struct LibraryExportStats {
+  unsigned Reused = 0;   // Loaded from the cache.
+  unsigned Compiled = 0; // Compiled and stored.
+};
+
+// Updates the process-wide hit/miss/store counters and sets the
+// DXC_OUT_COMPILE_CACHE_STATS output on pResult. pExports, if given, adds the
+// per-export results of an incremental library compile.
+HRESULT SetCompileCacheStatsOutput(DxcResult *pResult,
+                                   const CompileCacheKey &Key, bool Hit,
+                                   bool Stored,
+                                   const LibraryExportStats *pExports = nullptr);
+
+} // namespace dxcutil
@@ -20,7 +20,9 @@
 #include "dxc/Support/Path.h"
 #include "dxc/Support/Unicode.h"
 #include "dxc/Support/dxcfilesystem.h"
+#include "clang/Basic/VirtualFileSystem.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "llvm/Support/MemoryBuffer.h"
 
 #ifndef _WIN32
 #include <sys/stat.h>
@@ -165,6 +167,74 @@ void MakeAbsoluteOrCurDirRelativeW(LPCWSTR &Path, std::wstring &PathStorage) {
   }
 }
 
+/// Source buffer that refers to the text of an included file's blob, which it
+/// keeps alive, instead of a copy of it.
+class DxcBlobMemoryBuffer : public llvm::MemoryBuffer {
+private:
+  CComPtr<IDxcBlobUtf8> m_pBlob;
+  std::string m_Name;
+
+public:
+  DxcBlobMemoryBuffer(IDxcBlobUtf8 *pBlob, StringRef Name)
+      : m_pBlob(pBlob), m_Name(Name) {
+    const char *pText = pBlob->GetStringPointer();
+    init(pText, pText + pBlob->GetStringLength(),
+         /*RequiresNullTerminator*/ true);
+  }
+  const char *getBufferIdentifier() const override { return m_Name.c_str(); }
+  BufferKind getBufferKind() const override { return MemoryBuffer_Malloc; }
+};
+
+/// File opened through DxcArgsBlobFileSystem; its buffer is the blob itself.
+class DxcBlobFile : public clang::vfs::File {
+private:
+  std::unique_ptr<clang::vfs::File> m_pFile;
+  CComPtr<IDxcBlobUtf8> m_pBlob;
+
+public:
+  DxcBlobFile(std::unique_ptr<clang::vfs::File> pFile, IDxcBlobUtf8 *pBlob)
+      : m_pFile(std::move(pFile)), m_pBlob(pBlob) {}
+  llvm::ErrorOr<clang::vfs::Status> status() override {
+    return m_pFile->status();
+  }
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+  getBuffer(const Twine &Name, int64_t FileSize, bool RequiresNullTerminator,
+            bool IsVolatile) override {
+    if (m_pBlob->GetStringLength() == 0)
+      return m_pFile->getBuffer(Name, FileSize, RequiresNullTerminator,
+                                IsVolatile);
+    return std::unique_ptr<llvm::MemoryBuffer>(
+        new DxcBlobMemoryBuffer(m_pBlob, Name.str()));
+  }
+  std::error_code close() override { return m_pFile->close(); }
+  void setName(StringRef Name) override { m_pFile->setName(Name); }
+};
+
+class DxcArgsFileSystemImpl;
+
+/// Virtual file system that clang reads sources through. Files are opened as
+/// usual, through DxcArgsFileSystem, but those it holds as blobs are handed to
+/// the source manager without being copied out through Read.
+class DxcArgsBlobFileSystem : public clang::vfs::FileSystem {
+private:
+  DxcArgsFileSystemImpl &m_FileSystem;
+  IntrusiveRefCntPtr<clang::vfs::FileSystem> m_pBase;
+
+public:
+  DxcArgsBlobFileSystem(DxcArgsFileSystemImpl &fileSystem,
+                        IntrusiveRefCntPtr<clang::vfs::FileSystem> pBase)
+      : m_FileSystem(fileSystem), m_pBase(std::move(pBase)) {}
+  llvm::ErrorOr<clang::vfs::Status> status(const Twine &Path) override {
+    return m_pBase->status(Path);
+  }
+  llvm::ErrorOr<std::unique_ptr<clang::vfs::File>>
+  openFileForRead(const Twine &Path) override;
+  clang::vfs::directory_iterator dir_begin(const Twine &Dir,
+                                           std::error_code &EC) override {
+    return m_pBase->dir_begin(Dir, EC);
+  }
+};
+
 /// File system based on API arguments. Support being added incrementally.
 ///
 /// DxcArgsFileSystem emulates a file system to clang/llvm based on API
@@ -198,6 +268,7 @@ private:
   LPCWSTR m_pOutputStreamName;
   std::wstring m_pAbsOutputStreamName;
   CComPtr<IDxcIncludeHandler> m_includeLoader;
+  CComPtr<IDxcCachingIncludeHandler> m_cachingIncludeLoader;
   std::vector<std::wstring> m_searchEntries;
   bool m_bDisplayIncludeProcess;
   UINT32 m_DefaultCodePage;
@@ -266,20 +337,30 @@ private:
         return ERROR_OUT_OF_STRUCTURES;
       }
 
-      CComPtr<::IDxcBlob> fileBlob;
+      CComPtr<IDxcBlobUtf8> fileBlobUtf8;
 
       std::wstring NormalizedFileName = hlsl::NormalizePathW(lpFileName);
-      HRESULT hr =
-          m_includeLoader->LoadSource(NormalizedFileName.c_str(), &fileBlob);
-      if (FAILED(hr)) {
-        return ERROR_UNHANDLED_EXCEPTION;
-      }
-      if (fileBlob.p != nullptr) {
-        CComPtr<IDxcBlobUtf8> fileBlobUtf8;
-        if (FAILED(hlsl::DxcGetBlobAsUtf8(fileBlob, DxcGetThreadMallocNoRef(),
+      if (m_cachingIncludeLoader.p != nullptr) {
+        // The cache hands out files already decoded with our code page.
+        if (FAILED(m_cachingIncludeLoader->LoadSourceUtf8(
+                NormalizedFileName.c_str(), m_DefaultCodePage,
+                &fileBlobUtf8))) {
+          return ERROR_UNHANDLED_EXCEPTION;
+        }
+      } else {
+        CComPtr<::IDxcBlob> fileBlob;
+        HRESULT hr =
+            m_includeLoader->LoadSource(NormalizedFileName.c_str(), &fileBlob);
+        if (FAILED(hr)) {
+          return ERROR_UNHANDLED_EXCEPTION;
+        }
+        if (fileBlob.p != nullptr &&
+            FAILED(hlsl::DxcGetBlobAsUtf8(fileBlob, DxcGetThreadMallocNoRef(),
                                           &fileBlobUtf8, m_DefaultCodePage))) {
           return ERROR_UNHANDLED_EXCEPTION;
         }
+      }
+      if (fileBlobUtf8.p != nullptr) {
         CComPtr<IStream> fileStream;
         if (FAILED(hlsl::CreateReadOnlyBlobStream(fileBlobUtf8, &fileStream))) {
           return ERROR_UNHANDLED_EXCEPTION;
@@ -322,6 +403,8 @@ public:
       : m_pSource(pSource), m_pSourceName(pSourceName),
         m_pOutputStreamName(nullptr), m_includeLoader(pHandler),
         m_bDisplayIncludeProcess(false), m_DefaultCodePage(defaultCodePage) {
+    if (pHandler != nullptr)
+      pHandler->QueryInterface(&m_cachingIncludeLoader);
     MakeAbsoluteOrCurDirRelativeW(m_pSourceName, m_pAbsSourceName);
     IFT(CreateReadOnlyBlobStream(m_pSource, &m_pSourceStream));
     m_includedFiles.push_back(
@@ -330,6 +413,13 @@ public:
   void EnableDisplayIncludeProcess() override {
     m_bDisplayIncludeProcess = true;
   }
+  IDxcBlobUtf8 *FindIncludedBlob(LPCWSTR lpFileName) const {
+    for (const IncludedFile &file : m_includedFiles) {
+      if (0 == wcscmp(lpFileName, file.Name.c_str()))
+        return file.Blob;
+    }
+    return nullptr;
+  }
   void WriteStdErrToStream(raw_string_ostream &s) override {
     s.write((char *)m_pStdErrStream->GetPtr(), m_pStdErrStream->GetPtrSize());
     s.flush();
@@ -395,6 +485,16 @@ public:
         m_searchEntries.emplace_back(std::move(ws));
       }
     }
+
+    // Nothing has been read through the file manager yet, so it can be
+    // recreated to read files through their blobs.
+    if (compiler.hasFileManager()) {
+      compiler.setVirtualFileSystem(
+          new DxcArgsBlobFileSystem(*this, &compiler.getVirtualFileSystem()));
+      compiler.createFileManager();
+      if (compiler.hasSourceManager())
+        compiler.createSourceManager(compiler.getFileManager());
+    }
   }
 
   HRESULT RegisterOutputStream(LPCWSTR pName, IStream *pStream) override {
@@ -795,6 +895,28 @@ public:
   }
 #endif // _WIN32
 };
+
+llvm::ErrorOr<std::unique_ptr<clang::vfs::File>>
+DxcArgsBlobFileSystem::openFileForRead(const Twine &Path) {
+  llvm::ErrorOr<std::unique_ptr<clang::vfs::File>> Result =
+      m_pBase->openFileForRead(Path);
+  if (!Result)
+    return Result;
+
+  // Opening the file loaded it, under the name CreateFileW looks it up by.
+  std::wstring FileName;
+  if (!Unicode::UTF8ToWideString(Path.str().c_str(), &FileName))
+    return Result;
+  LPCWSTR lpFileName = FileName.c_str();
+  std::wstring FileNameStore;
+  MakeAbsoluteOrCurDirRelativeW(lpFileName, FileNameStore);
+  IDxcBlobUtf8 *pBlob = m_FileSystem.FindIncludedBlob(lpFileName);
+  if (pBlob == nullptr)
+    return Result;
+  return std::unique_ptr<clang::vfs::File>(
+      new DxcBlobFile(std::move(Result.get()), pBlob));
+}
+
 } // namespace dxcutil
 
 namespace dxcutil {
@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcincludecache.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the include file cache shared by compiles.                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/Path.h"
+#include "dxc/Support/dxcfilesystem.h"
+#include "dxc/Support/microcom.h"
+#include "dxc/dxcapi.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+using namespace hlsl;
+
+namespace {
+
+// FILETIME counts 100ns intervals from 1601, 11644473600s before 1970.
+UINT64 GetCurrentFileTime() {
+  typedef std::chrono::duration<UINT64, std::ratio<1, 10000000>> FileTimeUnits;
+  return std::chrono::duration_cast<FileTimeUnits>(
+             std::chrono::system_clock::now().time_since_epoch())
+             .count() +
+         116444736000000000ULL;
+}
+
+} // namespace
+
+class DxcIncludeCache : public IDxcIncludeCache {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+
+  struct Entry {
+    CComPtr<IDxcBlobUtf8> Blob;
+    UINT64 LoadTime;
+  };
+  // Files are decoded with the code page of the compile that loads them, so
+  // the same file may be cached once per code page.
+  typedef std::pair<std::wstring, UINT32> EntryKey;
+
+  // Guards the fields below.
+  std::mutex m_mutex;
+  std::map<EntryKey, Entry> m_entries;
+  // Bumped by every invalidation, so that a load which started before one
+  // does not add back what it dropped.
+  UINT64 m_generation = 0;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcIncludeCache)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid,
+                                           void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcIncludeCache>(this, iid, ppvObject);
+  }
+
+  HRESULT Load(IDxcIncludeHandler *pIncludeHandler, LPCWSTR pFilename,
+               UINT32 defaultCodePage, IDxcBlobUtf8 **ppResult);
+
+  // IDxcIncludeCache
+  HRESULT STDMETHODCALLTYPE
+  CreateIncludeHandler(IDxcIncludeHandler *pIncludeHandler,
+                       IDxcIncludeHandler **ppResult) override;
+  HRESULT STDMETHODCALLTYPE Invalidate(LPCWSTR pFilename) override;
+  HRESULT STDMETHODCALLTYPE InvalidateIfModified(LPCWSTR pFilename,
+                                                 UINT64 lastWriteTime) override;
+};
+
+class DxcCachingIncludeHandler : public IDxcCachingIncludeHandler {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<DxcIncludeCache> m_pCache;
+  CComPtr<IDxcIncludeHandler> m_pIncludeHandler;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_ALLOC(DxcCachingIncludeHandler)
+  DxcCachingIncludeHandler(IMalloc *pMalloc, DxcIncludeCache *pCache,
+                           IDxcIncludeHandler *pIncludeHandler)
+      : m_pMalloc(pMalloc), m_pCache(pCache),
+        m_pIncludeHandler(pIncludeHandler) {}
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid,
+                                           void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcCachingIncludeHandler,
+                                 IDxcIncludeHandler>(this, iid, ppvObject);
+  }
+
+  HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR pFilename,
+                                       IDxcBlob **ppIncludeSource) override {
+    if (ppIncludeSource == nullptr)
+      return E_POINTER;
+    CComPtr<IDxcBlobUtf8> pSource;
+    IFR(LoadSourceUtf8(pFilename, CP_ACP, &pSource));
+    *ppIncludeSource = pSource.Detach();
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  LoadSourceUtf8(LPCWSTR pFilename, UINT32 defaultCodePage,
+                 IDxcBlobUtf8 **ppIncludeSource) override {
+    return m_pCache->Load(m_pIncludeHandler, pFilename, defaultCodePage,
+                          ppIncludeSource);
+  }
+};
+
+HRESULT DxcIncludeCache::Load(IDxcIncludeHandler *pIncludeHandler,
+                              LPCWSTR pFilename, UINT32 defaultCodePage,
+                              IDxcBlobUtf8 **ppResult) {
+  if (pFilename == nullptr || ppResult == nullptr)
+    return E_POINTER;
+  *ppResult = nullptr;
+
+  try {
+    EntryKey key(NormalizePathW(pFilename), defaultCodePage);
+    UINT64 generation;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = m_entries.find(key);
+      if (it != m_entries.end()) {
+        *ppResult = it->second.Blob;
+        (*ppResult)->AddRef();
+        return S_OK;
+      }
+      generation = m_generation;
+    }
+
+    // Load without holding the lock, so that misses on other files proceed
+    // concurrently. Taking the time first errs towards treating the entry as
+    // older than a write that raced with the load.
+    UINT64 loadTime = GetCurrentFileTime();
+    CComPtr<IDxcBlob> pBlob;
+    IFR(pIncludeHandler->LoadSource(pFilename, &pBlob));
+    if (pBlob == nullptr)
+      return S_OK;
+    CComPtr<IDxcBlobUtf8> pBlobUtf8;
+    IFR(DxcGetBlobAsUtf8(pBlob, m_pMalloc, &pBlobUtf8, defaultCodePage));
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (generation == m_generation) {
+        Entry &entry = m_entries[key];
+        if (entry.Blob == nullptr) {
+          entry.Blob = pBlobUtf8;
+          entry.LoadTime = loadTime;
+        }
+      }
+    }
+    *ppResult = pBlobUtf8.Detach();
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT STDMETHODCALLTYPE DxcIncludeCache::CreateIncludeHandler(
+    IDxcIncludeHandler *pIncludeHandler, IDxcIncludeHandler **ppResult) {
+  if (pIncludeHandler == nullptr || ppResult == nullptr)
+    return E_POINTER;
+  *ppResult = nullptr;
+  CComPtr<DxcCachingIncludeHandler> pHandler =
+      DxcCachingIncludeHandler::Alloc(m_pMalloc, this, pIncludeHandler);
+  IFROOM(pHandler.p);
+  *ppResult = pHandler.Detach();
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DxcIncludeCache::Invalidate(LPCWSTR pFilename) {
+  try {
+    std::wstring name;
+    if (pFilename != nullptr)
+      name = NormalizePathW(pFilename);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_generation;
+    if (pFilename == nullptr) {
+      m_entries.clear();
+      return S_OK;
+    }
+    // Entries for one file are adjacent, one per code page.
+    auto it = m_entries.lower_bound(EntryKey(name, 0));
+    while (it != m_entries.end() && it->first.first == name)
+      it = m_entries.erase(it);
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT STDMETHODCALLTYPE DxcIncludeCache::InvalidateIfModified(
+    LPCWSTR pFilename, UINT64 lastWriteTime) {
+  if (pFilename == nullptr)
+    return E_POINTER;
+  try {
+    std::wstring name = NormalizePathW(pFilename);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_generation;
+    auto it = m_entries.lower_bound(EntryKey(name, 0));
+    while (it != m_entries.end() && it->first.first == name) {
+      if (it->second.LoadTime < lastWriteTime)
+        it = m_entries.erase(it);
+      else
+        ++it;
+    }
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT CreateDxcIncludeCache(REFIID riid, LPVOID *ppv) {
+  try {
+    CComPtr<DxcIncludeCache> result(
+        DxcIncludeCache::Alloc(DxcGetThreadMallocNoRef()));
+    IFROOM(result.p);
+    return result.p->QueryInterface(riid, ppv);
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
@@ -0,0 +1,252 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcincrementallib.cpp                                                     //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Per-export fingerprints for incremental library compilation.              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxcincrementallib.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Attr.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/HlslTypes.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Lex/Lexer.h"
+#include "clang/Sema/SemaConsumer.h"
+#include "clang/Sema/SemaHLSL.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
+#include <algorithm>
+
+using namespace clang;
+using namespace llvm;
+
+namespace {
+
+// Byte range of a function definition in the main buffer, including any
+// attributes written before it.
+struct FunctionRange {
+  unsigned Begin;
+  unsigned End;
+};
+
+// Adds the tokens of the main buffer in [Begin, End), separated by single
+// spaces and with line directives dropped, so that edits which only move or
+// reindent code do not change the key. Tokens are added as written, so the
+// contents of string literals are kept.
+void AddNormalizedText(dxcutil::CompileCacheKeyBuilder &Builder,
+                       const SourceManager &SM, const LangOptions &LangOpts,
+                       unsigned Begin, unsigned End) {
+  FileID MainFile = SM.getMainFileID();
+  StringRef Buffer = SM.getBufferData(MainFile);
+  Lexer Lex(SM.getLocForStartOfFile(MainFile), LangOpts, Buffer.begin(),
+            Buffer.begin() + Begin, Buffer.end());
+  std::string Normalized;
+  Normalized.reserve(End - Begin);
+  bool AfterHash = false;
+  bool InLineDirective = false;
+  Token Tok;
+  for (;;) {
+    Lex.LexFromRawLexer(Tok);
+    unsigned Offset = SM.getFileOffset(Tok.getLocation());
+    if (Tok.is(tok::eof) || Offset >= End)
+      break;
+    if (Tok.isAtStartOfLine()) {
+      AfterHash = false;
+      InLineDirective = false;
+    }
+    if (InLineDirective)
+      continue;
+    if (Tok.isAtStartOfLine() && Tok.is(tok::hash)) {
+      AfterHash = true;
+      continue;
+    }
+    if (AfterHash) {
+      // Both '#line N' and '# N' are line directives.
+      AfterHash = false;
+      if (Tok.is(tok::numeric_constant) ||
+          (Tok.is(tok::raw_identifier) && Tok.getRawIdentifier() == "line")) {
+        InLineDirective = true;
+        continue;
+      }
+      Normalized += "# ";
+    }
+    Normalized.append(Buffer.data() + Offset, Tok.getLength());
+    Normalized += ' ';
+  }
+  if (AfterHash)
+    Normalized += "# ";
+  Builder.AddString(Normalized);
+}
+
+// Exports compiled apart each get their own copy of the internal functions
+// and variables they use, so they must not share mutable state through them.
+// Subobjects are dropped by the linker.
+bool IsSplittableDecl(const Decl *D) {
+  if (const VarDecl *VD = dyn_cast<VarDecl>(D)) {
+    if (hlsl::IsHLSLSubobjectType(VD->getType()))
+      return false;
+    if (VD->hasAttr<HLSLGroupSharedAttr>())
+      return false;
+    if ((VD->getStorageClass() == SC_Static || VD->isStaticLocal()) &&
+        !VD->getType().isConstQualified())
+      return false;
+  }
+  if (const DeclContext *DC = dyn_cast<DeclContext>(D)) {
+    for (const Decl *Child : DC->decls())
+      if (!IsSplittableDecl(Child))
+        return false;
+  }
+  return true;
+}
+
+class LibraryExportFingerprintConsumer : public SemaConsumer {
+public:
+  LibraryExportFingerprintConsumer(
+      const dxcutil::CompileCacheKey &ConfigKey,
+      std::vector<dxcutil::LibraryExportKey> &Exports)
+      : m_ConfigKey(ConfigKey), m_Exports(Exports), m_pSema(nullptr) {}
+
+  void InitializeSema(Sema &S) override { m_pSema = &S; }
+  void ForgetSema() override { m_pSema = nullptr; }
+
+  void HandleTranslationUnit(ASTContext &Ctx) override {
+    if (!m_pSema || Ctx.getDiagnostics().hasErrorOccurred())
+      return;
+    TranslationUnitDecl *TU = Ctx.getTranslationUnitDecl();
+    if (!IsSplittableDecl(TU))
+      return;
+
+    std::vector<std::pair<FunctionDecl *, std::vector<FunctionDecl *>>>
+        Exports;
+    hlsl::GetExportedFunctionCallees(m_pSema, Exports);
+    if (Exports.empty())
+      return;
+
+    SourceManager &SM = Ctx.getSourceManager();
+    if (!CollectFunctionRanges(TU, SM, Ctx.getLangOpts()))
+      return;
+
+    // Group exports by name, since -exports selects all overloads.
+    MapVector<StringRef, SmallPtrSet<FunctionDecl *, 16>> Groups;
+    for (auto &Export : Exports) {
+      FunctionDecl *FD = Export.first;
+      if (!FD->getDeclContext()->isTranslationUnit() ||
+          FD->hasAttr<HLSLPatchConstantFuncAttr>() || !FD->getIdentifier())
+        return;
+      Groups[FD->getName()].insert(Export.second.begin(), Export.second.end());
+    }
+
+    // Text outside of function definitions: globals, types, declarations.
+    const LangOptions &LangOpts = Ctx.getLangOpts();
+    unsigned BufferSize = SM.getBufferData(SM.getMainFileID()).size();
+    std::vector<FunctionRange> Ranges;
+    for (auto &It : m_Ranges)
+      Ranges.push_back(It.second);
+    std::sort(Ranges.begin(), Ranges.end(),
+              [](const FunctionRange &A, const FunctionRange &B) {
+                return A.Begin < B.Begin;
+              });
+    dxcutil::CompileCacheKeyBuilder CommonBuilder;
+    unsigned Offset = 0;
+    for (const FunctionRange &Range : Ranges) {
+      AddNormalizedText(CommonBuilder, SM, LangOpts, Offset, Range.Begin);
+      Offset = Range.End;
+    }
+    AddNormalizedText(CommonBuilder, SM, LangOpts, Offset, BufferSize);
+    dxcutil::CompileCacheKey CommonKey;
+    CommonBuilder.Finish(CommonKey);
+
+    for (auto &Group : Groups) {
+      // Reachable definitions outside m_Ranges, such as methods, are part of
+      // the common text.
+      std::vector<FunctionRange> Reachable;
+      for (FunctionDecl *FD : Group.second) {
+        const FunctionDecl *Def = nullptr;
+        if (!FD->hasBody(Def))
+          continue;
+        auto It = m_Ranges.find(Def);
+        if (It != m_Ranges.end())
+          Reachable.push_back(It->second);
+      }
+      std::sort(Reachable.begin(), Reachable.end(),
+                [](const FunctionRange &A, const FunctionRange &B) {
+                  return A.Begin < B.Begin;
+                });
+
+      dxcutil::CompileCacheKeyBuilder Builder;
+      Builder.AddBytes(m_ConfigKey.Digest, sizeof(m_ConfigKey.Digest));
+      Builder.AddBytes(CommonKey.Digest, sizeof(CommonKey.Digest));
+      Builder.AddString(Group.first);
+      for (const FunctionRange &Range : Reachable)
+        AddNormalizedText(Builder, SM, LangOpts, Range.Begin, Range.End);
+
+      dxcutil::LibraryExportKey Export;
+      Export.Name = Group.first;
+      Builder.Finish(Export.Key);
+      m_Exports.push_back(std::move(Export));
+    }
+  }
+
+private:
+  // Records the ranges of the non-template function definitions at namespace
+  // scope. Returns false if one is not entirely within the main buffer.
+  bool CollectFunctionRanges(DeclContext *DC, SourceManager &SM,
+                             const LangOptions &LangOpts) {
+    FileID MainFile = SM.getMainFileID();
+    for (Decl *D : DC->decls()) {
+      if (NamespaceDecl *NS = dyn_cast<NamespaceDecl>(D)) {
+        if (!CollectFunctionRanges(NS, SM, LangOpts))
+          return false;
+        continue;
+      }
+      FunctionDecl *FD = dyn_cast<FunctionDecl>(D);
+      if (!FD || FD->isImplicit() || !FD->doesThisDeclarationHaveABody() ||
+          FD->getDescribedFunctionTemplate())
+        continue;
+
+      SourceLocation Begin = FD->getSourceRange().getBegin();
+      for (const Attr *A : FD->attrs()) {
+        SourceLocation AttrBegin = A->getRange().getBegin();
+        if (!A->isImplicit() && AttrBegin.isValid() &&
+            SM.isBeforeInTranslationUnit(AttrBegin, Begin))
+          Begin = AttrBegin;
+      }
+      SourceLocation End =
+          Lexer::getLocForEndOfToken(FD->getLocEnd(), 0, SM, LangOpts);
+      if (Begin.isInvalid() || End.isInvalid() || !Begin.isFileID() ||
+          !End.isFileID() || SM.getFileID(Begin) != MainFile ||
+          SM.getFileID(End) != MainFile)
+        return false;
+
+      FunctionRange Range = {SM.getFileOffset(Begin), SM.getFileOffset(End)};
+      m_Ranges[FD] = Range;
+    }
+    return true;
+  }
+
+  const dxcutil::CompileCacheKey &m_ConfigKey;
+  std::vector<dxcutil::LibraryExportKey> &m_Exports;
+  Sema *m_pSema;
+  DenseMap<const FunctionDecl *, FunctionRange> m_Ranges;
+};
+
+} // namespace
+
+namespace dxcutil {
+
+std::unique_ptr<ASTConsumer>
+LibraryExportFingerprintAction::CreateASTConsumer(CompilerInstance &CI,
+                                                  StringRef InFile) {
+  m_Exports.clear();
+  return llvm::make_unique<LibraryExportFingerprintConsumer>(m_ConfigKey,
+                                                             m_Exports);
+}
+
+} // namespace dxcutil
@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcincrementallib.h                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Per-export fingerprints for incremental library compilation.              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxccompilecache.h"
+#include "clang/Frontend/FrontendAction.h"
+
+#include <string>
+#include <vector>
+
+namespace dxcutil {
+
+// A unit of incremental library compilation: the exported functions sharing
+// Name, compiled on their own with -exports Name. Key covers everything the
+// compiled export depends on.
+struct LibraryExportKey {
+  std::string Name;
+  CompileCacheKey Key;
+};
+
+// Parses a preprocessed library and fingerprints each export from the text of
+// the function definitions it can reach, plus all text outside of function
+// definitions, so that editing a function body only changes the keys of the
+// exports that call it. ConfigKey folds in the arguments and versions.
+//
+// Libraries whose exports cannot be compiled apart without changing their
+// meaning, such as those sharing mutable globals or declaring subobjects, are
+// reported as not splittable.
+class LibraryExportFingerprintAction : public clang::ASTFrontendAction {
+public:
+  LibraryExportFingerprintAction(const CompileCacheKey &ConfigKey)
+      : m_ConfigKey(ConfigKey) {}
+
+  // Valid after Execute; empty if the library is not splittable or failed to
+  // parse.
+  const std::vector<LibraryExportKey> &GetExports() const { return m_Exports; }
+
+protected:
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(clang::CompilerInstance &CI,
+                    llvm::StringRef InFile) override;
+
+private:
+  CompileCacheKey m_ConfigKey;
+  std::vector<LibraryExportKey> m_Exports;
+};
+
+} // namespace dxcutil
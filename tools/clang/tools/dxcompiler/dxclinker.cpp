@@ -219,8 +219,20 @@ DxcLinker::RegisterLibrary(LPCWSTR pLibName, // Name of the library.
       }
     }
 
+    // The linker keeps the bitcode of the registered module to link entries
+    // in parallel; the blob is kept alive below.
+    const DxilPartHeader *pProgramPart = hlsl::GetDxilPartByType(
+        pHeader, pDebugModule ? hlsl::DxilFourCC::DFCC_ShaderDebugInfoDXIL
+                              : hlsl::DxilFourCC::DFCC_DXIL);
+    const char *pIL = nullptr;
+    uint32_t ILLength = 0;
+    GetDxilProgramBitcode(reinterpret_cast<const DxilProgramHeader *>(
+                              GetDxilPartData(pProgramPart)),
+                          &pIL, &ILLength);
+
     if (m_pLinker->RegisterLib(pUtf8LibName.m_psz, std::move(pModule),
-                               std::move(pDebugModule))) {
+                               std::move(pDebugModule),
+                               StringRef(pIL, ILLength))) {
       m_blobs.emplace_back(pBlob);
       return S_OK;
     } else {
@@ -25,6 +25,7 @@
 #include "clang/Sema/SemaHLSL.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/PassProfiler.h"
 #include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Transforms/Utils/Cloning.h"
@@ -48,17 +49,22 @@
 #include "dxc/Support/Unicode.h"
 #include "dxc/Support/dxcapi.impl.h"
 #include "dxc/Support/dxcapi.use.h"
+#include "dxc/Support/dxcarena.h"
 #include "dxc/Support/microcom.h"
 
 #ifdef _WIN32
 #include "dxcetw.h"
 #endif
+#include "dxccompilecache.h"
+#include "dxcincrementallib.h"
 #include "dxcompileradapter.h"
 #include "dxcshadersourceinfo.h"
 #include "dxcversion.inc"
 #include "dxillib.h"
 #include <algorithm>
 #include <cfloat>
+#include <mutex>
+#include <unordered_map>
 
 // SPIRV change starts
 #ifdef ENABLE_SPIRV_CODEGEN
@@ -82,6 +88,10 @@ using namespace clang;
 using namespace hlsl;
 using std::string;
 
+// This declaration is used to link the exports of incremental library
+// compiles.
+HRESULT CreateDxcLinker(REFIID riid, LPVOID *ppv);
+
 static bool ShouldBeCopiedIntoPDB(UINT32 FourCC) {
   switch (FourCC) {
   case hlsl::DFCC_ShaderDebugName:
@@ -445,6 +455,311 @@ static void CreateDefineStrings(const DxcDefine *pDefines, UINT defineCount,
   }
 }
 
+// Only full compiles whose outputs depend on nothing beyond the source, its
+// includes and the arguments can be served from the compile cache.
+static bool IsCompileCacheable(const hlsl::options::DxcOpts &opts) {
+  // Pass profiles and arena statistics are only meaningful if the compile
+  // actually runs.
+  if (!opts.Preprocess.empty() || opts.AstDump || opts.OptDump ||
+      opts.DumpDependencies || opts.VerifyDiagnostics || opts.PassProfile ||
+      opts.ArenaAlloc ||
+      opts.CodeGenHighLevel || opts.IsRootSignatureProfile() || opts.GenMetal)
+    return false;
+#ifdef ENABLE_SPIRV_CODEGEN
+  if (opts.GenSPIRV)
+    return false;
+#endif
+  // These read extra files through the include handler.
+  return opts.ImportBindingTable.empty() && opts.RootSignatureSource.empty() &&
+         opts.PrivateSource.empty();
+}
+
+// Whether a compile cache miss can compile the text that was preprocessed to
+// compute the key, instead of preprocessing the source again. Debug info and
+// source-based hashes need the original sources, and language extensions may
+// read macros (semantic defines, root signature define) after preprocessing.
+static bool CanCompilePreprocessedSource(
+    const hlsl::options::DxcOpts &opts,
+    const DxcLangExtensionsHelper &langExtensionsHelper) {
+  return !opts.GeneratePDB() && !opts.DebugNameForSource &&
+         !opts.DisplayIncludeProcess && opts.RootSignatureDefine.empty() &&
+         langExtensionsHelper.GetSemanticDefines().empty() &&
+         langExtensionsHelper.GetNonOptSemanticDefines().empty();
+}
+
+// Library compiles that -fincremental-lib can split into one compile per
+// export. Exports must keep their default linkage, and debug information
+// would record the sources of each export compile separately.
+static bool IsIncrementalLibCompile(const hlsl::options::DxcOpts &opts) {
+  return opts.IncrementalLib && opts.IsLibraryProfile() &&
+         opts.TargetProfile != "lib_6_x" && opts.Exports.empty() &&
+         !opts.ExportShadersOnly && opts.DefaultLinkage.empty() &&
+         !opts.GeneratePDB() && !opts.DebugNameForSource;
+}
+
+// Allocates straight from an IMalloc, for containers that must not allocate
+// through the thread allocator.
+template <typename T> struct DxcDirectAllocator {
+  typedef T value_type;
+  IMalloc *pMalloc;
+
+  DxcDirectAllocator(IMalloc *pMalloc) : pMalloc(pMalloc) {}
+  template <typename U>
+  DxcDirectAllocator(const DxcDirectAllocator<U> &Other)
+      : pMalloc(Other.pMalloc) {}
+
+  T *allocate(size_t n) {
+    void *p = pMalloc->Alloc(n * sizeof(T));
+    if (p == nullptr)
+      throw std::bad_alloc();
+    return (T *)p;
+  }
+  void deallocate(T *p, size_t) { pMalloc->Free(p); }
+
+  template <typename U>
+  bool operator==(const DxcDirectAllocator<U> &Other) const {
+    return pMalloc == Other.pMalloc;
+  }
+  template <typename U>
+  bool operator!=(const DxcDirectAllocator<U> &Other) const {
+    return pMalloc != Other.pMalloc;
+  }
+};
+
+// Forwards to another allocator, counting the bytes requested through it. A
+// reallocation counts only the bytes it grows the block by, so the size of
+// each block allocated through this allocator is tracked; IMalloc::GetSize
+// is not implemented by every allocator.
+class DxcCountingMalloc : public IMalloc {
+private:
+  typedef std::unordered_map<
+      void *, SIZE_T, std::hash<void *>, std::equal_to<void *>,
+      DxcDirectAllocator<std::pair<void *const, SIZE_T>>>
+      BlockSizeMap;
+
+  DXC_MICROCOM_TM_REF_FIELDS()
+  std::atomic<uint64_t> m_AllocatedBytes{0};
+  std::mutex m_BlockSizesMutex;
+  BlockSizeMap m_BlockSizes;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DxcCountingMalloc(IMalloc *pMalloc)
+      : m_dwRef(0), m_pMalloc(pMalloc),
+        m_BlockSizes(0, std::hash<void *>(), std::equal_to<void *>(),
+                     DxcDirectAllocator<std::pair<void *const, SIZE_T>>(
+                         pMalloc)) {}
+  DXC_MICROCOM_TM_ALLOC(DxcCountingMalloc)
+
+  STDMETHODIMP QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IMalloc>(this, iid, ppvObject);
+  }
+  void *STDMETHODCALLTYPE Alloc(SIZE_T cb) override {
+    void *pv = m_pMalloc->Alloc(cb);
+    if (pv == nullptr)
+      return nullptr;
+    m_AllocatedBytes += cb;
+    std::lock_guard<std::mutex> Lock(m_BlockSizesMutex);
+    m_BlockSizes[pv] = cb;
+    return pv;
+  }
+  void *STDMETHODCALLTYPE Realloc(void *pv, SIZE_T cb) override {
+    std::lock_guard<std::mutex> Lock(m_BlockSizesMutex);
+    // Blocks allocated before the counting started are counted in full.
+    SIZE_T OldSize = 0;
+    auto It = m_BlockSizes.find(pv);
+    if (It != m_BlockSizes.end()) {
+      OldSize = It->second;
+      m_BlockSizes.erase(It);
+    }
+    void *pNew = m_pMalloc->Realloc(pv, cb);
+    if (pNew == nullptr) {
+      // A failed reallocation leaves the old block in place.
+      if (cb != 0 && OldSize != 0)
+        m_BlockSizes[pv] = OldSize;
+      return nullptr;
+    }
+    if (cb > OldSize)
+      m_AllocatedBytes += cb - OldSize;
+    m_BlockSizes[pNew] = cb;
+    return pNew;
+  }
+  void STDMETHODCALLTYPE Free(void *pv) override {
+    {
+      std::lock_guard<std::mutex> Lock(m_BlockSizesMutex);
+      m_BlockSizes.erase(pv);
+    }
+    m_pMalloc->Free(pv);
+  }
+  SIZE_T STDMETHODCALLTYPE GetSize(void *pv) override {
+    return m_pMalloc->GetSize(pv);
+  }
+  int STDMETHODCALLTYPE DidAlloc(void *pv) override {
+    return m_pMalloc->DidAlloc(pv);
+  }
+  void STDMETHODCALLTYPE HeapMinimize(void) override {
+    m_pMalloc->HeapMinimize();
+  }
+
+  uint64_t GetAllocatedBytes() const { return m_AllocatedBytes; }
+};
+
+// Profiles the passes run on this thread while it is alive, for -fpass-profile.
+// Allocations are counted by routing the thread allocator through a
+// DxcCountingMalloc.
+class DxcPassProfiler {
+private:
+  CComPtr<DxcCountingMalloc> m_pCountingMalloc;
+  DxcThreadMalloc m_TM;
+
+public:
+  DxcPassProfiler(IMalloc *pMalloc, bool enable)
+      : m_pCountingMalloc(enable && !llvm::passProfilerEnabled()
+                              ? DxcCountingMalloc::Alloc(pMalloc)
+                              : nullptr),
+        m_TM(m_pCountingMalloc ? m_pCountingMalloc.p : pMalloc) {
+    if (m_pCountingMalloc) {
+      DxcCountingMalloc *pCounter = m_pCountingMalloc;
+      llvm::passProfilerInitialize(
+          [pCounter]() { return pCounter->GetAllocatedBytes(); });
+    }
+  }
+  ~DxcPassProfiler() {
+    if (m_pCountingMalloc)
+      llvm::passProfilerCleanup();
+  }
+
+  HRESULT SetOutput(DxcResult *pResult) {
+    if (!m_pCountingMalloc)
+      return S_OK;
+    std::string Profile;
+    raw_string_ostream OS(Profile);
+    llvm::passProfilerWrite(OS);
+    OS.flush();
+    return pResult->SetOutputString(DXC_OUT_PASS_PROFILE, Profile.c_str(),
+                                    Profile.size());
+  }
+};
+
+// Keeps the LLVM contexts of finished compiles for -freuse-llvm-context, so
+// that later compiles skip rebuilding their types, constants and tables.
+class DxcLLVMContextPool {
+private:
+  // Types and metadata of past compiles accumulate in a context, so it is
+  // only recycled a limited number of times.
+  static const unsigned kMaxUses = 32;
+  static const unsigned kMaxContexts = 4;
+
+  struct Entry {
+    std::unique_ptr<llvm::LLVMContext> Context;
+    unsigned Uses;
+  };
+  std::mutex m_mutex;
+  std::vector<Entry> m_contexts;
+
+public:
+  std::unique_ptr<llvm::LLVMContext> Acquire(unsigned &Uses) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_contexts.empty()) {
+        Entry entry = std::move(m_contexts.back());
+        m_contexts.pop_back();
+        Uses = entry.Uses;
+        return std::move(entry.Context);
+      }
+    }
+    Uses = 0;
+    return llvm::make_unique<llvm::LLVMContext>();
+  }
+
+  // Keeps Context if nothing still uses it; otherwise it is destroyed.
+  void Release(std::unique_ptr<llvm::LLVMContext> Context,
+               unsigned Uses) throw() {
+    try {
+      if (++Uses >= kMaxUses || !Context->resetForReuse())
+        return;
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_contexts.size() < kMaxContexts)
+        m_contexts.push_back({std::move(Context), Uses});
+    } catch (...) {
+    }
+  }
+};
+
+// The LLVM context of one compile, taken from the pool if reuse is enabled.
+class DxcCompileLLVMContext {
+private:
+  DxcLLVMContextPool *m_pPool;
+  unsigned m_Uses = 0;
+  std::unique_ptr<llvm::LLVMContext> m_Context;
+
+public:
+  DxcCompileLLVMContext(DxcLLVMContextPool &pool, bool reuse)
+      : m_pPool(reuse ? &pool : nullptr),
+        m_Context(reuse ? pool.Acquire(m_Uses)
+                        : llvm::make_unique<llvm::LLVMContext>()) {}
+  ~DxcCompileLLVMContext() {
+    if (m_pPool)
+      m_pPool->Release(std::move(m_Context), m_Uses);
+  }
+
+  llvm::LLVMContext &get() { return *m_Context; }
+};
+
+// Reports the statistics of the -farena-alloc arena, for DXC_OUT_ALLOCATOR_STATS.
+static HRESULT SetArenaStatsOutput(DxcResult *pResult,
+                                   DxcArenaMalloc *pArena) {
+  DxcArenaStats Stats;
+  pArena->GetStats(&Stats);
+  std::string Text;
+  raw_string_ostream OS(Text);
+  OS << "allocations: " << Stats.AllocCount << "\n"
+     << "allocated bytes: " << Stats.AllocatedBytes << "\n"
+     << "peak live bytes: " << Stats.PeakLiveBytes << "\n"
+     << "peak reserved bytes: " << Stats.PeakReservedBytes << "\n"
+     << "chunks: " << Stats.ChunkCount << "\n"
+     << "parent allocations: " << Stats.ParentAllocCount << "\n";
+  OS.flush();
+  return pResult->SetOutputString(DXC_OUT_ALLOCATOR_STATS, Text.c_str(),
+                                  Text.size());
+}
+
+// Replaces pObject, if it is a blob allocated from pArena or holding memory
+// from it, with a copy allocated from pMalloc.
+template <typename T>
+static HRESULT CopyBlobOutOfArena(CComPtr<T> &pObject, DxcArenaMalloc *pArena,
+                                  IMalloc *pMalloc) {
+  CComPtr<IDxcBlob> pBlob;
+  if (!pObject || FAILED(pObject.QueryInterface(&pBlob)))
+    return S_OK;
+  if (!pArena->Owns(pBlob.p) && !pArena->Owns(pBlob->GetBufferPointer()))
+    return S_OK;
+  BOOL encodingKnown = FALSE;
+  UINT32 codePage = CP_ACP;
+  CComPtr<IDxcBlobEncoding> pEncoding;
+  if (SUCCEEDED(pBlob.QueryInterface(&pEncoding)))
+    IFR(pEncoding->GetEncoding(&encodingKnown, &codePage));
+  CComPtr<IDxcBlobEncoding> pCopy;
+  IFR(hlsl::DxcCreateBlob(pBlob->GetBufferPointer(), pBlob->GetBufferSize(),
+                          /*bPinned*/ false, /*bCopy*/ true,
+                          encodingKnown != FALSE, codePage, pMalloc, &pCopy));
+  pObject.Release();
+  return pCopy.QueryInterface(&pObject);
+}
+
+// Copies the outputs of a -farena-alloc compile out of the arena, so that a
+// result kept after the compile does not keep the arena's chunks alive.
+static HRESULT CopyOutputsOutOfArena(DxcResult *pResult,
+                                     DxcArenaMalloc *pArena,
+                                     IMalloc *pMalloc) {
+  for (unsigned i = DXC_OUT_NONE + 1; i <= kNumDxcOutputTypes; i++) {
+    DxcOutputObject *pOutput = pResult->Output((DXC_OUT_KIND)i);
+    IFR(CopyBlobOutOfArena(pOutput->object, pArena, pMalloc));
+    IFR(CopyBlobOutOfArena(pOutput->name, pArena, pMalloc));
+  }
+  return S_OK;
+}
+
 static HRESULT ErrorWithString(const std::string &error, REFIID riid,
                                void **ppResult) {
   CComPtr<IDxcResult> pResult;
@@ -457,6 +772,7 @@ static HRESULT ErrorWithString(const std::string &error, REFIID riid,
 }
 
 class DxcCompiler : public IDxcCompiler3,
+                    public IDxcStreamPreprocessor,
                     public IDxcLangExtensions3,
                     public IDxcContainerEvent,
                     public IDxcVersionInfo3,
@@ -471,6 +787,7 @@ private:
   DxcLangExtensionsHelper m_langExtensionsHelper;
   CComPtr<IDxcContainerEventsHandler> m_pDxcContainerEventsHandler;
   DxcCompilerAdapter m_DxcCompilerAdapter;
+  DxcLLVMContextPool m_contextPool;
 
 public:
   DxcCompiler(IMalloc *pMalloc)
@@ -497,7 +814,8 @@ public:
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid,
                                            void **ppvObject) override {
-    HRESULT hr = DoBasicQueryInterface<IDxcCompiler3, IDxcLangExtensions,
+    HRESULT hr = DoBasicQueryInterface<IDxcCompiler3, IDxcStreamPreprocessor,
+                                       IDxcLangExtensions,
                                        IDxcLangExtensions2, IDxcLangExtensions3,
                                        IDxcContainerEvent, IDxcVersionInfo
 #ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
@@ -523,6 +841,32 @@ public:
                                            // #include directives (optional)
       REFIID riid, LPVOID *ppResult // IDxcResult: status, buffer, and errors
       ) override {
+    return CompileImpl(pSource, pArguments, argCount, pIncludeHandler, nullptr,
+                       riid, ppResult);
+  }
+
+  // Preprocess to a caller-provided stream.
+  HRESULT STDMETHODCALLTYPE PreprocessToStream(
+      const DxcBuffer *pSource,            // Source text to preprocess
+      LPCWSTR *pArguments,                 // Array of pointers to arguments
+      UINT32 argCount,                     // Number of arguments
+      IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle
+                                           // #include directives (optional)
+      IStream *pOutput,             // Receives the preprocessed text
+      REFIID riid, LPVOID *ppResult // IDxcResult: status and errors
+      ) override {
+    if (pOutput == nullptr)
+      return E_INVALIDARG;
+    return CompileImpl(pSource, pArguments, argCount, pIncludeHandler, pOutput,
+                       riid, ppResult);
+  }
+
+  // Compiles, or preprocesses with -P. If pPreprocessOutput is given, the
+  // preprocessed text is written to it rather than returned in the result.
+  HRESULT CompileImpl(const DxcBuffer *pSource, LPCWSTR *pArguments,
+                      UINT32 argCount, IDxcIncludeHandler *pIncludeHandler,
+                      IStream *pPreprocessOutput, REFIID riid,
+                      LPVOID *ppResult) {
     llvm::TimeTraceScope TimeScope("Compile", StringRef(""));
     if (pSource == nullptr || ppResult == nullptr ||
         (argCount > 0 && pArguments == nullptr))
@@ -572,6 +916,9 @@ public:
       }
 
       bool isPreprocessing = !opts.Preprocess.empty();
+      if (pPreprocessOutput && !isPreprocessing)
+        return ErrorWithString("-P is required to preprocess to a stream",
+                               riid, ppResult);
       if (isPreprocessing) {
         DxcEtw_DXCompilerPreprocess_Start();
         bPreprocessStarted = true;
@@ -646,6 +993,74 @@ public:
       IFC(hlsl::DxcGetBlobAsUtf8(pSourceEncoding, m_pMalloc, &utf8Source,
                                  opts.DefaultTextCodePage));
 
+      // A compile cache hit returns the stored outputs without running Sema,
+      // CodeGen, optimization or validation.
+      dxcutil::CompileCacheKey cacheKey;
+      dxcutil::CompileCacheKey configKey;
+      std::string preprocessed;
+      std::string preprocessDiagnostics;
+      bool useCompileCache =
+          !opts.CompileCacheDir.empty() && IsCompileCacheable(opts) &&
+          m_pDxcContainerEventsHandler == nullptr &&
+          ComputeCompileCacheKey(utf8Source, pWideSourceName, pUtf8SourceName,
+                                 pIncludeHandler, opts, pArguments, argCount,
+                                 cacheKey, &preprocessed, &configKey,
+                                 &preprocessDiagnostics);
+      if (useCompileCache && dxcutil::LoadCompileCacheEntry(
+                                 opts.CompileCacheDir, cacheKey, pResult)) {
+        IFT(dxcutil::SetCompileCacheStatsOutput(pResult, cacheKey,
+                                                /*Hit*/ true,
+                                                /*Stored*/ false));
+        IFT(pResult->QueryInterface(riid, ppResult));
+        hr = S_OK;
+        goto Cleanup;
+      }
+      // On a miss, a library may still reuse the exports it did not change.
+      dxcutil::LibraryExportStats exportStats;
+      if (useCompileCache && IsIncrementalLibCompile(opts) &&
+          CompileLibraryIncrementally(pSource, pWideSourceName, pUtf8SourceName,
+                                      pIncludeHandler, opts, pArguments,
+                                      argCount, preprocessed, configKey,
+                                      pResult, exportStats)) {
+        bool stored = dxcutil::StoreCompileCacheEntry(opts.CompileCacheDir,
+                                                      cacheKey, pResult);
+        IFT(dxcutil::SetCompileCacheStatsOutput(pResult, cacheKey,
+                                                /*Hit*/ false, stored,
+                                                &exportStats));
+        IFT(pResult->QueryInterface(riid, ppResult));
+        hr = S_OK;
+        goto Cleanup;
+      }
+      // Otherwise compile the preprocessed text rather than preprocessing
+      // the source and its includes a second time. Its #line directives keep
+      // diagnostic locations. A preprocess that reported anything is redone,
+      // so that its diagnostics are reported exactly once.
+      bool compilePreprocessed =
+          useCompileCache && preprocessDiagnostics.empty() &&
+          CanCompilePreprocessedSource(opts, m_langExtensionsHelper);
+      if (compilePreprocessed) {
+        CComPtr<IDxcBlobEncoding> pPreprocessedBlob;
+        IFT(hlsl::DxcCreateBlob(preprocessed.data(), preprocessed.size(),
+                                /*bPinned*/ false, /*bCopy*/ true,
+                                /*encodingKnown*/ true, CP_UTF8, m_pMalloc,
+                                &pPreprocessedBlob));
+        utf8Source.Release();
+        IFT(hlsl::DxcGetBlobAsUtf8(pPreprocessedBlob, m_pMalloc, &utf8Source));
+        // Includes are already expanded in the preprocessed source.
+        pIncludeHandler = nullptr;
+      }
+
+      // With -farena-alloc, the compile allocates from an arena whose chunks
+      // are released together when it ends. The profiler installs it as the
+      // thread allocator, under its own counting allocator if enabled.
+      CComPtr<DxcArenaMalloc> pArena;
+      if (opts.ArenaAlloc) {
+        pArena = DxcArenaMalloc::Alloc(m_pMalloc);
+        IFTOOM(pArena.p);
+      }
+      DxcPassProfiler passProfiler(pArena ? pArena.p : m_pMalloc.p,
+                                   opts.PassProfile);
+
       CComPtr<IDxcBlob> pOutputBlob;
       dxcutil::DxcArgsFileSystem *msfPtr = dxcutil::CreateDxcArgsFileSystem(
           utf8Source, pWideSourceName.m_psz, pIncludeHandler,
@@ -675,20 +1090,29 @@ public:
       if (opts.DisplayIncludeProcess)
         msfPtr->EnableDisplayIncludeProcess();
 
-      IFT(msfPtr->RegisterOutputStream(L"output.bc", pOutputStream));
+      IFT(msfPtr->RegisterOutputStream(
+          L"output.bc",
+          pPreprocessOutput ? pPreprocessOutput
+                            : static_cast<IStream *>(pOutputStream.p)));
       IFT(msfPtr->CreateStdStreams(m_pMalloc));
 
       StringRef Data(utf8Source->GetStringPointer(),
                      utf8Source->GetStringLength());
 
-      // Not very efficient but also not very important.
+      // Not very efficient but also not very important. Macros are already
+      // expanded in preprocessed source; defining them again could expand
+      // some tokens twice.
       std::vector<std::string> defines;
-      CreateDefineStrings(opts.Defines.data(), opts.Defines.size(), defines);
+      if (!compilePreprocessed)
+        CreateDefineStrings(opts.Defines.data(), opts.Defines.size(), defines);
 
       // Setup a compiler instance.
       raw_stream_ostream outStream(pOutputStream.p);
-      llvm::LLVMContext
-          llvmContext; // LLVMContext should outlive CompilerInstance
+      // LLVMContext should outlive CompilerInstance. A pooled context would
+      // keep memory from the arena past the compile, so the two are exclusive.
+      DxcCompileLLVMContext compileContext(
+          m_contextPool, opts.ReuseLLVMContext && !opts.ArenaAlloc);
+      llvm::LLVMContext &llvmContext = compileContext.get();
       std::unique_ptr<llvm::Module> debugModule;
       CComPtr<AbstractMemoryStream> pReflectionStream;
       CompilerInstance compiler;
@@ -735,6 +1159,15 @@ public:
         PPOutOpts.ShowMacros = 0;        // Print macro definitions.
         PPOutOpts.RewriteIncludes = 0;   // Preprocess include directives only.
 
+        // Write straight to the caller's stream, if given, so that the
+        // preprocessed text never has to fit in memory.
+        std::unique_ptr<raw_sequential_stream_ostream> pStreamOut;
+        if (pPreprocessOutput) {
+          pStreamOut.reset(
+              new raw_sequential_stream_ostream(pPreprocessOutput));
+          compiler.setOutStream(pStreamOut.get());
+        }
+
         FrontendInputFile file(pUtf8SourceName, IK_HLSL);
         clang::PrintPreprocessedAction action;
         if (action.BeginSourceFile(compiler, file)) {
@@ -742,6 +1175,10 @@ public:
           action.EndSourceFile();
         }
         outStream.flush();
+        if (pStreamOut) {
+          pStreamOut->flush();
+          compiler.setOutStream(&outStream);
+        }
       } else {
         compiler.getLangOpts().HLSLEntryFunction =
             compiler.getCodeGenOpts().HLSLEntryFunction = pUtf8EntryPoint;
@@ -1302,8 +1739,13 @@ public:
         } // PDB in private
       }   // Write PDB
 
-      IFT(primaryOutput.SetObject(pOutputBlob, opts.DefaultTextCodePage));
-      IFT(pResult->SetOutput(primaryOutput));
+      // Streamed preprocessor output has already been written out.
+      if (pPreprocessOutput) {
+        primaryOutput.kind = DXC_OUT_NONE;
+      } else {
+        IFT(primaryOutput.SetObject(pOutputBlob, opts.DefaultTextCodePage));
+        IFT(pResult->SetOutput(primaryOutput));
+      }
 
       // It is possible for errors to occur, but the diagnostic or AST consumers
       // can recover from them, or translate them to mean something different.
@@ -1312,8 +1754,20 @@ public:
       // DiagnosticClient for the number of errors.
       unsigned NumErrors =
           compiler.getDiagnostics().getClient()->getNumErrors();
+      IFT(passProfiler.SetOutput(pResult));
+      if (pArena) {
+        IFT(SetArenaStatsOutput(pResult, pArena));
+        IFT(CopyOutputsOutOfArena(pResult, pArena, m_pMalloc));
+      }
       IFT(pResult->SetStatusAndPrimaryResult(NumErrors > 0 ? E_FAIL : S_OK,
                                              primaryOutput.kind));
+      if (useCompileCache) {
+        bool stored = NumErrors == 0 &&
+                      dxcutil::StoreCompileCacheEntry(opts.CompileCacheDir,
+                                                      cacheKey, pResult);
+        IFT(dxcutil::SetCompileCacheStatsOutput(pResult, cacheKey,
+                                                /*Hit*/ false, stored));
+      }
       IFT(pResult->QueryInterface(riid, ppResult));
 
       hr = S_OK;
@@ -1418,6 +1872,327 @@ public:
     return hr;
   }
 
+  // Computes the compile cache key from the preprocessed source, the
+  // normalized arguments and the compiler and validator versions. Returns
+  // false if preprocessing fails, so the compile runs uncached and reports its
+  // diagnostics as usual. If requested, also returns the preprocessed source,
+  // a key covering only the arguments and versions, and the diagnostics of
+  // the preprocess.
+  bool ComputeCompileCacheKey(IDxcBlobUtf8 *pSource, LPCWSTR pWideSourceName,
+                              LPCSTR pUtf8SourceName,
+                              IDxcIncludeHandler *pIncludeHandler,
+                              hlsl::options::DxcOpts &opts,
+                              LPCWSTR *pArguments, UINT32 argCount,
+                              dxcutil::CompileCacheKey &key,
+                              std::string *pPreprocessed = nullptr,
+                              dxcutil::CompileCacheKey *pConfigKey = nullptr,
+                              std::string *pDiagnostics = nullptr) {
+    TimeTraceScope TimeScope("ComputeCompileCacheKey", StringRef(""));
+    std::unique_ptr<dxcutil::DxcArgsFileSystem> msf(
+        dxcutil::CreateDxcArgsFileSystem(pSource, pWideSourceName,
+                                         pIncludeHandler,
+                                         opts.DefaultTextCodePage));
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+
+    CComPtr<AbstractMemoryStream> pPreprocessStream;
+    IFT(CreateMemoryStream(m_pMalloc, &pPreprocessStream));
+    IFT(msf->RegisterOutputStream(L"output.bc", pPreprocessStream));
+    IFT(msf->CreateStdStreams(m_pMalloc));
+
+    std::vector<std::string> defines;
+    CreateDefineStrings(opts.Defines.data(), opts.Defines.size(), defines);
+
+    // Diagnostics are reported by the compile that follows, not by this pass.
+    std::string diagnostics;
+    raw_string_ostream diagStream(diagnostics);
+    raw_stream_ostream outStream(pPreprocessStream.p);
+    CompilerInstance compiler;
+    std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
+        llvm::make_unique<TextDiagnosticPrinter>(
+            diagStream, &compiler.getDiagnosticOpts());
+    // SetupCompilerForCompile consumes the warning options.
+    std::vector<std::string> warnings = opts.Warnings;
+    SetupCompilerForCompile(compiler, &m_langExtensionsHelper, pUtf8SourceName,
+                            diagPrinter.get(), defines, opts, pArguments,
+                            argCount);
+    opts.Warnings = std::move(warnings);
+    msf->SetupForCompilerInstance(compiler);
+    compiler.getFrontendOpts().OutputFile = "output.bc";
+    compiler.WriteDefaultOutputDirectly = true;
+    compiler.setOutStream(&outStream);
+
+    clang::PreprocessorOutputOptions &PPOutOpts =
+        compiler.getPreprocessorOutputOpts();
+    PPOutOpts.ShowCPP = 1;
+    PPOutOpts.ShowLineMarkers = 1;
+    PPOutOpts.UseLineDirectives = 1;
+    compiler.getTarget().adjust(compiler.getLangOpts());
+
+    dxcutil::CompileCacheKeyBuilder builder;
+    FrontendInputFile file(pUtf8SourceName, IK_HLSL);
+    clang::PrintPreprocessedAction action;
+    if (!action.BeginSourceFile(compiler, file))
+      return false;
+    action.Execute();
+    // PDBs and source-based shader hashes embed the original sources, which
+    // the preprocessed text does not fully capture (comments, for one).
+    if (opts.GeneratePDB() || opts.DebugNameForSource) {
+      SourceManager &SM = compiler.getSourceManager();
+      std::vector<std::pair<StringRef, StringRef>> sources;
+      for (auto it = SM.fileinfo_begin(), end = SM.fileinfo_end(); it != end;
+           ++it) {
+        if (const llvm::MemoryBuffer *pBuffer = it->second->getRawBuffer())
+          sources.emplace_back(it->first->getName(), pBuffer->getBuffer());
+      }
+      std::sort(sources.begin(), sources.end());
+      for (const auto &source : sources) {
+        builder.AddString(source.first);
+        builder.AddString(source.second);
+      }
+    }
+    action.EndSourceFile();
+    outStream.flush();
+    if (compiler.getDiagnostics().hasErrorOccurred())
+      return false;
+
+    StringRef preprocessed((const char *)pPreprocessStream->GetPtr(),
+                           pPreprocessStream->GetPtrSize());
+    builder.AddString(preprocessed);
+    unsigned valMajor = opts.ValVerMajor, valMinor = opts.ValVerMinor;
+    if (valMajor == UINT_MAX)
+      dxcutil::GetValidatorVersion(&valMajor, &valMinor, opts.SelectValidator);
+    dxcutil::CompileCacheKeyBuilder configBuilder;
+    for (dxcutil::CompileCacheKeyBuilder *pBuilder : {&builder, &configBuilder}) {
+      pBuilder->AddNormalizedArguments(opts.Args);
+      pBuilder->AddVersionInfo(static_cast<IDxcVersionInfo *>(this));
+      pBuilder->AddUInt32(valMajor);
+      pBuilder->AddUInt32(valMinor);
+    }
+    builder.Finish(key);
+    if (pConfigKey)
+      configBuilder.Finish(*pConfigKey);
+    if (pPreprocessed)
+      *pPreprocessed = preprocessed.str();
+    if (pDiagnostics) {
+      diagStream.flush();
+      *pDiagnostics = std::move(diagnostics);
+    }
+    return true;
+  }
+
+  // Parses the preprocessed library source and computes the key of each of
+  // its exports. Returns false if the library cannot be compiled one export
+  // at a time. Warnings from the parse are returned in diagnostics.
+  bool ComputeLibraryExportKeys(LPCWSTR pWideSourceName, LPCSTR pUtf8SourceName,
+                                hlsl::options::DxcOpts &opts,
+                                LPCWSTR *pArguments, UINT32 argCount,
+                                StringRef preprocessed,
+                                const dxcutil::CompileCacheKey &configKey,
+                                std::vector<dxcutil::LibraryExportKey> &exports,
+                                std::string &diagnostics) {
+    TimeTraceScope TimeScope("ComputeLibraryExportKeys", StringRef(""));
+    CComPtr<IDxcBlobEncoding> pPreprocessedBlob;
+    CComPtr<IDxcBlobUtf8> pPreprocessedUtf8;
+    IFT(hlsl::DxcCreateBlob(preprocessed.data(), preprocessed.size(),
+                            /*bPinned*/ false, /*bCopy*/ true,
+                            /*encodingKnown*/ true, CP_UTF8, m_pMalloc,
+                            &pPreprocessedBlob));
+    IFT(hlsl::DxcGetBlobAsUtf8(pPreprocessedBlob, m_pMalloc,
+                               &pPreprocessedUtf8));
+    // Includes are already expanded in the preprocessed source.
+    std::unique_ptr<dxcutil::DxcArgsFileSystem> msf(
+        dxcutil::CreateDxcArgsFileSystem(pPreprocessedUtf8, pWideSourceName,
+                                         nullptr, opts.DefaultTextCodePage));
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+    IFT(msf->CreateStdStreams(m_pMalloc));
+
+    // So are macros; defining them again could expand some tokens twice.
+    std::vector<std::string> defines;
+    raw_string_ostream diagStream(diagnostics);
+    CompilerInstance compiler;
+    std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
+        llvm::make_unique<TextDiagnosticPrinter>(
+            diagStream, &compiler.getDiagnosticOpts());
+    std::vector<std::string> warnings = opts.Warnings;
+    SetupCompilerForCompile(compiler, &m_langExtensionsHelper, pUtf8SourceName,
+                            diagPrinter.get(), defines, opts, pArguments,
+                            argCount);
+    opts.Warnings = std::move(warnings);
+    msf->SetupForCompilerInstance(compiler);
+    compiler.getLangOpts().IsHLSLLibrary = true;
+    compiler.getLangOpts().HLSLEntryFunction =
+        compiler.getCodeGenOpts().HLSLEntryFunction = "";
+    compiler.getTarget().adjust(compiler.getLangOpts());
+
+    FrontendInputFile file(pUtf8SourceName, IK_HLSL);
+    dxcutil::LibraryExportFingerprintAction action(configKey);
+    if (!action.BeginSourceFile(compiler, file))
+      return false;
+    action.Execute();
+    action.EndSourceFile();
+    diagStream.flush();
+    exports = action.GetExports();
+    return !exports.empty();
+  }
+
+  // Compiles a library from its exports, taking those that did not change
+  // from the compile cache under their own keys and linking the results.
+  // The exports that changed are compiled together in a single compile; when
+  // most of them changed, the library is compiled whole instead. Either way,
+  // each changed export is then linked out of the compiled library on its
+  // own and cached. exportStats counts the exports reused and compiled.
+  // Returns false, leaving pResult untouched, if the library cannot be split
+  // or any step fails, in which case the caller compiles it whole.
+  bool CompileLibraryIncrementally(
+      const DxcBuffer *pSource, LPCWSTR pWideSourceName, LPCSTR pUtf8SourceName,
+      IDxcIncludeHandler *pIncludeHandler, hlsl::options::DxcOpts &opts,
+      LPCWSTR *pArguments, UINT32 argCount, StringRef preprocessed,
+      const dxcutil::CompileCacheKey &configKey, DxcResult *pResult,
+      dxcutil::LibraryExportStats &exportStats) {
+    TimeTraceScope TimeScope("CompileLibraryIncrementally", StringRef(""));
+    std::vector<dxcutil::LibraryExportKey> exports;
+    std::string diagnostics;
+    if (!ComputeLibraryExportKeys(pWideSourceName, pUtf8SourceName, opts,
+                                  pArguments, argCount, preprocessed,
+                                  configKey, exports, diagnostics))
+      return false;
+
+    std::vector<CComPtr<IDxcBlob>> objects(exports.size());
+    std::vector<size_t> missed;
+    for (size_t i = 0; i < exports.size(); ++i) {
+      CComPtr<DxcResult> pCached = DxcResult::Alloc(m_pMalloc);
+      if (dxcutil::LoadCompileCacheEntry(opts.CompileCacheDir, exports[i].Key,
+                                         pCached))
+        IFT(pCached->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&objects[i]),
+                               nullptr));
+      if (!objects[i])
+        missed.push_back(i);
+    }
+    bool compileWhole = missed.size() * 2 > exports.size();
+
+    CComPtr<IDxcResult> pCompileResult;
+    CA2W targetProfile(opts.TargetProfile.str().c_str());
+    HRESULT status;
+    if (!missed.empty()) {
+      // The changed exports are compiled from the original source, so that
+      // they see the same includes and defines. Unless the library is
+      // compiled whole, validation is left to the link.
+      std::string exportList;
+      for (size_t i : missed) {
+        if (!exportList.empty())
+          exportList += ';';
+        exportList += exports[i].Name;
+      }
+      CA2W exportListW(exportList.c_str());
+      std::vector<LPCWSTR> compileArgs(pArguments, pArguments + argCount);
+      compileArgs.push_back(L"-fcompile-cache=");
+      if (!compileWhole) {
+        compileArgs.push_back(L"-Vd");
+        compileArgs.push_back(L"-exports");
+        compileArgs.push_back(exportListW.m_psz);
+      }
+      IFT(Compile(pSource, compileArgs.data(), compileArgs.size(),
+                  pIncludeHandler, IID_PPV_ARGS(&pCompileResult)));
+      IFT(pCompileResult->GetStatus(&status));
+      if (FAILED(status))
+        return false;
+      CComPtr<IDxcBlob> pCompiled;
+      IFT(pCompileResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&pCompiled),
+                                    nullptr));
+      if (!pCompiled)
+        return false;
+      // The compile parsed the same source as the fingerprints did, so its
+      // diagnostics replace theirs rather than repeating them.
+      CComPtr<IDxcBlobUtf8> pCompileErrors;
+      if (pCompileResult->HasOutput(DXC_OUT_ERRORS))
+        IFT(pCompileResult->GetOutput(DXC_OUT_ERRORS,
+                                      IID_PPV_ARGS(&pCompileErrors), nullptr));
+      if (pCompileErrors)
+        diagnostics.assign(pCompileErrors->GetStringPointer(),
+                           pCompileErrors->GetStringLength());
+
+      // Each changed export is cached on its own, so that a later edit to
+      // another export does not invalidate it.
+      CComPtr<IDxcLinker> pSplitLinker;
+      IFT(CreateDxcLinker(IID_PPV_ARGS(&pSplitLinker)));
+      LPCWSTR compiledName = L"compiled";
+      IFT(pSplitLinker->RegisterLibrary(compiledName, pCompiled));
+      std::vector<LPCWSTR> splitArgs(pArguments, pArguments + argCount);
+      splitArgs.push_back(L"-Vd");
+      splitArgs.push_back(L"-exports");
+      splitArgs.push_back(nullptr);
+      for (size_t i : missed) {
+        CA2W exportName(exports[i].Name.c_str());
+        splitArgs.back() = exportName.m_psz;
+        CComPtr<IDxcOperationResult> pSplitOperationResult;
+        IFT(pSplitLinker->Link(L"", targetProfile, &compiledName, 1,
+                               splitArgs.data(), splitArgs.size(),
+                               &pSplitOperationResult));
+        CComPtr<IDxcResult> pSplitResult;
+        IFT(pSplitOperationResult.QueryInterface(&pSplitResult));
+        IFT(pSplitResult->GetStatus(&status));
+        if (FAILED(status))
+          return false;
+        IFT(pSplitResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&objects[i]),
+                                    nullptr));
+        if (!objects[i])
+          return false;
+        dxcutil::StoreCompileCacheEntry(opts.CompileCacheDir, exports[i].Key,
+                                        pSplitResult);
+      }
+    }
+    exportStats.Reused = exports.size() - missed.size();
+    exportStats.Compiled = missed.size();
+
+    if (compileWhole) {
+      IFT(pResult->CopyOutputsFromResult(pCompileResult));
+      IFT(pResult->SetStatusAndPrimaryResult(S_OK, DXC_OUT_OBJECT));
+      return true;
+    }
+
+    // Link the libraries split from the compile rather than the compiled
+    // library itself, so that every library linked was produced the same
+    // way, whether cached or not.
+    CComPtr<IDxcLinker> pLinker;
+    IFT(CreateDxcLinker(IID_PPV_ARGS(&pLinker)));
+    std::vector<std::wstring> libNames;
+    for (size_t i = 0; i < exports.size(); ++i) {
+      CA2W libName(exports[i].Key.ToString().c_str());
+      libNames.emplace_back(libName.m_psz);
+      IFT(pLinker->RegisterLibrary(libNames.back().c_str(), objects[i]));
+    }
+
+    std::vector<LPCWSTR> libNamePtrs;
+    for (const std::wstring &libName : libNames)
+      libNamePtrs.push_back(libName.c_str());
+    CComPtr<IDxcOperationResult> pLinkOperationResult;
+    IFT(pLinker->Link(L"", targetProfile, libNamePtrs.data(),
+                      libNamePtrs.size(), pArguments, argCount,
+                      &pLinkOperationResult));
+    CComPtr<IDxcResult> pLinkResult;
+    IFT(pLinkOperationResult.QueryInterface(&pLinkResult));
+    IFT(pLinkResult->GetStatus(&status));
+    if (FAILED(status))
+      return false;
+
+    IFT(pResult->CopyOutputsFromResult(pLinkResult));
+    // Link diagnostics come after those of the compile, as they would in a
+    // whole compile.
+    CComPtr<IDxcBlobUtf8> pLinkErrors;
+    if (pLinkResult->HasOutput(DXC_OUT_ERRORS))
+      IFT(pLinkResult->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&pLinkErrors),
+                                 nullptr));
+    if (pLinkErrors)
+      diagnostics.append(pLinkErrors->GetStringPointer(),
+                         pLinkErrors->GetStringLength());
+    IFT(pResult->SetOutputString(DXC_OUT_ERRORS, diagnostics.c_str(),
+                                 diagnostics.size()));
+    IFT(pResult->SetStatusAndPrimaryResult(S_OK, DXC_OUT_OBJECT));
+    return true;
+  }
+
   void SetupCompilerForCompile(CompilerInstance &compiler,
                                DxcLangExtensionsHelper *helper,
                                LPCSTR pMainFile,
@@ -274,6 +274,25 @@ static void AppendFileContentEntry(Buffer *buf, llvm::StringRef content) {
   assert(paddedOffset == header.AlignedSizeInBytes);
 }
 
+// Same layout as AppendFileContentEntry, but written to a compression stream
+// so the contents are not copied first.
+static hlsl::ZlibResult
+CompressFileContentEntry(hlsl::ZlibCompressStream &stream,
+                         llvm::StringRef content, uint32_t *pEntrySize) {
+  hlsl::DxilSourceInfo_SourceContentsEntry header = {};
+  header.AlignedSizeInBytes =
+      PadToFourBytes(sizeof(header) + content.size() + 1);
+  header.ContentSizeInBytes = content.size() + 1;
+  *pEntrySize = header.AlignedSizeInBytes;
+
+  // Null terminator and padding.
+  const uint8_t zeros[4] = {};
+  stream.Write(&header, sizeof(header));
+  stream.Write(content.data(), content.size());
+  return stream.Write(zeros, header.AlignedSizeInBytes - sizeof(header) -
+                                 content.size());
+}
+
 static size_t BeginSection(Buffer *buf) {
   const size_t sectionOffset = buf->size();
 
@@ -403,40 +422,47 @@ void SourceInfoWriter::Write(llvm::StringRef targetProfile,
   {
     const size_t sectionOffset = BeginSection(&m_Buffer);
 
-    // Put all the contents in a buffer
-    Buffer uncompressedBuffer;
-    for (unsigned i = 0; i < sourceFileList.size(); i++) {
-      SourceFile &file = sourceFileList[i];
-      AppendFileContentEntry(&uncompressedBuffer, file.Content);
-    }
-
+    // Write an empty header
     const size_t headerOffset = m_Buffer.size();
-
-    // Write the header
     hlsl::DxilSourceInfo_SourceContents header = {};
-    header.EntriesSizeInBytes = uncompressedBuffer.size();
-    header.UncompressedEntriesSizeInBytes = uncompressedBuffer.size();
     header.Count = sourceFileList.size();
     Append(&m_Buffer, &header, sizeof(header));
 
+    // Compress the entries straight from the file contents.
     const size_t sizeBeforeCompress = m_Buffer.size();
-    bool bCompressed =
-        hlsl::ZlibResult::Success ==
-        ZlibCompressAppend(DxcGetThreadMallocNoRef(), uncompressedBuffer.data(),
-                           uncompressedBuffer.size(), m_Buffer);
+    uint32_t uncompressedSize = 0;
+    bool bCompressed = false;
+    {
+      hlsl::ZlibCompressStream stream(DxcGetThreadMallocNoRef(), &m_Buffer,
+                                      hlsl::ZlibAppendCallback<Buffer>);
+      hlsl::ZlibResult result = hlsl::ZlibResult::Success;
+      for (unsigned i = 0; i < sourceFileList.size(); i++) {
+        uint32_t entrySize = 0;
+        result = CompressFileContentEntry(stream, sourceFileList[i].Content,
+                                          &entrySize);
+        uncompressedSize += entrySize;
+      }
+      if (result == hlsl::ZlibResult::Success)
+        result = stream.Finish();
+      bCompressed = result == hlsl::ZlibResult::Success;
+    }
 
     // If we compressed the content, go back to rewrite the header to write the
     // correct size in bytes.
+    header.UncompressedEntriesSizeInBytes = uncompressedSize;
     if (bCompressed) {
       header.EntriesSizeInBytes = m_Buffer.size() - sizeBeforeCompress;
       header.CompressType =
           hlsl::DxilSourceInfo_SourceContentsCompressType::Zlib;
-      memcpy(m_Buffer.data() + headerOffset, &header, sizeof(header));
     }
     // Otherwise, just write the whole uncompressed
     else {
-      Append(&m_Buffer, uncompressedBuffer.data(), uncompressedBuffer.size());
+      m_Buffer.resize(sizeBeforeCompress);
+      for (unsigned i = 0; i < sourceFileList.size(); i++)
+        AppendFileContentEntry(&m_Buffer, sourceFileList[i].Content);
+      header.EntriesSizeInBytes = uncompressedSize;
     }
+    memcpy(m_Buffer.data() + headerOffset, &header, sizeof(header));
 
     FinishSection(&m_Buffer, sectionOffset,
                   hlsl::DxilSourceInfoSectionType::SourceContents);
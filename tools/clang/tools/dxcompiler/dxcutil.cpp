@@ -42,7 +42,10 @@ HRESULT CreateDxcValidator(REFIID riid, LPVOID *ppv);
 // the module. It trusts that the caller didn't make any changes and is
 // kept internal because the layout of the module class may change based
 // on changes across modules, or picking a different compiler version or CRT.
-HRESULT RunInternalValidator(IDxcValidator *pValidator,
+// When pModule is null, the module is loaded from pShader instead; otherwise
+// ModuleBitcode is the bitcode pModule was written to in pShader.
+HRESULT RunInternalValidator(IDxcValidator *pValidator, llvm::Module *pModule,
+                             llvm::StringRef ModuleBitcode,
                              llvm::Module *pDebugModule, IDxcBlob *pShader,
                              UINT32 Flags, IDxcOperationResult **ppResult);
 
@@ -121,13 +124,13 @@ void AssembleToContainer(AssembleInputs &inputs) {
         inputs.pVersionInfo, pContainerStream, inputs.DebugName,
         inputs.SerializeFlags, inputs.pShaderHashOut, inputs.pReflectionOut,
         inputs.pRootSigOut, inputs.pPrivateBlob->GetBufferPointer(),
-        inputs.pPrivateBlob->GetBufferSize());
+        inputs.pPrivateBlob->GetBufferSize(), inputs.pProgramBitcodeOut);
   } else {
     SerializeDxilContainerForModule(
         &inputs.pM->GetOrCreateDxilModule(), inputs.pModuleBitcode,
         inputs.pVersionInfo, pContainerStream, inputs.DebugName,
         inputs.SerializeFlags, inputs.pShaderHashOut, inputs.pReflectionOut,
-        inputs.pRootSigOut);
+        inputs.pRootSigOut, nullptr, 0, inputs.pProgramBitcodeOut);
   }
   inputs.pOutputContainerBlob.Release();
   IFT(pContainerStream.QueryInterface(&inputs.pOutputContainerBlob));
@@ -162,8 +165,8 @@ HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs) {
   HRESULT valHR = S_OK;
 
   // If we have debug info, this will be a clone of the module before debug info
-  // is stripped. This is used with internal validator to provide more useful
-  // error messages.
+  // is stripped. This is used with an external IDxcValidator2 to provide more
+  // useful error messages.
   std::unique_ptr<llvm::Module> llvmModuleWithDebugInfo;
 
   CComPtr<IDxcValidator> pValidator;
@@ -175,15 +178,16 @@ HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs) {
     pValidator.QueryInterface(&pValidator2);
   }
 
-  if (bInternalValidator || pValidator2) {
-    // If using the internal validator or external validator supports
-    // IDxcValidator2, we'll use the modules directly. In this case, we'll want
-    // to make a clone to avoid SerializeDxilContainerForModule stripping all
-    // the debug info. The debug info will be stripped from the orginal module,
-    // but preserved in the cloned module.
-    if (llvm::getDebugMetadataVersionFromModule(*inputs.pM) != 0) {
-      llvmModuleWithDebugInfo.reset(llvm::CloneModule(inputs.pM.get()));
-    }
+  bool bHasDebugInfo =
+      llvm::getDebugMetadataVersionFromModule(*inputs.pM) != 0;
+  if (pValidator2 && bHasDebugInfo) {
+    // If the external validator supports IDxcValidator2, we'll pass it the
+    // debug module. In this case, we'll want to make a clone to avoid
+    // SerializeDxilContainerForModule stripping all the debug info. The debug
+    // info will be stripped from the orginal module, but preserved in the
+    // cloned module. The internal validator validates the stripped module
+    // in place and doesn't need the clone.
+    llvmModuleWithDebugInfo.reset(llvm::CloneModule(inputs.pM.get()));
   }
 
   // Verify validator version can validate this module
@@ -206,16 +210,30 @@ HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs) {
     return E_FAIL;
   }
 
+  // The internal validator checks the DXIL part against the bitcode written
+  // for the module, rather than serializing the module again.
+  CComPtr<AbstractMemoryStream> pProgramBitcode;
+  if (bInternalValidator) {
+    IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pProgramBitcode));
+    inputs.pProgramBitcodeOut = pProgramBitcode;
+  }
+
   AssembleToContainer(inputs);
+  inputs.pProgramBitcodeOut = nullptr;
 
   CComPtr<IDxcOperationResult> pValResult;
   // Important: in-place edit is required so the blob is reused and thus
   // dxil.dll can be released.
   inputs.ValidationFlags |= DxcValidatorFlags_InPlaceEdit;
   if (bInternalValidator) {
-    IFT(RunInternalValidator(pValidator, llvmModuleWithDebugInfo.get(),
-                             inputs.pOutputContainerBlob,
-                             inputs.ValidationFlags, &pValResult));
+    // The module now matches the DXIL part of the container, so validate it
+    // in place instead of loading it back from the container.
+    IFT(RunInternalValidator(
+        pValidator, inputs.pM.get(),
+        StringRef((const char *)pProgramBitcode->GetPtr(),
+                  pProgramBitcode->GetPtrSize()),
+        nullptr, inputs.pOutputContainerBlob, inputs.ValidationFlags,
+        &pValResult));
   } else {
     if (pValidator2 && llvmModuleWithDebugInfo) {
       // If metadata was stripped, re-serialize the input module.
@@ -73,6 +73,8 @@ struct AssembleInputs {
   CComPtr<IDxcBlob> pPrivateBlob = nullptr;
   hlsl::options::ValidatorSelection SelectValidator =
       hlsl::options::ValidatorSelection::Auto;
+  // If set, receives the bitcode written to the DXIL part of the container.
+  hlsl::AbstractMemoryStream *pProgramBitcodeOut = nullptr;
 };
 HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs);
 HRESULT ValidateRootSignatureInContainer(
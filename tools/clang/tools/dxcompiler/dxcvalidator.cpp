@@ -53,6 +53,17 @@ public:
           *ppResult // Validation output status, buffer, and errors
   );
 
+  // For internal use only.
+  HRESULT ValidateWithModule(
+      IDxcBlob *pShader,             // Shader to validate.
+      UINT32 Flags,                  // Validation flags.
+      llvm::Module *pModule,         // Module serialized into pShader.
+      llvm::StringRef ModuleBitcode, // Bitcode pModule was serialized to.
+      llvm::Module *pDebugModule,    // Debug module to validate, if available
+      IDxcOperationResult *
+          *ppResult // Validation output status, buffer, and errors
+  );
+
   // IDxcValidator
   HRESULT STDMETHODCALLTYPE Validate(
       IDxcBlob *pShader, // Shader to validate.
@@ -114,6 +125,19 @@ HRESULT DxcValidator::ValidateWithOptDebugModule(
                                           ppResult);
 }
 
+HRESULT DxcValidator::ValidateWithModule(
+    IDxcBlob *pShader,             // Shader to validate.
+    UINT32 Flags,                  // Validation flags.
+    llvm::Module *pModule,         // Module serialized into pShader.
+    llvm::StringRef ModuleBitcode, // Bitcode pModule was serialized to.
+    llvm::Module *pDebugModule,    // Debug module to validate, if available
+    IDxcOperationResult *
+        *ppResult // Validation output status, buffer, and errors
+) {
+  return hlsl::validateWithModule(pShader, Flags, pModule, ModuleBitcode,
+                                  pDebugModule, ppResult);
+}
+
 HRESULT STDMETHODCALLTYPE DxcValidator::GetVersion(UINT32 *pMajor,
                                                    UINT32 *pMinor) {
   return hlsl::getValidationVersion(pMajor, pMinor);
@@ -151,7 +175,8 @@ HRESULT STDMETHODCALLTYPE DxcValidator::GetFlags(UINT32 *pFlags) {
 
 ///////////////////////////////////////////////////////////////////////////////
 
-HRESULT RunInternalValidator(IDxcValidator *pValidator,
+HRESULT RunInternalValidator(IDxcValidator *pValidator, llvm::Module *pModule,
+                             llvm::StringRef ModuleBitcode,
                              llvm::Module *pDebugModule, IDxcBlob *pShader,
                              UINT32 Flags, IDxcOperationResult **ppResult) {
   DXASSERT_NOMSG(pValidator != nullptr);
@@ -159,6 +184,9 @@ HRESULT RunInternalValidator(IDxcValidator *pValidator,
   DXASSERT_NOMSG(ppResult != nullptr);
 
   DxcValidator *pInternalValidator = (DxcValidator *)pValidator;
+  if (pModule)
+    return pInternalValidator->ValidateWithModule(
+        pShader, Flags, pModule, ModuleBitcode, pDebugModule, ppResult);
   return pInternalValidator->ValidateWithOptDebugModule(pShader, Flags,
                                                         pDebugModule, ppResult);
 }
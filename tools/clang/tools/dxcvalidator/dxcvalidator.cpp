@@ -89,6 +89,8 @@ static void HashAndUpdateOrCopy(uint32_t Flags, IDxcBlob *Shader,
 static uint32_t runValidation(
     IDxcBlob *Shader,
     uint32_t Flags,            // Validation flags.
+    llvm::Module *Module,      // Module in Shader, if already loaded
+    StringRef ModuleBitcode,   // Bitcode Module was serialized to
     llvm::Module *DebugModule, // Debug module to validate, if available
     AbstractMemoryStream *DiagMemStream) {
   // Run validation may throw, but that indicates an inability to validate,
@@ -98,6 +100,12 @@ static uint32_t runValidation(
 
   raw_stream_ostream DiagStream(DiagMemStream);
 
+  if (Module)
+    return ValidateDxilContainerWithModule(Shader->GetBufferPointer(),
+                                           Shader->GetBufferSize(), Module,
+                                           ModuleBitcode, DebugModule,
+                                           DiagStream);
+
   return ValidateDxilContainer(Shader->GetBufferPointer(),
                                Shader->GetBufferSize(), DebugModule,
                                DiagStream);
@@ -206,9 +214,11 @@ uint32_t hlsl::validateWithDebug(
   return hr;
 }
 
-uint32_t hlsl::validateWithOptDebugModule(
+static uint32_t validateWithOptModules(
     IDxcBlob *Shader,            // Shader to validate.
     uint32_t Flags,              // Validation flags.
+    llvm::Module *Module,        // Module in Shader, if already loaded
+    StringRef ModuleBitcode,     // Bitcode Module was serialized to
     llvm::Module *DebugModule,   // Debug module to validate, if available
     IDxcOperationResult **Result // Validation output status, buffer, and errors
 ) {
@@ -229,7 +239,9 @@ uint32_t hlsl::validateWithOptDebugModule(
     else if (Flags & DxcValidatorFlags_ModuleOnly)
       validationStatus = runDxilModuleValidation(Shader, DiagStream);
     else
-      validationStatus = runValidation(Shader, Flags, DebugModule, DiagStream);
+      validationStatus =
+          runValidation(Shader, Flags, Module, ModuleBitcode, DebugModule,
+                        DiagStream);
     if (FAILED(validationStatus)) {
       std::string msg("Validation failed.\n");
       ULONG cbWritten;
@@ -275,6 +287,36 @@ uint32_t hlsl::validateWithOptDebugModule(
   return hr;
 }
 
+uint32_t hlsl::validateWithOptDebugModule(
+    IDxcBlob *Shader,            // Shader to validate.
+    uint32_t Flags,              // Validation flags.
+    llvm::Module *DebugModule,   // Debug module to validate, if available
+    IDxcOperationResult **Result // Validation output status, buffer, and errors
+) {
+  return validateWithOptModules(Shader, Flags, nullptr, StringRef(),
+                                DebugModule, Result);
+}
+
+uint32_t hlsl::validateWithModule(
+    IDxcBlob *Shader,            // Shader to validate.
+    uint32_t Flags,              // Validation flags.
+    llvm::Module *Module,        // Module serialized into Shader.
+    StringRef ModuleBitcode,     // Bitcode Module was serialized to.
+    llvm::Module *DebugModule,   // Debug module to validate, if available
+    IDxcOperationResult **Result // Validation output status, buffer, and errors
+) {
+  if (Result == nullptr)
+    return E_INVALIDARG;
+  *Result = nullptr;
+  if (Shader == nullptr || Module == nullptr ||
+      Flags & ~DxcValidatorFlags_ValidMask ||
+      Flags & (DxcValidatorFlags_ModuleOnly |
+               DxcValidatorFlags_RootSignatureOnly))
+    return E_INVALIDARG;
+  return validateWithOptModules(Shader, Flags, Module, ModuleBitcode,
+                                DebugModule, Result);
+}
+
 uint32_t hlsl::getValidationVersion(unsigned *Major, unsigned *Minor) {
   if (Major == nullptr || Minor == nullptr)
     return E_INVALIDARG;
@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include "llvm/ADT/StringRef.h"
 #include <cstdint>
 
 struct IDxcOperationResult;
@@ -33,6 +34,18 @@ uint32_t validateWithOptDebugModule(
     IDxcOperationResult **Result // Validation output status, buffer, and errors
 );
 
+// For internal use only. Validates Module, which must be the module that was
+// serialized to ModuleBitcode in Shader, without loading it back from the
+// container.
+uint32_t validateWithModule(
+    IDxcBlob *Shader,              // Shader to validate.
+    uint32_t Flags,                // Validation flags.
+    llvm::Module *Module,          // Module serialized into Shader.
+    llvm::StringRef ModuleBitcode, // Bitcode Module was serialized to.
+    llvm::Module *DebugModule,     // Debug module to validate, if available
+    IDxcOperationResult **Result // Validation output status, buffer, and errors
+);
+
 // IDxcValidator2
 uint32_t validateWithDebug(
     IDxcBlob *Shader,            // Shader to validate.
@@ -3057,6 +3057,10 @@ static void clang_parseTranslationUnit_Impl(void *UserData) {
     = options & CXTranslationUnit_IncludeBriefCommentsInCodeCompletion;
   bool SkipFunctionBodies = options & CXTranslationUnit_SkipFunctionBodies;
   bool ForSerialization = options & CXTranslationUnit_ForSerialization;
+  // HLSL Change Starts - no support for PCH
+  bool SkipIncludedFunctionBodies =
+      options & CXTranslationUnit_SkipIncludedFunctionBodies;
+  // HLSL Change Ends
 
   // Configure the diagnostics.
   IntrusiveRefCntPtr<DiagnosticsEngine>
@@ -3131,7 +3135,8 @@ static void clang_parseTranslationUnit_Impl(void *UserData) {
       CacheCodeCompletionResults, IncludeBriefCommentsInCodeCompletion,
       /*AllowPCHWithCompilerErrors=*/true, SkipFunctionBodies,
       /*UserFilesAreVolatile=*/true, ForSerialization, &ErrUnit,
-      CXXIdx->HlslLangExtensions)); // HLSL Change - add language extensions
+      CXXIdx->HlslLangExtensions, // HLSL Change - add language extensions
+      SkipIncludedFunctionBodies)); // HLSL Change
 
   // Early failures in LoadFromCommandLine may return with ErrUnit unset.
   if (!Unit && !ErrUnit) {
@@ -3343,6 +3348,7 @@ struct ReparseTranslationUnitInfo {
   ArrayRef<CXUnsavedFile> unsaved_files;
   unsigned options;
   CXErrorCode &result;
+  ::llvm::sys::fs::MSFileSystemRef fsr; // HLSL Change
 };
 
 static void clang_reparseTranslationUnit_Impl(void *UserData) {
@@ -3352,6 +3358,14 @@ static void clang_reparseTranslationUnit_Impl(void *UserData) {
   unsigned options = RTUI->options;
   (void) options;
 
+  // HLSL Change Starts
+  if (RTUI->fsr) {
+    // As when parsing, this runs on its own thread and the caller's file
+    // system must be installed on it.
+    ::llvm::sys::fs::SetCurrentThreadFileSystem(RTUI->fsr);
+  }
+  // HLSL Change Ends
+
   // Check arguments.
   if (isNotUsableTU(TU)) {
     LOG_BAD_TU(TU);
@@ -3404,13 +3418,15 @@ int clang_reparseTranslationUnit(CXTranslationUnit TU,
   CXErrorCode result = CXError_Failure;
   ReparseTranslationUnitInfo RTUI = {
       TU, llvm::makeArrayRef(unsaved_files, num_unsaved_files), options,
-      result};
+      result, nullptr};
 
   if (getenv("LIBCLANG_NOTHREADS")) {
     clang_reparseTranslationUnit_Impl(&RTUI);
     return result;
   }
 
+  RTUI.fsr = ::llvm::sys::fs::GetCurrentThreadFileSystem(); // HLSL Change
+
   llvm::CrashRecoveryContext CRC;
 
   if (!RunSafely(CRC, clang_reparseTranslationUnit_Impl, &RTUI)) {
@@ -1297,9 +1297,23 @@ HRESULT DxcToken::GetSpelling(LPSTR *pValue) {
 ///////////////////////////////////////////////////////////////////////////////
 
 DxcTranslationUnit::DxcTranslationUnit(IMalloc *pMalloc)
-    : m_dwRef(0), m_pMalloc(pMalloc), m_tu(nullptr) {}
+    : m_dwRef(0), m_pMalloc(pMalloc), m_tu(nullptr), m_reparseRunning(false),
+      m_reparseQueued(false), m_pQueuedFiles(nullptr), m_numQueuedFiles(0),
+      m_reparseStatus(S_OK) {}
 
 DxcTranslationUnit::~DxcTranslationUnit() {
+  // Drop any queued reparse and let the running one finish; it uses m_tu.
+  {
+    std::unique_lock<std::mutex> lock(m_reparseLock);
+    if (m_reparseQueued) {
+      CleanupUnsavedFiles(m_pQueuedFiles, m_numQueuedFiles);
+      m_reparseQueued = false;
+    }
+    m_reparseDone.wait(lock, [this] { return !m_reparseRunning; });
+  }
+  if (m_reparseThread.joinable())
+    m_reparseThread.join();
+
   if (m_tu != nullptr) {
     // TODO: until an interface to file access is defined and implemented,
     // simply fall back to pure Win32/CRT calls. Also, note that this can throw
@@ -1432,20 +1446,116 @@ HRESULT DxcTranslationUnit::GetFileName(LPSTR *pResult) {
                                   pResult);
 }
 
+HRESULT DxcTranslationUnit::ReparseWithFiles(CXUnsavedFile *files,
+                                             unsigned numFiles) {
+  DxcThreadMalloc TM(m_pMalloc);
+
+  // The reparse may run on a thread of our own, so set up file access here
+  // rather than relying on the caller's.
+  try {
+    ::llvm::sys::fs::MSFileSystem *msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+    int reparseResult = clang_reparseTranslationUnit(
+        m_tu, numFiles, files, clang_defaultReparseOptions(m_tu));
+    return reparseResult == 0 ? S_OK : E_FAIL;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+void DxcTranslationUnit::ReparseThreadProc() {
+  // The queued files were allocated with m_pMalloc and are freed here.
+  DxcThreadMalloc TM(m_pMalloc);
+  std::unique_lock<std::mutex> lock(m_reparseLock);
+  while (m_reparseQueued) {
+    CXUnsavedFile *files = m_pQueuedFiles;
+    unsigned numFiles = m_numQueuedFiles;
+    m_pQueuedFiles = nullptr;
+    m_numQueuedFiles = 0;
+    m_reparseQueued = false;
+
+    lock.unlock();
+    HRESULT hr = ReparseWithFiles(files, numFiles);
+    CleanupUnsavedFiles(files, numFiles);
+    lock.lock();
+    m_reparseStatus = hr;
+  }
+  // The lock is not taken again after this, so the thread may be joined by
+  // whoever holds it.
+  m_reparseRunning = false;
+  m_reparseDone.notify_all();
+}
+
 HRESULT DxcTranslationUnit::Reparse(IDxcUnsavedFile **unsaved_files,
                                     unsigned num_unsaved_files) {
   HRESULT hr;
   CXUnsavedFile *local_unsaved_files;
   DxcThreadMalloc TM(m_pMalloc);
+  IFR(WaitForReparse(nullptr));
   hr =
       SetupUnsavedFiles(unsaved_files, num_unsaved_files, &local_unsaved_files);
   if (FAILED(hr))
     return hr;
-  int reparseResult =
-      clang_reparseTranslationUnit(m_tu, num_unsaved_files, local_unsaved_files,
-                                   clang_defaultReparseOptions(m_tu));
+  hr = ReparseWithFiles(local_unsaved_files, num_unsaved_files);
   CleanupUnsavedFiles(local_unsaved_files, num_unsaved_files);
-  return reparseResult == 0 ? S_OK : E_FAIL;
+  return hr;
+}
+
+HRESULT DxcTranslationUnit::ReparseAsync(IDxcUnsavedFile **unsaved_files,
+                                         unsigned num_unsaved_files) {
+  HRESULT hr;
+  CXUnsavedFile *local_unsaved_files;
+  DxcThreadMalloc TM(m_pMalloc);
+  if (m_tu == nullptr)
+    return E_FAIL;
+  hr =
+      SetupUnsavedFiles(unsaved_files, num_unsaved_files, &local_unsaved_files);
+  if (FAILED(hr))
+    return hr;
+
+  std::unique_lock<std::mutex> lock(m_reparseLock);
+  if (m_reparseQueued)
+    CleanupUnsavedFiles(m_pQueuedFiles, m_numQueuedFiles);
+  m_pQueuedFiles = local_unsaved_files;
+  m_numQueuedFiles = num_unsaved_files;
+  m_reparseQueued = true;
+
+  if (!m_reparseRunning) {
+    // A previous thread has already finished its work; reap it.
+    if (m_reparseThread.joinable())
+      m_reparseThread.join();
+    try {
+      m_reparseThread =
+          std::thread(&DxcTranslationUnit::ReparseThreadProc, this);
+    } catch (...) {
+      CleanupUnsavedFiles(m_pQueuedFiles, m_numQueuedFiles);
+      m_pQueuedFiles = nullptr;
+      m_numQueuedFiles = 0;
+      m_reparseQueued = false;
+      return E_OUTOFMEMORY;
+    }
+    m_reparseRunning = true;
+  }
+  return S_OK;
+}
+
+HRESULT DxcTranslationUnit::IsReparsePending(BOOL *pValue) {
+  if (pValue == nullptr)
+    return E_POINTER;
+  std::unique_lock<std::mutex> lock(m_reparseLock);
+  *pValue = m_reparseRunning || m_reparseQueued;
+  return S_OK;
+}
+
+HRESULT DxcTranslationUnit::WaitForReparse(HRESULT *pReparseStatus) {
+  std::unique_lock<std::mutex> lock(m_reparseLock);
+  m_reparseDone.wait(lock, [this] { return !m_reparseRunning; });
+  if (pReparseStatus != nullptr)
+    *pReparseStatus = m_reparseStatus;
+  return S_OK;
 }
 
 HRESULT DxcTranslationUnit::GetCursorForLocation(IDxcSourceLocation *location,
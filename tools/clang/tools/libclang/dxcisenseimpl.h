@@ -20,6 +20,9 @@
 #include "clang-c/Index.h"
 #include "clang/AST/Decl.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 // Forward declarations.
 class DxcCursor;
@@ -315,17 +318,32 @@ public:
   HRESULT STDMETHODCALLTYPE GetSpelling(LPSTR *pValue) override;
 };
 
-class DxcTranslationUnit : public IDxcTranslationUnit {
+class DxcTranslationUnit : public IDxcTranslationUnit2 {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
   CXTranslationUnit m_tu;
 
+  // Background reparse state, guarded by m_reparseLock. m_pQueuedFiles holds
+  // the files of the next reparse to run, if m_reparseQueued is set.
+  std::mutex m_reparseLock;
+  std::condition_variable m_reparseDone;
+  std::thread m_reparseThread;
+  bool m_reparseRunning;
+  bool m_reparseQueued;
+  CXUnsavedFile *m_pQueuedFiles;
+  unsigned m_numQueuedFiles;
+  HRESULT m_reparseStatus;
+
+  HRESULT ReparseWithFiles(CXUnsavedFile *files, unsigned numFiles);
+  void ReparseThreadProc();
+
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_ALLOC(DxcTranslationUnit)
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid,
                                            void **ppvObject) override {
-    return DoBasicQueryInterface<IDxcTranslationUnit>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDxcTranslationUnit, IDxcTranslationUnit2>(
+        this, iid, ppvObject);
   }
 
   DxcTranslationUnit(IMalloc *pMalloc);
@@ -365,6 +383,12 @@ public:
       const char *fileName, unsigned line, unsigned column,
       IDxcUnsavedFile **pUnsavedFiles, unsigned numUnsavedFiles,
       DxcCodeCompleteFlags options, IDxcCodeCompleteResults **pResult) override;
+
+  // IDxcTranslationUnit2
+  HRESULT STDMETHODCALLTYPE ReparseAsync(IDxcUnsavedFile **unsaved_files,
+                                         unsigned num_unsaved_files) override;
+  HRESULT STDMETHODCALLTYPE IsReparsePending(BOOL *pValue) override;
+  HRESULT STDMETHODCALLTYPE WaitForReparse(HRESULT *pReparseStatus) override;
 };
 
 class DxcType : public IDxcType {
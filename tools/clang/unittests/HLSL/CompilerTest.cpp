@@ -184,6 +184,7 @@ public:
 
   TEST_METHOD(CompileWhenIncludeThenLoadInvoked)
   TEST_METHOD(CompileWhenIncludeThenLoadUsed)
+  TEST_METHOD(CompileWhenIncludeCacheSharedThenLoadedOnce)
   TEST_METHOD(CompileWhenIncludeAbsoluteThenLoadAbsolute)
   TEST_METHOD(CompileWhenIncludeLocalThenLoadRelative)
   TEST_METHOD(CompileWhenIncludeSystemThenLoadNotRelative)
@@ -195,6 +196,12 @@ public:
   TEST_METHOD(CompileThenCheckDisplayIncludeProcess)
   TEST_METHOD(CompileThenPrintTimeReport)
   TEST_METHOD(CompileThenPrintTimeTrace)
+  TEST_METHOD(CompileThenPrintPassProfile)
+  TEST_METHOD(CompileWithArenaAllocThenPrintStats)
+  TEST_METHOD(CompileWithReusedLLVMContextThenSameOutput)
+  TEST_METHOD(CompileWithCompileCacheThenHit)
+  TEST_METHOD(CompileLibIncrementallyThenEditExport)
+  TEST_METHOD(CompileBatchThenAllJobsComplete)
   TEST_METHOD(CompileWhenIncludeMissingThenFail)
   TEST_METHOD(CompileWhenIncludeHasPathThenOK)
   TEST_METHOD(CompileWhenIncludeEmptyThenOK)
@@ -256,6 +263,7 @@ public:
   TEST_METHOD(PreprocessWhenExpandTokenPastingOperandThenAccept)
   TEST_METHOD(PreprocessWithDebugOptsThenOk)
   TEST_METHOD(PreprocessCheckBuiltinIsOk)
+  TEST_METHOD(PreprocessToStreamThenWrittenInChunks)
   TEST_METHOD(WhenSigMismatchPCFunctionThenFail)
   TEST_METHOD(CompileOtherModesWithDebugOptsThenOk)
 
@@ -2882,6 +2890,48 @@ TEST_F(CompilerTest, CompileWhenIncludeThenLoadUsed) {
                         pInclude->GetAllFileNames().c_str());
 }
 
+TEST_F(CompilerTest, CompileWhenIncludeCacheSharedThenLoadedOnce) {
+  CComPtr<IDxcIncludeCache> pCache;
+  CComPtr<TestIncludeHandler> pInclude;
+  CComPtr<IDxcIncludeHandler> pCachingInclude;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(
+      m_dllSupport.CreateInstance(CLSID_DxcIncludeCache, &pCache));
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define ZERO 0");
+  pInclude->CallResults.emplace_back("#define ZERO 0");
+  VERIFY_SUCCEEDED(pCache->CreateIncludeHandler(pInclude, &pCachingInclude));
+  CreateBlobFromText("#include \"helper.h\"\r\n"
+                     "float4 main() : SV_Target { return ZERO; }",
+                     &pSource);
+
+  // Each compile uses a compiler instance of its own; only the first one
+  // loads the header.
+  auto compile = [&]() {
+    CComPtr<IDxcCompiler> pCompiler;
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                        L"ps_6_0", nullptr, 0, nullptr, 0,
+                                        pCachingInclude, &pResult));
+    VerifyOperationSucceeded(pResult);
+  };
+  compile();
+  compile();
+  VERIFY_ARE_EQUAL_WSTR(L"." SLASH_W L"helper.h;",
+                        pInclude->GetAllFileNames().c_str());
+
+  // A write older than the cached contents keeps them; invalidating the
+  // file loads it again.
+  VERIFY_SUCCEEDED(pCache->InvalidateIfModified(L"./helper.h", 0));
+  compile();
+  VERIFY_ARE_EQUAL(1u, pInclude->CallInfos.size());
+  VERIFY_SUCCEEDED(pCache->Invalidate(L"./helper.h"));
+  compile();
+  VERIFY_ARE_EQUAL(2u, pInclude->CallInfos.size());
+}
+
 static std::wstring NormalizeForPlatform(const std::wstring &s) {
 #ifdef _WIN32
   wchar_t From = L'/';
@@ -3454,6 +3504,353 @@ TEST_F(CompilerTest, CompileThenPrintTimeTrace) {
   VERIFY_ARE_NOT_EQUAL(string::npos, text.find("{ \"traceEvents\": ["));
 }
 
+TEST_F(CompilerTest, CompileThenPrintPassProfile) {
+  CComPtr<IDxcCompiler3> pCompiler;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+
+  std::string source = "float4 main(float4 a : A) : SV_Target {\n"
+                       "  return a.x > 0 ? a * 2 : a.yzwx;\n"
+                       "}";
+  DxcBuffer SourceBuf = {};
+  SourceBuf.Ptr = source.c_str();
+  SourceBuf.Size = source.size();
+  SourceBuf.Encoding = CP_UTF8;
+
+  LPCWSTR args[] = {L"-Tps_6_0", L"-fpass-profile"};
+  CComPtr<IDxcResult> pResult;
+  VERIFY_SUCCEEDED(pCompiler->Compile(&SourceBuf, args, _countof(args),
+                                      nullptr, IID_PPV_ARGS(&pResult)));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+
+  CComPtr<IDxcBlobUtf8> pProfile;
+  VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_PASS_PROFILE,
+                                      IID_PPV_ARGS(&pProfile), nullptr));
+  std::string text(pProfile->GetStringPointer(), pProfile->GetStringLength());
+  VERIFY_ARE_NOT_EQUAL(string::npos, text.find("{ \"passes\": ["));
+  VERIFY_ARE_NOT_EQUAL(string::npos,
+                       text.find("\"name\":\"HLSL DXIL Finalize Module\""));
+  VERIFY_ARE_NOT_EQUAL(string::npos, text.find("\"instructionsAfter\":"));
+  VERIFY_ARE_NOT_EQUAL(string::npos, text.find("\"allocatedBytes\":"));
+}
+
+TEST_F(CompilerTest, CompileWithArenaAllocThenPrintStats) {
+  CComPtr<IDxcCompiler3> pCompiler;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+
+  std::string source = "float4 main(float4 a : A) : SV_Target {\n"
+                       "  return a.x > 0 ? a * 2 : a.yzwx;\n"
+                       "}";
+  DxcBuffer SourceBuf = {};
+  SourceBuf.Ptr = source.c_str();
+  SourceBuf.Size = source.size();
+  SourceBuf.Encoding = CP_UTF8;
+
+  LPCWSTR args[] = {L"-Tps_6_0", L"-farena-alloc", L"-Zi", L"-Qembed_debug"};
+  CComPtr<IDxcResult> pResult;
+  VERIFY_SUCCEEDED(pCompiler->Compile(&SourceBuf, args, _countof(args),
+                                      nullptr, IID_PPV_ARGS(&pResult)));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+
+  CComPtr<IDxcBlobUtf8> pStats;
+  VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_ALLOCATOR_STATS,
+                                      IID_PPV_ARGS(&pStats), nullptr));
+  std::string text(pStats->GetStringPointer(), pStats->GetStringLength());
+  VERIFY_ARE_NOT_EQUAL(string::npos, text.find("allocations: "));
+  VERIFY_ARE_NOT_EQUAL(string::npos, text.find("peak live bytes: "));
+  VERIFY_ARE_NOT_EQUAL(string::npos, text.find("peak reserved bytes: "));
+
+  // Outputs allocated from the arena outlive the compile.
+  CComPtr<IDxcBlob> pObject;
+  VERIFY_SUCCEEDED(
+      pResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&pObject), nullptr));
+  std::string disassembly = DisassembleProgram(m_dllSupport, pObject);
+  VERIFY_ARE_NOT_EQUAL(string::npos, disassembly.find("@main"));
+}
+
+TEST_F(CompilerTest, CompileWithReusedLLVMContextThenSameOutput) {
+  CComPtr<IDxcCompiler3> pCompiler;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+
+  std::string sources[] = {
+      "struct S { float4 v; };\n"
+      "StructuredBuffer<S> buf;\n"
+      "float4 main(uint i : I) : SV_Target { return buf[i].v; }",
+      "struct S { float2 v; };\n"
+      "Texture2D<float4> tex;\n"
+      "SamplerState samp;\n"
+      "float4 main(S s : S) : SV_Target { return tex.Sample(samp, s.v); }"};
+
+  auto compile = [&](const std::string &source, bool reuse) {
+    DxcBuffer SourceBuf = {};
+    SourceBuf.Ptr = source.c_str();
+    SourceBuf.Size = source.size();
+    SourceBuf.Encoding = CP_UTF8;
+    std::vector<LPCWSTR> args = {L"-Tps_6_0", L"-Zi", L"-Qembed_debug"};
+    if (reuse)
+      args.push_back(L"-freuse-llvm-context");
+    CComPtr<IDxcResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(&SourceBuf, args.data(),
+                                        (UINT32)args.size(), nullptr,
+                                        IID_PPV_ARGS(&pResult)));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+    CComPtr<IDxcBlob> pObject;
+    VERIFY_SUCCEEDED(
+        pResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&pObject), nullptr));
+    return std::string((const char *)pObject->GetBufferPointer(),
+                       pObject->GetBufferSize());
+  };
+
+  std::string expected[] = {compile(sources[0], false),
+                            compile(sources[1], false)};
+  // Each source is compiled in contexts used before by both of them.
+  for (unsigned i = 0; i < 4; ++i) {
+    VERIFY_ARE_EQUAL(expected[i % 2], compile(sources[i % 2], true));
+  }
+}
+
+// A new directory under the system temp directory for the files written by
+// one test, removed along with them when the test ends.
+class ScopedTempDirectory {
+public:
+  explicit ScopedTempDirectory(llvm::StringRef Prefix) {
+    ::llvm::sys::fs::MSFileSystem *msfPtr;
+    VERIFY_SUCCEEDED(CreateMSFileSystemForDisk(&msfPtr));
+    m_msf.reset(msfPtr);
+    ::llvm::sys::fs::AutoPerThreadSystem pts(m_msf.get());
+    VERIFY_IS_FALSE((bool)pts.error_code());
+    llvm::SmallString<128> path;
+    VERIFY_IS_FALSE((bool)llvm::sys::fs::createUniqueDirectory(Prefix, path));
+    m_path = path.str();
+  }
+  ~ScopedTempDirectory() {
+    ::llvm::sys::fs::AutoPerThreadSystem pts(m_msf.get());
+    for (const std::string &file : GetFiles())
+      llvm::sys::fs::remove(file);
+    llvm::sys::fs::remove(m_path);
+  }
+
+  std::wstring GetPath() const {
+    return Unicode::UTF8ToWideStringOrThrow(m_path.c_str());
+  }
+
+  std::vector<std::string> GetFiles() const {
+    ::llvm::sys::fs::AutoPerThreadSystem pts(m_msf.get());
+    std::error_code EC;
+    std::vector<std::string> files;
+    for (llvm::sys::fs::directory_iterator It(m_path, EC), End;
+         It != End && !EC; It.increment(EC))
+      files.push_back(It->path());
+    return files;
+  }
+
+private:
+  std::unique_ptr<::llvm::sys::fs::MSFileSystem> m_msf;
+  std::string m_path;
+};
+
+TEST_F(CompilerTest, CompileWithCompileCacheThenHit) {
+  CComPtr<IDxcCompiler3> pCompiler;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+
+  std::string source = "float4 main() : SV_Target { return VALUE; }";
+  DxcBuffer SourceBuf = {};
+  SourceBuf.Ptr = source.c_str();
+  SourceBuf.Size = source.size();
+  SourceBuf.Encoding = CP_UTF8;
+
+  ScopedTempDirectory CacheDir("dxc-compile-cache");
+  std::wstring CacheArg = L"-fcompile-cache=" + CacheDir.GetPath();
+  LPCWSTR args[] = {L"-Tps_6_0", L"-DVALUE=2", CacheArg.c_str()};
+
+  auto compileAndGetStats = [&](CComPtr<IDxcResult> &pResult) {
+    VERIFY_SUCCEEDED(pCompiler->Compile(&SourceBuf, args, _countof(args),
+                                        nullptr, IID_PPV_ARGS(&pResult)));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+    CComPtr<IDxcBlobUtf8> pStats;
+    VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_COMPILE_CACHE_STATS,
+                                        IID_PPV_ARGS(&pStats), nullptr));
+    return std::string(pStats->GetStringPointer(), pStats->GetStringLength());
+  };
+
+  CComPtr<IDxcResult> pMissResult;
+  std::string missStats = compileAndGetStats(pMissResult);
+  VERIFY_ARE_NOT_EQUAL(string::npos, missStats.find("result: miss"));
+  // The entry is renamed into place; no temporary file is left behind.
+  std::vector<std::string> files = CacheDir.GetFiles();
+  VERIFY_ARE_EQUAL(1u, files.size());
+  VERIFY_IS_TRUE(llvm::StringRef(files[0]).endswith(".dxcc"));
+
+  CComPtr<IDxcResult> pHitResult;
+  std::string hitStats = compileAndGetStats(pHitResult);
+  VERIFY_ARE_NOT_EQUAL(string::npos, hitStats.find("result: hit"));
+
+  // The miss compiles the text preprocessed for the key, which must produce
+  // what an uncached compile does; the hit must return the same outputs.
+  CComPtr<IDxcResult> pUncachedResult;
+  VERIFY_SUCCEEDED(pCompiler->Compile(&SourceBuf, args, _countof(args) - 1,
+                                      nullptr,
+                                      IID_PPV_ARGS(&pUncachedResult)));
+  for (DXC_OUT_KIND kind : {DXC_OUT_OBJECT, DXC_OUT_SHADER_HASH}) {
+    CComPtr<IDxcBlob> pExpected;
+    VERIFY_SUCCEEDED(
+        pUncachedResult->GetOutput(kind, IID_PPV_ARGS(&pExpected), nullptr));
+    for (IDxcResult *pResult : {pMissResult.p, pHitResult.p}) {
+      CComPtr<IDxcBlob> pActual;
+      VERIFY_SUCCEEDED(
+          pResult->GetOutput(kind, IID_PPV_ARGS(&pActual), nullptr));
+      VERIFY_ARE_EQUAL(pExpected->GetBufferSize(), pActual->GetBufferSize());
+      VERIFY_ARE_EQUAL(0, memcmp(pExpected->GetBufferPointer(),
+                                 pActual->GetBufferPointer(),
+                                 pActual->GetBufferSize()));
+    }
+  }
+}
+
+TEST_F(CompilerTest, CompileLibIncrementallyThenEditExport) {
+  CComPtr<IDxcCompiler3> pCompiler;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+
+  ScopedTempDirectory CacheDir("dxc-compile-cache");
+  std::wstring CacheArg = L"-fcompile-cache=" + CacheDir.GetPath();
+  LPCWSTR args[] = {L"-Tlib_6_3", CacheArg.c_str(), L"-fincremental-lib"};
+
+  std::string errors;
+  auto compileAndGetStats = [&](const std::string &source) {
+    DxcBuffer SourceBuf = {};
+    SourceBuf.Ptr = source.c_str();
+    SourceBuf.Size = source.size();
+    SourceBuf.Encoding = CP_UTF8;
+    CComPtr<IDxcResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(&SourceBuf, args, _countof(args),
+                                        nullptr, IID_PPV_ARGS(&pResult)));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+    CComPtr<IDxcBlob> pObject;
+    VERIFY_SUCCEEDED(
+        pResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&pObject), nullptr));
+    VERIFY_IS_TRUE(pObject->GetBufferSize() > 0);
+    CComPtr<IDxcBlobUtf8> pErrors;
+    VERIFY_SUCCEEDED(
+        pResult->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&pErrors), nullptr));
+    errors.assign(pErrors->GetStringPointer(), pErrors->GetStringLength());
+    CComPtr<IDxcBlobUtf8> pStats;
+    VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_COMPILE_CACHE_STATS,
+                                        IID_PPV_ARGS(&pStats), nullptr));
+    return std::string(pStats->GetStringPointer(), pStats->GetStringLength());
+  };
+
+  std::string common = "float helper(float x) { return x * 3; }\n"
+                       "export float A(float x) { return helper(x); }\n";
+  std::string source = common + "export float B(float x) { return x + 1; }\n";
+  std::string stats = compileAndGetStats(source);
+  VERIFY_ARE_NOT_EQUAL(string::npos, stats.find("result: miss"));
+  VERIFY_ARE_NOT_EQUAL(string::npos, stats.find("exports reused: 0\n"));
+  VERIFY_ARE_NOT_EQUAL(string::npos, stats.find("exports compiled: 2\n"));
+  // One entry for the library and one for each export.
+  VERIFY_ARE_EQUAL(3u, CacheDir.GetFiles().size());
+
+  // Editing B only recompiles B; A comes from the cache and is linked back in.
+  // The warnings of the compile are reported.
+  std::string edited =
+      common + "export float B(float x) { float2 v = x; float w = v; "
+               "return w + 2; }\n";
+  stats = compileAndGetStats(edited);
+  VERIFY_ARE_NOT_EQUAL(string::npos, stats.find("result: miss"));
+  VERIFY_ARE_NOT_EQUAL(string::npos, stats.find("exports reused: 1\n"));
+  VERIFY_ARE_NOT_EQUAL(string::npos, stats.find("exports compiled: 1\n"));
+  VERIFY_ARE_NOT_EQUAL(string::npos,
+                       errors.find("implicit truncation of vector type"));
+  // A new entry for the edited library and one for the edited B.
+  VERIFY_ARE_EQUAL(5u, CacheDir.GetFiles().size());
+
+  // The edited library is now stored whole.
+  stats = compileAndGetStats(edited);
+  VERIFY_ARE_NOT_EQUAL(string::npos, stats.find("result: hit"));
+  VERIFY_ARE_EQUAL(string::npos, stats.find("exports "));
+  VERIFY_ARE_EQUAL(5u, CacheDir.GetFiles().size());
+}
+
+class TestBatchCompileCallback : public IDxcBatchCompileCallback {
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  TestBatchCompileCallback(size_t jobCount)
+      : m_dwRef(0), Statuses(jobCount, S_FALSE) {}
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid,
+                                           void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcBatchCompileCallback>(this, iid,
+                                                           ppvObject);
+  }
+
+  // Compile status of each job; S_FALSE until the job completes.
+  std::vector<HRESULT> Statuses;
+  unsigned CallCount = 0;
+  HRESULT ReturnValue = S_OK;
+
+  HRESULT STDMETHODCALLTYPE OnJobComplete(UINT32 jobIndex, HRESULT hrCompile,
+                                          IDxcResult *pResult) override {
+    // Calls are serialized by the batch compiler.
+    ++CallCount;
+    if (jobIndex >= Statuses.size() || Statuses[jobIndex] != S_FALSE ||
+        FAILED(hrCompile) || pResult == nullptr)
+      return E_UNEXPECTED;
+    return SUCCEEDED(pResult->GetStatus(&Statuses[jobIndex])) ? ReturnValue
+                                                              : E_UNEXPECTED;
+  }
+};
+
+TEST_F(CompilerTest, CompileBatchThenAllJobsComplete) {
+  CComPtr<IDxcBatchCompiler> pBatchCompiler;
+  VERIFY_SUCCEEDED(
+      m_dllSupport.CreateInstance(CLSID_DxcBatchCompiler, &pBatchCompiler));
+
+  std::string goodSource = "float4 main() : SV_Target { return 1; }";
+  std::string badSource = "float4 main() : SV_Target { return undeclared; }";
+  DxcBuffer goodBuf = {goodSource.c_str(), goodSource.size(), CP_UTF8};
+  DxcBuffer badBuf = {badSource.c_str(), badSource.size(), CP_UTF8};
+  LPCWSTR args[] = {L"-Tps_6_0"};
+
+  std::vector<DxcBatchCompileJob> jobs;
+  for (unsigned i = 0; i < 6; ++i) {
+    DxcBatchCompileJob job = {i == 3 ? &badBuf : &goodBuf, args,
+                              _countof(args), nullptr};
+    jobs.push_back(job);
+  }
+
+  // Run twice so the second batch reuses the workers of the first.
+  for (UINT32 maxWorkers : {2u, 0u}) {
+    CComPtr<TestBatchCompileCallback> pCallback =
+        new TestBatchCompileCallback(jobs.size());
+    VERIFY_SUCCEEDED(pBatchCompiler->CompileBatch(
+        jobs.data(), (UINT32)jobs.size(), maxWorkers, pCallback));
+    VERIFY_ARE_EQUAL(jobs.size(), pCallback->CallCount);
+    for (size_t i = 0; i < jobs.size(); ++i) {
+      if (i == 3)
+        VERIFY_FAILED(pCallback->Statuses[i]);
+      else
+        VERIFY_SUCCEEDED(pCallback->Statuses[i]);
+    }
+  }
+
+  // A failing callback stops the batch and its failure is returned.
+  CComPtr<TestBatchCompileCallback> pCallback =
+      new TestBatchCompileCallback(jobs.size());
+  pCallback->ReturnValue = E_ABORT;
+  VERIFY_ARE_EQUAL(E_ABORT, pBatchCompiler->CompileBatch(
+                                jobs.data(), (UINT32)jobs.size(), 2,
+                                pCallback));
+  VERIFY_ARE_EQUAL(1u, pCallback->CallCount);
+}
+
 TEST_F(CompilerTest, CompileWhenIncludeMissingThenFail) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -4577,6 +4974,104 @@ TEST_F(CompilerTest, PreprocessWhenValidThenOK) {
                        text.c_str());
 }
 
+// Collects what is written to it, recording the largest single write.
+class TestOutputStream : public IStream {
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  TestOutputStream() : m_dwRef(0) {}
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid,
+                                           void **ppvObject) override {
+    return DoBasicQueryInterface<IStream, ISequentialStream>(this, iid,
+                                                             ppvObject);
+  }
+
+  std::string Text;
+  ULONG WriteCount = 0;
+  ULONG MaxWriteSize = 0;
+
+  HRESULT STDMETHODCALLTYPE Read(void *, ULONG, ULONG *) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE Write(const void *pv, ULONG cb,
+                                  ULONG *pcbWritten) override {
+    Text.append((const char *)pv, cb);
+    ++WriteCount;
+    MaxWriteSize = std::max(MaxWriteSize, cb);
+    if (pcbWritten)
+      *pcbWritten = cb;
+    return S_OK;
+  }
+  HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER, DWORD,
+                                 ULARGE_INTEGER *) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE SetSize(ULARGE_INTEGER) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE CopyTo(IStream *, ULARGE_INTEGER, ULARGE_INTEGER *,
+                                   ULARGE_INTEGER *) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE Commit(DWORD) override { return S_OK; }
+  HRESULT STDMETHODCALLTYPE Revert(void) override { return E_NOTIMPL; }
+  HRESULT STDMETHODCALLTYPE LockRegion(ULARGE_INTEGER, ULARGE_INTEGER,
+                                       DWORD) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE UnlockRegion(ULARGE_INTEGER, ULARGE_INTEGER,
+                                         DWORD) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE Stat(STATSTG *, DWORD) override {
+    return E_NOTIMPL;
+  }
+  HRESULT STDMETHODCALLTYPE Clone(IStream **) override { return E_NOTIMPL; }
+};
+
+TEST_F(CompilerTest, PreprocessToStreamThenWrittenInChunks) {
+  CComPtr<IDxcCompiler3> pCompiler;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+  CComPtr<IDxcStreamPreprocessor> pStreamPreprocessor;
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pStreamPreprocessor));
+
+  // Expands to several megabytes.
+  std::string source = "#define A float x;\n"
+                       "#define B A A A A A A A A A A A A A A A A\n"
+                       "#define C B B B B B B B B B B B B B B B B\n"
+                       "#define D C C C C C C C C C C C C C C C C\n";
+  for (unsigned i = 0; i < 64; ++i)
+    source += "D\n";
+  DxcBuffer SourceBuf = {};
+  SourceBuf.Ptr = source.c_str();
+  SourceBuf.Size = source.size();
+  SourceBuf.Encoding = CP_UTF8;
+  LPCWSTR args[] = {L"-P", L"-Fi", L"out.hlsl"};
+
+  CComPtr<IDxcResult> pExpected;
+  VERIFY_SUCCEEDED(pCompiler->Compile(&SourceBuf, args, _countof(args),
+                                      nullptr, IID_PPV_ARGS(&pExpected)));
+  CComPtr<IDxcBlobUtf8> pExpectedText;
+  VERIFY_SUCCEEDED(pExpected->GetOutput(
+      DXC_OUT_HLSL, IID_PPV_ARGS(&pExpectedText), nullptr));
+
+  CComPtr<TestOutputStream> pOutput = new TestOutputStream();
+  CComPtr<IDxcResult> pResult;
+  VERIFY_SUCCEEDED(pStreamPreprocessor->PreprocessToStream(
+      &SourceBuf, args, _countof(args), nullptr, pOutput,
+      IID_PPV_ARGS(&pResult)));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+  VERIFY_IS_FALSE(pResult->HasOutput(DXC_OUT_HLSL));
+
+  VERIFY_ARE_EQUAL(std::string(pExpectedText->GetStringPointer(),
+                               pExpectedText->GetStringLength()),
+                   pOutput->Text);
+  VERIFY_IS_TRUE(pOutput->WriteCount > 1);
+  VERIFY_IS_TRUE(pOutput->MaxWriteSize <= 64 * 1024);
+}
+
 TEST_F(CompilerTest, PreprocessWhenExpandTokenPastingOperandThenAccept) {
   // Tests that we can turn on fxc's behavior (pre-expanding operands before
   // performing token-pasting) using -flegacy-macro-expansion
@@ -115,6 +115,8 @@ protected:
   TEST_METHOD(TUWhenRegionInactiveThenEndIsBeforeEndifHash)
   TEST_METHOD(TUWhenRegionInactiveThenStartIsAtIfdefEol)
   TEST_METHOD(TUWhenUnsaveFileThenOK)
+  TEST_METHOD(TUWhenSkipIncludedFunctionBodiesThenIncludedBodiesSkipped)
+  TEST_METHOD(TUWhenReparseAsyncThenLatestWins)
 
   TEST_METHOD(QualifiedNameClass)
   TEST_METHOD(QualifiedNameVariable)
@@ -522,6 +524,86 @@ TEST_F(DXIntellisenseTest, TUWhenUnsaveFileThenOK) {
   }
 }
 
+TEST_F(DXIntellisenseTest,
+       TUWhenSkipIncludedFunctionBodiesThenIncludedBodiesSkipped) {
+  const char main_text[] = "#include \"inc.h\"\r\n"
+                           "float f() { return undeclared_in_main; }";
+  const char inc_text[] = "float g() { return undeclared_in_inc; }";
+  const unsigned optionValues[] = {
+      DxcTranslationUnitFlags_UseCallerThread,
+      DxcTranslationUnitFlags_UseCallerThread |
+          DxcTranslationUnitFlags_PrecompiledPreamble,
+      DxcTranslationUnitFlags_UseCallerThread |
+          DxcTranslationUnitFlags_SkipIncludedFunctionBodies};
+  const unsigned expectedCounts[] = {2, 2, 1};
+
+  for (unsigned i = 0; i < _countof(optionValues); ++i) {
+    CComPtr<IDxcIntelliSense> isense;
+    CComPtr<IDxcIndex> index;
+    CComPtr<IDxcUnsavedFile> unsaved[2];
+    CComPtr<IDxcTranslationUnit> TU;
+    unsigned diagCount;
+    VERIFY_SUCCEEDED(
+        CompilationResult::DefaultHlslSupport->CreateIntellisense(&isense));
+    VERIFY_SUCCEEDED(isense->CreateIndex(&index));
+    VERIFY_SUCCEEDED(isense->CreateUnsavedFile("./inc.h", inc_text,
+                                               strlen(inc_text), &unsaved[0]));
+    VERIFY_SUCCEEDED(isense->CreateUnsavedFile(
+        "file.hlsl", main_text, strlen(main_text), &unsaved[1]));
+    VERIFY_SUCCEEDED(index->ParseTranslationUnit(
+        "file.hlsl", nullptr, 0, &unsaved[0].p, 2,
+        (DxcTranslationUnitFlags)optionValues[i], &TU));
+    // Errors in the bodies of included functions are only skipped on request;
+    // errors in the main file are always found.
+    VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+    VERIFY_ARE_EQUAL(expectedCounts[i], diagCount);
+  }
+}
+
+TEST_F(DXIntellisenseTest, TUWhenReparseAsyncThenLatestWins) {
+  const char bad_text[] = "float f() { return undeclared; }";
+  const char worse_text[] = "float f() { return undeclared + also; }";
+  const char good_text[] = "float f() { return 1; }";
+  CComPtr<IDxcIntelliSense> isense;
+  CComPtr<IDxcIndex> index;
+  CComPtr<IDxcUnsavedFile> unsaved[3];
+  CComPtr<IDxcTranslationUnit> TU;
+  CComPtr<IDxcTranslationUnit2> TU2;
+  unsigned diagCount;
+  BOOL pending;
+  HRESULT reparseStatus;
+  VERIFY_SUCCEEDED(
+      CompilationResult::DefaultHlslSupport->CreateIntellisense(&isense));
+  VERIFY_SUCCEEDED(isense->CreateIndex(&index));
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", bad_text,
+                                             strlen(bad_text), &unsaved[0]));
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", worse_text,
+                                             strlen(worse_text), &unsaved[1]));
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", good_text,
+                                             strlen(good_text), &unsaved[2]));
+  VERIFY_SUCCEEDED(index->ParseTranslationUnit(
+      "file.hlsl", nullptr, 0, &unsaved[0].p, 1,
+      DxcTranslationUnitFlags_UseCallerThread, &TU));
+  VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(1U, diagCount);
+
+  // Only the last edit needs to be reflected once the reparse settles.
+  VERIFY_SUCCEEDED(TU.QueryInterface(&TU2));
+  VERIFY_SUCCEEDED(TU2->ReparseAsync(&unsaved[1].p, 1));
+  VERIFY_SUCCEEDED(TU2->ReparseAsync(&unsaved[2].p, 1));
+  VERIFY_SUCCEEDED(TU2->WaitForReparse(&reparseStatus));
+  VERIFY_SUCCEEDED(reparseStatus);
+  VERIFY_SUCCEEDED(TU2->IsReparsePending(&pending));
+  VERIFY_IS_FALSE(pending);
+  VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(0U, diagCount);
+
+  // A reparse still running when the translation unit goes away is waited on.
+  VERIFY_SUCCEEDED(TU2->ReparseAsync(&unsaved[0].p, 1));
+  TU2.Release();
+  TU.Release();
+}
+
 TEST_F(DXIntellisenseTest, QualifiedNameClass) {
   char program[] = "class TheClass {\r\n"
                    "};\r\n"
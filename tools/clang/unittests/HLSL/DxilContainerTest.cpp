@@ -44,7 +44,9 @@
 #endif
 #endif
 
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/MSFileSystem.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "dxc/Test/HLSLTestData.h"
@@ -55,6 +57,7 @@
 #include "dxc/Support/dxcapi.use.h"
 #include "dxc/Support/HLSLOptions.h"
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilContainer/DxilContainerReader.h"
 #include "dxc/DxilContainer/DxilRuntimeReflection.h"
 #include <assert.h> // Needed for DxilPipelineStateValidation.h
 #include "dxc/DxilContainer/DxilPipelineStateValidation.h"
@@ -115,6 +118,8 @@ public:
   TEST_METHOD(DisassemblyWhenValidThenOK)
   TEST_METHOD(ValidateFromLL_Abs2)
   TEST_METHOD(DxilContainerUnitTest)
+  TEST_METHOD(DxilContainerReaderViewsParts)
+  TEST_METHOD(DxilContainerReaderLoadsFile)
   TEST_METHOD(DxilContainerCompilerVersionTest)
   TEST_METHOD(ContainerBuilder_AddPrivateForceLast)
 
@@ -2936,3 +2941,102 @@ TEST_F(DxilContainerTest, DxilContainerUnitTest) {
       hlsl::GetDxilProgramHeader(&header, hlsl::DxilFourCC::DFCC_DXIL));
   VERIFY_IS_NULL(hlsl::GetDxilPartByType(&header, hlsl::DxilFourCC::DFCC_DXIL));
 }
+
+TEST_F(DxilContainerTest, DxilContainerReaderViewsParts) {
+  if (m_ver.SkipDxilVersion(1, 3))
+    return;
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram("float4 main() : SV_Target { return 0; }", L"main",
+                   L"ps_6_0", nullptr, 0, &pProgram);
+
+  hlsl::DxilContainerReader reader;
+  VERIFY_SUCCEEDED(reader.Load(pProgram->GetBufferPointer(),
+                               (uint32_t)pProgram->GetBufferSize()));
+
+  // Parts point into the caller's buffer.
+  const void *pPart = nullptr;
+  uint32_t partSize = 0;
+  VERIFY_SUCCEEDED(reader.FindFirstPartContent(hlsl::DFCC_DXIL, &pPart,
+                                               &partSize));
+  const char *pBegin = (const char *)pProgram->GetBufferPointer();
+  VERIFY_IS_TRUE(pBegin < (const char *)pPart &&
+                 (const char *)pPart + partSize <=
+                     pBegin + pProgram->GetBufferSize());
+
+  DxilPipelineStateValidation PSV;
+  VERIFY_SUCCEEDED(reader.GetPipelineStateValidation(PSV));
+  VERIFY_ARE_EQUAL(PSV.GetSigOutputElements(), 1U);
+
+  hlsl::RDAT::DxilRuntimeData RDAT;
+  VERIFY_ARE_EQUAL(reader.GetRuntimeData(RDAT), DXC_E_MISSING_PART);
+
+  pProgram.Release();
+  CompileToProgram("export float f(float x) { return x * 2; }", L"",
+                   L"lib_6_3", nullptr, 0, &pProgram);
+  VERIFY_SUCCEEDED(reader.Load(pProgram->GetBufferPointer(),
+                               (uint32_t)pProgram->GetBufferSize()));
+  VERIFY_SUCCEEDED(reader.GetRuntimeData(RDAT));
+  VERIFY_ARE_EQUAL(RDAT.GetFunctionTable().Count(), 1U);
+}
+
+TEST_F(DxilContainerTest, DxilContainerReaderLoadsFile) {
+  if (m_ver.SkipDxilVersion(1, 3))
+    return;
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram("float4 main() : SV_Target { return 0; }", L"main",
+                   L"ps_6_0", nullptr, 0, &pProgram);
+  const char *pBegin = (const char *)pProgram->GetBufferPointer();
+  uint32_t programSize = (uint32_t)pProgram->GetBufferSize();
+
+  ::llvm::sys::fs::MSFileSystem *msfPtr;
+  VERIFY_SUCCEEDED(CreateMSFileSystemForDisk(&msfPtr));
+  std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+  ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+  VERIFY_IS_FALSE((bool)pts.error_code());
+
+  // Writes the first size bytes of the container to a new temporary file.
+  std::vector<std::string> fileNames;
+  auto writeFile = [&](uint32_t size) -> std::string {
+    llvm::SmallString<128> path;
+    int fd;
+    VERIFY_IS_FALSE(
+        (bool)llvm::sys::fs::createTemporaryFile("dxil", "dxo", fd, path));
+    {
+      llvm::raw_fd_ostream OS(fd, /*shouldClose*/ true);
+      OS.write(pBegin, size);
+    }
+    fileNames.push_back(path.str());
+    return path.str();
+  };
+
+  hlsl::DxilContainerReader reader;
+  VERIFY_SUCCEEDED(reader.LoadFile(writeFile(programSize)));
+  uint32_t partCount = 0;
+  VERIFY_SUCCEEDED(reader.GetPartCount(&partCount));
+  VERIFY_ARE_EQUAL(partCount,
+                   hlsl::IsDxilContainerLike(pBegin, programSize)->PartCount);
+
+  // Parts point into the file owned by the reader, and hold what was written.
+  for (uint32_t i = 0; i < partCount; ++i) {
+    const void *pPart = nullptr;
+    uint32_t partSize = 0;
+    VERIFY_SUCCEEDED(reader.GetPartContent(i, &pPart, &partSize));
+    const hlsl::DxilPartHeader *pExpected = hlsl::GetDxilContainerPart(
+        hlsl::IsDxilContainerLike(pBegin, programSize), i);
+    VERIFY_ARE_EQUAL(partSize, pExpected->PartSize);
+    VERIFY_IS_FALSE(pBegin <= (const char *)pPart &&
+                    (const char *)pPart < pBegin + programSize);
+    VERIFY_ARE_EQUAL(
+        0, memcmp(pPart, hlsl::GetDxilPartData(pExpected), partSize));
+  }
+  DxilPipelineStateValidation PSV;
+  VERIFY_SUCCEEDED(reader.GetPipelineStateValidation(PSV));
+  VERIFY_ARE_EQUAL(PSV.GetSigOutputElements(), 1U);
+
+  // A truncated container fails to load, and leaves the reader unloaded.
+  VERIFY_FAILED(reader.LoadFile(writeFile(programSize / 2)));
+  VERIFY_ARE_EQUAL(reader.GetPartCount(&partCount), E_NOT_VALID_STATE);
+
+  for (const std::string &fileName : fileNames)
+    llvm::sys::fs::remove(fileName);
+}
@@ -11,6 +11,7 @@
 #include "dxc/DXIL/DxilInstructions.h"
 #include "dxc/DXIL/DxilOperations.h"
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilInterp/DxilInterpreter.h"
 #include "dxc/HLSL/HLOperationLowerExtension.h"
 #include "dxc/HlslIntrinsicOp.h"
 #include "dxc/Support/microcom.h"
@@ -73,6 +74,8 @@ public:
 
   TEST_METHOD(CanonicalSystemValueSemantic)
 
+  TEST_METHOD(InterpretDivergentWaveActiveSum)
+
   void VerifyValidatorVersionFails(LPCWSTR shaderModel,
                                    const std::vector<LPCWSTR> &arguments,
                                    const std::vector<LPCSTR> &expectedErrors);
@@ -640,3 +643,77 @@ TEST_F(DxilModuleTest, CanonicalSystemValueSemantic) {
                      1, 4, 0, 0, 0, {0});
   VERIFY_ARE_EQUAL_STR("SV_Position", newElt->GetSemanticName().data());
 }
+
+TEST_F(DxilModuleTest, InterpretDivergentWaveActiveSum) {
+  // The WaveActiveSum shader from ShaderOpArithTable.xml, run through the
+  // DXIL interpreter with the masks and validation of
+  // ExecutionTest::WaveIntrinsicsActiveIntTest.
+  Compiler c(m_dllSupport);
+  c.Compile("struct PerThreadData {\n"
+            "  uint firstLaneId; uint laneIndex; int mask; int input;\n"
+            "  int output;\n"
+            "};\n"
+            "RWStructuredBuffer<PerThreadData> g_sb : register(u0);\n"
+            "[numthreads(8,12,1)]\n"
+            "void main(uint GI : SV_GroupIndex) {\n"
+            "  PerThreadData pts = g_sb[GI];\n"
+            "  pts.firstLaneId = WaveReadLaneFirst(GI);\n"
+            "  pts.laneIndex = WaveGetLaneIndex();\n"
+            "  if (pts.mask != 0) {\n"
+            "    pts.output = WaveActiveSum(pts.input);\n"
+            "  } else {\n"
+            "    pts.output = WaveActiveSum(pts.input);\n"
+            "  }\n"
+            "  g_sb[GI] = pts;\n"
+            "}\n",
+            L"cs_6_0");
+  DxilModule &DM = c.GetDxilModule();
+
+  struct PerThreadData {
+    uint32_t firstLaneId;
+    uint32_t laneIndex;
+    int32_t mask;
+    int32_t input;
+    int32_t output;
+  };
+  const unsigned NumThreads = 8 * 12;
+  const int32_t Inputs[] = {1, 2, 3, 4};
+  bool (*const Masks[])(unsigned) = {
+      [](unsigned) { return true; },
+      [](unsigned i) { return i % 2 == 0; },
+      [](unsigned i) { return i % 3 == 0; },
+  };
+
+  DxilInterpreter Interp(DM);
+  for (unsigned WaveSize : {4u, 32u, 64u}) {
+    Interp.SetWaveSize(WaveSize);
+    for (auto Mask : Masks) {
+      std::vector<PerThreadData> Data(NumThreads);
+      for (unsigned i = 0; i < NumThreads; ++i) {
+        Data[i].firstLaneId = 0xFFFFBFFF;
+        Data[i].laneIndex = 0xFFFFBFFF;
+        Data[i].mask = Mask(i) ? 1 : 0;
+        Data[i].input = Inputs[i % _countof(Inputs)];
+        Data[i].output = 0xFFFFBFFF;
+      }
+      Interp.BindResource(DXIL::ResourceClass::UAV, 0, 0, Data.data(),
+                          Data.size() * sizeof(PerThreadData));
+      Interp.Dispatch(1, 1, 1);
+
+      // Waves are packed in SV_GroupIndex order, and each WaveActiveSum
+      // only sees the lanes of its wave that took the same branch.
+      for (unsigned i = 0; i < NumThreads; ++i) {
+        unsigned Wave = i / WaveSize;
+        int32_t Expected = 0;
+        for (unsigned j = Wave * WaveSize;
+             j < std::min((Wave + 1) * WaveSize, NumThreads); ++j) {
+          if (Mask(j) == Mask(i))
+            Expected += Inputs[j % _countof(Inputs)];
+        }
+        VERIFY_ARE_EQUAL(Wave * WaveSize, Data[i].firstLaneId);
+        VERIFY_ARE_EQUAL(i % WaveSize, Data[i].laneIndex);
+        VERIFY_ARE_EQUAL(Expected, Data[i].output);
+      }
+    }
+  }
+}
@@ -19,10 +19,16 @@
 #include <fstream>
 
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilValidation/DxilValidation.h"
+#include "dxc/HLSL/DxilLinker.h"
 #include "dxc/Support/Global.h" // for IFT macro
 #include "dxc/Test/DxcTestUtils.h"
 #include "dxc/Test/HlslTestUtils.h"
 #include "dxc/dxcapi.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
 
 using namespace std;
 using namespace hlsl;
@@ -79,6 +85,7 @@ public:
   TEST_METHOD(RunLinkWithDxcResultNames)
   TEST_METHOD(RunLinkWithDxcResultRdat)
   TEST_METHOD(RunLinkWithDxcResultErrors)
+  TEST_METHOD(RunLinkEntriesMatchesLink)
 
   dxc::DxcDllSupport m_dllSupport;
   VersionSupportInfo m_ver;
@@ -1272,3 +1279,92 @@ TEST_F(LinkerTest, RunLinkWithDxcResultErrors) {
                                 pErrorOutput->GetStringLength()));
   }
 }
+
+TEST_F(LinkerTest, RunLinkEntriesMatchesLink) {
+  CComPtr<IDxcBlob> pEntryLib, pResLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_entries2.hlsl", &pEntryLib);
+  CompileLib(L"..\\CodeGenHLSL\\lib_resource2.hlsl", &pResLib);
+
+  // Register the libs the way IDxcLinker does, lazily loaded from their DXIL
+  // parts.
+  LLVMContext Ctx;
+  unsigned ValMajor, ValMinor;
+  GetValidationVersion(&ValMajor, &ValMinor);
+  std::unique_ptr<DxilLinker> pLinker(
+      DxilLinker::CreateLinker(Ctx, ValMajor, ValMinor));
+  std::pair<const char *, IDxcBlob *> Libs[] = {{"entry", pEntryLib},
+                                                {"res", pResLib}};
+  for (auto &Lib : Libs) {
+    const DxilContainerHeader *pHeader = IsDxilContainerLike(
+        Lib.second->GetBufferPointer(), Lib.second->GetBufferSize());
+    VERIFY_IS_NOT_NULL(pHeader);
+    const DxilPartHeader *pPart = GetDxilPartByType(pHeader, DFCC_DXIL);
+    VERIFY_IS_NOT_NULL(pPart);
+    const char *pIL = nullptr;
+    uint32_t ILLength = 0;
+    GetDxilProgramBitcode(
+        reinterpret_cast<const DxilProgramHeader *>(GetDxilPartData(pPart)),
+        &pIL, &ILLength);
+
+    std::unique_ptr<llvm::Module> pModule, pDebugModule;
+    std::string Diag;
+    raw_string_ostream DiagStream(Diag);
+    VERIFY_SUCCEEDED(ValidateLoadModuleFromContainerLazy(
+        Lib.second->GetBufferPointer(), Lib.second->GetBufferSize(), pModule,
+        pDebugModule, Ctx, Ctx, DiagStream));
+    VERIFY_IS_NULL(pDebugModule.get());
+    VERIFY_IS_TRUE(pLinker->RegisterLib(Lib.first, std::move(pModule), nullptr,
+                                        StringRef(pIL, ILLength)));
+    VERIFY_IS_TRUE(pLinker->AttachLib(Lib.first));
+  }
+
+  std::vector<DxilLinkEntry> Entries;
+  Entries.emplace_back("vs_main", "vs_6_0");
+  Entries.emplace_back("hs_main", "hs_6_0");
+  Entries.emplace_back("ds_main", "ds_6_0");
+  Entries.emplace_back("gs_main", "gs_6_0");
+  Entries.emplace_back("ps_main", "ps_6_0");
+  Entries.emplace_back("cs_main", "cs_6_0");
+
+  // Link every entry one at a time first.
+  std::vector<std::string> Expected;
+  for (DxilLinkEntry &Entry : Entries) {
+    dxilutil::ExportMap ExportMap;
+    std::unique_ptr<llvm::Module> pM =
+        pLinker->Link(Entry.Entry, Entry.Profile, ExportMap);
+    VERIFY_IS_NOT_NULL(pM.get());
+    std::string Bitcode;
+    raw_string_ostream OS(Bitcode);
+    WriteBitcodeToFile(pM.get(), OS);
+    Expected.emplace_back(OS.str());
+  }
+
+  // Each entry linked in parallel is identical to the one linked alone.
+  VERIFY_IS_TRUE(pLinker->LinkEntries(Entries, 3));
+  for (unsigned i = 0; i < Entries.size(); ++i) {
+    VERIFY_IS_NOT_NULL(Entries[i].pModule.get());
+    VERIFY_ARE_EQUAL_STR("", Entries[i].Diagnostics.c_str());
+    std::string Bitcode;
+    raw_string_ostream OS(Bitcode);
+    WriteBitcodeToFile(Entries[i].pModule.get(), OS);
+    VERIFY_IS_TRUE(OS.str() == Expected[i]);
+  }
+
+  // Entries can only be linked from libs registered with their bitcode.
+  LLVMContext OtherCtx;
+  std::unique_ptr<DxilLinker> pOtherLinker(
+      DxilLinker::CreateLinker(OtherCtx, ValMajor, ValMinor));
+  std::unique_ptr<llvm::Module> pModule, pDebugModule;
+  std::string Diag;
+  raw_string_ostream DiagStream(Diag);
+  VERIFY_SUCCEEDED(ValidateLoadModuleFromContainerLazy(
+      pEntryLib->GetBufferPointer(), pEntryLib->GetBufferSize(), pModule,
+      pDebugModule, OtherCtx, OtherCtx, DiagStream));
+  VERIFY_IS_TRUE(
+      pOtherLinker->RegisterLib("entry", std::move(pModule), nullptr));
+  VERIFY_IS_TRUE(pOtherLinker->AttachLib("entry"));
+  std::vector<DxilLinkEntry> OtherEntries;
+  OtherEntries.emplace_back("ps_main", "ps_6_0");
+  VERIFY_IS_FALSE(pOtherLinker->LinkEntries(OtherEntries, 0));
+  VERIFY_IS_NULL(OtherEntries[0].pModule.get());
+}
@@ -20,10 +20,18 @@
 #include "dxc/DxilContainer/DxilContainerAssembler.h"
 #include "dxc/DxilContainer/DxilPipelineStateValidation.h"
 #include "dxc/DxilHash/DxilHash.h"
+#include "dxc/DxilValidation/DxilValidation.h"
 #include "dxc/Support/WinIncludes.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Regex.h"
+#include "llvm/Support/raw_ostream.h"
 
 #ifdef _WIN32
 #include <atlbase.h>
@@ -52,6 +60,8 @@ public:
   TEST_CLASS_SETUP(InitSupport);
 
   TEST_METHOD(WhenCorrectThenOK)
+  TEST_METHOD(WhenModuleDiffersFromDxilPartThenFail)
+  TEST_METHOD(WhenLibValidatedConcurrentlyThenDiagsMatchSerial)
   TEST_METHOD(WhenMisalignedThenFail)
   TEST_METHOD(WhenEmptyFileThenFail)
   TEST_METHOD(WhenIncorrectMagicThenFail)
@@ -711,6 +721,119 @@ TEST_F(ValidationTest, WhenCorrectThenOK) {
   CheckValidationMsgs(pProgram, nullptr);
 }
 
+TEST_F(ValidationTest, WhenModuleDiffersFromDxilPartThenFail) {
+  CComPtr<IDxcBlob> pProgram, pOtherProgram;
+  if (!CompileSource("float4 main() : SV_Target { return 1; }", "ps_6_0",
+                     &pProgram))
+    return;
+  CompileSource("float4 main() : SV_Target { return 2; }", "ps_6_0",
+                &pOtherProgram);
+
+  // Load the module from the DXIL part of the first program.
+  const DxilContainerHeader *pContainer = IsDxilContainerLike(
+      pProgram->GetBufferPointer(), pProgram->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pContainer);
+  const DxilPartHeader *pPart = GetDxilPartByType(pContainer, DFCC_DXIL);
+  VERIFY_IS_NOT_NULL(pPart);
+  const char *pIL = nullptr;
+  uint32_t ILLength = 0;
+  GetDxilProgramBitcode(
+      reinterpret_cast<const DxilProgramHeader *>(GetDxilPartData(pPart)), &pIL,
+      &ILLength);
+  llvm::LLVMContext Context;
+  std::unique_ptr<llvm::MemoryBuffer> pBitcodeBuf(
+      llvm::MemoryBuffer::getMemBuffer(llvm::StringRef(pIL, ILLength), "",
+                                       false));
+  llvm::ErrorOr<std::unique_ptr<llvm::Module>> pModule(
+      llvm::parseBitcodeFile(pBitcodeBuf->getMemBufferRef(), Context));
+  VERIFY_IS_FALSE((bool)pModule.getError());
+
+  std::string Diag;
+  llvm::raw_string_ostream DiagStream(Diag);
+  // Validating the module in place certifies the container it came from...
+  llvm::StringRef ModuleBitcode(pIL, ILLength);
+  VERIFY_SUCCEEDED(ValidateDxilContainerWithModule(
+      pProgram->GetBufferPointer(), pProgram->GetBufferSize(),
+      pModule.get().get(), ModuleBitcode, nullptr, DiagStream));
+  // ...but not one whose DXIL part holds a different module.
+  VERIFY_FAILED(ValidateDxilContainerWithModule(
+      pOtherProgram->GetBufferPointer(), pOtherProgram->GetBufferSize(),
+      pModule.get().get(), ModuleBitcode, nullptr, DiagStream));
+  DiagStream.flush();
+  VERIFY_ARE_NOT_EQUAL(
+      std::string::npos,
+      Diag.find("Container part 'DXIL Program' does not match expected for "
+                "module."));
+}
+
+TEST_F(ValidationTest, WhenLibValidatedConcurrentlyThenDiagsMatchSerial) {
+  // Enough function definitions to split them between several workers.
+  const unsigned NumFunctions = 64;
+  std::string Source;
+  for (unsigned i = 0; i < NumFunctions; ++i)
+    Source += "export float f" + std::to_string(i) +
+              "(float a) { return a * " + std::to_string(i + 2) + "; }\n";
+  CComPtr<IDxcBlob> pProgram;
+  if (!CompileSource(Source.c_str(), "lib_6_3", &pProgram))
+    return;
+
+  const DxilContainerHeader *pContainer = IsDxilContainerLike(
+      pProgram->GetBufferPointer(), pProgram->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pContainer);
+  const DxilPartHeader *pPart = GetDxilPartByType(pContainer, DFCC_DXIL);
+  VERIFY_IS_NOT_NULL(pPart);
+  const char *pIL = nullptr;
+  uint32_t ILLength = 0;
+  GetDxilProgramBitcode(
+      reinterpret_cast<const DxilProgramHeader *>(GetDxilPartData(pPart)), &pIL,
+      &ILLength);
+  llvm::LLVMContext Context;
+  std::unique_ptr<llvm::MemoryBuffer> pBitcodeBuf(
+      llvm::MemoryBuffer::getMemBuffer(llvm::StringRef(pIL, ILLength), "",
+                                       false));
+  llvm::ErrorOr<std::unique_ptr<llvm::Module>> pModule(
+      llvm::parseBitcodeFile(pBitcodeBuf->getMemBufferRef(), Context));
+  VERIFY_IS_FALSE((bool)pModule.getError());
+
+  // Give every function a division by zero to report.
+  llvm::Type *I32Ty = llvm::Type::getInt32Ty(Context);
+  unsigned NumDefinitions = 0;
+  for (llvm::Function &F : *pModule.get()) {
+    if (F.isDeclaration())
+      continue;
+    llvm::BinaryOperator::CreateUDiv(llvm::ConstantInt::get(I32Ty, 1),
+                                     llvm::ConstantInt::get(I32Ty, 0), "",
+                                     F.back().getTerminator());
+    ++NumDefinitions;
+  }
+  VERIFY_IS_GREATER_THAN_OR_EQUAL(NumDefinitions, NumFunctions);
+  std::string Bitcode;
+  llvm::raw_string_ostream BitcodeStream(Bitcode);
+  llvm::WriteBitcodeToFile(pModule.get().get(), BitcodeStream);
+  BitcodeStream.flush();
+
+  auto Validate = [&](unsigned MaxThreads) {
+    ScopedValidationThreadLimit Limit(MaxThreads);
+    std::string Diag;
+    llvm::raw_string_ostream DiagStream(Diag);
+    VERIFY_FAILED(
+        ValidateDxilBitcode(Bitcode.data(), Bitcode.size(), DiagStream));
+    DiagStream.flush();
+    return Diag;
+  };
+  std::string SerialDiag = Validate(1);
+  std::string ConcurrentDiag = Validate(4);
+  VERIFY_ARE_EQUAL_STR(SerialDiag.c_str(), ConcurrentDiag.c_str());
+
+  // Every function is reported, in module order.
+  size_t Pos = 0;
+  for (unsigned i = 0; i < NumFunctions; ++i) {
+    std::string Name = "?f" + std::to_string(i) + "@@";
+    Pos = ConcurrentDiag.find(Name, Pos);
+    VERIFY_ARE_NOT_EQUAL(std::string::npos, Pos);
+  }
+}
+
 // Lots of these going on below for simplicity in setting up payloads.
 //
 // warning C4838: conversion from 'int' to 'const char' requires a narrowing
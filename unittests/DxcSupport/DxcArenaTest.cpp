@@ -0,0 +1,131 @@
+//===- unittests/DxcSupport/DxcArenaTest.cpp ------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// DxcArenaMalloc unit tests.
+//
+//===----------------------------------------------------------------------===//
+
+#include "dxc/Support/WinIncludes.h"
+
+#include "dxc/Support/Global.h"
+#include "dxc/Support/dxcarena.h"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace hlsl;
+
+namespace {
+
+// Releasing an arena goes through the thread allocator.
+class DxcArenaTest : public ::testing::Test {
+protected:
+  static void SetUpTestCase() { DxcInitThreadMalloc(); }
+  static void TearDownTestCase() { DxcCleanupThreadMalloc(); }
+
+  void SetUp() override {
+    ASSERT_TRUE(SUCCEEDED(DxcCoGetMalloc(1, &pMalloc)));
+  }
+
+  CComPtr<IMalloc> pMalloc;
+};
+
+TEST_F(DxcArenaTest, AllocRoundsUpToSizeClass) {
+  CComPtr<DxcArenaMalloc> pArena = DxcArenaMalloc::Alloc(pMalloc);
+  ASSERT_TRUE(pArena != nullptr);
+  for (SIZE_T cb = 1; cb <= 256 * 1024; cb += cb < 4096 ? 1 : 97) {
+    void *pv = pArena->Alloc(cb);
+    ASSERT_TRUE(pv != nullptr);
+    EXPECT_EQ(0u, (uintptr_t)pv % 16);
+    EXPECT_TRUE(pArena->Owns(pv));
+    // Classes are multiples of 16 bytes, then a quarter of a power of two.
+    EXPECT_GE(pArena->GetSize(pv), cb);
+    EXPECT_LE(pArena->GetSize(pv), cb + cb / 4 + 16);
+    pArena->Free(pv);
+  }
+  DxcArenaStats Stats;
+  pArena->GetStats(&Stats);
+  EXPECT_EQ(0u, Stats.LiveBytes);
+}
+
+TEST_F(DxcArenaTest, FreedBlocksAreReused) {
+  CComPtr<DxcArenaMalloc> pArena = DxcArenaMalloc::Alloc(pMalloc);
+  ASSERT_TRUE(pArena != nullptr);
+  void *pFirst = pArena->Alloc(100);
+  pArena->Free(pFirst);
+  EXPECT_EQ(pFirst, pArena->Alloc(100));
+  pArena->Free(pFirst);
+  // Alternating allocations would fill many chunks if freed memory were
+  // never handed out again.
+  for (unsigned i = 0; i < 100000; ++i)
+    pArena->Free(pArena->Alloc(1000 + i % 1000));
+  DxcArenaStats Stats;
+  pArena->GetStats(&Stats);
+  EXPECT_EQ(1u, Stats.ChunkCount);
+  EXPECT_EQ(0u, Stats.LiveBytes);
+}
+
+TEST_F(DxcArenaTest, LargeAllocationsUseParent) {
+  CComPtr<DxcArenaMalloc> pArena = DxcArenaMalloc::Alloc(pMalloc);
+  ASSERT_TRUE(pArena != nullptr);
+  void *pv = pArena->Alloc(1024 * 1024);
+  ASSERT_TRUE(pv != nullptr);
+  EXPECT_FALSE(pArena->Owns(pv));
+  EXPECT_FALSE(DxcArenaFree(pv));
+  pArena->Free(pv);
+  DxcArenaStats Stats;
+  pArena->GetStats(&Stats);
+  EXPECT_EQ(1u, Stats.ParentAllocCount);
+  EXPECT_EQ(0u, Stats.ChunkCount);
+}
+
+TEST_F(DxcArenaTest, BlockOutlivesArena) {
+  void *pv;
+  {
+    CComPtr<DxcArenaMalloc> pArena = DxcArenaMalloc::Alloc(pMalloc);
+    ASSERT_TRUE(pArena != nullptr);
+    // Blocks on the free list are returned to their chunk on release.
+    pArena->Free(pArena->Alloc(32));
+    pv = pArena->Alloc(32);
+    memset(pv, 0xcc, 32);
+  }
+  EXPECT_TRUE(DxcArenaFree(pv));
+  void *pOther = pMalloc->Alloc(32);
+  EXPECT_FALSE(DxcArenaFree(pOther));
+  pMalloc->Free(pOther);
+}
+
+TEST_F(DxcArenaTest, ConcurrentAllocAndFree) {
+  CComPtr<DxcArenaMalloc> pArena = DxcArenaMalloc::Alloc(pMalloc);
+  ASSERT_TRUE(pArena != nullptr);
+  std::vector<std::thread> Threads;
+  for (unsigned t = 0; t < 4; ++t) {
+    Threads.emplace_back([&pArena, t]() {
+      std::vector<void *> Blocks;
+      for (unsigned i = 0; i < 20000; ++i) {
+        Blocks.push_back(pArena->Alloc((i * 37 + t) % 3000 + 1));
+        if (i % 3 == 0) {
+          pArena->Free(Blocks.back());
+          Blocks.pop_back();
+        }
+      }
+      for (void *pv : Blocks)
+        pArena->Free(pv);
+    });
+  }
+  for (std::thread &Thread : Threads)
+    Thread.join();
+  DxcArenaStats Stats;
+  pArena->GetStats(&Stats);
+  EXPECT_EQ(0u, Stats.LiveBytes);
+  EXPECT_EQ(80000u, Stats.AllocCount);
+}
+
+} // namespace
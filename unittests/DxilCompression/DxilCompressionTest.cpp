@@ -0,0 +1,154 @@
+//===- unittests/DxilCompression/DxilCompressionTest.cpp ------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// DxilCompression.h unit tests.
+//
+//===----------------------------------------------------------------------===//
+
+#include "dxc/Support/WinIncludes.h"
+
+#include "dxc/DxilCompression/DxilCompression.h"
+#include "dxc/DxilCompression/DxilCompressionHelpers.h"
+#include "llvm/ADT/STLExtras.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace hlsl;
+
+namespace {
+
+// Compressible data, large enough that the compressed output is passed on in
+// several segments.
+std::vector<uint8_t> MakeTestData() {
+  std::vector<uint8_t> Data;
+  uint32_t Seed = 1;
+  for (unsigned Line = 0; Data.size() < 1024 * 1024; ++Line) {
+    std::string Text = "float4 value" + std::to_string(Line) + " = " +
+                       std::to_string(Seed % 1000) + ";\n";
+    Data.insert(Data.end(), Text.begin(), Text.end());
+    // Some incompressible bytes too.
+    for (unsigned i = 0; i < 16; ++i) {
+      Seed = Seed * 1103515245 + 12345;
+      Data.push_back((uint8_t)(Seed >> 16));
+    }
+  }
+  return Data;
+}
+
+// The bundled miniz does not allocate on its own, so every test passes an
+// allocator.
+class DxilCompressionTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_TRUE(SUCCEEDED(DxcCoGetMalloc(1, &pMalloc)));
+  }
+
+  std::vector<uint8_t> Inflate(const std::vector<uint8_t> &Compressed,
+                               size_t UncompressedSize) {
+    std::vector<uint8_t> Data(UncompressedSize);
+    EXPECT_EQ(ZlibResult::Success,
+              ZlibDecompress(pMalloc, Compressed.data(), Compressed.size(),
+                             Data.data(), Data.size()));
+    return Data;
+  }
+
+  CComPtr<IMalloc> pMalloc;
+};
+
+TEST_F(DxilCompressionTest, StreamSingleWriteRoundTrip) {
+  std::vector<uint8_t> Data = MakeTestData();
+  std::vector<uint8_t> Compressed;
+  {
+    ZlibCompressStream Stream(pMalloc, &Compressed,
+                              ZlibAppendCallback<std::vector<uint8_t>>);
+    EXPECT_EQ(ZlibResult::Success, Stream.Write(Data.data(), Data.size()));
+    EXPECT_EQ(ZlibResult::Success, Stream.Finish());
+    EXPECT_EQ(Compressed.size(), Stream.GetCompressedSize());
+  }
+  EXPECT_LT(Compressed.size(), Data.size());
+  EXPECT_EQ(Data, Inflate(Compressed, Data.size()));
+}
+
+TEST_F(DxilCompressionTest, StreamMultipleWritesRoundTrip) {
+  std::vector<uint8_t> Data = MakeTestData();
+  std::vector<uint8_t> Compressed;
+  ZlibCompressStream Stream(pMalloc, &Compressed,
+                            ZlibAppendCallback<std::vector<uint8_t>>);
+  // Pieces of varying size, including empty ones and pieces larger than the
+  // segment the stream gathers its output in.
+  const size_t PieceSizes[] = {0, 1, 7, 4096, 0, 65536, 100000, 3};
+  size_t Offset = 0;
+  for (unsigned i = 0; Offset < Data.size(); ++i) {
+    size_t Size = std::min(PieceSizes[i % llvm::array_lengthof(PieceSizes)],
+                           Data.size() - Offset);
+    EXPECT_EQ(ZlibResult::Success, Stream.Write(Data.data() + Offset, Size));
+    Offset += Size;
+  }
+  EXPECT_EQ(ZlibResult::Success, Stream.Finish());
+  EXPECT_EQ(Compressed.size(), Stream.GetCompressedSize());
+  EXPECT_EQ(Data, Inflate(Compressed, Data.size()));
+}
+
+TEST_F(DxilCompressionTest, StreamEmptyRoundTrip) {
+  std::vector<uint8_t> Compressed;
+  ZlibCompressStream Stream(pMalloc, &Compressed,
+                            ZlibAppendCallback<std::vector<uint8_t>>);
+  EXPECT_EQ(ZlibResult::Success, Stream.Finish());
+  EXPECT_FALSE(Compressed.empty());
+  uint8_t Byte = 0;
+  EXPECT_EQ(ZlibResult::Success,
+            ZlibDecompress(pMalloc, Compressed.data(), Compressed.size(),
+                           &Byte, 0));
+}
+
+TEST_F(DxilCompressionTest, StreamMatchesCompressAppend) {
+  std::vector<uint8_t> Data = MakeTestData();
+  for (int Level : {ZlibDefaultCompression, ZlibNoCompression, ZlibBestSpeed,
+                    ZlibBestCompression}) {
+    SCOPED_TRACE(Level);
+    std::vector<uint8_t> Expected;
+    EXPECT_EQ(ZlibResult::Success,
+              ZlibCompressAppend(pMalloc, Data.data(), Data.size(), Expected,
+                                 Level));
+
+    std::vector<uint8_t> Streamed;
+    ZlibCompressStream Stream(pMalloc, &Streamed,
+                              ZlibAppendCallback<std::vector<uint8_t>>, Level);
+    const size_t Half = Data.size() / 2;
+    EXPECT_EQ(ZlibResult::Success, Stream.Write(Data.data(), Half));
+    EXPECT_EQ(ZlibResult::Success,
+              Stream.Write(Data.data() + Half, Data.size() - Half));
+    EXPECT_EQ(ZlibResult::Success, Stream.Finish());
+    // Stored blocks are split wherever the output buffer fills, and miniz's
+    // fastest level looks ahead less when not told the input is complete, so
+    // at those levels only the data is the same.
+    if (Level == ZlibNoCompression || Level == ZlibBestSpeed)
+      EXPECT_EQ(Data, Inflate(Streamed, Data.size()));
+    else
+      EXPECT_EQ(Expected, Streamed);
+  }
+}
+
+TEST_F(DxilCompressionTest, StreamCallbackFailureIsSticky) {
+  std::vector<uint8_t> Data = MakeTestData();
+  auto FailingCallback = [](void *, size_t) -> void * { return nullptr; };
+  ZlibCompressStream Stream(pMalloc, nullptr, FailingCallback);
+  ZlibResult Result = Stream.Write(Data.data(), Data.size());
+  if (Result == ZlibResult::Success)
+    Result = Stream.Finish();
+  EXPECT_EQ(ZlibResult::OutOfMemory, Result);
+  EXPECT_EQ(ZlibResult::OutOfMemory, Stream.Write(Data.data(), 1));
+  EXPECT_EQ(ZlibResult::OutOfMemory, Stream.Finish());
+  EXPECT_EQ(0u, Stream.GetCompressedSize());
+}
+
+} // namespace
@@ -16,6 +16,8 @@ using UINT32 = unsigned int;
 
 #include "dxc/DxilHash/DxilHash.h"
 #include "gtest/gtest.h"
+#include <string>
+#include <vector>
 
 namespace {
 
@@ -122,4 +124,37 @@ TEST(DxilHashTest, FixHashValueTest) {
       true);
 }
 
+TEST(DxilHashTest, MultipleBufferTest) {
+  // Sizes around the block and padding boundaries, in an order that puts
+  // differently sized buffers in the same group of lanes.
+  std::vector<std::string> Inputs;
+  for (unsigned Size : {200u, 0u, 1u, 55u, 56u, 63u, 64u, 65u, 119u, 120u,
+                        127u, 128u, 1000u, 3u, 4096u}) {
+    std::string S;
+    for (unsigned i = 0; i < Size; ++i)
+      S.push_back((char)(i * 7 + Size));
+    Inputs.push_back(S);
+  }
+
+  std::vector<const BYTE *> Data;
+  std::vector<UINT32> Sizes;
+  for (const std::string &S : Inputs) {
+    Data.push_back((const BYTE *)S.data());
+    Sizes.push_back(S.size());
+  }
+
+  std::vector<OutputHash> Retail(Inputs.size()), Debug(Inputs.size());
+  ComputeHashRetailMultiple(Data.data(), Sizes.data(), Data.size(),
+                            (BYTE *)Retail.data());
+  ComputeHashDebugMultiple(Data.data(), Sizes.data(), Data.size(),
+                           (BYTE *)Debug.data());
+  for (size_t i = 0; i < Inputs.size(); ++i) {
+    OutputHash O;
+    ComputeHashRetail(Data[i], Sizes[i], (BYTE *)&O);
+    EXPECT_EQ(O, Retail[i]);
+    ComputeHashDebug(Data[i], Sizes[i], (BYTE *)&O);
+    EXPECT_EQ(O, Debug[i]);
+  }
+}
+
 } // namespace
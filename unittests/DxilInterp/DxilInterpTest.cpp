@@ -0,0 +1,390 @@
+//===- unittests/DxilInterp/DxilInterpTest.cpp ---- Run DxilInterp tests --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// DxilInterpreter.h unit tests.
+//
+//===----------------------------------------------------------------------===//
+
+#include "dxc/DxilInterp/DxilInterpreter.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/Support/Global.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace hlsl;
+using namespace llvm;
+
+namespace {
+
+const char Prologue[] = R"(
+target datalayout = "e-m:e-p:32:32-i1:32-i8:32-i16:32-i32:32-i64:64-f16:32-f32:32-f64:64-n8:16:32:64"
+target triple = "dxil-ms-dx"
+
+%dx.types.Handle = type { i8* }
+%dx.types.ResRet.f32 = type { float, float, float, float, i32 }
+%dx.types.CBufRet.f32 = type { float, float, float, float }
+%struct.RWByteAddressBuffer = type { i32 }
+%"class.Buffer<float>" = type { float }
+%"class.RWBuffer<float>" = type { float }
+%Constants = type { float }
+
+declare %dx.types.Handle @dx.op.createHandle(i32, i8, i32, i32, i1)
+declare i32 @dx.op.threadId.i32(i32, i32)
+declare i32 @dx.op.flattenedThreadIdInGroup.i32(i32)
+declare void @dx.op.rawBufferStore.i32(i32, %dx.types.Handle, i32, i32, i32, i32, i32, i32, i8, i32)
+)";
+
+const char RawUAV[] = R"(
+!20 = !{!21}
+!21 = !{i32 0, %struct.RWByteAddressBuffer* undef, !"Out", i32 0, i32 0, i32 1, i32 11, i1 false, i1 false, i1 false, null}
+)";
+
+// Builds a compute shader module around Body, which defines @main and the
+// resource lists referenced by Resources.
+std::string MakeModule(const std::string &Body, const std::string &Resources,
+                       unsigned NumThreads) {
+  return std::string(Prologue) + Body + R"(
+!dx.version = !{!0}
+!dx.valver = !{!1}
+!dx.shaderModel = !{!2}
+!dx.resources = !{!3}
+!dx.entryPoints = !{!4}
+
+!0 = !{i32 1, i32 6}
+!1 = !{i32 1, i32 8}
+!2 = !{!"cs", i32 6, i32 6}
+!3 = )" + Resources + R"(
+!4 = !{void ()* @main, !"main", null, !3, !5}
+!5 = !{i32 4, !6}
+!6 = !{i32 )" + std::to_string(NumThreads) +
+         ", i32 1, i32 1}\n";
+}
+
+class DxilInterpTest : public ::testing::Test {
+protected:
+  LLVMContext Context;
+  std::unique_ptr<Module> M;
+
+  DxilModule &Parse(const std::string &Source) {
+    SMDiagnostic Err;
+    M = parseAssemblyString(Source, Err, Context);
+    if (!M) {
+      Err.print("DxilInterpTest", errs());
+      report_fatal_error("failed to parse test module");
+    }
+    return M->GetOrCreateDxilModule();
+  }
+};
+
+TEST_F(DxilInterpTest, ThreadIdToRawBuffer) {
+  DxilModule &DM = Parse(MakeModule(R"(
+define void @main() {
+  %h = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 0, i32 0, i1 false)
+  %tid = call i32 @dx.op.threadId.i32(i32 93, i32 0)
+  %v = mul i32 %tid, 3
+  %off = shl i32 %tid, 2
+  call void @dx.op.rawBufferStore.i32(i32 140, %dx.types.Handle %h, i32 %off, i32 undef, i32 %v, i32 undef, i32 undef, i32 undef, i8 1, i32 4)
+  ret void
+}
+)" + std::string(RawUAV),
+                                    "!{null, !20, null, null}", 8));
+  std::vector<uint32_t> Out(16);
+  DxilInterpreter Interp(DM);
+  EXPECT_EQ(32u, Interp.GetWaveSize());
+  Interp.BindResource(DXIL::ResourceClass::UAV, 0, 0, Out.data(),
+                      Out.size() * 4);
+  Interp.Dispatch(2, 1, 1);
+  for (unsigned i = 0; i < Out.size(); ++i)
+    EXPECT_EQ(i * 3, Out[i]);
+
+  const DxilInterpStats &Stats = Interp.GetStats();
+  EXPECT_EQ(2u, Stats.Groups);
+  EXPECT_EQ(2u, Stats.Waves);
+  EXPECT_EQ(12u, Stats.WaveInstructions);
+  EXPECT_EQ(96u, Stats.LaneInstructions);
+  Interp.ResetStats();
+  EXPECT_EQ(0u, Interp.GetStats().WaveInstructions);
+}
+
+TEST_F(DxilInterpTest, DivergentWaveOps) {
+  DxilModule &DM = Parse(MakeModule(R"(
+declare i32 @dx.op.waveActiveOp.i32(i32, i32, i8, i8)
+
+define void @main() {
+entry:
+  %h = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 0, i32 0, i1 false)
+  %tid = call i32 @dx.op.threadId.i32(i32 93, i32 0)
+  %bit = and i32 %tid, 1
+  %odd = icmp ne i32 %bit, 0
+  br i1 %odd, label %then, label %else
+
+then:
+  %a = call i32 @dx.op.waveActiveOp.i32(i32 119, i32 %tid, i8 0, i8 1)
+  br label %merge
+
+else:
+  %b = call i32 @dx.op.waveActiveOp.i32(i32 119, i32 100, i8 0, i8 1)
+  br label %merge
+
+merge:
+  %r = phi i32 [ %a, %then ], [ %b, %else ]
+  %count = call i32 @dx.op.waveActiveOp.i32(i32 119, i32 1, i8 0, i8 1)
+  %off = shl i32 %tid, 3
+  call void @dx.op.rawBufferStore.i32(i32 140, %dx.types.Handle %h, i32 %off, i32 undef, i32 %r, i32 %count, i32 undef, i32 undef, i8 3, i32 4)
+  ret void
+}
+)" + std::string(RawUAV),
+                                    "!{null, !20, null, null}", 8));
+  std::vector<uint32_t> Out(16);
+  DxilInterpreter Interp(DM);
+  Interp.SetWaveSize(4);
+  Interp.BindResource(DXIL::ResourceClass::UAV, 0, 0, Out.data(),
+                      Out.size() * 4);
+  Interp.Dispatch(1, 1, 1);
+  // Each branch only sees its own lanes; all lanes are back at the merge.
+  const uint32_t Expected[8] = {200, 1 + 3, 200, 1 + 3, 200, 5 + 7, 200, 5 + 7};
+  for (unsigned i = 0; i < 8; ++i) {
+    EXPECT_EQ(Expected[i], Out[i * 2]) << "thread " << i;
+    EXPECT_EQ(4u, Out[i * 2 + 1]) << "thread " << i;
+  }
+  EXPECT_EQ(2u, Interp.GetStats().Waves);
+}
+
+TEST_F(DxilInterpTest, InvalidWaveSizeThrows) {
+  DxilModule &DM = Parse(MakeModule(R"(
+define void @main() {
+  ret void
+}
+)",
+                                    "!{null, null, null, null}", 1));
+  DxilInterpreter Interp(DM);
+  // Lanes are wrapped with a mask, so sizes must be powers of two.
+  for (unsigned Size : {0u, 2u, 24u, 48u, 256u}) {
+    try {
+      Interp.SetWaveSize(Size);
+      FAIL() << "expected an exception for wave size " << Size;
+    } catch (const hlsl::Exception &E) {
+      EXPECT_EQ(E_INVALIDARG, E.hr);
+    }
+  }
+  EXPECT_EQ(32u, Interp.GetWaveSize());
+  Interp.SetWaveSize(128);
+  EXPECT_EQ(128u, Interp.GetWaveSize());
+}
+
+TEST_F(DxilInterpTest, GroupSharedBarrier) {
+  DxilModule &DM = Parse(MakeModule(R"(
+@gs = addrspace(3) global [8 x i32] undef, align 4
+
+declare void @dx.op.barrier(i32, i32)
+
+define void @main() {
+  %h = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 0, i32 0, i1 false)
+  %tid = call i32 @dx.op.flattenedThreadIdInGroup.i32(i32 96)
+  %p = getelementptr [8 x i32], [8 x i32] addrspace(3)* @gs, i32 0, i32 %tid
+  %v = mul i32 %tid, 10
+  store i32 %v, i32 addrspace(3)* %p, align 4
+  call void @dx.op.barrier(i32 80, i32 9)
+  %rev = sub i32 7, %tid
+  %q = getelementptr [8 x i32], [8 x i32] addrspace(3)* @gs, i32 0, i32 %rev
+  %w = load i32, i32 addrspace(3)* %q, align 4
+  %off = shl i32 %tid, 2
+  call void @dx.op.rawBufferStore.i32(i32 140, %dx.types.Handle %h, i32 %off, i32 undef, i32 %w, i32 undef, i32 undef, i32 undef, i8 1, i32 4)
+  ret void
+}
+)" + std::string(RawUAV),
+                                    "!{null, !20, null, null}", 8));
+  std::vector<uint32_t> Out(8);
+  DxilInterpreter Interp(DM);
+  // Two waves, so the second one's stores must land before the first reads.
+  Interp.SetWaveSize(4);
+  Interp.BindResource(DXIL::ResourceClass::UAV, 0, 0, Out.data(),
+                      Out.size() * 4);
+  Interp.Dispatch(1, 1, 1);
+  for (unsigned i = 0; i < 8; ++i)
+    EXPECT_EQ((7 - i) * 10, Out[i]) << "thread " << i;
+}
+
+TEST_F(DxilInterpTest, LoopWithDivergentExitAndCall) {
+  DxilModule &DM = Parse(MakeModule(R"(
+declare i32 @dx.op.waveActiveOp.i32(i32, i32, i8, i8)
+
+define i32 @clamp3(i32 %x) {
+entry:
+  %big = icmp ugt i32 %x, 3
+  br i1 %big, label %early, label %done
+
+early:
+  ret i32 3
+
+done:
+  ret i32 %x
+}
+
+define void @main() {
+entry:
+  %h = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 0, i32 0, i1 false)
+  %tid = call i32 @dx.op.threadId.i32(i32 93, i32 0)
+  %none = icmp eq i32 %tid, 0
+  br i1 %none, label %exit, label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %c = call i32 @clamp3(i32 %i)
+  %acc.next = add i32 %acc, %c
+  %i.next = add i32 %i, 1
+  %more = icmp ult i32 %i.next, %tid
+  br i1 %more, label %loop, label %exit
+
+exit:
+  %sum = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %count = call i32 @dx.op.waveActiveOp.i32(i32 119, i32 1, i8 0, i8 1)
+  %off = shl i32 %tid, 3
+  call void @dx.op.rawBufferStore.i32(i32 140, %dx.types.Handle %h, i32 %off, i32 undef, i32 %sum, i32 %count, i32 undef, i32 undef, i8 3, i32 4)
+  ret void
+}
+)" + std::string(RawUAV),
+                                    "!{null, !20, null, null}", 8));
+  std::vector<uint32_t> Out(16);
+  DxilInterpreter Interp(DM);
+  Interp.SetWaveSize(8);
+  Interp.BindResource(DXIL::ResourceClass::UAV, 0, 0, Out.data(),
+                      Out.size() * 4);
+  Interp.Dispatch(1, 1, 1);
+  uint32_t Sum = 0;
+  for (unsigned i = 0; i < 8; ++i) {
+    EXPECT_EQ(Sum, Out[i * 2]) << "thread " << i;
+    EXPECT_EQ(8u, Out[i * 2 + 1]) << "thread " << i;
+    Sum += std::min(i, 3u);
+  }
+}
+
+TEST_F(DxilInterpTest, TypedBuffersAndCBuffer) {
+  DxilModule &DM = Parse(MakeModule(R"(
+declare %dx.types.ResRet.f32 @dx.op.bufferLoad.f32(i32, %dx.types.Handle, i32, i32)
+declare void @dx.op.bufferStore.f32(i32, %dx.types.Handle, i32, i32, float, float, float, float, i8)
+declare %dx.types.CBufRet.f32 @dx.op.cbufferLoadLegacy.f32(i32, %dx.types.Handle, i32)
+
+define void @main() {
+  %in = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 0, i32 0, i32 0, i1 false)
+  %out = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 0, i32 0, i1 false)
+  %cb = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 2, i32 0, i32 0, i1 false)
+  %tid = call i32 @dx.op.threadId.i32(i32 93, i32 0)
+  %ld = call %dx.types.ResRet.f32 @dx.op.bufferLoad.f32(i32 68, %dx.types.Handle %in, i32 %tid, i32 undef)
+  %x = extractvalue %dx.types.ResRet.f32 %ld, 0
+  %row = call %dx.types.CBufRet.f32 @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %cb, i32 0)
+  %scale = extractvalue %dx.types.CBufRet.f32 %row, 0
+  %y = fmul fast float %x, %scale
+  call void @dx.op.bufferStore.f32(i32 69, %dx.types.Handle %out, i32 %tid, i32 undef, float %y, float %y, float %y, float %y, i8 15)
+  ret void
+}
+
+!10 = !{!11}
+!11 = !{i32 0, %"class.Buffer<float>"* undef, !"In", i32 0, i32 0, i32 1, i32 10, i32 0, !12}
+!12 = !{i32 0, i32 9}
+!20 = !{!21}
+!21 = !{i32 0, %"class.RWBuffer<float>"* undef, !"Out", i32 0, i32 0, i32 1, i32 10, i1 false, i1 false, i1 false, !12}
+!30 = !{!31}
+!31 = !{i32 0, %Constants* undef, !"Constants", i32 0, i32 0, i32 1, i32 4, null}
+)",
+                                    "!{!10, !20, !30, null}", 8));
+  std::vector<float> In = {1, 2, 3, 4, 5, 6};
+  float Scale = 2.5f;
+  std::vector<float> Out(8, -1.0f);
+  DxilInterpreter Interp(DM);
+  Interp.BindResource(DXIL::ResourceClass::SRV, 0, 0, In.data(),
+                      In.size() * 4);
+  Interp.BindResource(DXIL::ResourceClass::CBuffer, 0, 0, &Scale, 4);
+  // Leave the last element unbound; its store is out of bounds.
+  Interp.BindResource(DXIL::ResourceClass::UAV, 0, 0, Out.data(), 7 * 4);
+  Interp.Dispatch(1, 1, 1);
+  for (unsigned i = 0; i < 6; ++i)
+    EXPECT_EQ(In[i] * Scale, Out[i]) << "thread " << i;
+  EXPECT_EQ(0.0f, Out[6]);
+  EXPECT_EQ(-1.0f, Out[7]);
+}
+
+TEST_F(DxilInterpTest, AtomicsAndCounter) {
+  DxilModule &DM = Parse(MakeModule(R"(
+declare i32 @dx.op.atomicBinOp.i32(i32, %dx.types.Handle, i32, i32, i32, i32, i32)
+declare i32 @dx.op.bufferUpdateCounter(i32, %dx.types.Handle, i8)
+
+define void @main() {
+  %h = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 0, i32 0, i1 false)
+  %tid = call i32 @dx.op.threadId.i32(i32 93, i32 0)
+  %old = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %h, i32 0, i32 0, i32 undef, i32 undef, i32 2)
+  %slot = call i32 @dx.op.bufferUpdateCounter(i32 70, %dx.types.Handle %h, i8 1)
+  %idx = add i32 %slot, 1
+  %off = shl i32 %idx, 2
+  call void @dx.op.rawBufferStore.i32(i32 140, %dx.types.Handle %h, i32 %off, i32 undef, i32 %tid, i32 undef, i32 undef, i32 undef, i8 1, i32 4)
+  ret void
+}
+)" + std::string(RawUAV),
+                                    "!{null, !20, null, null}", 16));
+  std::vector<uint32_t> Out(33);
+  DxilInterpreter Interp(DM);
+  Interp.BindResource(DXIL::ResourceClass::UAV, 0, 0, Out.data(),
+                      Out.size() * 4);
+  Interp.Dispatch(2, 1, 1);
+  EXPECT_EQ(64u, Out[0]);
+  EXPECT_EQ(32u, Interp.GetUAVCounter(0, 0));
+  std::vector<uint32_t> Ids(Out.begin() + 1, Out.end());
+  std::sort(Ids.begin(), Ids.end());
+  for (unsigned i = 0; i < Ids.size(); ++i)
+    EXPECT_EQ(i, Ids[i]);
+}
+
+TEST_F(DxilInterpTest, UnsupportedOperationThrows) {
+  DxilModule &DM = Parse(MakeModule(R"(
+declare float @dx.op.derivCoarseX.f32(i32, float)
+
+define void @main() {
+  %d = call float @dx.op.derivCoarseX.f32(i32 83, float 1.000000e+00)
+  ret void
+}
+)",
+                                    "!{null, null, null, null}", 1));
+  DxilInterpreter Interp(DM);
+  try {
+    Interp.Dispatch(1, 1, 1);
+    FAIL() << "expected an exception";
+  } catch (const hlsl::Exception &E) {
+    EXPECT_EQ(DXC_E_NOT_SUPPORTED, E.hr);
+    EXPECT_NE(std::string::npos, E.msg.find("DerivCoarseX")) << E.msg;
+  }
+}
+
+TEST_F(DxilInterpTest, UnboundResourceThrows) {
+  DxilModule &DM = Parse(MakeModule(R"(
+define void @main() {
+  %h = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 0, i32 0, i1 false)
+  call void @dx.op.rawBufferStore.i32(i32 140, %dx.types.Handle %h, i32 0, i32 undef, i32 1, i32 undef, i32 undef, i32 undef, i8 1, i32 4)
+  ret void
+}
+)" + std::string(RawUAV),
+                                    "!{null, !20, null, null}", 1));
+  DxilInterpreter Interp(DM);
+  try {
+    Interp.Dispatch(1, 1, 1);
+    FAIL() << "expected an exception";
+  } catch (const hlsl::Exception &E) {
+    EXPECT_EQ(E_INVALIDARG, E.hr);
+    EXPECT_NE(std::string::npos, E.msg.find("u0, space0")) << E.msg;
+  }
+}
+
+} // namespace
@@ -0,0 +1,142 @@
+//===- DxilCDBench - Benchmark the ControlDependence analysis -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program computes the control dependence of every function in the given
+// IR files, for instance the .ll files under tools/clang/test/CodeGenDXIL,
+// and outputs the time spent building post dominator trees, recording them,
+// and answering queries for every block or only for the blocks with calls.
+//
+//===----------------------------------------------------------------------===//
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/HLSL/ControlDependence.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+static cl::list<std::string> InputFilenames(cl::Positional, cl::OneOrMore,
+                                            cl::desc("<IR files>"));
+
+static cl::opt<unsigned> Iterations("iterations",
+                                    cl::desc("Number of times to compute"),
+                                    cl::init(10));
+
+static double now() { return TimeRecord::getCurrentTime(false).getWallTime(); }
+
+static bool HasCall(BasicBlock &BB) {
+  for (Instruction &I : BB)
+    if (isa<CallInst>(I))
+      return true;
+  return false;
+}
+
+static void report(StringRef Name, double Seconds, unsigned Iterations) {
+  outs() << Name << ": " << format("%.3f", Seconds * 1000 / Iterations)
+         << " ms per iteration\n";
+}
+
+int main(int argc, char **argv) {
+  llvm::sys::fs::MSFileSystem *msfPtr;
+  if (!SUCCEEDED(CreateMSFileSystemForDisk(&msfPtr)))
+    return 1;
+  std::unique_ptr<llvm::sys::fs::MSFileSystem> msf(msfPtr);
+  llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+  llvm::STDStreamCloser stdStreamCloser;
+
+  cl::ParseCommandLineOptions(argc, argv, "ControlDependence benchmark\n");
+
+  LLVMContext Context;
+  std::vector<std::unique_ptr<Module>> Modules;
+  std::vector<Function *> Functions;
+  for (const std::string &Filename : InputFilenames) {
+    SMDiagnostic Err;
+    std::unique_ptr<Module> M = parseIRFile(Filename, Err, Context);
+    if (!M) {
+      // Tests of invalid IR are expected in a test corpus.
+      errs() << "Skipping " << Filename << ": " << Err.getMessage() << "\n";
+      continue;
+    }
+    for (Function &F : *M)
+      if (!F.empty())
+        Functions.push_back(&F);
+    Modules.push_back(std::move(M));
+  }
+
+  uint64_t NumBlocks = 0;
+  for (Function *F : Functions)
+    NumBlocks += F->size();
+  outs() << Modules.size() << " modules, " << Functions.size()
+         << " functions, " << NumBlocks << " blocks, " << Iterations
+         << " iterations\n";
+
+  std::vector<std::unique_ptr<PostDomRelationType>> PostDoms;
+  double Start = now();
+  for (unsigned It = 0; It < Iterations; ++It) {
+    PostDoms.clear();
+    for (Function *F : Functions) {
+      PostDoms.emplace_back(new PostDomRelationType(true));
+      PostDoms.back()->recalculate(*F);
+    }
+  }
+  report("post dominators", now() - Start, Iterations);
+
+  // Queries for all blocks, as when printing the whole relation, and for
+  // blocks with calls only, as when a pass asks about the blocks of the
+  // stores and intrinsics it visits.
+  double ComputeTime = 0, AllTime = 0, CallsTime = 0;
+  uint64_t NumEdges = 0;
+  for (unsigned It = 0; It < Iterations; ++It) {
+    std::vector<ControlDependence> CDs(Functions.size());
+    Start = now();
+    for (size_t i = 0; i < Functions.size(); ++i)
+      CDs[i].Compute(Functions[i], *PostDoms[i]);
+    ComputeTime += now() - Start;
+
+    Start = now();
+    NumEdges = 0;
+    for (size_t i = 0; i < Functions.size(); ++i) {
+      for (BasicBlock &BB : *Functions[i])
+        for (BasicBlock *pCDBB : CDs[i].GetCDBlocks(&BB)) {
+          (void)pCDBB;
+          ++NumEdges;
+        }
+    }
+    AllTime += now() - Start;
+
+    for (size_t i = 0; i < Functions.size(); ++i)
+      CDs[i].Compute(Functions[i], *PostDoms[i]);
+    Start = now();
+    for (size_t i = 0; i < Functions.size(); ++i) {
+      for (BasicBlock &BB : *Functions[i])
+        if (HasCall(BB))
+          for (BasicBlock *pCDBB : CDs[i].GetCDBlocks(&BB))
+            (void)pCDBB;
+    }
+    CallsTime += now() - Start;
+  }
+  outs() << NumEdges << " control dependences\n";
+  report("compute", ComputeTime, Iterations);
+  report("query all blocks", AllTime, Iterations);
+  report("query blocks with calls", CallsTime, Iterations);
+  return 0;
+}
@@ -0,0 +1,143 @@
+//===- DxilContainerBench - Benchmark writing DXIL containers -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program writes DXIL containers for the given DXIL modules, for instance
+// the output of dxc -T lib_6_x -Fc, and outputs the time spent in
+// SerializeDxilContainerForModule. Library targets with debug info are the
+// interesting case, since their program part is written again after stripping.
+// Serializing strips the module, so each iteration parses the files again;
+// only serialization is timed.
+//
+//===----------------------------------------------------------------------===//
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilContainer/DxilContainerAssembler.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/dxcapi.impl.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+static cl::list<std::string> InputFilenames(cl::Positional, cl::OneOrMore,
+                                            cl::desc("<DXIL IR files>"));
+
+static cl::opt<unsigned> Iterations("iterations",
+                                    cl::desc("Number of times to serialize"),
+                                    cl::init(10));
+
+static cl::opt<bool> DebugInfoPart("debug-info-part",
+                                   cl::desc("Include the debug info part"),
+                                   cl::init(false));
+
+static double now() { return TimeRecord::getCurrentTime(false).getWallTime(); }
+
+int main(int argc, char **argv) {
+  llvm::sys::fs::MSFileSystem *msfPtr;
+  if (!SUCCEEDED(CreateMSFileSystemForDisk(&msfPtr)))
+    return 1;
+  std::unique_ptr<llvm::sys::fs::MSFileSystem> msf(msfPtr);
+  llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+  llvm::STDStreamCloser stdStreamCloser;
+  if (FAILED(DxcInitThreadMalloc()))
+    return 1;
+  DxcSetThreadMallocToDefault();
+
+  cl::ParseCommandLineOptions(argc, argv, "DXIL container writer benchmark\n");
+
+  std::vector<std::unique_ptr<MemoryBuffer>> Buffers;
+  for (const std::string &Filename : InputFilenames) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+        MemoryBuffer::getFile(Filename);
+    if (!Buffer) {
+      errs() << "Cannot read " << Filename << "\n";
+      return 1;
+    }
+    Buffers.push_back(std::move(*Buffer));
+  }
+
+  // The compiler's default output: reflection moves to its own part.
+  SerializeDxilFlags Flags = SerializeDxilFlags::IncludeDebugNamePart;
+  Flags |= SerializeDxilFlags::IncludeReflectionPart;
+  Flags |= SerializeDxilFlags::StripReflectionFromDxilPart;
+  if (DebugInfoPart)
+    Flags |= SerializeDxilFlags::IncludeDebugInfoPart;
+
+  uint64_t NumBytes = 0;
+  unsigned NumModules = 0;
+  double Total = 0, Best = 0;
+  for (unsigned It = 0; It < Iterations; ++It) {
+    std::vector<std::unique_ptr<LLVMContext>> Contexts;
+    std::vector<std::unique_ptr<Module>> Modules;
+    std::vector<CComPtr<AbstractMemoryStream>> Bitcode;
+    for (const std::unique_ptr<MemoryBuffer> &Buffer : Buffers) {
+      SMDiagnostic Err;
+      Contexts.emplace_back(new LLVMContext);
+      std::unique_ptr<Module> M =
+          parseIR(Buffer->getMemBufferRef(), Err, *Contexts.back());
+      if (!M) {
+        errs() << "Skipping " << Buffer->getBufferIdentifier() << ": "
+               << Err.getMessage() << "\n";
+        continue;
+      }
+      // Load the DXIL module from the metadata.
+      M->GetOrCreateDxilModule();
+      // The compiler hands over the module's bitcode as well.
+      CComPtr<AbstractMemoryStream> pBitcode;
+      IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pBitcode));
+      raw_stream_ostream OS(pBitcode.p);
+      WriteBitcodeToFile(M.get(), OS, true);
+      OS.flush();
+      Bitcode.push_back(pBitcode);
+      Modules.push_back(std::move(M));
+    }
+
+    NumBytes = 0;
+    NumModules = Modules.size();
+    double Time = 0;
+    for (unsigned i = 0; i < Modules.size(); ++i) {
+      CComPtr<AbstractMemoryStream> pContainer;
+      IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pContainer));
+      double Start = now();
+      SerializeDxilContainerForModule(&Modules[i]->GetDxilModule(), Bitcode[i],
+                                      nullptr, pContainer, "", Flags);
+      Time += now() - Start;
+      NumBytes += pContainer->GetPtrSize();
+    }
+    Total += Time;
+    if (It == 0 || Time < Best)
+      Best = Time;
+  }
+
+  outs() << NumModules << " modules, " << NumBytes << " container bytes, "
+         << Iterations << " iterations\n";
+  if (NumModules == 0)
+    return 0;
+  outs() << "mean: " << format("%.3f", Total * 1e3 / Iterations)
+         << " ms per iteration\n";
+  outs() << "best: " << format("%.3f", Best * 1e3) << " ms per iteration, "
+         << format("%.1f", NumBytes / Best / (1024 * 1024)) << " MB/s\n";
+  return 0;
+}
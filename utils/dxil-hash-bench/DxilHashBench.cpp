@@ -0,0 +1,132 @@
+//===- DxilHashBench - Benchmark the DxilHash implementation --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program hashes containers, or generated buffers of a given size, with
+// the single and multi-buffer DxilHash functions and outputs the throughput.
+//
+//===----------------------------------------------------------------------===//
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/DxilHash/DxilHash.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <vector>
+
+using namespace llvm;
+
+static cl::list<std::string> InputFilenames(cl::Positional,
+                                            cl::desc("<container files>"));
+
+static cl::opt<unsigned>
+    BufferSizeKB("size",
+                 cl::desc("Size in KB of each generated buffer, when no "
+                          "files are given"),
+                 cl::init(1024));
+
+static cl::opt<unsigned>
+    BufferCount("buffers",
+                cl::desc("Number of generated buffers, when no files are "
+                         "given"),
+                cl::init(16));
+
+static cl::opt<unsigned> Iterations("iterations",
+                                    cl::desc("Number of times to hash"),
+                                    cl::init(10));
+
+static cl::opt<bool> Debug("debug",
+                           cl::desc("Benchmark the debug hash instead of the "
+                                    "retail hash"),
+                           cl::init(false));
+
+static void report(StringRef Name, double Seconds, uint64_t Bytes) {
+  double MBPerSecond = Seconds > 0 ? Bytes / Seconds / (1024 * 1024) : 0;
+  outs() << Name << ": " << format("%.3f", Seconds) << " s, "
+         << format("%.1f", MBPerSecond) << " MB/s\n";
+}
+
+int main(int argc, char **argv) {
+  llvm::sys::fs::MSFileSystem *msfPtr;
+  if (!SUCCEEDED(CreateMSFileSystemForDisk(&msfPtr)))
+    return 1;
+  std::unique_ptr<llvm::sys::fs::MSFileSystem> msf(msfPtr);
+  llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+  llvm::STDStreamCloser stdStreamCloser;
+
+  cl::ParseCommandLineOptions(argc, argv, "DxilHash benchmark\n");
+
+  std::vector<std::unique_ptr<MemoryBuffer>> Files;
+  std::vector<std::vector<BYTE>> Generated;
+  std::vector<const BYTE *> Data;
+  std::vector<UINT32> Sizes;
+  if (!InputFilenames.empty()) {
+    for (const std::string &Filename : InputFilenames) {
+      ErrorOr<std::unique_ptr<MemoryBuffer>> Buf =
+          MemoryBuffer::getFileOrSTDIN(Filename);
+      if (!Buf) {
+        errs() << "Failed to read " << Filename << ": "
+               << Buf.getError().message() << "\n";
+        return 1;
+      }
+      Files.push_back(std::move(*Buf));
+      Data.push_back((const BYTE *)Files.back()->getBufferStart());
+      Sizes.push_back((UINT32)Files.back()->getBufferSize());
+    }
+  } else {
+    for (unsigned i = 0; i < BufferCount; ++i) {
+      Generated.emplace_back(BufferSizeKB * 1024);
+      std::vector<BYTE> &Buf = Generated.back();
+      for (size_t j = 0; j < Buf.size(); ++j)
+        Buf[j] = (BYTE)(j * 31 + i);
+      Data.push_back(Buf.data());
+      Sizes.push_back((UINT32)Buf.size());
+    }
+  }
+
+  uint64_t TotalBytes = 0;
+  for (UINT32 Size : Sizes)
+    TotalBytes += Size;
+  TotalBytes *= Iterations;
+  outs() << Data.size() << " buffers, " << TotalBytes / Iterations
+         << " bytes, " << Iterations << " iterations\n";
+
+  HASH_FUNCTION_PROTO *pHash = Debug ? ComputeHashDebug : ComputeHashRetail;
+  std::vector<BYTE> SingleHashes(Data.size() * DXIL_CONTAINER_HASH_SIZE);
+  double Start = TimeRecord::getCurrentTime(true).getWallTime();
+  for (unsigned It = 0; It < Iterations; ++It) {
+    for (size_t i = 0; i < Data.size(); ++i)
+      pHash(Data[i], Sizes[i], &SingleHashes[i * DXIL_CONTAINER_HASH_SIZE]);
+  }
+  report("single", TimeRecord::getCurrentTime(false).getWallTime() - Start,
+         TotalBytes);
+
+  std::vector<BYTE> MultiHashes(Data.size() * DXIL_CONTAINER_HASH_SIZE);
+  Start = TimeRecord::getCurrentTime(true).getWallTime();
+  for (unsigned It = 0; It < Iterations; ++It) {
+    if (Debug)
+      ComputeHashDebugMultiple(Data.data(), Sizes.data(), (UINT32)Data.size(),
+                               MultiHashes.data());
+    else
+      ComputeHashRetailMultiple(Data.data(), Sizes.data(),
+                                (UINT32)Data.size(), MultiHashes.data());
+  }
+  report("multi", TimeRecord::getCurrentTime(false).getWallTime() - Start,
+         TotalBytes);
+
+  if (SingleHashes != MultiHashes) {
+    errs() << "Single and multi-buffer hashes differ\n";
+    return 1;
+  }
+  return 0;
+}
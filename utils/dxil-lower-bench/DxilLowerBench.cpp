@@ -0,0 +1,138 @@
+//===- DxilLowerBench - Benchmark lowering HL operations to DXIL ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program lowers the HL operations of the given high-level IR files, for
+// instance the output of dxc -fcgl or the .ll files under
+// tools/clang/test/CodeGenDXIL that run -dxilgen, and outputs the time spent
+// in TranslateBuiltinOperations per call site. Lowering rewrites the module,
+// so each iteration parses the files again; only lowering is timed.
+//
+//===----------------------------------------------------------------------===//
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/HLSL/HLModule.h"
+#include "dxc/HLSL/HLOperationLower.h"
+#include "dxc/HLSL/HLOperations.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+static cl::list<std::string> InputFilenames(cl::Positional, cl::OneOrMore,
+                                            cl::desc("<IR files>"));
+
+static cl::opt<unsigned> Iterations("iterations",
+                                    cl::desc("Number of times to lower"),
+                                    cl::init(10));
+
+static double now() { return TimeRecord::getCurrentTime(false).getWallTime(); }
+
+// Counts the calls that TranslateBuiltinOperations rewrites. Handle creation
+// and annotation are lowered later by DxilGenerationPass.
+static uint64_t CountCallSites(Module &M) {
+  uint64_t NumCalls = 0;
+  for (Function &F : M) {
+    if (!F.isDeclaration())
+      continue;
+    switch (GetHLOpcodeGroup(&F)) {
+    case HLOpcodeGroup::NotHL:
+    case HLOpcodeGroup::HLCreateHandle:
+    case HLOpcodeGroup::HLAnnotateHandle:
+      break;
+    default:
+      NumCalls += F.getNumUses();
+    }
+  }
+  return NumCalls;
+}
+
+int main(int argc, char **argv) {
+  llvm::sys::fs::MSFileSystem *msfPtr;
+  if (!SUCCEEDED(CreateMSFileSystemForDisk(&msfPtr)))
+    return 1;
+  std::unique_ptr<llvm::sys::fs::MSFileSystem> msf(msfPtr);
+  llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+  llvm::STDStreamCloser stdStreamCloser;
+
+  cl::ParseCommandLineOptions(argc, argv, "HL operation lowering benchmark\n");
+
+  std::vector<std::unique_ptr<MemoryBuffer>> Buffers;
+  for (const std::string &Filename : InputFilenames) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+        MemoryBuffer::getFile(Filename);
+    if (!Buffer) {
+      errs() << "Cannot read " << Filename << "\n";
+      return 1;
+    }
+    Buffers.push_back(std::move(*Buffer));
+  }
+
+  uint64_t NumCalls = 0;
+  double Total = 0, Best = 0;
+  for (unsigned It = 0; It < Iterations; ++It) {
+    // Each module gets its own context; lowering looks up named types such as
+    // dx.types.Handle, which would be renamed if modules shared a context.
+    std::vector<std::unique_ptr<LLVMContext>> Contexts;
+    std::vector<std::unique_ptr<Module>> Modules;
+    for (const std::unique_ptr<MemoryBuffer> &Buffer : Buffers) {
+      SMDiagnostic Err;
+      Contexts.emplace_back(new LLVMContext);
+      std::unique_ptr<Module> M =
+          parseIR(Buffer->getMemBufferRef(), Err, *Contexts.back());
+      if (!M) {
+        errs() << "Skipping " << Buffer->getBufferIdentifier() << ": "
+               << Err.getMessage() << "\n";
+        continue;
+      }
+      Modules.push_back(std::move(M));
+    }
+
+    NumCalls = 0;
+    double Time = 0;
+    for (std::unique_ptr<Module> &M : Modules) {
+      // Modules that are already DXIL have nothing to lower.
+      uint64_t ModuleCalls = CountCallSites(*M);
+      if (ModuleCalls == 0)
+        continue;
+      NumCalls += ModuleCalls;
+      HLModule &HLM = M->GetOrCreateHLModule();
+      std::unordered_set<Instruction *> UpdateCounterSet;
+      double Start = now();
+      TranslateBuiltinOperations(HLM, nullptr, UpdateCounterSet);
+      Time += now() - Start;
+    }
+    Total += Time;
+    if (It == 0 || Time < Best)
+      Best = Time;
+  }
+
+  outs() << Buffers.size() << " modules, " << NumCalls << " call sites, "
+         << Iterations << " iterations\n";
+  if (NumCalls == 0)
+    return 0;
+  outs() << "mean: " << format("%.1f", Total * 1e9 / Iterations / NumCalls)
+         << " ns per call site\n";
+  outs() << "best: " << format("%.1f", Best * 1e9 / NumCalls)
+         << " ns per call site\n";
+  return 0;
+}
@@ -0,0 +1,83 @@
+//===- DxilOpBench - Benchmark DXIL operation function lookups ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program looks up the float overloads of a few DXIL operations with
+// hlsl::OP::GetOpFunc, then the op class of the resulting functions with
+// hlsl::OP::GetOpCodeClass, and outputs the time spent in each.
+//
+//===----------------------------------------------------------------------===//
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Type.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+
+using namespace llvm;
+using namespace hlsl;
+
+static cl::opt<unsigned> Iterations("iterations",
+                                    cl::desc("Number of lookups of each kind"),
+                                    cl::init(20000000));
+
+static void report(StringRef Name, double Seconds) {
+  outs() << Name << ": " << format("%.1f", Seconds * 1000) << " ms\n";
+}
+
+int main(int argc, char **argv) {
+  llvm::sys::fs::MSFileSystem *msfPtr;
+  if (!SUCCEEDED(CreateMSFileSystemForDisk(&msfPtr)))
+    return 1;
+  std::unique_ptr<llvm::sys::fs::MSFileSystem> msf(msfPtr);
+  llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+  llvm::STDStreamCloser stdStreamCloser;
+
+  cl::ParseCommandLineOptions(argc, argv, "DXIL operation lookup benchmark\n");
+
+  LLVMContext Ctx;
+  Module M("dxil-op-bench", Ctx);
+  OP HlslOP(Ctx, &M);
+  Type *F32 = Type::getFloatTy(Ctx);
+  const OP::OpCode OpCodes[] = {OP::OpCode::Sin, OP::OpCode::FMax,
+                                OP::OpCode::Dot3};
+  const unsigned NumOpCodes = sizeof(OpCodes) / sizeof(OpCodes[0]);
+  Function *Funcs[NumOpCodes];
+  for (unsigned i = 0; i < NumOpCodes; ++i)
+    Funcs[i] = HlslOP.GetOpFunc(OpCodes[i], F32);
+
+  // Sum the results so the lookups are not optimized away.
+  uintptr_t Sum = 0;
+  double Start = TimeRecord::getCurrentTime(true).getWallTime();
+  for (unsigned It = 0; It < Iterations; ++It)
+    Sum += (uintptr_t)HlslOP.GetOpFunc(OpCodes[It % NumOpCodes], F32);
+  report("GetOpFunc", TimeRecord::getCurrentTime(false).getWallTime() - Start);
+
+  Start = TimeRecord::getCurrentTime(true).getWallTime();
+  for (unsigned It = 0; It < Iterations; ++It) {
+    OP::OpCodeClass OpClass;
+    if (HlslOP.GetOpCodeClass(Funcs[It % NumOpCodes], OpClass))
+      Sum += (unsigned)OpClass;
+  }
+  report("GetOpCodeClass",
+         TimeRecord::getCurrentTime(false).getWallTime() - Start);
+
+  if (Sum == 0) {
+    errs() << "No DXIL operation functions were found\n";
+    return 1;
+  }
+  return 0;
+}
@@ -1040,6 +1040,42 @@ def get_hlsl_intrinsics():
     return result
 
 
+def get_hlsl_intrinsic_name_indices():
+    # For each table, the positions of its entries ordered by the name used to
+    # look them up, then by position, so Sema can binary search by name and
+    # still find the first entry of a name in table order.
+    db = get_db_hlsl()
+    tables = {}
+    ns_order = []
+    for i in sorted(db.intrinsics, key=lambda x: x.key):
+        if i.ns not in tables:
+            tables[i.ns] = (i.vulkanSpecific, [])
+            ns_order.append(i.ns)
+        name = i.params[0].name
+        if name == i.name and i.hidden:
+            name = "$hidden$" + name
+        tables[i.ns][1].append(name)
+    result = "\n//\n// Name indices\n//\n\n"
+    lookup = "static const UINT *GetIntrinsicNameIndex(const HLSL_INTRINSIC *table) {\n"
+    for ns in ns_order:
+        is_vk, names = tables[ns]
+        order = sorted(range(len(names)), key=lambda idx: (names[idx], idx))
+        text = "static const UINT g_%s_NameIndex[] = {\n" % ns
+        for start in range(0, len(order), 16):
+            text += "    %s,\n" % ", ".join(str(idx) for idx in order[start : start + 16])
+        text += "};\n"
+        text += "static_assert(_countof(g_%s_NameIndex) == _countof(g_%s), " % (ns, ns)
+        text += '"otherwise name index is out of sync");\n\n'
+        entry = "  if (table == g_%s)\n    return g_%s_NameIndex;\n" % (ns, ns)
+        if is_vk:
+            text = "#ifdef ENABLE_SPIRV_CODEGEN\n" + text + "#endif // ENABLE_SPIRV_CODEGEN\n\n"
+            entry = "#ifdef ENABLE_SPIRV_CODEGEN\n" + entry + "#endif // ENABLE_SPIRV_CODEGEN\n"
+        result += text
+        lookup += entry
+    lookup += "  return nullptr;\n}\n"
+    return result + lookup
+
+
 # SPIRV Change Starts
 def wrap_with_ifdef_if_vulkan_specific(intrinsic, text):
     if intrinsic.vulkanSpecific:
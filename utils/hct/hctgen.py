@@ -127,6 +127,7 @@ def writeDxilIntrinsicTables(args):
     out = openOutput(args)
     printHeader(out, "gen_intrin_main_tables_15.h")
     out.write(get_hlsl_intrinsics())
+    out.write(get_hlsl_intrinsic_name_indices())
     out.write(get_hlsl_intrinsic_stats())
     return 0
 